@@ -0,0 +1,109 @@
+#include "ofxDepthCodec.h"
+
+namespace {
+	// 0, -1, 1, -2, 2 ... to 0, 1, 2, 3, 4 ...
+	inline unsigned short zigzag(unsigned short delta) {
+		return (unsigned short)((delta << 1) ^ (0 - (delta >> 15)));
+	}
+
+	inline unsigned short unzigzag(unsigned short value) {
+		return (unsigned short)((value >> 1) ^ (0 - (value & 1)));
+	}
+}
+
+//--------------------------------------------------------------------
+ofxDepthCodec::ofxDepthCodec() {
+	hashTable.assign(ofxLz4::HASH_SIZE, 0);
+}
+
+//--------------------------------------------------------------------
+void ofxDepthCodec::encodeDepth(const unsigned short* depth, const unsigned short* reference, size_t numPixels, vector<unsigned char>& out) {
+	planes.resize(numPixels * 2);
+	unsigned char* low = numPixels > 0 ? &planes[0] : NULL;
+	unsigned char* high = low + numPixels;
+
+	unsigned short previous = 0;
+	for(size_t i = 0; i < numPixels; i++) {
+		unsigned short prediction = reference != NULL ? reference[i] : previous;
+		unsigned short value = zigzag((unsigned short)(depth[i] - prediction));
+		low[i] = (unsigned char)value;
+		high[i] = (unsigned char)(value >> 8);
+		previous = depth[i];
+	}
+	compress(out);
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthCodec::decodeDepth(const unsigned char* data, size_t size, const unsigned short* reference, unsigned short* depth, size_t numPixels) {
+	planes.resize(numPixels * 2);
+	if(numPixels == 0 || !ofxLz4::decompress(data, size, &planes[0], planes.size())) {
+		return false;
+	}
+	const unsigned char* low = &planes[0];
+	const unsigned char* high = low + numPixels;
+
+	if(reference != NULL) {
+		for(size_t i = 0; i < numPixels; i++) {
+			depth[i] = (unsigned short)(reference[i] + unzigzag((unsigned short)(low[i] | (high[i] << 8))));
+		}
+	} else {
+		unsigned short previous = 0;
+		for(size_t i = 0; i < numPixels; i++) {
+			previous = (unsigned short)(previous + unzigzag((unsigned short)(low[i] | (high[i] << 8))));
+			depth[i] = previous;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthCodec::encodeVideo(const unsigned char* video, const unsigned char* reference, size_t numPixels, int channels, vector<unsigned char>& out) {
+	size_t numBytes = numPixels * channels;
+	planes.resize(numBytes);
+	unsigned char* deltas = numBytes > 0 ? &planes[0] : NULL;
+
+	if(reference != NULL) {
+		for(size_t i = 0; i < numBytes; i++) {
+			deltas[i] = (unsigned char)(video[i] - reference[i]);
+		}
+	} else {
+		for(size_t i = 0; i < (size_t)channels && i < numBytes; i++) {
+			deltas[i] = video[i];
+		}
+		for(size_t i = channels; i < numBytes; i++) {
+			deltas[i] = (unsigned char)(video[i] - video[i - channels]);
+		}
+	}
+	compress(out);
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthCodec::decodeVideo(const unsigned char* data, size_t size, const unsigned char* reference, unsigned char* video, size_t numPixels, int channels) {
+	size_t numBytes = numPixels * channels;
+	planes.resize(numBytes);
+	if(numBytes == 0 || !ofxLz4::decompress(data, size, &planes[0], planes.size())) {
+		return false;
+	}
+	const unsigned char* deltas = &planes[0];
+
+	if(reference != NULL) {
+		for(size_t i = 0; i < numBytes; i++) {
+			video[i] = (unsigned char)(reference[i] + deltas[i]);
+		}
+	} else {
+		for(size_t i = 0; i < (size_t)channels && i < numBytes; i++) {
+			video[i] = deltas[i];
+		}
+		for(size_t i = channels; i < numBytes; i++) {
+			video[i] = (unsigned char)(video[i - channels] + deltas[i]);
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthCodec::compress(vector<unsigned char>& out) {
+	out.resize(ofxLz4::compressBound(planes.size()));
+	size_t size = ofxLz4::compress(planes.empty() ? NULL : &planes[0], planes.size(), &out[0], &hashTable[0]);
+	out.resize(size);
+}
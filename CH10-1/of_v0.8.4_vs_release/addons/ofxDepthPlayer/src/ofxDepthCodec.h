@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxLz4.h"
+
+/// lossless compression of depth & video frames for ofxDepthRecorder
+///
+/// each frame is turned into deltas first, either against the pixel to its
+/// left (keyframes) or against the same pixel of the previous frame, which
+/// leaves mostly small numbers for a still camera:
+///
+/// - depth deltas are zigzag coded (0, -1, 1, -2 ... to 0, 1, 2, 3 ...) and
+///   split into a plane of low bytes and one of high bytes, the high plane
+///   is nearly all zeros
+/// - video deltas are taken per channel, modulo 256
+///
+/// then compressed with ofxLz4 (block format, readable by any LZ4 decoder)
+///
+/// the scratch buffers are kept between frames, so use one codec per thread
+class ofxDepthCodec {
+
+public:
+
+	ofxDepthCodec();
+
+	/// compress depth, reference is the previous frame or NULL for a keyframe
+	void encodeDepth(const unsigned short* depth, const unsigned short* reference, size_t numPixels, vector<unsigned char>& out);
+
+	/// decompress into depth, reference must be the frame the data was
+	/// encoded against and may be depth itself
+	bool decodeDepth(const unsigned char* data, size_t size, const unsigned short* reference, unsigned short* depth, size_t numPixels);
+
+	/// same for video with the given number of channels
+	void encodeVideo(const unsigned char* video, const unsigned char* reference, size_t numPixels, int channels, vector<unsigned char>& out);
+	bool decodeVideo(const unsigned char* data, size_t size, const unsigned char* reference, unsigned char* video, size_t numPixels, int channels);
+
+private:
+
+	void compress(vector<unsigned char>& out);
+
+	vector<unsigned char> planes;  ///< deltas before compression
+	vector<unsigned int> hashTable;  ///< kept for ofxLz4::compress()
+};
@@ -0,0 +1,1046 @@
+#include "ofxDepthPlayer.h"
+
+#ifdef TARGET_WIN32
+	#include <windows.h>
+#else
+	#include <chrono>
+#endif
+
+namespace {
+	const char MAGIC[4] = {'O', 'F', 'D', 'P'};
+	const unsigned int VERSION = 1;
+
+	// all little endian, as written by the machine recording
+	struct Header {
+		char magic[4];
+		unsigned int version;
+		int width, height, videoChannels, keyframeInterval;
+		int reserved[2];
+	};
+
+	// the file is the header followed by chunks:
+	// FRAM  a FrameRecord, the compressed depth and the compressed video
+	// INDX  an entry per frame, written by close()
+	// IEND  the file offset of the INDX chunk, always last
+	struct ChunkHeader {
+		char id[4];
+		unsigned int size;  ///< bytes after the chunk header
+	};
+
+	const unsigned int KEYFRAME = 1;
+
+	// larger than any depth camera, bounds the sizes read from a file
+	const int MAX_SIZE = 4096;
+
+	struct FrameRecord {
+		double time;
+		unsigned int flags;
+		unsigned int depthSize, videoSize;
+		unsigned int reserved;
+	};
+
+	const unsigned int MAX_DEPTH_LEVELS = 10001;
+
+	bool seek(FILE* file, unsigned long long offset, int origin=SEEK_SET) {
+#ifdef TARGET_WIN32
+		return _fseeki64(file, (long long)offset, origin) == 0;
+#else
+		return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+	}
+
+	unsigned long long tell(FILE* file) {
+#ifdef TARGET_WIN32
+		return _ftelli64(file);
+#else
+		return ftello(file);
+#endif
+	}
+
+	bool isChunk(const ChunkHeader& chunk, const char* id) {
+		return memcmp(chunk.id, id, 4) == 0;
+	}
+
+	// the record and the compressed depth & video fill the chunk exactly,
+	// each size is checked on its own as their sum can wrap around in 32 bit
+	bool isValidFrame(const FrameRecord& record, unsigned int chunkSize) {
+		return chunkSize >= sizeof(record)
+			&& record.depthSize <= chunkSize - sizeof(record)
+			&& record.videoSize == chunkSize - sizeof(record) - record.depthSize;
+	}
+}
+
+//--------------------------------------------------------------------
+ofxDepthRecorder::ofxDepthRecorder() {
+	file = NULL;
+	width = 0;
+	height = 0;
+	videoChannels = 0;
+	keyframeInterval = 30;
+	numBytes = 0;
+	numRawBytes = 0;
+	numFrameBytes = 0;
+}
+
+//--------------------------------------------------------------------
+ofxDepthRecorder::~ofxDepthRecorder() {
+	close();
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthRecorder::open(const string& fileName, int width, int height, int videoChannels, int keyframeInterval) {
+	close();
+	if(width <= 0 || height <= 0 || width > MAX_SIZE || height > MAX_SIZE
+	   || videoChannels < 0 || videoChannels > 4) {
+		ofLogError("ofxDepthRecorder") << "open(): can't record " << width << "x" << height
+			<< " with " << videoChannels << " video channels";
+		return false;
+	}
+	file = fopen(ofToDataPath(fileName).c_str(), "wb");
+	if(file == NULL) {
+		ofLogError("ofxDepthRecorder") << "open(): could not open \"" << fileName << "\"";
+		return false;
+	}
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.width = width;
+	header.height = height;
+	header.videoChannels = videoChannels;
+	header.keyframeInterval = MAX(keyframeInterval, 1);
+	if(fwrite(&header, sizeof(header), 1, file) != 1) {
+		ofLogError("ofxDepthRecorder") << "open(): could not write to \"" << fileName << "\"";
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	this->videoChannels = videoChannels;
+	this->keyframeInterval = header.keyframeInterval;
+	numBytes = sizeof(header);
+	numRawBytes = 0;
+	numFrameBytes = 0;
+	index.clear();
+	previousDepth.allocate(width, height, 1);
+	if(videoChannels > 0) {
+		previousVideo.allocate(width, height, videoChannels);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthRecorder::close() {
+	if(file == NULL) {
+		return;
+	}
+	unsigned long long indexOffset = numBytes;
+	if(!writeChunk("INDX", index.empty() ? NULL : &index[0], index.size() * sizeof(ofxDepthIndexEntry))
+	   || !writeChunk("IEND", &indexOffset, sizeof(indexOffset))) {
+		ofLogError("ofxDepthRecorder") << "close(): could not write the index, it will be rebuilt on playback";
+	}
+	fclose(file);
+	file = NULL;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthRecorder::isOpen() const {
+	return file != NULL;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthRecorder::write(const ofShortPixels& depth, double time) {
+	if(videoChannels > 0) {
+		ofLogWarning("ofxDepthRecorder") << "write(): the file was opened with video, skipping a frame without";
+		return false;
+	}
+	return write(depth, ofPixels(), time);
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthRecorder::write(const ofShortPixels& depth, const ofPixels& video, double time) {
+	if(file == NULL) {
+		return false;
+	}
+	if(depth.getWidth() != width || depth.getHeight() != height || depth.getNumChannels() != 1) {
+		ofLogWarning("ofxDepthRecorder") << "write(): depth is "
+			<< depth.getWidth() << "x" << depth.getHeight() << "x" << depth.getNumChannels()
+			<< ", expected " << width << "x" << height << "x1, skipping";
+		return false;
+	}
+	if(videoChannels > 0 && (video.getWidth() != width || video.getHeight() != height
+	   || video.getNumChannels() != videoChannels)) {
+		ofLogWarning("ofxDepthRecorder") << "write(): video is "
+			<< video.getWidth() << "x" << video.getHeight() << "x" << video.getNumChannels()
+			<< ", expected " << width << "x" << height << "x" << videoChannels << ", skipping";
+		return false;
+	}
+
+	size_t numPixels = (size_t)width * height;
+	bool bKeyframe = index.size() % keyframeInterval == 0;
+	codec.encodeDepth(depth.getPixels(), bKeyframe ? NULL : previousDepth.getPixels(), numPixels, depthData);
+	videoData.clear();
+	if(videoChannels > 0) {
+		codec.encodeVideo(video.getPixels(), bKeyframe ? NULL : previousVideo.getPixels(), numPixels, videoChannels, videoData);
+	}
+
+	FrameRecord record;
+	memset(&record, 0, sizeof(record));
+	record.time = time;
+	record.flags = bKeyframe ? KEYFRAME : 0;
+	record.depthSize = depthData.size();
+	record.videoSize = videoData.size();
+
+	ofxDepthIndexEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.offset = numBytes;
+	entry.time = time;
+	entry.flags = record.flags;
+
+	if(!writeChunk("FRAM", &record, sizeof(record), &depthData[0], depthData.size(),
+				   videoData.empty() ? NULL : &videoData[0], videoData.size())) {
+		ofLogError("ofxDepthRecorder") << "write(): could not write frame " << index.size() << ", closing";
+		close();
+		return false;
+	}
+	index.push_back(entry);
+	numRawBytes += numPixels * (sizeof(unsigned short) + videoChannels);
+	numFrameBytes += numBytes - entry.offset;
+
+	memcpy(previousDepth.getPixels(), depth.getPixels(), numPixels * sizeof(unsigned short));
+	if(videoChannels > 0) {
+		memcpy(previousVideo.getPixels(), video.getPixels(), numPixels * videoChannels);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthRecorder::getNumFrames() const {
+	return index.size();
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxDepthRecorder::getNumBytes() const {
+	return numBytes;
+}
+
+//--------------------------------------------------------------------
+float ofxDepthRecorder::getCompressionRatio() const {
+	return numFrameBytes > 0 ? (float)((double)numRawBytes / numFrameBytes) : 0;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthRecorder::writeChunk(const char* id, const void* data, size_t size, const void* data2, size_t size2, const void* data3, size_t size3) {
+	ChunkHeader chunk;
+	memcpy(chunk.id, id, 4);
+	chunk.size = size + size2 + size3;
+	if(fwrite(&chunk, sizeof(chunk), 1, file) != 1
+	   || (size > 0 && fwrite(data, size, 1, file) != 1)
+	   || (size2 > 0 && fwrite(data2, size2, 1, file) != 1)
+	   || (size3 > 0 && fwrite(data3, size3, 1, file) != 1)) {
+		return false;
+	}
+	numBytes += sizeof(chunk) + chunk.size;
+	return true;
+}
+
+//--------------------------------------------------------------------
+ofxDepthReader::ofxDepthReader() {
+	file = NULL;
+	width = 0;
+	height = 0;
+	videoChannels = 0;
+	frame = -1;
+}
+
+//--------------------------------------------------------------------
+ofxDepthReader::~ofxDepthReader() {
+	close();
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthReader::open(const string& fileName) {
+	close();
+	this->fileName = fileName;
+	file = fopen(ofToDataPath(fileName).c_str(), "rb");
+	if(file == NULL) {
+		ofLogError("ofxDepthReader") << "open(): could not open \"" << fileName << "\"";
+		return false;
+	}
+	Header header;
+	if(fread(&header, sizeof(header), 1, file) != 1
+	   || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+	   || header.width <= 0 || header.height <= 0 || header.width > MAX_SIZE || header.height > MAX_SIZE
+	   || header.videoChannels < 0 || header.videoChannels > 4) {
+		ofLogError("ofxDepthReader") << "open(): \"" << fileName << "\" is not a depth recording";
+		close();
+		return false;
+	}
+	width = header.width;
+	height = header.height;
+	videoChannels = header.videoChannels;
+
+	if(!readIndex() && !rebuildIndex()) {
+		close();
+		return false;
+	}
+	if(index.empty() || !(index[0].flags & KEYFRAME)) {
+		ofLogError("ofxDepthReader") << "open(): \"" << fileName << "\" has no frames";
+		close();
+		return false;
+	}
+
+	depth.allocate(width, height, 1);
+	if(videoChannels > 0) {
+		video.allocate(width, height, videoChannels);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthReader::close() {
+	if(file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+	index.clear();
+	frame = -1;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthReader::isOpen() const {
+	return file != NULL;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthReader::getNumFrames() const {
+	return index.size();
+}
+
+//--------------------------------------------------------------------
+int ofxDepthReader::getWidth() const {
+	return width;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthReader::getHeight() const {
+	return height;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthReader::getVideoChannels() const {
+	return videoChannels;
+}
+
+//--------------------------------------------------------------------
+double ofxDepthReader::getFrameTime(int frame) const {
+	if(frame < 0 || frame >= (int)index.size()) {
+		return 0;
+	}
+	return index[frame].time;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthReader::getFrameAt(double time) const {
+	int first = 0, last = index.size();
+	while(first < last) {
+		int middle = (first + last) / 2;
+		if(index[middle].time <= time) {
+			first = middle + 1;
+		} else {
+			last = middle;
+		}
+	}
+	return MAX(first - 1, 0);
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthReader::read(int frame) {
+	if(file == NULL || frame < 0 || frame >= (int)index.size()) {
+		return false;
+	}
+	if(frame == this->frame) {
+		return true;
+	}
+
+	// decode forward from the last keyframe, or from the frame held if that's closer
+	int start = frame;
+	while(!(index[start].flags & KEYFRAME)) {
+		start--;
+	}
+	if(this->frame >= start && this->frame < frame) {
+		start = this->frame + 1;
+	}
+	for(int i = start; i <= frame; i++) {
+		if(!decode(i)) {
+			ofLogError("ofxDepthReader") << "read(): frame " << i << " of \"" << fileName << "\" is damaged";
+			this->frame = -1;
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthReader::getFrame() const {
+	return frame;
+}
+
+//--------------------------------------------------------------------
+ofShortPixels& ofxDepthReader::getDepthPixelsRef() {
+	return depth;
+}
+
+//--------------------------------------------------------------------
+ofPixels& ofxDepthReader::getPixelsRef() {
+	return video;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthReader::readIndex() {
+	ChunkHeader chunk;
+	unsigned long long indexOffset;
+	if(!seek(file, 0, SEEK_END)) {
+		return false;
+	}
+	unsigned long long fileSize = tell(file);
+	unsigned long long endSize = sizeof(chunk) + sizeof(indexOffset);
+	if(fileSize < sizeof(Header) + sizeof(chunk) + endSize
+	   || !seek(file, fileSize - endSize)
+	   || fread(&chunk, sizeof(chunk), 1, file) != 1 || !isChunk(chunk, "IEND") || chunk.size != sizeof(indexOffset)
+	   || fread(&indexOffset, sizeof(indexOffset), 1, file) != 1
+	   || indexOffset < sizeof(Header) || indexOffset > fileSize - endSize - sizeof(chunk)
+	   || !seek(file, indexOffset)
+	   || fread(&chunk, sizeof(chunk), 1, file) != 1 || !isChunk(chunk, "INDX")
+	   || chunk.size != fileSize - endSize - sizeof(chunk) - indexOffset
+	   || chunk.size % sizeof(ofxDepthIndexEntry) != 0) {
+		return false;
+	}
+
+	index.resize(chunk.size / sizeof(ofxDepthIndexEntry));
+	if(!index.empty() && fread(&index[0], sizeof(ofxDepthIndexEntry), index.size(), file) != index.size()) {
+		index.clear();
+		return false;
+	}
+	for(size_t i = 0; i < index.size(); i++) {
+		if(index[i].offset < sizeof(Header) || index[i].offset > indexOffset
+		   || indexOffset - index[i].offset < sizeof(chunk) + sizeof(FrameRecord)) {
+			index.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthReader::rebuildIndex() {
+	index.clear();
+	if(!seek(file, 0, SEEK_END)) {
+		return false;
+	}
+	unsigned long long fileSize = tell(file);
+
+	// walk the chunks up to the first one cut off
+	unsigned long long offset = sizeof(Header);
+	ChunkHeader chunk;
+	while(seek(file, offset) && fread(&chunk, sizeof(chunk), 1, file) == 1
+		  && offset + sizeof(chunk) + chunk.size <= fileSize) {
+		if(isChunk(chunk, "FRAM")) {
+			FrameRecord record;
+			if(chunk.size < sizeof(record) || fread(&record, sizeof(record), 1, file) != 1
+			   || !isValidFrame(record, chunk.size)) {
+				break;
+			}
+			ofxDepthIndexEntry entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.offset = offset;
+			entry.time = record.time;
+			entry.flags = record.flags;
+			index.push_back(entry);
+		} else if(isChunk(chunk, "INDX") || isChunk(chunk, "IEND")) {
+			break;
+		}
+		offset += sizeof(chunk) + chunk.size;
+	}
+	ofLogWarning("ofxDepthReader") << "open(): \"" << fileName << "\" has no index, the recording was not closed? "
+		<< "found " << index.size() << " frames";
+	return true;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthReader::decode(int frame) {
+	const ofxDepthIndexEntry& entry = index[frame];
+	size_t numPixels = (size_t)width * height;
+	ChunkHeader chunk;
+	if(!seek(file, entry.offset) || fread(&chunk, sizeof(chunk), 1, file) != 1
+	   || !isChunk(chunk, "FRAM") || chunk.size < sizeof(FrameRecord)) {
+		return false;
+	}
+	// no frame compresses to more than this, don't allocate for a corrupt size
+	size_t maxSize = sizeof(FrameRecord) + ofxLz4::compressBound(numPixels * 2)
+		+ ofxLz4::compressBound(numPixels * videoChannels);
+	if(chunk.size > maxSize) {
+		return false;
+	}
+	data.resize(chunk.size);
+	if(fread(&data[0], chunk.size, 1, file) != 1) {
+		return false;
+	}
+	FrameRecord record;
+	memcpy(&record, &data[0], sizeof(record));
+	if(!isValidFrame(record, chunk.size) || (videoChannels > 0) != (record.videoSize > 0)) {
+		return false;
+	}
+
+	// delta frames are decoded in place over the frame before
+	bool bKeyframe = (record.flags & KEYFRAME) != 0;
+	if(!bKeyframe && this->frame != frame - 1) {
+		return false;
+	}
+	const unsigned char* depthData = &data[sizeof(record)];
+	if(!codec.decodeDepth(depthData, record.depthSize, bKeyframe ? NULL : depth.getPixels(), depth.getPixels(), numPixels)) {
+		return false;
+	}
+	if(videoChannels > 0 && !codec.decodeVideo(depthData + record.depthSize, record.videoSize,
+											   bKeyframe ? NULL : video.getPixels(), video.getPixels(), numPixels, videoChannels)) {
+		return false;
+	}
+	this->frame = frame;
+	return true;
+}
+
+//--------------------------------------------------------------------
+ofxDepthPlayer::ofxDepthPlayer() {
+	bLoaded = false;
+	width = 0;
+	height = 0;
+	videoChannels = 0;
+	numFrames = 0;
+	firstTime = 0;
+	duration = 0;
+	numPrefetch = 8;
+
+	seekFrame = -1;
+	generation = 0;
+	bLoop = true;
+	bDone = false;
+
+	mode = PLAYBACK_REALTIME;
+	speed = 1;
+	bPaused = false;
+	bClockNeedsReset = true;
+	clockStart = 0;
+	clockOrigin = 0;
+	currentFrame = -1;
+	currentTime = 0;
+	currentPlayTime = 0;
+	bIsFrameNew = false;
+	numDroppedFrames = 0;
+
+	bUseTexture = true;
+	nearClipping = 500;
+	farClipping = 4000;
+	bNearWhite = true;
+	updateDepthLookupTable();
+}
+
+//--------------------------------------------------------------------
+ofxDepthPlayer::~ofxDepthPlayer() {
+	close();
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::load(const string& fileName) {
+	close();
+	if(!reader.open(fileName)) {
+		return false;
+	}
+	width = reader.getWidth();
+	height = reader.getHeight();
+	videoChannels = reader.getVideoChannels();
+	numFrames = reader.getNumFrames();
+	firstTime = reader.getFrameTime(0);
+	duration = reader.getFrameTime(numFrames - 1) - firstTime;
+
+	depthPixelsRaw.allocate(width, height, 1);
+	depthPixelsRaw.set(0);
+	depthPixels.allocate(width, height, 1);
+	depthPixels.set(0);
+	distancePixels.allocate(width, height, 1);
+	distancePixels.set(0);
+	// as many channels as recorded (swapped with the slots), black RGB without video
+	videoPixels.allocate(width, height, videoChannels > 0 ? videoChannels : 3);
+	videoPixels.set(0);
+	if(bUseTexture) {
+		depthTex.allocate(width, height, GL_LUMINANCE);
+		videoTex.allocate(videoPixels);
+	}
+
+	slots.resize(numPrefetch);
+	freeSlots.clear();
+	for(int i = 0; i < numPrefetch; i++) {
+		slots[i].depth.allocate(width, height, 1);
+		if(videoChannels > 0) {
+			slots[i].video.allocate(width, height, videoChannels);
+		}
+		freeSlots.push_back(i);
+	}
+	ready.clear();
+	seekFrame = 0;
+	bDone = false;
+
+	bClockNeedsReset = true;
+	currentFrame = -1;
+	currentTime = 0;
+	currentPlayTime = 0;
+	bIsFrameNew = false;
+	numDroppedFrames = 0;
+
+	bLoaded = true;
+	startThread(true, false); // blocking, not verbose
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::close() {
+	if(!bLoaded) {
+		return;
+	}
+	stopThread();
+	waitForThread(false);
+	reader.close();
+	slots.clear();
+	ready.clear();
+	freeSlots.clear();
+	bLoaded = false;
+	bIsFrameNew = false;
+	currentFrame = -1;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::isLoaded() {
+	return bLoaded;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::isFrameNew() {
+	return bIsFrameNew;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::update() {
+	bIsFrameNew = false;
+	if(!bLoaded) {
+		return;
+	}
+
+	lock();
+	int slot = -1;
+	if(!ready.empty()) {
+		if(bClockNeedsReset) {
+			// first frame after load() or a seek, start the clock at it
+			slot = ready.front();
+			ready.pop_front();
+			resetClock(slots[slot].playTime);
+			bClockNeedsReset = false;
+		} else if(!bPaused && mode == PLAYBACK_FAST) {
+			slot = ready.front();
+			ready.pop_front();
+		} else if(!bPaused) {
+			// the last frame that's due, the ones before it are too late
+			double playTime = clockOrigin + (now() - clockStart) * speed;
+			while(!ready.empty() && slots[ready.front()].playTime <= playTime) {
+				if(slot >= 0) {
+					freeSlots.push_back(slot);
+					numDroppedFrames++;
+				}
+				slot = ready.front();
+				ready.pop_front();
+			}
+		}
+	}
+	if(slot >= 0) {
+		Slot& frame = slots[slot];
+		swap(depthPixelsRaw, frame.depth);
+		if(videoChannels > 0) {
+			swap(videoPixels, frame.video);
+		}
+		currentFrame = frame.frame;
+		currentTime = frame.time;
+		currentPlayTime = frame.playTime;
+		freeSlots.push_back(slot);
+	}
+	unlock();
+
+	if(slot < 0) {
+		return;
+	}
+	bIsFrameNew = true;
+
+	const unsigned short* raw = depthPixelsRaw.getPixels();
+	unsigned char* gray = depthPixels.getPixels();
+	float* distance = distancePixels.getPixels();
+	const unsigned char* lookup = &depthLookupTable[0];
+	size_t numPixels = (size_t)width * height;
+	for(size_t i = 0; i < numPixels; i++) {
+		gray[i] = lookup[MIN(raw[i], (unsigned short)(MAX_DEPTH_LEVELS - 1))];
+		distance[i] = raw[i];
+	}
+
+	if(bUseTexture) {
+		depthTex.loadData(depthPixels.getPixels(), width, height, GL_LUMINANCE);
+		if(videoChannels > 0) {
+			videoTex.loadData(videoPixels);
+		}
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setPlaybackMode(PlaybackMode mode) {
+	if(mode != this->mode) {
+		this->mode = mode;
+		resetClock(currentPlayTime);
+	}
+}
+
+//--------------------------------------------------------------------
+ofxDepthPlayer::PlaybackMode ofxDepthPlayer::getPlaybackMode() {
+	return mode;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setSpeed(float speed) {
+	if(speed <= 0) {
+		ofLogWarning("ofxDepthPlayer") << "setSpeed(): speed must be > 0, use setPaused() to stop";
+		return;
+	}
+	resetClock(bPaused ? currentPlayTime : clockOrigin + (now() - clockStart) * this->speed);
+	this->speed = speed;
+}
+
+//--------------------------------------------------------------------
+float ofxDepthPlayer::getSpeed() {
+	return speed;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setPaused(bool bPaused) {
+	if(bPaused != this->bPaused) {
+		this->bPaused = bPaused;
+		resetClock(currentPlayTime);
+	}
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::isPaused() {
+	return bPaused;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setLoop(bool bLoop) {
+	lock();
+	this->bLoop = bLoop;
+	if(bLoop) {
+		bDone = false;
+	}
+	unlock();
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::isLoop() {
+	lock();
+	bool bLoop = this->bLoop;
+	unlock();
+	return bLoop;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::isDone() {
+	lock();
+	bool bDone = this->bDone && ready.empty();
+	unlock();
+	return bDone;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setFrame(int frame) {
+	if(!bLoaded) {
+		return;
+	}
+	lock();
+	seekFrame = MAX(MIN(frame, numFrames - 1), 0);
+	generation++;
+	freeSlots.insert(freeSlots.end(), ready.begin(), ready.end());
+	ready.clear();
+	bDone = false;
+	unlock();
+	bClockNeedsReset = true;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setTime(double seconds) {
+	setFrame(reader.getFrameAt(firstTime + seconds));
+}
+
+//--------------------------------------------------------------------
+int ofxDepthPlayer::getCurrentFrame() {
+	return currentFrame;
+}
+
+//--------------------------------------------------------------------
+int ofxDepthPlayer::getNumFrames() {
+	return numFrames;
+}
+
+//--------------------------------------------------------------------
+double ofxDepthPlayer::getTime() {
+	return currentTime;
+}
+
+//--------------------------------------------------------------------
+double ofxDepthPlayer::getDuration() {
+	return duration;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setNumPrefetchFrames(int numFrames) {
+	if(bLoaded) {
+		ofLogWarning("ofxDepthPlayer") << "setNumPrefetchFrames(): set before load()";
+		return;
+	}
+	numPrefetch = MAX(numFrames, 1);
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxDepthPlayer::getNumDroppedFrames() {
+	return numDroppedFrames;
+}
+
+//--------------------------------------------------------------------
+unsigned char* ofxDepthPlayer::getPixels() {
+	return videoPixels.getPixels();
+}
+
+//--------------------------------------------------------------------
+ofPixels& ofxDepthPlayer::getPixelsRef() {
+	return videoPixels;
+}
+
+//--------------------------------------------------------------------
+unsigned char* ofxDepthPlayer::getDepthPixels() {
+	return depthPixels.getPixels();
+}
+
+//--------------------------------------------------------------------
+ofPixels& ofxDepthPlayer::getDepthPixelsRef() {
+	return depthPixels;
+}
+
+//--------------------------------------------------------------------
+unsigned short* ofxDepthPlayer::getRawDepthPixels() {
+	return depthPixelsRaw.getPixels();
+}
+
+//--------------------------------------------------------------------
+ofShortPixels& ofxDepthPlayer::getRawDepthPixelsRef() {
+	return depthPixelsRaw;
+}
+
+//--------------------------------------------------------------------
+float* ofxDepthPlayer::getDistancePixels() {
+	return distancePixels.getPixels();
+}
+
+//--------------------------------------------------------------------
+ofFloatPixels& ofxDepthPlayer::getDistancePixelsRef() {
+	return distancePixels;
+}
+
+//--------------------------------------------------------------------
+float ofxDepthPlayer::getDistanceAt(int x, int y) {
+	return depthPixelsRaw[y * width + x];
+}
+
+//--------------------------------------------------------------------
+ofTexture& ofxDepthPlayer::getTextureReference() {
+	return videoTex;
+}
+
+//--------------------------------------------------------------------
+ofTexture& ofxDepthPlayer::getDepthTextureReference() {
+	return depthTex;
+}
+
+//--------------------------------------------------------------------
+bool ofxDepthPlayer::hasVideo() {
+	return videoChannels > 0;
+}
+
+//--------------------------------------------------------------------
+float ofxDepthPlayer::getWidth() {
+	return width;
+}
+
+//--------------------------------------------------------------------
+float ofxDepthPlayer::getHeight() {
+	return height;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setDepthClipping(float nearClip, float farClip) {
+	nearClipping = nearClip;
+	farClipping = farClip;
+	updateDepthLookupTable();
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::enableDepthNearValueWhite(bool bEnabled) {
+	bNearWhite = bEnabled;
+	updateDepthLookupTable();
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::setUseTexture(bool bUse) {
+	bUseTexture = bUse;
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::draw(float x, float y, float w, float h) {
+	if(bUseTexture && videoChannels > 0) {
+		videoTex.draw(x, y, w, h);
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::draw(float x, float y) {
+	draw(x, y, (float)width, (float)height);
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::drawDepth(float x, float y, float w, float h) {
+	if(bUseTexture) {
+		depthTex.draw(x, y, w, h);
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::drawDepth(float x, float y) {
+	drawDepth(x, y, (float)width, (float)height);
+}
+
+//--------------------------------------------------------------------
+double ofxDepthPlayer::measureDecodeRate(const string& fileName, int numPasses) {
+	ofxDepthReader reader;
+	if(!reader.open(fileName)) {
+		return 0;
+	}
+	int numFrames = reader.getNumFrames();
+	double start = now();
+	for(int pass = 0; pass < numPasses; pass++) {
+		for(int i = 0; i < numFrames; i++) {
+			if(!reader.read(i)) {
+				return 0;
+			}
+		}
+	}
+	double elapsed = now() - start;
+	return elapsed > 0 ? numFrames * numPasses / elapsed : 0;
+}
+
+/* ***** PRIVATE ***** */
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::threadedFunction() {
+	int frame = 0;
+	double loopOffset = 0;
+	double frameDuration = numFrames > 1 ? duration / (numFrames - 1) : 1 / 30.0;
+
+	while(isThreadRunning()) {
+		lock();
+		if(seekFrame >= 0) {
+			frame = seekFrame;
+			seekFrame = -1;
+			loopOffset = 0;
+		}
+		unsigned int frameGeneration = generation;
+		bool bLoop = this->bLoop;
+		int slot = -1;
+		if(!bDone && !freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		if(slot >= 0 && frame >= numFrames && !bLoop) {
+			freeSlots.push_back(slot);
+			slot = -1;
+			bDone = true;
+		}
+		unlock();
+
+		if(slot < 0) {
+			// all frames decoded ahead, or at the end
+			sleep(1);
+			continue;
+		}
+
+		if(frame >= numFrames) {
+			loopOffset += duration + frameDuration;
+			frame = 0;
+		}
+		Slot& next = slots[slot];
+		bool bRead = reader.read(frame);
+		if(bRead) {
+			size_t numPixels = (size_t)width * height;
+			memcpy(next.depth.getPixels(), reader.getDepthPixelsRef().getPixels(), numPixels * sizeof(unsigned short));
+			if(videoChannels > 0) {
+				memcpy(next.video.getPixels(), reader.getPixelsRef().getPixels(), numPixels * videoChannels);
+			}
+			next.frame = frame;
+			next.time = reader.getFrameTime(frame) - firstTime;
+			next.playTime = next.time + loopOffset;
+		}
+
+		lock();
+		if(frameGeneration != generation) {
+			// seeked meanwhile
+			freeSlots.push_back(slot);
+		} else if(!bRead) {
+			freeSlots.push_back(slot);
+			bDone = true;
+		} else {
+			ready.push_back(slot);
+			frame++;
+		}
+		unlock();
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::resetClock(double playTime) {
+	clockOrigin = playTime;
+	clockStart = now();
+}
+
+//--------------------------------------------------------------------
+void ofxDepthPlayer::updateDepthLookupTable() {
+	unsigned char nearColor = bNearWhite ? 255 : 0;
+	unsigned char farColor = bNearWhite ? 0 : 255;
+	depthLookupTable.resize(MAX_DEPTH_LEVELS);
+	depthLookupTable[0] = 0;
+	for(unsigned int i = 1; i < MAX_DEPTH_LEVELS; i++) {
+		depthLookupTable[i] = ofMap(i, nearClipping, farClipping, nearColor, farColor, true);
+	}
+}
+
+//--------------------------------------------------------------------
+double ofxDepthPlayer::now() {
+#ifdef TARGET_WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxBase3DVideo.h"
+#include "ofxDepthCodec.h"
+
+#include <cstdio>
+#include <deque>
+
+/// a frame in the index at the end of a recording
+struct ofxDepthIndexEntry {
+	unsigned long long offset;  ///< of the frame's chunk in the file
+	double time;
+	unsigned int flags;
+	unsigned int reserved;
+};
+
+/// writes depth frames (16 bit, usually mm) and optionally video frames
+/// with their timestamps to a file ofxDepthPlayer can play back
+///
+/// every frame is compressed losslessly with ofxDepthCodec, against the
+/// previous frame or, every keyframeInterval frames, on its own so playback
+/// can seek. The file is a header and a chunk per frame, close() appends
+/// an index of the frames. A file cut short without its index (ie. the app
+/// crashed) still plays, the index is rebuilt from the chunks.
+///
+/// compression runs in write(), a few ms for a 640x480 depth & rgb frame
+///
+///     recorder.open("take1.depth", kinect.width, kinect.height);
+///
+///     // update()
+///     if(kinect.isFrameNewDepth()) {
+///         recorder.write(kinect.getRawDepthPixelsRef(), kinect.getPixelsRef(), kinect.getDepthTime());
+///     }
+///
+class ofxDepthRecorder {
+
+public:
+
+	ofxDepthRecorder();
+	~ofxDepthRecorder();
+
+	/// videoChannels is 3 for rgb, 1 for infrared or 0 to record depth only,
+	/// video frames must have the same size as the depth frames
+	bool open(const string& fileName, int width, int height, int videoChannels=3, int keyframeInterval=30);
+
+	/// writes the index and closes the file
+	void close();
+	bool isOpen() const;
+
+	/// add a frame, time is in seconds on any clock
+	bool write(const ofShortPixels& depth, const ofPixels& video, double time);
+	bool write(const ofShortPixels& depth, double time); ///< depth only files
+
+	int getNumFrames() const;
+
+	/// bytes written so far
+	unsigned long long getNumBytes() const;
+
+	/// raw frame size / stored frame size so far
+	float getCompressionRatio() const;
+
+private:
+
+	bool writeChunk(const char* id, const void* data, size_t size, const void* data2=NULL, size_t size2=0, const void* data3=NULL, size_t size3=0);
+
+	FILE* file;
+	int width, height, videoChannels, keyframeInterval;
+	unsigned long long numBytes, numRawBytes, numFrameBytes;
+
+	vector<ofxDepthIndexEntry> index;
+
+	ofxDepthCodec codec;
+	vector<unsigned char> depthData, videoData;
+	ofShortPixels previousDepth;
+	ofPixels previousVideo;
+};
+
+/// reads the frames of a file written by ofxDepthRecorder one at a time
+///
+/// reading the next frame decodes one frame, any other frame decodes forward
+/// from the keyframe before it
+class ofxDepthReader {
+
+public:
+
+	ofxDepthReader();
+	~ofxDepthReader();
+
+	bool open(const string& fileName);
+	void close();
+	bool isOpen() const;
+
+	int getNumFrames() const;
+	int getWidth() const;
+	int getHeight() const;
+	int getVideoChannels() const; ///< 0 if the file has no video
+
+	/// the recorded time of a frame in seconds
+	double getFrameTime(int frame) const;
+
+	/// the last frame recorded at or before time, 0 if time is before the first
+	int getFrameAt(double time) const;
+
+	/// decode a frame into the depth & video pixels
+	bool read(int frame);
+
+	/// the frame read last, -1 if none
+	int getFrame() const;
+
+	ofShortPixels& getDepthPixelsRef();
+	ofPixels& getPixelsRef();
+
+private:
+
+	bool readIndex();
+	bool rebuildIndex();
+	bool decode(int frame);
+
+	vector<ofxDepthIndexEntry> index;
+
+	FILE* file;
+	string fileName;
+	int width, height, videoChannels;
+	int frame;
+
+	ofxDepthCodec codec;
+	vector<unsigned char> data;
+	ofShortPixels depth;
+	ofPixels video;
+};
+
+/// plays back a file written by ofxDepthRecorder through the same interface
+/// as ofxKinect
+///
+/// frames are decoded ahead on a thread of their own, update() only swaps in
+/// the next decoded frame and converts the depth to grayscale & distance.
+///
+/// there are two modes:
+/// - PLAYBACK_REALTIME shows the frames at their recorded times, if update()
+///   falls behind it skips frames, like a live camera would
+/// - PLAYBACK_FAST shows every frame once, one per update(), as fast as the
+///   app runs. Handy for repeatable performance tests
+///
+class ofxDepthPlayer : public ofxBase3DVideo, protected ofThread {
+
+public:
+
+	enum PlaybackMode {
+		PLAYBACK_REALTIME,
+		PLAYBACK_FAST
+	};
+
+	ofxDepthPlayer();
+	virtual ~ofxDepthPlayer();
+
+/// \section Main
+
+	/// open a file and start decoding from the first frame
+	bool load(const string& fileName);
+
+	/// stop decoding and close the file
+	void close();
+
+	bool isLoaded();
+
+	/// is the current frame new?
+	bool isFrameNew();
+
+	/// takes the next due frame into the pixels & textures
+	void update();
+
+/// \section Playback
+
+	void setPlaybackMode(PlaybackMode mode);
+	PlaybackMode getPlaybackMode();
+
+	/// 2 plays twice as fast, default is 1, realtime mode only
+	void setSpeed(float speed);
+	float getSpeed();
+
+	void setPaused(bool bPaused);
+	bool isPaused();
+
+	/// start over at the end of the file, default is true
+	void setLoop(bool bLoop);
+	bool isLoop();
+
+	/// is the file played to the end? (never with loop on)
+	bool isDone();
+
+	/// seek to a frame or a time in seconds since the first frame,
+	/// the frame is shown on one of the next updates
+	void setFrame(int frame);
+	void setTime(double seconds);
+
+	/// the current frame, -1 before the first update()
+	int getCurrentFrame();
+	int getNumFrames();
+
+	/// the recorded time of the current frame in seconds since the first frame
+	double getTime();
+	double getDuration();
+
+	/// how many frames are decoded ahead, default is 8, set before load()
+	void setNumPrefetchFrames(int numFrames);
+
+	/// frames decoded but skipped in realtime mode since load()
+	unsigned long long getNumDroppedFrames();
+
+/// \section Pixel Data
+
+	/// the video pixels, black for depth only files
+	unsigned char* getPixels();
+	ofPixels& getPixelsRef();
+
+	/// grayscale depth, see setDepthClipping()
+	unsigned char* getDepthPixels();
+	ofPixels& getDepthPixelsRef();
+
+	/// the recorded depth values
+	unsigned short* getRawDepthPixels();
+	ofShortPixels& getRawDepthPixelsRef();
+
+	/// depth as float, in mm for a recorded ofxKinect
+	float* getDistancePixels();
+	ofFloatPixels& getDistancePixelsRef();
+	float getDistanceAt(int x, int y);
+
+	ofTexture& getTextureReference();
+	ofTexture& getDepthTextureReference();
+
+	bool hasVideo();
+	float getWidth();
+	float getHeight();
+
+/// \section Grayscale Depth Value
+
+	/// same as ofxKinect, default is 50cm - 4m with near white
+	void setDepthClipping(float nearClip=500, float farClip=4000);
+	void enableDepthNearValueWhite(bool bEnabled=true);
+
+/// \section Draw
+
+	/// enable/disable frame loading into textures on update()
+	void setUseTexture(bool bUse);
+
+	void draw(float x, float y, float w, float h);
+	void draw(float x, float y);
+	void drawDepth(float x, float y, float w, float h);
+	void drawDepth(float x, float y);
+
+/// \section Benchmark
+
+	/// decode all frames of a file in order on the calling thread,
+	/// returns the decoded frames per second, 0 if the file can't be read
+	static double measureDecodeRate(const string& fileName, int numPasses=1);
+
+private:
+
+	void threadedFunction();
+	void resetClock(double playTime);
+	void updateDepthLookupTable();
+	static double now();
+
+	ofxDepthReader reader;  ///< decodes on the thread, the index is read only once loaded
+	bool bLoaded;
+	int width, height, videoChannels, numFrames;
+	double firstTime, duration;
+	int numPrefetch;
+
+	/// a decoded frame
+	struct Slot {
+		ofShortPixels depth;
+		ofPixels video;
+		int frame;
+		double time;      ///< recorded time since the first frame
+		double playTime;  ///< same, but counting on when looping
+	};
+	vector<Slot> slots;
+
+	/// shared, under lock()
+	std::deque<int> ready;    ///< decoded slots in play order
+	vector<int> freeSlots;
+	int seekFrame;            ///< -1 if no seek pending
+	unsigned int generation;  ///< counts seeks, frames decoded before a seek are thrown away
+	bool bLoop;
+	bool bDone;
+
+	/// main thread only
+	PlaybackMode mode;
+	float speed;
+	bool bPaused;
+	bool bClockNeedsReset;
+	double clockStart, clockOrigin;  ///< play time clockOrigin was at clockStart
+	int currentFrame;
+	double currentTime, currentPlayTime;
+	bool bIsFrameNew;
+	unsigned long long numDroppedFrames;
+
+	ofShortPixels depthPixelsRaw;
+	ofPixels depthPixels;
+	ofFloatPixels distancePixels;
+	ofPixels videoPixels;
+	ofTexture depthTex, videoTex;
+	bool bUseTexture;
+
+	vector<unsigned char> depthLookupTable;
+	float nearClipping, farClipping;
+	bool bNearWhite;
+};
@@ -13,22 +13,9 @@ void testApp::setup()
     particles.init(w, h);
     
     // initial positions
-    // use new to allocate 4,000,000 floats on the heap rather than
-    // the stack
-    float* particlePosns = new float[w * h * 4];
-    for (unsigned y = 0; y < h; ++y)
-    {
-        for (unsigned x = 0; x < w; ++x)
-        {
-            unsigned idx = y * w + x;
-            particlePosns[idx * 4] = 400.f * x / (float)w - 200.f; // particle x
-            particlePosns[idx * 4 + 1] = 400.f * y / (float)h - 200.f; // particle y
-            particlePosns[idx * 4 + 2] = 0.f; // particle z
-            particlePosns[idx * 4 + 3] = 0.f; // dummy
-        }
-    }
-    particles.loadDataTexture(ofxGpuParticles::POSITION, particlePosns);
-    delete[] particlePosns;
+    // generated a band of rows at a time straight into the texture,
+    // so no 16MB position array is needed
+    particles.loadDataTexture(ofxGpuParticles::POSITION, itg::ParticleGrid(w, h, -200.f, -200.f, 400.f, 400.f));
     
     // initial velocities
     particles.zeroDataTexture(ofxGpuParticles::VELOCITY);
@@ -0,0 +1,172 @@
+/*
+ *  CpuParticles.cpp
+ */
+#include "CpuParticles.h"
+
+namespace itg
+{
+    CpuParticles::CpuParticles() : width(0), height(0), numFloats(0)
+    {
+    }
+
+    void CpuParticles::init(unsigned width, unsigned height, ofPrimitiveMode primitive, unsigned numDataTextures, unsigned numThreads)
+    {
+        this->width = width;
+        this->height = height;
+        numFloats = width * height * FLOATS_PER_TEXEL;
+
+        kernel.allocate(width * height, numDataTextures, numThreads);
+
+        // vertices are overwritten with the positions in draw()
+        mesh.clear();
+        mesh.getVertices().resize(width * height);
+        mesh.setMode(primitive);
+        mesh.setUsage(GL_DYNAMIC_DRAW);
+    }
+
+    void CpuParticles::update()
+    {
+        ofNotifyEvent(updateEvent, uniforms, this);
+        kernel.update(uniforms);
+    }
+
+    void CpuParticles::draw()
+    {
+        const float* x = kernel.getChannel(POSITION, 0);
+        const float* y = kernel.getChannel(POSITION, 1);
+        const float* z = kernel.getChannel(POSITION, 2);
+        vector<ofVec3f>& vertices = mesh.getVertices();
+        for (unsigned i = 0; i < vertices.size(); ++i)
+        {
+            vertices[i].set(x[i], y[i], z[i]);
+        }
+        mesh.draw();
+    }
+
+    void CpuParticles::loadDataTexture(unsigned idx, float* data,
+                                       unsigned x, unsigned y, unsigned width, unsigned height)
+    {
+        if (idx < kernel.getNumTextures())
+        {
+            if (!width) width = this->width;
+            if (!height) height = this->height;
+            for (unsigned row = 0; row < height; ++row)
+            {
+                kernel.setTexels(idx, data + row * width * FLOATS_PER_TEXEL, (y + row) * this->width + x, width);
+            }
+        }
+        else ofLogError() << "Trying to load data from array into non-existent buffer.";
+    }
+
+    void CpuParticles::loadDataTexture(unsigned idx, const ParticleGrid& grid)
+    {
+        if (grid.getWidth() != width || grid.getHeight() != height)
+        {
+            ofLogError() << "Particle grid is " << grid.getWidth() << "x" << grid.getHeight()
+                         << ", expected " << width << "x" << height;
+        }
+        else if (idx < kernel.getNumTextures())
+        {
+            // straight into the channels
+            float* r = kernel.getChannel(idx, 0);
+            float* g = kernel.getChannel(idx, 1);
+            float* b = kernel.getChannel(idx, 2);
+            float* a = kernel.getChannel(idx, 3);
+            for (unsigned y = 0, i = 0; y < height; ++y)
+            {
+                for (unsigned x = 0; x < width; ++x, ++i)
+                {
+                    ofVec3f p = grid.getPosition(x, y);
+                    r[i] = p.x;
+                    g[i] = p.y;
+                    b[i] = p.z;
+                    a[i] = 0.f;
+                }
+            }
+        }
+        else ofLogError() << "Trying to load data from array into non-existent buffer.";
+    }
+
+    void CpuParticles::zeroDataTexture(unsigned idx,
+                                       unsigned x, unsigned y, unsigned width, unsigned height)
+    {
+        if (!width) width = this->width;
+        if (!height) height = this->height;
+        vector<float> zeroes(width * FLOATS_PER_TEXEL, 0.f);
+        for (unsigned row = 0; row < height; ++row)
+        {
+            loadDataTexture(idx, &zeroes[0], x, y + row, width, 1);
+        }
+    }
+
+    void CpuParticles::readDataTexture(unsigned idx, float* data) const
+    {
+        kernel.getTexels(idx, data, 0, width * height);
+    }
+
+    void CpuParticles::save(const string& fileName)
+    {
+        ParticleSnapshot snapshot;
+        readSnapshot(snapshot);
+        if (!snapshot.saveText(ofToDataPath(fileName, true)))
+        {
+            ofLogError() << "Could not save particle data to " << ofToDataPath(fileName, true);
+        }
+    }
+
+    void CpuParticles::saveBinary(const string& fileName, ParticleSnapshot::Format format, ParticleSnapshot::Compression compression)
+    {
+        ParticleSnapshot snapshot;
+        readSnapshot(snapshot);
+        if (!snapshot.saveBinary(ofToDataPath(fileName, true), format, compression))
+        {
+            ofLogError() << "Could not save particle data to " << ofToDataPath(fileName, true);
+        }
+    }
+
+    void CpuParticles::load(const string& fileName)
+    {
+        const string path = ofToDataPath(fileName, true);
+        ParticleSnapshot snapshot;
+        if (ParticleSnapshot::isBinary(path))
+        {
+            if (!snapshot.loadBinary(path))
+            {
+                ofLogError() << "Could not load particle data from " << path;
+                return;
+            }
+            if (snapshot.getWidth() != width || snapshot.getHeight() != height)
+            {
+                ofLogError() << "Particle data in " << path << " is " << snapshot.getWidth() << "x" << snapshot.getHeight()
+                             << ", expected " << width << "x" << height;
+                return;
+            }
+        }
+        else
+        {
+            snapshot.allocate(width, height, kernel.getNumTextures());
+            if (!snapshot.loadText(path))
+            {
+                ofLogError() << "Could not load particle data from " << path;
+                return;
+            }
+        }
+
+        // const, so mapped data is read without a copy
+        const ParticleSnapshot& loaded = snapshot;
+        for (unsigned i = 0; i < loaded.getNumTextures(); ++i)
+        {
+            if (i < kernel.getNumTextures()) kernel.setTexels(i, loaded.getData(i), 0, width * height);
+            else ofLogError() << "Trying to load data from file into non-existent buffer.";
+        }
+    }
+
+    void CpuParticles::readSnapshot(ParticleSnapshot& snapshot) const
+    {
+        snapshot.allocate(width, height, kernel.getNumTextures());
+        for (unsigned i = 0; i < snapshot.getNumTextures(); ++i)
+        {
+            readDataTexture(i, snapshot.getData(i));
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ *  CpuParticles.h
+ *
+ *  Same interface as GpuParticles, but the update runs on the CPU with
+ *  ParticleKernel, so it also works headless and without GL 3.
+ *  Only draw() needs a GL context.
+ */
+#pragma once
+
+#include "ofMain.h"
+#include "ParticleGrid.h"
+#include "ParticleKernel.h"
+#include "ParticleSnapshot.h"
+
+namespace itg
+{
+    class CpuParticles
+    {
+    public:
+        typedef ParticleKernel::Uniforms Uniforms;
+        static const unsigned FLOATS_PER_TEXEL = 4;
+
+        // you don't have to use these but makes
+        // code more readable
+        enum DataTextureIndex
+        {
+            POSITION,
+            VELOCITY
+        };
+
+        CpuParticles();
+
+        // numThreads = 0 uses one thread per core
+        void init(unsigned width, unsigned height,
+                  ofPrimitiveMode primitive = OF_PRIMITIVE_POINTS, unsigned numDataTextures = 2, unsigned numThreads = 0);
+        void update();
+        void draw();
+
+        void loadDataTexture(unsigned idx, float* data,
+                             unsigned x = 0, unsigned y = 0, unsigned width = 0, unsigned height = 0);
+        void loadDataTexture(unsigned idx, const ParticleGrid& grid);
+        void zeroDataTexture(unsigned idx,
+                             unsigned x = 0, unsigned y = 0, unsigned width = 0, unsigned height = 0);
+        // copies a whole data texture out as RGBA floats
+        void readDataTexture(unsigned idx, float* data) const;
+
+        unsigned getWidth() const { return width; }
+        unsigned getHeight() const { return height; }
+        unsigned getNumFloats() const { return numFloats; }
+
+        // listen to this event to set the uniforms, it is called with the
+        // same setUniform names as the update shader of GpuParticles
+        ofEvent<Uniforms> updateEvent;
+
+        Uniforms& getUniformsRef() { return uniforms; }
+        ParticleKernel& getKernelRef() { return kernel; }
+        ofVboMesh& getMeshRef() { return mesh; }
+
+        void save(const string& fileName);
+        void saveBinary(const string& fileName,
+                        ParticleSnapshot::Format format = ParticleSnapshot::FLOAT32,
+                        ParticleSnapshot::Compression compression = ParticleSnapshot::NONE);
+        void load(const string& fileName);
+
+    private:
+        void readSnapshot(ParticleSnapshot& snapshot) const;
+
+        ParticleKernel kernel;
+        Uniforms uniforms;
+        ofVboMesh mesh;
+        unsigned width, height, numFloats;
+    };
+}
@@ -65,14 +65,7 @@ namespace itg
         
         // mesh
         mesh.clear();
-        for (int y = 0; y < height; ++y)
-        {
-            for (int x = 0; x < width; ++x)
-            {
-                mesh.addVertex(ofVec3f(200.f * x / (float)width - 100.f, 200.f * y / (float)height - 100.f, -500.f));
-                mesh.addTexCoord(ofVec2f(x, y));
-            }
-        }
+        ParticleGrid(width, height, -100.f, -100.f, 200.f, 200.f, -500.f).getMesh(mesh, true);
         mesh.setMode(primitive);
         
         // shaders
@@ -140,6 +133,25 @@ namespace itg
         else ofLogError() << "Trying to load data from array into non-existent buffer.";
     }
     
+    void GpuParticles::loadDataTexture(unsigned idx, const ParticleGrid& grid)
+    {
+        if (grid.getWidth() != width || grid.getHeight() != height)
+        {
+            ofLogError() << "Particle grid is " << grid.getWidth() << "x" << grid.getHeight()
+                         << ", expected " << width << "x" << height;
+            return;
+        }
+        
+        const unsigned rowsPerBand = max(TEXELS_PER_BAND / max(width, 1u), 1u);
+        vector<float> band(min(rowsPerBand, height) * width * FLOATS_PER_TEXEL);
+        for (unsigned y = 0; y < height; y += rowsPerBand)
+        {
+            unsigned numRows = min(rowsPerBand, height - y);
+            grid.getTexels(&band[0], y, numRows);
+            loadDataTexture(idx, &band[0], 0, y, width, numRows);
+        }
+    }
+    
     void GpuParticles::zeroDataTexture(unsigned idx,
                                        unsigned x, unsigned y, unsigned width, unsigned height)
     {
@@ -171,48 +183,72 @@ namespace itg
     
     void GpuParticles::save(const string& fileName)
     {
-        ofstream fileStream(ofToDataPath(fileName, true).c_str());
-        if (fileStream.is_open())
+        ParticleSnapshot snapshot;
+        readSnapshot(snapshot);
+        if (!snapshot.saveText(ofToDataPath(fileName, true)))
         {
-            for (unsigned i = 0; i < fbos[currentReadFbo].getNumTextures(); ++i)
-            {
-                if (i) fileStream << "|";
-                ofFloatPixels pixels;
-                fbos[currentReadFbo].getTextureReference(i).readToPixels(pixels);
-                for (unsigned j = 0; j < pixels.size(); ++j)
-                {
-                    if (j) fileStream << ",";
-                    fileStream << pixels[j];
-                }
-            }
-            fileStream.close();
+            ofLogError() << "Could not save particle data to " << ofToDataPath(fileName, true);
+        }
+    }
+    
+    void GpuParticles::saveBinary(const string& fileName, ParticleSnapshot::Format format, ParticleSnapshot::Compression compression)
+    {
+        ParticleSnapshot snapshot;
+        readSnapshot(snapshot);
+        if (!snapshot.saveBinary(ofToDataPath(fileName, true), format, compression))
+        {
+            ofLogError() << "Could not save particle data to " << ofToDataPath(fileName, true);
         }
-        else ofLogError() << "Could not save particle data to " << ofToDataPath(fileName, true);
     }
     
     void GpuParticles::load(const string& fileName)
     {
-        ifstream fileStream(ofToDataPath(fileName, true).c_str());
-        if (fileStream.is_open())
+        const string path = ofToDataPath(fileName, true);
+        ParticleSnapshot snapshot;
+        if (ParticleSnapshot::isBinary(path))
         {
-            string data((istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
-            vector<string> textureData = ofSplitString(data, "|");
-            for (unsigned i = 0; i < textureData.size(); ++i)
+            if (!snapshot.loadBinary(path))
+            {
+                ofLogError() << "Could not load particle data from " << path;
+                return;
+            }
+            if (snapshot.getWidth() != width || snapshot.getHeight() != height)
             {
-                if (i < fbos[currentReadFbo].getNumTextures())
-                {
-                    vector<string> floatsAsText = ofSplitString(textureData[i], ",");
-                    vector<float> floats(floatsAsText.size(), 0);
-                    for (unsigned j = 0; j < floats.size(); ++j)
-                    {
-                        floats[j] = atof(floatsAsText[j].c_str());
-                    }
-                    loadDataTexture(i, &floats[0]);
-                }
-                else ofLogError() << "Trying to load data from file into non-existent buffer.";
+                ofLogError() << "Particle data in " << path << " is " << snapshot.getWidth() << "x" << snapshot.getHeight()
+                             << ", expected " << width << "x" << height;
+                return;
             }
-            fileStream.close();
         }
-        else ofLogError() << "Could not load particle data from " << ofToDataPath(fileName, true);
+        else
+        {
+            snapshot.allocate(width, height, fbos[currentReadFbo].getNumTextures());
+            if (!snapshot.loadText(path))
+            {
+                ofLogError() << "Could not load particle data from " << path;
+                return;
+            }
+        }
+        loadSnapshot(snapshot);
+    }
+    
+    void GpuParticles::readSnapshot(ParticleSnapshot& snapshot)
+    {
+        snapshot.allocate(width, height, fbos[currentReadFbo].getNumTextures());
+        ofFloatPixels pixels;
+        for (unsigned i = 0; i < snapshot.getNumTextures(); ++i)
+        {
+            fbos[currentReadFbo].getTextureReference(i).readToPixels(pixels);
+            memcpy(snapshot.getData(i), pixels.getPixels(), sizeof(float) * min((unsigned)pixels.size(), snapshot.getNumFloats()));
+        }
+    }
+    
+    void GpuParticles::loadSnapshot(const ParticleSnapshot& snapshot)
+    {
+        for (unsigned i = 0; i < snapshot.getNumTextures(); ++i)
+        {
+            // binary float32 data goes to the texture straight from the mapped file
+            if (i < fbos[currentReadFbo].getNumTextures()) loadDataTexture(i, const_cast<float*>(snapshot.getData(i)));
+            else ofLogError() << "Trying to load data from file into non-existent buffer.";
+        }
     }
 }
\ No newline at end of file
@@ -32,6 +32,8 @@
 #pragma once
 
 #include "ofMain.h"
+#include "ParticleGrid.h"
+#include "ParticleSnapshot.h"
 
 namespace itg
 {
@@ -45,6 +47,7 @@ namespace itg
         static const string UPDATE_SHADER_NAME;
         static const string DRAW_SHADER_NAME;
         static const unsigned FLOATS_PER_TEXEL = 4;
+        static const unsigned TEXELS_PER_BAND = 65536;
         
         // you don't have to use these but makes
         // code more readable
@@ -63,6 +66,8 @@ namespace itg
         
         void loadDataTexture(unsigned idx, float* data,
                              unsigned x = 0, unsigned y = 0, unsigned width = 0, unsigned height = 0);
+        // generates the grid a band of rows at a time, no full size array needed
+        void loadDataTexture(unsigned idx, const ParticleGrid& grid);
         void zeroDataTexture(unsigned idx,
                              unsigned x = 0, unsigned y = 0, unsigned width = 0, unsigned height = 0);
         
@@ -82,12 +87,20 @@ namespace itg
         ofShader& getUpdateShaderRef() { return updateShader; }
         ofShader& getDrawShaderRef() { return drawShader; }
         
+        // text format, kept for compatibility with old saves
         void save(const string& fileName);
+        // binary format, much smaller and faster to load, see ParticleSnapshot.h
+        void saveBinary(const string& fileName,
+                        ParticleSnapshot::Format format = ParticleSnapshot::FLOAT32,
+                        ParticleSnapshot::Compression compression = ParticleSnapshot::NONE);
+        // loads either format
         void load(const string& fileName);
         
     private:
         void texturedQuad(float x, float y, float width, float height, float s, float t);
         void setUniforms(ofShader& shader);
+        void readSnapshot(ParticleSnapshot& snapshot);
+        void loadSnapshot(const ParticleSnapshot& snapshot);
         
         ofFbo fbos[2];
         ofVboMesh mesh;
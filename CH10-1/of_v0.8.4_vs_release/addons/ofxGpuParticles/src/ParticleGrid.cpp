@@ -0,0 +1,77 @@
+/*
+ *  ParticleGrid.cpp
+ */
+#include "ParticleGrid.h"
+
+#include <thread>
+
+namespace itg
+{
+    ParticleGrid::ParticleGrid(unsigned width, unsigned height,
+                               float originX, float originY, float sizeX, float sizeY, float z) :
+        width(width), height(height), originX(originX), originY(originY), sizeX(sizeX), sizeY(sizeY), z(z)
+    {
+    }
+
+    ofVec3f ParticleGrid::getPosition(unsigned x, unsigned y) const
+    {
+        // same expression as the loops this replaces, so the positions are identical
+        return ofVec3f(sizeX * x / (float)width + originX, sizeY * y / (float)height + originY, z);
+    }
+
+    void ParticleGrid::getTexels(float* rgba, unsigned firstRow, unsigned numRows) const
+    {
+        for (unsigned y = firstRow; y < firstRow + numRows; ++y)
+        {
+            float py = sizeY * y / (float)height + originY;
+            for (unsigned x = 0; x < width; ++x, rgba += FLOATS_PER_TEXEL)
+            {
+                rgba[0] = sizeX * x / (float)width + originX;
+                rgba[1] = py;
+                rgba[2] = z;
+                rgba[3] = 0.f;
+            }
+        }
+    }
+
+    void ParticleGrid::getMesh(ofMesh& mesh, bool isParallel) const
+    {
+        // resize once, then write in place, no push_back per particle
+        mesh.getVertices().resize(width * height);
+        mesh.getTexCoords().resize(width * height);
+        if (!width || !height) return;
+        ofVec3f* vertices = &mesh.getVertices()[0];
+        ofVec2f* texCoords = &mesh.getTexCoords()[0];
+
+        unsigned numThreads = isParallel ? max(std::thread::hardware_concurrency(), 1u) : 1;
+        numThreads = min(numThreads, height);
+        if (numThreads <= 1)
+        {
+            getMeshRows(vertices, texCoords, 0, height);
+            return;
+        }
+
+        vector<std::thread> threads;
+        unsigned rowsPerThread = (height + numThreads - 1) / numThreads;
+        for (unsigned y = rowsPerThread; y < height; y += rowsPerThread)
+        {
+            threads.push_back(std::thread(&ParticleGrid::getMeshRows, this, vertices, texCoords, y, min(rowsPerThread, height - y)));
+        }
+        getMeshRows(vertices, texCoords, 0, rowsPerThread);
+        for (unsigned i = 0; i < threads.size(); ++i) threads[i].join();
+    }
+
+    void ParticleGrid::getMeshRows(ofVec3f* vertices, ofVec2f* texCoords, unsigned firstRow, unsigned numRows) const
+    {
+        vertices += firstRow * width;
+        texCoords += firstRow * width;
+        for (unsigned y = firstRow; y < firstRow + numRows; ++y)
+        {
+            for (unsigned x = 0; x < width; ++x)
+            {
+                *vertices++ = getPosition(x, y);
+                *texCoords++ = ofVec2f(x, y);
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ *  ParticleGrid.h
+ *
+ *  Particles laid out on a regular grid in the xy plane, one per texel.
+ *
+ *  Generates the data straight into its destination, either a band of
+ *  texture rows (see GpuParticles::loadDataTexture(idx, grid)) or the
+ *  vertex and texture coordinate arrays of an ofMesh, instead of going
+ *  through a full size temporary array or addVertex() per particle.
+ */
+#pragma once
+
+#include "ofMain.h"
+
+namespace itg
+{
+    class ParticleGrid
+    {
+    public:
+        static const unsigned FLOATS_PER_TEXEL = 4;
+
+        // texel (x, y) is at (originX + sizeX * x / width, originY + sizeY * y / height, z)
+        ParticleGrid(unsigned width, unsigned height,
+                     float originX, float originY, float sizeX, float sizeY, float z = 0.f);
+
+        unsigned getWidth() const { return width; }
+        unsigned getHeight() const { return height; }
+
+        ofVec3f getPosition(unsigned x, unsigned y) const;
+
+        // RGBA texels of rows [firstRow, firstRow + numRows), alpha is 0
+        void getTexels(float* rgba, unsigned firstRow, unsigned numRows) const;
+
+        // replaces the vertices and texture coordinates of the mesh,
+        // the texture coordinates are the texel coordinates (x, y)
+        void getMesh(ofMesh& mesh, bool isParallel = false) const;
+
+    private:
+        void getMeshRows(ofVec3f* vertices, ofVec2f* texCoords, unsigned firstRow, unsigned numRows) const;
+
+        unsigned width, height;
+        float originX, originY, sizeX, sizeY, z;
+    };
+}
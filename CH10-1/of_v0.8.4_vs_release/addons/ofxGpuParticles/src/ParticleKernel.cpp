@@ -0,0 +1,431 @@
+/*
+ *  ParticleKernel.cpp
+ *
+ *  The update follows the example update shader:
+ *
+ *      vec3 direction = mouse - pos;
+ *      float distSquared = dot(direction, direction);
+ *      float magnitude = attraction * (1.0 - distSquared / radiusSquared);
+ *      vec3 force = step(distSquared, radiusSquared) * magnitude * normalize(direction);
+ *      force += gravity;
+ *      vel += elapsed * force;
+ *      vel.x *= step(abs(pos.x), bounds.x) * 2.0 - 1.0;
+ *      vel.y *= step(abs(pos.y), bounds.y) * 2.0 - 1.0;
+ *      vel *= damping;
+ *      pos += elapsed * vel;
+ *
+ *  The SIMD paths use the same operations in the same order as the scalar
+ *  path (no reciprocal approximations), so all of them give the same result.
+ */
+#include "ParticleKernel.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if !defined(PARTICLES_NO_SIMD) && (defined(__AVX__) || defined(__AVX2__))
+    #define PARTICLES_USE_AVX
+    #include <immintrin.h>
+#elif !defined(PARTICLES_NO_SIMD) && (defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define PARTICLES_USE_SSE
+    #include <emmintrin.h>
+#endif
+
+namespace itg
+{
+    // particles are processed this many at a time, arrays are padded to it
+    static const unsigned SIMD_WIDTH = 8;
+
+    // fixed set of threads that share out the chunks of one update,
+    // the calling thread takes chunks too
+    class ParticleKernel::Workers
+    {
+    public:
+        typedef void (*Job)(void* context, unsigned index);
+
+        explicit Workers(unsigned numThreads) :
+            generation(0), isQuitting(false), numBusy(0), numJobs(0), job(0), context(0)
+        {
+            next = 0;
+            for (unsigned i = 1; i < numThreads; ++i) threads.push_back(std::thread(&Workers::loop, this));
+        }
+
+        ~Workers()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isQuitting = true;
+            }
+            started.notify_all();
+            for (unsigned i = 0; i < threads.size(); ++i) threads[i].join();
+        }
+
+        unsigned getNumThreads() const { return (unsigned)threads.size() + 1; }
+
+        void run(unsigned numJobs, Job job, void* context)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                this->numJobs = numJobs;
+                this->job = job;
+                this->context = context;
+                next = 0;
+                numBusy = (unsigned)threads.size();
+                ++generation;
+            }
+            started.notify_all();
+
+            work();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while (numBusy) finished.wait(lock);
+        }
+
+    private:
+        void loop()
+        {
+            unsigned seen = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while (generation == seen && !isQuitting) started.wait(lock);
+                    if (isQuitting) return;
+                    seen = generation;
+                }
+
+                work();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--numBusy == 0) finished.notify_one();
+            }
+        }
+
+        void work()
+        {
+            for (unsigned i = next++; i < numJobs; i = next++) job(context, i);
+        }
+
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable started, finished;
+        unsigned generation;
+        bool isQuitting;
+        unsigned numBusy;
+        std::atomic<unsigned> next;
+        unsigned numJobs;
+        Job job;
+        void* context;
+    };
+
+    ParticleKernel::Uniforms::Uniforms() :
+        radiusSquared(200.f * 200.f), elapsed(1.f / 60.f), attraction(500.f), damping(0.995f)
+    {
+        mouse[0] = mouse[1] = mouse[2] = 0.f;
+        gravity[0] = 0.f;
+        gravity[1] = -0.5f;
+        gravity[2] = 0.f;
+        bounds[0] = 512.f;
+        bounds[1] = 384.f;
+    }
+
+    void ParticleKernel::Uniforms::setUniform1f(const std::string& name, float v1)
+    {
+        if (name == "radiusSquared") radiusSquared = v1;
+        else if (name == "elapsed") elapsed = v1;
+        else if (name == "attraction") attraction = v1;
+        else if (name == "damping") damping = v1;
+    }
+
+    void ParticleKernel::Uniforms::setUniform2f(const std::string& name, float v1, float v2)
+    {
+        if (name == "bounds")
+        {
+            bounds[0] = v1;
+            bounds[1] = v2;
+        }
+    }
+
+    void ParticleKernel::Uniforms::setUniform3f(const std::string& name, float v1, float v2, float v3)
+    {
+        float v[3] = { v1, v2, v3 };
+        setUniform3fv(name, v);
+    }
+
+    void ParticleKernel::Uniforms::setUniform3fv(const std::string& name, const float* v, int count)
+    {
+        if (count < 1) return;
+        if (name == "mouse") memcpy(mouse, v, sizeof(mouse));
+        else if (name == "gravity") memcpy(gravity, v, sizeof(gravity));
+    }
+
+    ParticleKernel::ParticleKernel() :
+        numParticles(0), numTextures(0), stride(0), channels(0), workers(0), currentUniforms(0)
+    {
+    }
+
+    ParticleKernel::~ParticleKernel()
+    {
+        delete workers;
+    }
+
+    void ParticleKernel::allocate(unsigned numParticles, unsigned numTextures, unsigned numThreads)
+    {
+        this->numParticles = numParticles;
+        this->numTextures = std::max(numTextures, 2u);
+        stride = (numParticles + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+
+        // one extra SIMD_WIDTH of floats to align the first channel to 32 bytes
+        buffer.assign((size_t)this->numTextures * FLOATS_PER_TEXEL * stride + SIMD_WIDTH, 0.f);
+        size_t misalignment = ((size_t)&buffer[0] / sizeof(float)) % SIMD_WIDTH;
+        channels = &buffer[0] + (misalignment ? SIMD_WIDTH - misalignment : 0);
+
+        if (!numThreads) numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        if (!workers || workers->getNumThreads() != numThreads)
+        {
+            delete workers;
+            workers = new Workers(numThreads);
+        }
+    }
+
+    unsigned ParticleKernel::getNumThreads() const
+    {
+        return workers ? workers->getNumThreads() : 0;
+    }
+
+    void ParticleKernel::setTexels(unsigned texture, const float* rgba, unsigned first, unsigned count)
+    {
+        float* r = getChannel(texture, 0) + first;
+        float* g = getChannel(texture, 1) + first;
+        float* b = getChannel(texture, 2) + first;
+        float* a = getChannel(texture, 3) + first;
+        for (unsigned i = 0; i < count; ++i, rgba += FLOATS_PER_TEXEL)
+        {
+            r[i] = rgba[0];
+            g[i] = rgba[1];
+            b[i] = rgba[2];
+            a[i] = rgba[3];
+        }
+    }
+
+    void ParticleKernel::getTexels(unsigned texture, float* rgba, unsigned first, unsigned count) const
+    {
+        const float* r = getChannel(texture, 0) + first;
+        const float* g = getChannel(texture, 1) + first;
+        const float* b = getChannel(texture, 2) + first;
+        const float* a = getChannel(texture, 3) + first;
+        for (unsigned i = 0; i < count; ++i, rgba += FLOATS_PER_TEXEL)
+        {
+            rgba[0] = r[i];
+            rgba[1] = g[i];
+            rgba[2] = b[i];
+            rgba[3] = a[i];
+        }
+    }
+
+    void ParticleKernel::update(const Uniforms& uniforms)
+    {
+        if (!workers || !numParticles) return;
+        currentUniforms = &uniforms;
+        workers->run((stride + PARTICLES_PER_CHUNK - 1) / PARTICLES_PER_CHUNK, &ParticleKernel::updateChunk, this);
+        currentUniforms = 0;
+    }
+
+    const char* ParticleKernel::getInstructionSet()
+    {
+#if defined(PARTICLES_USE_AVX)
+        return "AVX";
+#elif defined(PARTICLES_USE_SSE)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    void ParticleKernel::updateChunk(void* context, unsigned chunk)
+    {
+        ParticleKernel* kernel = (ParticleKernel*)context;
+        unsigned begin = chunk * PARTICLES_PER_CHUNK;
+        unsigned end = std::min(begin + PARTICLES_PER_CHUNK, kernel->stride);
+        kernel->updateRange(*kernel->currentUniforms, begin, end);
+    }
+
+    void ParticleKernel::updateScalar(const Uniforms& u, unsigned begin, unsigned end)
+    {
+        float* px = getChannel(0, 0);
+        float* py = getChannel(0, 1);
+        float* pz = getChannel(0, 2);
+        float* vx = getChannel(1, 0);
+        float* vy = getChannel(1, 1);
+        float* vz = getChannel(1, 2);
+
+        for (unsigned i = begin; i < end; ++i)
+        {
+            float dx = u.mouse[0] - px[i];
+            float dy = u.mouse[1] - py[i];
+            float dz = u.mouse[2] - pz[i];
+            float distSquared = dx * dx + dy * dy + dz * dz;
+
+            // magnitude * normalize(direction), zero outside the radius
+            float scale = 0.f;
+            if (distSquared <= u.radiusSquared && distSquared > 0.f)
+            {
+                scale = u.attraction * (1.f - distSquared / u.radiusSquared) / sqrtf(distSquared);
+            }
+
+            float x = vx[i] + u.elapsed * (dx * scale + u.gravity[0]);
+            float y = vy[i] + u.elapsed * (dy * scale + u.gravity[1]);
+            float z = vz[i] + u.elapsed * (dz * scale + u.gravity[2]);
+
+            if (!(fabsf(px[i]) <= u.bounds[0])) x = -x;
+            if (!(fabsf(py[i]) <= u.bounds[1])) y = -y;
+
+            vx[i] = x * u.damping;
+            vy[i] = y * u.damping;
+            vz[i] = z * u.damping;
+
+            px[i] += u.elapsed * vx[i];
+            py[i] += u.elapsed * vy[i];
+            pz[i] += u.elapsed * vz[i];
+        }
+    }
+
+#if defined(PARTICLES_USE_AVX)
+
+    void ParticleKernel::updateRange(const Uniforms& u, unsigned begin, unsigned end)
+    {
+        float* px = getChannel(0, 0);
+        float* py = getChannel(0, 1);
+        float* pz = getChannel(0, 2);
+        float* vx = getChannel(1, 0);
+        float* vy = getChannel(1, 1);
+        float* vz = getChannel(1, 2);
+
+        const __m256 mx = _mm256_set1_ps(u.mouse[0]);
+        const __m256 my = _mm256_set1_ps(u.mouse[1]);
+        const __m256 mz = _mm256_set1_ps(u.mouse[2]);
+        const __m256 radiusSquared = _mm256_set1_ps(u.radiusSquared);
+        const __m256 attraction = _mm256_set1_ps(u.attraction);
+        const __m256 elapsed = _mm256_set1_ps(u.elapsed);
+        const __m256 gx = _mm256_set1_ps(u.gravity[0]);
+        const __m256 gy = _mm256_set1_ps(u.gravity[1]);
+        const __m256 gz = _mm256_set1_ps(u.gravity[2]);
+        const __m256 boundX = _mm256_set1_ps(u.bounds[0]);
+        const __m256 boundY = _mm256_set1_ps(u.bounds[1]);
+        const __m256 damping = _mm256_set1_ps(u.damping);
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 sign = _mm256_set1_ps(-0.f);
+
+        for (unsigned i = begin; i < end; i += 8)
+        {
+            __m256 x = _mm256_load_ps(px + i);
+            __m256 y = _mm256_load_ps(py + i);
+            __m256 z = _mm256_load_ps(pz + i);
+
+            __m256 dx = _mm256_sub_ps(mx, x);
+            __m256 dy = _mm256_sub_ps(my, y);
+            __m256 dz = _mm256_sub_ps(mz, z);
+            __m256 distSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(distSquared, radiusSquared, _CMP_LE_OQ), _mm256_cmp_ps(distSquared, zero, _CMP_GT_OQ));
+            __m256 scale = _mm256_mul_ps(attraction, _mm256_sub_ps(one, _mm256_div_ps(distSquared, radiusSquared)));
+            scale = _mm256_and_ps(inside, _mm256_div_ps(scale, _mm256_sqrt_ps(distSquared)));
+
+            __m256 nvx = _mm256_add_ps(_mm256_load_ps(vx + i), _mm256_mul_ps(elapsed, _mm256_add_ps(_mm256_mul_ps(dx, scale), gx)));
+            __m256 nvy = _mm256_add_ps(_mm256_load_ps(vy + i), _mm256_mul_ps(elapsed, _mm256_add_ps(_mm256_mul_ps(dy, scale), gy)));
+            __m256 nvz = _mm256_add_ps(_mm256_load_ps(vz + i), _mm256_mul_ps(elapsed, _mm256_add_ps(_mm256_mul_ps(dz, scale), gz)));
+
+            // flip the sign outside the bounds
+            nvx = _mm256_xor_ps(nvx, _mm256_and_ps(sign, _mm256_cmp_ps(_mm256_andnot_ps(sign, x), boundX, _CMP_NLE_UQ)));
+            nvy = _mm256_xor_ps(nvy, _mm256_and_ps(sign, _mm256_cmp_ps(_mm256_andnot_ps(sign, y), boundY, _CMP_NLE_UQ)));
+
+            nvx = _mm256_mul_ps(nvx, damping);
+            nvy = _mm256_mul_ps(nvy, damping);
+            nvz = _mm256_mul_ps(nvz, damping);
+            _mm256_store_ps(vx + i, nvx);
+            _mm256_store_ps(vy + i, nvy);
+            _mm256_store_ps(vz + i, nvz);
+
+            _mm256_store_ps(px + i, _mm256_add_ps(x, _mm256_mul_ps(elapsed, nvx)));
+            _mm256_store_ps(py + i, _mm256_add_ps(y, _mm256_mul_ps(elapsed, nvy)));
+            _mm256_store_ps(pz + i, _mm256_add_ps(z, _mm256_mul_ps(elapsed, nvz)));
+        }
+    }
+
+#elif defined(PARTICLES_USE_SSE)
+
+    void ParticleKernel::updateRange(const Uniforms& u, unsigned begin, unsigned end)
+    {
+        float* px = getChannel(0, 0);
+        float* py = getChannel(0, 1);
+        float* pz = getChannel(0, 2);
+        float* vx = getChannel(1, 0);
+        float* vy = getChannel(1, 1);
+        float* vz = getChannel(1, 2);
+
+        const __m128 mx = _mm_set1_ps(u.mouse[0]);
+        const __m128 my = _mm_set1_ps(u.mouse[1]);
+        const __m128 mz = _mm_set1_ps(u.mouse[2]);
+        const __m128 radiusSquared = _mm_set1_ps(u.radiusSquared);
+        const __m128 attraction = _mm_set1_ps(u.attraction);
+        const __m128 elapsed = _mm_set1_ps(u.elapsed);
+        const __m128 gx = _mm_set1_ps(u.gravity[0]);
+        const __m128 gy = _mm_set1_ps(u.gravity[1]);
+        const __m128 gz = _mm_set1_ps(u.gravity[2]);
+        const __m128 boundX = _mm_set1_ps(u.bounds[0]);
+        const __m128 boundY = _mm_set1_ps(u.bounds[1]);
+        const __m128 damping = _mm_set1_ps(u.damping);
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 sign = _mm_set1_ps(-0.f);
+
+        for (unsigned i = begin; i < end; i += 4)
+        {
+            __m128 x = _mm_load_ps(px + i);
+            __m128 y = _mm_load_ps(py + i);
+            __m128 z = _mm_load_ps(pz + i);
+
+            __m128 dx = _mm_sub_ps(mx, x);
+            __m128 dy = _mm_sub_ps(my, y);
+            __m128 dz = _mm_sub_ps(mz, z);
+            __m128 distSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            __m128 inside = _mm_and_ps(_mm_cmple_ps(distSquared, radiusSquared), _mm_cmpgt_ps(distSquared, zero));
+            __m128 scale = _mm_mul_ps(attraction, _mm_sub_ps(one, _mm_div_ps(distSquared, radiusSquared)));
+            scale = _mm_and_ps(inside, _mm_div_ps(scale, _mm_sqrt_ps(distSquared)));
+
+            __m128 nvx = _mm_add_ps(_mm_load_ps(vx + i), _mm_mul_ps(elapsed, _mm_add_ps(_mm_mul_ps(dx, scale), gx)));
+            __m128 nvy = _mm_add_ps(_mm_load_ps(vy + i), _mm_mul_ps(elapsed, _mm_add_ps(_mm_mul_ps(dy, scale), gy)));
+            __m128 nvz = _mm_add_ps(_mm_load_ps(vz + i), _mm_mul_ps(elapsed, _mm_add_ps(_mm_mul_ps(dz, scale), gz)));
+
+            // flip the sign outside the bounds
+            nvx = _mm_xor_ps(nvx, _mm_and_ps(sign, _mm_cmpnle_ps(_mm_andnot_ps(sign, x), boundX)));
+            nvy = _mm_xor_ps(nvy, _mm_and_ps(sign, _mm_cmpnle_ps(_mm_andnot_ps(sign, y), boundY)));
+
+            nvx = _mm_mul_ps(nvx, damping);
+            nvy = _mm_mul_ps(nvy, damping);
+            nvz = _mm_mul_ps(nvz, damping);
+            _mm_store_ps(vx + i, nvx);
+            _mm_store_ps(vy + i, nvy);
+            _mm_store_ps(vz + i, nvz);
+
+            _mm_store_ps(px + i, _mm_add_ps(x, _mm_mul_ps(elapsed, nvx)));
+            _mm_store_ps(py + i, _mm_add_ps(y, _mm_mul_ps(elapsed, nvy)));
+            _mm_store_ps(pz + i, _mm_add_ps(z, _mm_mul_ps(elapsed, nvz)));
+        }
+    }
+
+#else
+
+    void ParticleKernel::updateRange(const Uniforms& u, unsigned begin, unsigned end)
+    {
+        updateScalar(u, begin, end);
+    }
+
+#endif
+}
@@ -0,0 +1,89 @@
+/*
+ *  ParticleKernel.h
+ *
+ *  CPU version of the particle update shader, no OpenGL needed.
+ *
+ *  Data is stored as structure of arrays, one array per texture channel,
+ *  so the update runs 8 (AVX) or 4 (SSE2) particles at a time. Particles
+ *  are split into chunks that are updated by a small pool of threads.
+ *
+ *  Compile with /arch:AVX (or -mavx) to get the AVX path, otherwise SSE2
+ *  is used. Define PARTICLES_NO_SIMD to force the scalar path.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace itg
+{
+    class ParticleKernel
+    {
+    public:
+        static const unsigned FLOATS_PER_TEXEL = 4;
+        static const unsigned PARTICLES_PER_CHUNK = 16384;
+
+        // same names as the uniforms of the update shader, so listeners
+        // can set them the way they set them on an ofShader
+        class Uniforms
+        {
+        public:
+            Uniforms();
+
+            void setUniform1f(const std::string& name, float v1);
+            void setUniform2f(const std::string& name, float v1, float v2);
+            void setUniform3f(const std::string& name, float v1, float v2, float v3);
+            void setUniform3fv(const std::string& name, const float* v, int count = 1);
+
+            float mouse[3];         // attractor position
+            float radiusSquared;    // particles closer than this are attracted
+            float elapsed;          // time step in seconds
+            float attraction;       // force at the attractor
+            float gravity[3];
+            float bounds[2];        // velocity flips outside |x| > bounds[0], |y| > bounds[1]
+            float damping;
+        };
+
+        ParticleKernel();
+        ~ParticleKernel();
+
+        // numThreads = 0 uses one thread per core
+        void allocate(unsigned numParticles, unsigned numTextures = 2, unsigned numThreads = 0);
+
+        unsigned getNumParticles() const { return numParticles; }
+        unsigned getNumTextures() const { return numTextures; }
+        unsigned getNumThreads() const;
+
+        // one channel (0 - 3) of one texture, 32 byte aligned
+        float* getChannel(unsigned texture, unsigned channel) { return channels + (texture * FLOATS_PER_TEXEL + channel) * stride; }
+        const float* getChannel(unsigned texture, unsigned channel) const { return channels + (texture * FLOATS_PER_TEXEL + channel) * stride; }
+
+        // copy count RGBA texels in or out, starting at particle first
+        void setTexels(unsigned texture, const float* rgba, unsigned first, unsigned count);
+        void getTexels(unsigned texture, float* rgba, unsigned first, unsigned count) const;
+
+        // texture 0 is position, texture 1 is velocity
+        void update(const Uniforms& uniforms);
+
+        // "AVX", "SSE2" or "scalar"
+        static const char* getInstructionSet();
+
+        // exposed for testing, updates particles [begin, end) without SIMD
+        void updateScalar(const Uniforms& uniforms, unsigned begin, unsigned end);
+
+    private:
+        ParticleKernel(const ParticleKernel&);
+        ParticleKernel& operator=(const ParticleKernel&);
+
+        class Workers;
+
+        static void updateChunk(void* context, unsigned chunk);
+        void updateRange(const Uniforms& uniforms, unsigned begin, unsigned end);
+
+        unsigned numParticles, numTextures, stride;
+        std::vector<float> buffer;
+        float* channels;
+        Workers* workers;
+        const Uniforms* currentUniforms;
+    };
+}
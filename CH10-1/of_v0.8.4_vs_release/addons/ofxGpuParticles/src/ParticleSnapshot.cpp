@@ -0,0 +1,473 @@
+/*
+ *  ParticleSnapshot.cpp
+ *
+ *  See ParticleSnapshot.h for the file formats.
+ */
+#include "ParticleSnapshot.h"
+#include "ofxLz4.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace itg
+{
+    static const char MAGIC[4] = { 'G', 'P', 'S', 'N' };
+
+    // largest texture side a file may declare, any GL texture is smaller
+    static const unsigned MAX_TEXTURE_SIZE = 16384;
+
+    // read only memory mapping of a whole file
+    class ParticleSnapshot::MappedFile
+    {
+    public:
+        MappedFile() : data(0), size(0)
+#ifdef _WIN32
+            , file(INVALID_HANDLE_VALUE), mapping(0)
+#else
+            , fd(-1)
+#endif
+        {
+        }
+
+        ~MappedFile()
+        {
+            close();
+        }
+
+        bool open(const std::string& path)
+        {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            {
+                close();
+                return false;
+            }
+            size = (size_t)fileSize.QuadPart;
+            mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+            if (mapping) data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0)
+            {
+                close();
+                return false;
+            }
+            size = (size_t)st.st_size;
+            void* p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, size, MADV_SEQUENTIAL);
+                data = (const unsigned char*)p;
+            }
+#endif
+            if (!data)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (data) UnmapViewOfFile(data);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            mapping = 0;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (data) munmap((void*)data, size);
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+#endif
+            data = 0;
+            size = 0;
+        }
+
+        const unsigned char* data;
+        size_t size;
+
+    private:
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#else
+        int fd;
+#endif
+    };
+
+    // (a0 a1 a2 a3)(b0 b1 b2 b3)... -> (a0 b0 ...)(a1 b1 ...)...
+    static void shuffleBytes(const unsigned char* src, size_t count, size_t elementSize, unsigned char* dst)
+    {
+        for (size_t b = 0; b < elementSize; ++b)
+        {
+            unsigned char* out = dst + b * count;
+            const unsigned char* in = src + b;
+            for (size_t i = 0; i < count; ++i) out[i] = in[i * elementSize];
+        }
+    }
+
+    static void unshuffleBytes(const unsigned char* src, size_t count, size_t elementSize, unsigned char* dst)
+    {
+        for (size_t b = 0; b < elementSize; ++b)
+        {
+            const unsigned char* in = src + b * count;
+            unsigned char* out = dst + b;
+            for (size_t i = 0; i < count; ++i) out[i * elementSize] = in[i];
+        }
+    }
+
+    ParticleSnapshot::ParticleSnapshot() : width(0), height(0), mapped(0)
+    {
+    }
+
+    ParticleSnapshot::~ParticleSnapshot()
+    {
+        unmap();
+    }
+
+    void ParticleSnapshot::allocate(unsigned width, unsigned height, unsigned numTextures)
+    {
+        unmap();
+        this->width = width;
+        this->height = height;
+        storage.assign(numTextures, std::vector<float>(getNumFloats(), 0.f));
+        textures.resize(numTextures);
+        for (unsigned i = 0; i < numTextures; ++i) textures[i] = storage[i].empty() ? 0 : &storage[i][0];
+    }
+
+    void ParticleSnapshot::clear()
+    {
+        unmap();
+        width = height = 0;
+        textures.clear();
+        storage.clear();
+    }
+
+    void ParticleSnapshot::unmap()
+    {
+        delete mapped;
+        mapped = 0;
+    }
+
+    float* ParticleSnapshot::getData(unsigned idx)
+    {
+        // textures that point into the mapped file are copied before they can be written
+        if (storage[idx].size() != getNumFloats())
+        {
+            storage[idx].assign(textures[idx], textures[idx] + getNumFloats());
+            textures[idx] = &storage[idx][0];
+        }
+        return &storage[idx][0];
+    }
+
+    bool ParticleSnapshot::saveBinary(const std::string& path, Format format, Compression compression) const
+    {
+        std::ofstream fileStream(path.c_str(), std::ios::binary);
+        if (!fileStream.is_open()) return false;
+
+        Header header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.width = width;
+        header.height = height;
+        header.numTextures = getNumTextures();
+        header.floatsPerTexel = FLOATS_PER_TEXEL;
+        header.format = format;
+        header.compression = compression;
+        fileStream.write((const char*)&header, sizeof(header));
+
+        // block sizes are filled in once the blocks are written
+        std::vector<unsigned long long> blockSizes(getNumTextures(), 0);
+        std::streampos tablePos = fileStream.tellp();
+        if (!blockSizes.empty()) fileStream.write((const char*)&blockSizes[0], blockSizes.size() * sizeof(blockSizes[0]));
+
+        const size_t numFloats = getNumFloats();
+        std::vector<unsigned short> halves;
+        std::vector<unsigned char> shuffled, compressed;
+        std::vector<unsigned> hashTable(ofxLz4::HASH_SIZE, 0);
+        for (unsigned i = 0; i < getNumTextures(); ++i)
+        {
+            const unsigned char* block = (const unsigned char*)textures[i];
+            size_t elementSize = sizeof(float);
+            if (format == FLOAT16)
+            {
+                halves.resize(numFloats);
+                for (size_t j = 0; j < numFloats; ++j) halves[j] = floatToHalf(textures[i][j]);
+                block = (const unsigned char*)&halves[0];
+                elementSize = sizeof(unsigned short);
+            }
+
+            size_t blockSize = numFloats * elementSize;
+            if (compression == LZ4)
+            {
+                shuffled.resize(blockSize);
+                shuffleBytes(block, numFloats, elementSize, &shuffled[0]);
+                compressed.resize(ofxLz4::compressBound(blockSize));
+                blockSize = ofxLz4::compress(&shuffled[0], shuffled.size(), &compressed[0], &hashTable[0]);
+                block = &compressed[0];
+            }
+
+            fileStream.write((const char*)block, blockSize);
+            blockSizes[i] = blockSize;
+        }
+
+        fileStream.seekp(tablePos);
+        if (!blockSizes.empty()) fileStream.write((const char*)&blockSizes[0], blockSizes.size() * sizeof(blockSizes[0]));
+        return fileStream.good();
+    }
+
+    bool ParticleSnapshot::loadBinary(const std::string& path)
+    {
+        clear();
+
+        mapped = new MappedFile;
+        if (!mapped->open(path) || mapped->size < sizeof(Header))
+        {
+            clear();
+            return false;
+        }
+
+        Header header;
+        memcpy(&header, mapped->data, sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+            header.floatsPerTexel != FLOATS_PER_TEXEL || header.format > FLOAT16 || header.compression > LZ4)
+        {
+            clear();
+            return false;
+        }
+
+        // the sizes come from the file, check them before anything is sized from them
+        // so a corrupted header can't overflow width * height * 4 or the block table size
+        if (header.width > MAX_TEXTURE_SIZE || header.height > MAX_TEXTURE_SIZE ||
+            header.numTextures > (mapped->size - sizeof(Header)) / sizeof(unsigned long long))
+        {
+            clear();
+            return false;
+        }
+
+        width = header.width;
+        height = header.height;
+        const size_t numFloats = getNumFloats();
+        const size_t elementSize = (header.format == FLOAT16) ? sizeof(unsigned short) : sizeof(float);
+
+        size_t offset = sizeof(Header) + header.numTextures * sizeof(unsigned long long);
+        std::vector<unsigned long long> blockSizes(header.numTextures);
+        if (!blockSizes.empty()) memcpy(&blockSizes[0], mapped->data + sizeof(Header), blockSizes.size() * sizeof(blockSizes[0]));
+
+        textures.assign(header.numTextures, 0);
+        storage.assign(header.numTextures, std::vector<float>());
+
+        bool isMappedUsed = false;
+        std::vector<unsigned char> decompressed;
+        for (unsigned i = 0; i < header.numTextures; ++i)
+        {
+            if (blockSizes[i] > mapped->size - offset)
+            {
+                clear();
+                return false;
+            }
+            const unsigned char* block = mapped->data + offset;
+            size_t blockSize = (size_t)blockSizes[i];
+            offset += blockSize;
+
+            // a block can't hold more than it could expand to, don't allocate for it
+            const unsigned long long maxBytes = (header.compression == LZ4) ? blockSizes[i] * ofxLz4::MAX_RATIO : blockSizes[i];
+            if ((unsigned long long)numFloats * elementSize > maxBytes)
+            {
+                clear();
+                return false;
+            }
+
+            if (header.compression == LZ4)
+            {
+                decompressed.resize(numFloats * elementSize);
+                if (!ofxLz4::decompress(block, blockSize, decompressed.empty() ? 0 : &decompressed[0], decompressed.size()))
+                {
+                    clear();
+                    return false;
+                }
+                block = decompressed.empty() ? 0 : &decompressed[0];
+                blockSize = decompressed.size();
+            }
+
+            if (blockSize != numFloats * elementSize)
+            {
+                clear();
+                return false;
+            }
+
+            if (header.format == FLOAT32 && header.compression == NONE)
+            {
+                // no copy, the texture points into the mapped file
+                textures[i] = (const float*)block;
+                isMappedUsed = true;
+                continue;
+            }
+
+            storage[i].resize(numFloats);
+            float* out = storage[i].empty() ? 0 : &storage[i][0];
+            if (header.format == FLOAT16)
+            {
+                std::vector<unsigned short> halves(numFloats);
+                if (header.compression == LZ4) unshuffleBytes(block, numFloats, elementSize, (unsigned char*)&halves[0]);
+                else memcpy(&halves[0], block, blockSize);
+                for (size_t j = 0; j < numFloats; ++j) out[j] = halfToFloat(halves[j]);
+            }
+            else unshuffleBytes(block, numFloats, elementSize, (unsigned char*)out);
+            textures[i] = out;
+        }
+
+        if (!isMappedUsed) unmap();
+        return true;
+    }
+
+    bool ParticleSnapshot::saveText(const std::string& path) const
+    {
+        std::ofstream fileStream(path.c_str());
+        if (!fileStream.is_open()) return false;
+
+        for (unsigned i = 0; i < getNumTextures(); ++i)
+        {
+            if (i) fileStream << "|";
+            for (unsigned j = 0; j < getNumFloats(); ++j)
+            {
+                if (j) fileStream << ",";
+                fileStream << textures[i][j];
+            }
+        }
+        return fileStream.good();
+    }
+
+    bool ParticleSnapshot::loadText(const std::string& path)
+    {
+        std::ifstream fileStream(path.c_str());
+        if (!fileStream.is_open()) return false;
+        std::string data((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+
+        // parse in place rather than splitting into strings first,
+        // fields that are not numbers read as 0 like atof()
+        std::vector<std::vector<float> > parsed(1);
+        const char* p = data.c_str();
+        const char* end = p + data.size();
+        while (true)
+        {
+            char* next;
+            parsed.back().push_back((float)strtod(p, &next));
+            p = next;
+            while (p < end && *p != ',' && *p != '|') ++p;
+            if (p >= end) break;
+            if (*p == '|') parsed.push_back(std::vector<float>());
+            ++p;
+        }
+
+        unmap();
+        storage.swap(parsed);
+        textures.resize(storage.size());
+        bool isComplete = true;
+        for (unsigned i = 0; i < storage.size(); ++i)
+        {
+            isComplete = isComplete && storage[i].size() == getNumFloats();
+            storage[i].resize(getNumFloats(), 0.f);
+            textures[i] = storage[i].empty() ? 0 : &storage[i][0];
+        }
+        return isComplete;
+    }
+
+    bool ParticleSnapshot::isBinary(const std::string& path)
+    {
+        std::ifstream fileStream(path.c_str(), std::ios::binary);
+        char magic[4] = { 0 };
+        fileStream.read(magic, sizeof(magic));
+        return fileStream.good() && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    // round to nearest even, overflow goes to infinity
+    unsigned short ParticleSnapshot::floatToHalf(float value)
+    {
+        unsigned f;
+        memcpy(&f, &value, sizeof(f));
+        unsigned sign = (f >> 16) & 0x8000;
+        unsigned mantissa = f & 0x7fffff;
+        int exponent = (int)((f >> 23) & 0xff);
+
+        if (exponent == 0xff) return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        exponent = exponent - 127 + 15;
+        if (exponent >= 31) return (unsigned short)(sign | 0x7c00);
+
+        if (exponent <= 0)
+        {
+            // subnormal half
+            if (exponent < -10) return (unsigned short)sign;
+            mantissa |= 0x800000;
+            unsigned shift = 14 - exponent;
+            unsigned half = mantissa >> shift;
+            unsigned rest = mantissa & ((1u << shift) - 1);
+            unsigned halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+            return (unsigned short)(sign | half);
+        }
+
+        unsigned half = sign | (exponent << 10) | (mantissa >> 13);
+        unsigned rest = mantissa & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+        return (unsigned short)half;
+    }
+
+    float ParticleSnapshot::halfToFloat(unsigned short value)
+    {
+        unsigned sign = (value & 0x8000u) << 16;
+        int exponent = (value >> 10) & 0x1f;
+        unsigned mantissa = value & 0x3ff;
+        unsigned f;
+
+        if (exponent == 0)
+        {
+            if (mantissa == 0) f = sign;
+            else
+            {
+                // normalise the subnormal
+                exponent = 1;
+                while (!(mantissa & 0x400))
+                {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                mantissa &= 0x3ff;
+                f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+            }
+        }
+        else if (exponent == 31) f = sign | 0x7f800000 | (mantissa << 13);
+        else f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+        float result;
+        memcpy(&result, &f, sizeof(result));
+        return result;
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ *  ParticleSnapshot.h
+ *
+ *  CPU side copy of the particle data textures and its file formats.
+ *
+ *  Text format (GpuParticles::save() compatible):
+ *      textures separated by '|', floats separated by ','
+ *
+ *  Binary format (little endian):
+ *      Header          32 bytes, see below
+ *      block sizes     numTextures x uint64, bytes stored for each texture
+ *      blocks          one per texture, RGBA texels row by row
+ *
+ *  Uncompressed float32 blocks are 8 byte aligned, so a memory mapped file
+ *  can be handed to GpuParticles::loadDataTexture() without a copy.
+ *  LZ4 blocks are byte shuffled (all first bytes, then all second bytes...)
+ *  before compression, which makes float data much more compressible.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace itg
+{
+    class ParticleSnapshot
+    {
+    public:
+        static const unsigned FLOATS_PER_TEXEL = 4;
+        static const unsigned VERSION = 1;
+
+        enum Format
+        {
+            FLOAT32,
+            FLOAT16
+        };
+
+        enum Compression
+        {
+            NONE,
+            LZ4
+        };
+
+        struct Header
+        {
+            char magic[4];              // "GPSN"
+            unsigned version;
+            unsigned width;
+            unsigned height;
+            unsigned numTextures;
+            unsigned floatsPerTexel;
+            unsigned format;            // Format
+            unsigned compression;       // Compression
+        };
+
+        ParticleSnapshot();
+        ~ParticleSnapshot();
+
+        // allocate zeroed textures
+        void allocate(unsigned width, unsigned height, unsigned numTextures);
+        void clear();
+
+        unsigned getWidth() const { return width; }
+        unsigned getHeight() const { return height; }
+        unsigned getNumTextures() const { return (unsigned)textures.size(); }
+        unsigned getNumFloats() const { return width * height * FLOATS_PER_TEXEL; }
+
+        // writable data, copies mapped data first if needed
+        float* getData(unsigned idx);
+        // may point straight into a memory mapped file
+        const float* getData(unsigned idx) const { return textures[idx]; }
+
+        bool saveBinary(const std::string& path, Format format = FLOAT32, Compression compression = NONE) const;
+        bool loadBinary(const std::string& path);
+
+        // text files carry no size, so width and height are left as they are
+        // and every texture must hold getNumFloats() values
+        bool saveText(const std::string& path) const;
+        bool loadText(const std::string& path);
+
+        static bool isBinary(const std::string& path);
+
+        // exposed for testing
+        static unsigned short floatToHalf(float value);
+        static float halfToFloat(unsigned short value);
+
+    private:
+        ParticleSnapshot(const ParticleSnapshot&);
+        ParticleSnapshot& operator=(const ParticleSnapshot&);
+
+        class MappedFile;
+
+        void unmap();
+
+        unsigned width, height;
+        std::vector<const float*> textures;
+        std::vector<std::vector<float> > storage;
+        MappedFile* mapped;
+    };
+}
@@ -32,5 +32,7 @@
 #pragma once
 
 #include "GpuParticles.h"
+#include "CpuParticles.h"
 
-typedef itg::GpuParticles ofxGpuParticles;
\ No newline at end of file
+typedef itg::GpuParticles ofxGpuParticles;
+typedef itg::CpuParticles ofxCpuParticles;
\ No newline at end of file
@@ -30,6 +30,7 @@
     
 ==============================================================================*/
 #include "ofxKinect.h"
+#include "ofxKinectGroup.h"
 #include "ofMain.h"
 
 #include "libfreenect_registration.h"
@@ -43,6 +44,19 @@
 
 #define OFX_KINECT_GRAVITY 9.80665
 
+// define OFX_KINECT_NO_SIMD to use the plain loops
+#if !defined(OFX_KINECT_NO_SIMD) && (defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define OFX_KINECT_SSE2
+	#include <emmintrin.h>
+#endif
+#include <cfloat>
+
+#ifdef TARGET_WIN32
+	#include <windows.h>
+#else
+	#include <chrono>
+#endif
+
 // context static
 ofxKinectContext ofxKinect::kinectContext;
 
@@ -59,10 +73,17 @@ ofxKinect::ofxKinect() {
 	// set defaults
 	bGrabberInited = false;
 
-	bNeedsUpdateVideo = false;
-	bNeedsUpdateDepth = false;
 	bIsFrameNewVideo = false;
 	bIsFrameNewDepth = false;
+
+	depthTimestamp = 0;
+	videoTimestamp = 0;
+	depthFrameNumber = 0;
+	videoFrameNumber = 0;
+	depthTime = 0;
+	videoTime = 0;
+
+	group = NULL;
     
 	bIsVideoInfrared = false;
 	videoBytesPerPixel = 3;
@@ -85,12 +106,22 @@ ofxKinect::ofxKinect() {
 	bUseRegistration = false;
 	bNearWhite = true;
 
+	worldPixelSize = 0;
+	worldDistance = 0;
+
+	bLazyDepthPixels = false;
+	bDepthPixelsDirty = false;
+	bDistancePixelsDirty = false;
+
 	setDepthClipping();
 }
 
 //--------------------------------------------------------------------
 ofxKinect::~ofxKinect() {
 	close();
+	if(group != NULL) {
+		group->remove(*this);
+	}
 	clear();
 }
 
@@ -111,8 +142,7 @@ bool ofxKinect::init(bool infrared, bool video, bool texture) {
 
 	// allocate
 	depthPixelsRaw.allocate(width, height, 1);
-	depthPixelsRawBack.allocate(width, height, 1);
-	depthPixelsRawIntra.allocate(width, height, 1);
+	depthBuffer.allocate(width, height, 1);
     
     //We have to do this as freenect has 488 pixels for the IR image height.
     //Instead of having slightly different sizes depending on capture we will crop the last 8 rows of pixels which are empty.
@@ -122,18 +152,15 @@ bool ofxKinect::init(bool infrared, bool video, bool texture) {
     }
     
 	videoPixels.allocate(width, height, videoBytesPerPixel);
-	videoPixelsBack.allocate(width, videoHeight, videoBytesPerPixel);
-	videoPixelsIntra.allocate(width, videoHeight, videoBytesPerPixel);
+	videoBuffer.allocate(width, videoHeight, videoBytesPerPixel);
 
 	depthPixels.allocate(width, height, 1);
 	distancePixels.allocate(width, height, 1);
 
 	 // set
 	depthPixelsRaw.set(0);
-	depthPixelsRawBack.set(0);
 
 	videoPixels.set(0);
-	videoPixelsBack.set(0);
 
 	depthPixels.set(0);    
 	distancePixels.set(0);
@@ -162,13 +189,15 @@ void ofxKinect::clear() {
 	}
 
 	depthPixelsRaw.clear();
-	depthPixelsRawBack.clear();
+	depthBuffer.clear();
 
 	videoPixels.clear();
-	videoPixelsBack.clear();
+	videoBuffer.clear();
 
 	depthPixels.clear();
 	distancePixels.clear();
+	bDepthPixelsDirty = false;
+	bDistancePixelsDirty = false;
 
 	depthTex.clear();
 	videoTex.clear();
@@ -188,33 +217,16 @@ bool ofxKinect::open(int id) {
 		return false;
 	}
 
-	if(!kinectContext.open(*this, id)) {
+	if(group != NULL) {
+		ofLogWarning("ofxKinect") << "open(): cannot open, kinect is in a group, use ofxKinectGroup::open()";
 		return false;
 	}
 
-	if(serial == "0000000000000000") {
-        bHasMotorControl = false;
-        //if we do motor control via the audio device ( ie: 1473 or k4w ) and we have firmware uploaded
-        //then we can do motor stuff! :)
-        if( kinectDevice->motor_control_with_audio_enabled ){
-            bHasMotorControl = true;
-        }else{
-            ofLogVerbose("ofxKinect") << "open(): device " << deviceId << " does not have motor control";
-        }
-    }
-	else {
-		bHasMotorControl = true;
+	if(!kinectContext.open(*this, id)) {
+		return false;
 	}
 
-	lastDeviceId = deviceId;
-	timeSinceOpen = ofGetElapsedTimef();
-	bGotData = false;
-
-	freenect_set_user(kinectDevice, this);
-	freenect_set_depth_buffer(kinectDevice, depthPixelsRawBack.getPixels());
-	freenect_set_video_buffer(kinectDevice, videoPixelsBack.getPixels());
-	freenect_set_depth_callback(kinectDevice, &grabDepthFrame);
-	freenect_set_video_callback(kinectDevice, &grabVideoFrame);
+	prepareDevice();
 
 	startThread(true, false); // blocking, not verbose
 
@@ -227,11 +239,25 @@ bool ofxKinect::open(string serial) {
 		ofLogVerbose("ofxKinect") << "open(): cannot open, init not called";
 		return false;
 	}
+
+	if(group != NULL) {
+		ofLogWarning("ofxKinect") << "open(): cannot open, kinect is in a group, use ofxKinectGroup::open()";
+		return false;
+	}
 	
 	if(!kinectContext.open(*this, serial)) {
 		return false;
 	}
+
+	prepareDevice();
 	
+	startThread(true, false); // blocking, not verbose
+	
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxKinect::prepareDevice() {
 	if(serial == "0000000000000000") {
         bHasMotorControl = false;
         //if we do motor control via the audio device ( ie: 1473 or k4w ) and we have firmware uploaded
@@ -250,33 +276,50 @@ bool ofxKinect::open(string serial) {
 	timeSinceOpen = ofGetElapsedTimef();
 	bGotData = false;
 	
+	depthBuffer.reset();
+	videoBuffer.reset();
+
 	freenect_set_user(kinectDevice, this);
+	freenect_set_depth_buffer(kinectDevice, depthBuffer.getBack().pixels.getPixels());
+	freenect_set_video_buffer(kinectDevice, videoBuffer.getBack().pixels.getPixels());
 	freenect_set_depth_callback(kinectDevice, &grabDepthFrame);
 	freenect_set_video_callback(kinectDevice, &grabVideoFrame);
-	
-	startThread(true, false); // blocking, not verbose
-	
-	return true;
 }
 
 //---------------------------------------------------------------------------
 void ofxKinect::close() {
+	if(group != NULL && group->isConnected()) {
+		// the streams run on the group thread
+		group->close();
+		return;
+	}
+
 	if(isThreadRunning()) {
 		stopThread();
 		ofSleepMillis(10);
 		waitForThread(false);
 	}
 
+	clearConnection();
+}
+
+//---------------------------------------------------------------------------
+void ofxKinect::clearConnection() {
 	deviceId = -1;
 	serial = "";
 	bIsFrameNewVideo = false;
-	bNeedsUpdateVideo = false;
 	bIsFrameNewDepth = false;
-	bNeedsUpdateDepth = false;
+
+	// drop anything that arrived while closing
+	depthBuffer.update();
+	videoBuffer.update();
 }
 
 //---------------------------------------------------------------------------
 bool ofxKinect::isConnected() {
+	if(group != NULL) {
+		return group->isConnected() && deviceId != -1;
+	}
 	return isThreadRunning();
 }
 
@@ -297,11 +340,11 @@ bool ofxKinect::isFrameNewDepth(){
 
 //----------------------------------------------------------
 void ofxKinect::update() {
-	if(!bGrabberInited) {
+	if(!bGrabberInited || group != NULL) {
 		return;
 	}
 
-	if(!bNeedsUpdateVideo && !bNeedsUpdateDepth && !bGotData && tryCount < 5 && ofGetElapsedTimef() - timeSinceOpen > 2.0 ){
+	if(!videoBuffer.isFrameNew() && !depthBuffer.isFrameNew() && !bGotData && tryCount < 5 && ofGetElapsedTimef() - timeSinceOpen > 2.0 ){
 		close();
 		ofLogWarning("ofxKinect") << "update(): device " << lastDeviceId << " isn't delivering data, reconnecting tries: " << tryCount+1;
 		kinectContext.buildDeviceList();
@@ -311,49 +354,63 @@ void ofxKinect::update() {
 		return;
 	}
 
-	if(bNeedsUpdateVideo){
-		bIsFrameNewVideo = true;
-		bGotData = true;
-		tryCount = 0;
-		if(this->lock()) {
-            if( videoPixels.getHeight() == videoPixelsIntra.getHeight() ){
-                swap(videoPixels,videoPixelsIntra);
-            }else{
-                int minimumSize = MIN(videoPixels.size(), videoPixelsIntra.size());
-                memcpy(videoPixels.getPixels(), videoPixelsIntra.getPixels(), minimumSize);
-            }
-			bNeedsUpdateVideo = false;
-			this->unlock();
-		}
-
-		if(bUseTexture) {
-			videoTex.loadData(videoPixels.getPixels(), width, height, bIsVideoInfrared?GL_LUMINANCE:GL_RGB);
-		}
+	if(videoBuffer.update()){
+		updateVideo(videoBuffer.getFront());
 	} else {
 		bIsFrameNewVideo = false;
 	}
 
-	if(bNeedsUpdateDepth){
-		bIsFrameNewDepth = true;
-		bGotData = true;
-		tryCount = 0;
-		if(this->lock()) {
-			swap(depthPixelsRaw, depthPixelsRawIntra);
-			bNeedsUpdateDepth = false;
-			this->unlock();
-
-			updateDepthPixels();
-		}
-
-		if(bUseTexture) {
-			depthTex.loadData(depthPixels.getPixels(), width, height, GL_LUMINANCE);
-		}
+	if(depthBuffer.update()){
+		updateDepth(depthBuffer.getFront());
 	} else {
 		bIsFrameNewDepth = false;
 	}
 
 }
 
+//----------------------------------------------------------
+void ofxKinect::updateVideo(ofxKinectTripleBuffer<unsigned char>::Frame& frame) {
+	bIsFrameNewVideo = true;
+	bGotData = true;
+	tryCount = 0;
+	if( videoPixels.getHeight() == frame.pixels.getHeight() ){
+		swap(videoPixels,frame.pixels);
+	}else{
+		int minimumSize = MIN(videoPixels.size(), frame.pixels.size());
+		memcpy(videoPixels.getPixels(), frame.pixels.getPixels(), minimumSize);
+	}
+	videoTimestamp = frame.timestamp;
+	videoFrameNumber = frame.sequence;
+	videoTime = frame.time;
+
+	if(bUseTexture) {
+		videoTex.loadData(videoPixels.getPixels(), width, height, bIsVideoInfrared?GL_LUMINANCE:GL_RGB);
+	}
+}
+
+//----------------------------------------------------------
+void ofxKinect::updateDepth(ofxKinectTripleBuffer<unsigned short>::Frame& frame) {
+	bIsFrameNewDepth = true;
+	bGotData = true;
+	tryCount = 0;
+	swap(depthPixelsRaw, frame.pixels);
+	depthTimestamp = frame.timestamp;
+	depthFrameNumber = frame.sequence;
+	depthTime = frame.time;
+
+	bDepthPixelsDirty = true;
+	bDistancePixelsDirty = true;
+	if(!bLazyDepthPixels) {
+		updateDepthPixels();
+	} else if(bUseTexture) {
+		updateDepthPixels(true, false);
+	}
+
+	if(bUseTexture) {
+		depthTex.loadData(depthPixels.getPixels(), width, height, GL_LUMINANCE);
+	}
+}
+
 //------------------------------------
 float ofxKinect::getDistanceAt(int x, int y) {
 	return depthPixelsRaw[y * width + x];
@@ -376,6 +433,31 @@ ofVec3f ofxKinect::getWorldCoordinateAt(float cx, float cy, float wz) {
 	return ofVec3f(wx, wy, wz);
 }
 
+//------------------------------------
+void ofxKinect::getWorldCoordinates(ofFloatPixels& xyz, int step, const ofRectangle& roi) {
+	int x, y, numX, numY;
+	if(!getWorldRegion(step, roi, x, y, numX, numY)) {
+		xyz.clear();
+		return;
+	}
+	if(xyz.getWidth() != numX || xyz.getHeight() != numY || xyz.getNumChannels() != 3) {
+		xyz.allocate(numX, numY, 3);
+	}
+	fillWorldCoordinates(xyz.getPixels(), x, y, numX, numY, step);
+}
+
+//------------------------------------
+void ofxKinect::getWorldCoordinates(ofMesh& mesh, int step, const ofRectangle& roi) {
+	int x, y, numX, numY;
+	vector<ofVec3f>& vertices = mesh.getVertices();
+	if(!getWorldRegion(step, roi, x, y, numX, numY)) {
+		vertices.clear();
+		return;
+	}
+	vertices.resize(numX * numY);
+	fillWorldCoordinates(vertices[0].getPtr(), x, y, numX, numY, step);
+}
+
 //------------------------------------
 float ofxKinect::getSensorEmitterDistance() {
 	return kinectDevice->registration.zero_plane_info.dcmos_emitter_dist;
@@ -420,6 +502,7 @@ unsigned char * ofxKinect::getPixels() {
 
 //---------------------------------------------------------------------------
 unsigned char * ofxKinect::getDepthPixels() {
+	updateDepthPixels(true, false);
 	return depthPixels.getPixels();
 }
 
@@ -430,6 +513,7 @@ unsigned short * ofxKinect::getRawDepthPixels() {
 
 //---------------------------------------------------------------------------
 float* ofxKinect::getDistancePixels() {
+	updateDepthPixels(false, true);
 	return distancePixels.getPixels();
 }
 
@@ -438,6 +522,7 @@ ofPixels & ofxKinect::getPixelsRef(){
 }
 
 ofPixels & ofxKinect::getDepthPixelsRef(){
+	updateDepthPixels(true, false);
 	return depthPixels;
 }
 
@@ -446,6 +531,7 @@ ofShortPixels & ofxKinect::getRawDepthPixelsRef(){
 }
 
 ofFloatPixels & ofxKinect::getDistancePixelsRef(){
+	updateDepthPixels(false, true);
 	return distancePixels;
 }
 
@@ -465,6 +551,58 @@ ofTexture& ofxKinect::getDepthTextureReference(){
 	return depthTex;
 }
 
+//---------------------------------------------------------------------------
+uint32_t ofxKinect::getDepthTimestamp() {
+	return depthTimestamp;
+}
+
+//---------------------------------------------------------------------------
+uint32_t ofxKinect::getVideoTimestamp() {
+	return videoTimestamp;
+}
+
+//---------------------------------------------------------------------------
+unsigned long long ofxKinect::getDepthFrameNumber() {
+	return depthFrameNumber;
+}
+
+//---------------------------------------------------------------------------
+unsigned long long ofxKinect::getVideoFrameNumber() {
+	return videoFrameNumber;
+}
+
+//---------------------------------------------------------------------------
+double ofxKinect::getDepthTime() {
+	return depthTime;
+}
+
+//---------------------------------------------------------------------------
+double ofxKinect::getVideoTime() {
+	return videoTime;
+}
+
+//---------------------------------------------------------------------------
+double ofxKinect::now() {
+#ifdef TARGET_WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//---------------------------------------------------------------------------
+unsigned long long ofxKinect::getNumDroppedDepthFrames() {
+	return depthBuffer.getNumDropped();
+}
+
+//---------------------------------------------------------------------------
+unsigned long long ofxKinect::getNumDroppedVideoFrames() {
+	return videoBuffer.getNumDropped();
+}
+
 //---------------------------------------------------------------------------
 void ofxKinect::enableDepthNearValueWhite(bool bEnabled) {
 	bNearWhite = bEnabled;
@@ -493,6 +631,19 @@ float ofxKinect::getFarClipping() {
     return farClipping;
 }
 
+//---------------------------------------------------------------------------
+void ofxKinect::enableLazyDepthPixels(bool bEnabled) {
+	bLazyDepthPixels = bEnabled;
+	if(!bLazyDepthPixels) {
+		updateDepthPixels();
+	}
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinect::isLazyDepthPixels() {
+	return bLazyDepthPixels;
+}
+
 //--------------------------------------------------------------------
 bool ofxKinect::hasAccelControl() {
 	return bHasMotorControl; // depends on motor for now
@@ -683,13 +834,183 @@ void ofxKinect::updateDepthLookupTable() {
 }
 
 //----------------------------------------------------------
-void ofxKinect::updateDepthPixels() {
+// one pass over the raw depth for both conversions, 16 pixels at a time
+// with SSE2. The grayscale values use the same float operations as ofMap()
+// in updateDepthLookupTable(), so they match the table exactly
+void ofxKinect::updateDepthPixels(bool bGray, bool bDistance) {
+	bGray = bGray && bDepthPixelsDirty;
+	bDistance = bDistance && bDistancePixelsDirty;
+	if(!bGray && !bDistance) {
+		return;
+	}
+
+	const unsigned short* raw = depthPixelsRaw.getPixels();
+	unsigned char* gray = depthPixels.getPixels();
+	float* distance = distancePixels.getPixels();
+	const unsigned char* lookup = &depthLookupTable[0];
+	int maxDepth = depthLookupTable.size() - 1;
 	int n = width * height;
-	for(int i = 0; i < n; i++) {
-		distancePixels[i] = depthPixelsRaw[i];
+	int i = 0;
+
+#ifdef OFX_KINECT_SSE2
+	// ofMap() returns nearColor for an empty clipping range, leave that to the table
+	if(!bGray || fabs(nearClipping - farClipping) >= FLT_EPSILON) {
+		float nearColor = bNearWhite ? 255 : 0;
+		float farColor = bNearWhite ? 0 : 255;
+		const __m128 inMin = _mm_set1_ps(nearClipping);
+		const __m128 inRange = _mm_set1_ps(farClipping - nearClipping);
+		const __m128 outMin = _mm_set1_ps(nearColor);
+		const __m128 outRange = _mm_set1_ps(farColor - nearColor);
+		const __m128 maxLevel = _mm_set1_ps(maxDepth);
+		const __m128 black = _mm_setzero_ps();
+		const __m128 white = _mm_set1_ps(255);
+		const __m128i zero = _mm_setzero_si128();
+
+		for(; i + 16 <= n; i += 16) {
+			__m128i raw0 = _mm_loadu_si128((const __m128i*)(raw + i));
+			__m128i raw1 = _mm_loadu_si128((const __m128i*)(raw + i + 8));
+			__m128 d[4];
+			d[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw0, zero));
+			d[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(raw0, zero));
+			d[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(raw1, zero));
+			d[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(raw1, zero));
+
+			if(bDistance) {
+				for(int k = 0; k < 4; k++) {
+					_mm_storeu_ps(distance + i + 4 * k, d[k]);
+				}
+			}
+
+			if(bGray) {
+				__m128i g[4];
+				for(int k = 0; k < 4; k++) {
+					__m128 v = _mm_min_ps(d[k], maxLevel);
+					v = _mm_add_ps(_mm_mul_ps(_mm_div_ps(_mm_sub_ps(v, inMin), inRange), outRange), outMin);
+					v = _mm_min_ps(_mm_max_ps(v, black), white);
+					g[k] = _mm_cvttps_epi32(v);
+				}
+				__m128i g8 = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), _mm_packs_epi32(g[2], g[3]));
+				// no data (0) stays 0
+				__m128i empty = _mm_packs_epi16(_mm_cmpeq_epi16(raw0, zero), _mm_cmpeq_epi16(raw1, zero));
+				_mm_storeu_si128((__m128i*)(gray + i), _mm_andnot_si128(empty, g8));
+			}
+		}
+	}
+#endif
+
+	for(; i < n; i++) {
+		int d = raw[i];
+		if(bDistance) {
+			distance[i] = d;
+		}
+		if(bGray) {
+			gray[i] = lookup[d < maxDepth ? d : maxDepth];
+		}
+	}
+
+	if(bGray) {
+		bDepthPixelsDirty = false;
+	}
+	if(bDistance) {
+		bDistancePixelsDirty = false;
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinect::updateWorldLookupTables() {
+	double pixelSize = kinectDevice->registration.zero_plane_info.reference_pixel_size;
+	double distance = kinectDevice->registration.zero_plane_info.reference_distance;
+	if(worldLookupX.size() == (size_t)width && worldLookupY.size() == (size_t)height
+	   && pixelSize == worldPixelSize && distance == worldDistance) {
+		return;
+	}
+
+	// see freenect_camera_to_world(), the zero plane pixel size is
+	// for the 1280x1024 image, so it is doubled for 640x480
+	double factor = 2 * pixelSize / distance;
+	worldLookupX.resize(width);
+	for(int x = 0; x < width; x++) {
+		worldLookupX[x] = (x - width / 2) * factor;
+	}
+	worldLookupY.resize(height);
+	for(int y = 0; y < height; y++) {
+		worldLookupY[y] = (y - height / 2) * factor;
+	}
+	worldPixelSize = pixelSize;
+	worldDistance = distance;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinect::getWorldRegion(int& step, const ofRectangle& roi, int& x, int& y, int& numX, int& numY) {
+	if(kinectDevice == NULL) {
+		ofLogWarning("ofxKinect") << "getWorldCoordinates(): device not connected";
+		return false;
+	}
+	if(step < 1) {
+		step = 1;
+	}
+
+	ofRectangle region = roi;
+	if(region.isEmpty()) {
+		region.set(0, 0, width, height);
+	}
+	int minX = MAX((int)region.getMinX(), 0);
+	int minY = MAX((int)region.getMinY(), 0);
+	int maxX = MIN((int)region.getMaxX(), width);
+	int maxY = MIN((int)region.getMaxY(), height);
+	if(maxX <= minX || maxY <= minY) {
+		return false;
 	}
-	for(int i = 0; i < n; i++) {
-		depthPixels[i] = depthLookupTable[depthPixelsRaw[i]];
+
+	x = minX;
+	y = minY;
+	numX = (maxX - minX + step - 1) / step;
+	numY = (maxY - minY + step - 1) / step;
+
+	updateWorldLookupTables();
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinect::fillWorldCoordinates(float* xyz, int x, int y, int numX, int numY, int step) {
+	// a whole 640x480 frame takes ~0.2 ms on one core, less than it would
+	// cost to start & join worker threads for it, so there are none
+	const float* lookupX = &worldLookupX[x];
+	for(int row = 0; row < numY; row++) {
+		int py = y + row * step;
+		const unsigned short* raw = depthPixelsRaw.getPixels() + py * width + x;
+		float lookupY = worldLookupY[py];
+		float* dst = xyz + (size_t)row * numX * 3;
+		int i = 0;
+
+#ifdef OFX_KINECT_SSE2
+		if(step == 1) {
+			const __m128 ly = _mm_set1_ps(lookupY);
+			const __m128i zero = _mm_setzero_si128();
+			for(; i + 4 <= numX; i += 4) {
+				__m128 wz = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(raw + i)), zero));
+				__m128 wx = _mm_mul_ps(_mm_loadu_ps(lookupX + i), wz);
+				__m128 wy = _mm_mul_ps(ly, wz);
+
+				// interleave x0..x3 y0..y3 z0..z3 to x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+				__m128 xy01 = _mm_unpacklo_ps(wx, wy);
+				__m128 xy23 = _mm_unpackhi_ps(wx, wy);
+				__m128 z0x1 = _mm_shuffle_ps(wz, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+				__m128 y1z1 = _mm_shuffle_ps(xy01, wz, _MM_SHUFFLE(1, 1, 3, 3));
+				__m128 x3z2 = _mm_shuffle_ps(xy23, wz, _MM_SHUFFLE(3, 2, 3, 2));
+				_mm_storeu_ps(dst + 3 * i, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+				_mm_storeu_ps(dst + 3 * i + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+				_mm_storeu_ps(dst + 3 * i + 8, _mm_shuffle_ps(x3z2, x3z2, _MM_SHUFFLE(3, 1, 0, 2)));
+			}
+		}
+#endif
+
+		for(; i < numX; i++) {
+			float wz = raw[i * step];
+			dst[3 * i + 0] = lookupX[i * step] * wz;
+			dst[3 * i + 1] = lookupY * wz;
+			dst[3 * i + 2] = wz;
+		}
 	}
 }
 
@@ -699,11 +1020,9 @@ void ofxKinect::grabDepthFrame(freenect_device *dev, void *depth, uint32_t times
 	ofxKinect* kinect = kinectContext.getKinect(dev);
 
 	if(kinect->kinectDevice == dev) {
-		kinect->lock();
-		swap(kinect->depthPixelsRawBack,kinect->depthPixelsRawIntra);
-		kinect->bNeedsUpdateDepth = true;
-		kinect->unlock();
-		freenect_set_depth_buffer(kinect->kinectDevice,kinect->depthPixelsRawBack.getPixels());
+		// hand the filled buffer to update() and get an unused one back
+		ofShortPixels& back = kinect->depthBuffer.publish(timestamp, now()).pixels;
+		freenect_set_depth_buffer(kinect->kinectDevice,back.getPixels());
     }
 }
 
@@ -713,17 +1032,26 @@ void ofxKinect::grabVideoFrame(freenect_device *dev, void *video, uint32_t times
 	ofxKinect* kinect = kinectContext.getKinect(dev);
 
 	if(kinect->kinectDevice == dev) {
-		kinect->lock();
-		swap(kinect->videoPixelsBack,kinect->videoPixelsIntra);
-		kinect->bNeedsUpdateVideo = true;
-		kinect->unlock();
-		freenect_set_video_buffer(kinect->kinectDevice,kinect->videoPixelsBack.getPixels());
+		ofPixels& back = kinect->videoBuffer.publish(timestamp, now()).pixels;
+		freenect_set_video_buffer(kinect->kinectDevice,back.getPixels());
 	}
 }
 
 //---------------------------------------------------------------------------
 void ofxKinect::threadedFunction(){
 
+	startStreams();
+
+	while(isThreadRunning() && freenect_process_events(kinectContext.getContext()) >= 0) {        
+		updateDeviceState();
+	}
+
+	stopStreams();
+}
+
+//---------------------------------------------------------------------------
+void ofxKinect::startStreams(){
+
 	if(currentLed < 0) { 
         freenect_set_led(kinectDevice, (freenect_led_options)ofxKinect::LED_GREEN); 
     }
@@ -739,33 +1067,39 @@ void ofxKinect::threadedFunction(){
 	if(bGrabVideo) {
 		freenect_start_video(kinectDevice);
 	}
+}
 
-	while(isThreadRunning() && freenect_process_events(kinectContext.getContext()) >= 0) {        
-		if(bTiltNeedsApplying) {
-			freenect_set_tilt_degs(kinectDevice, targetTiltAngleDeg);
-			bTiltNeedsApplying = false;
+//---------------------------------------------------------------------------
+void ofxKinect::updateDeviceState(){
+
+	if(bTiltNeedsApplying) {
+		freenect_set_tilt_degs(kinectDevice, targetTiltAngleDeg);
+		bTiltNeedsApplying = false;
+	}
+	
+	if(bLedNeedsApplying) {
+		if(currentLed == ofxKinect::LED_DEFAULT) {
+			freenect_set_led(kinectDevice, (freenect_led_options)ofxKinect::LED_GREEN);
 		}
-		
-		if(bLedNeedsApplying) {
-			if(currentLed == ofxKinect::LED_DEFAULT) {
-				freenect_set_led(kinectDevice, (freenect_led_options)ofxKinect::LED_GREEN);
-			}
-			else {
-				freenect_set_led(kinectDevice, (freenect_led_options)currentLed);
-			}
-			bLedNeedsApplying = false;
+		else {
+			freenect_set_led(kinectDevice, (freenect_led_options)currentLed);
 		}
+		bLedNeedsApplying = false;
+	}
 
-		freenect_update_tilt_state(kinectDevice);
-		freenect_raw_tilt_state * tilt = freenect_get_tilt_state(kinectDevice);
-		currentTiltAngleDeg = freenect_get_tilt_degs(tilt);
+	freenect_update_tilt_state(kinectDevice);
+	freenect_raw_tilt_state * tilt = freenect_get_tilt_state(kinectDevice);
+	currentTiltAngleDeg = freenect_get_tilt_degs(tilt);
 
-		rawAccel.set(tilt->accelerometer_x, tilt->accelerometer_y, tilt->accelerometer_z);
+	rawAccel.set(tilt->accelerometer_x, tilt->accelerometer_y, tilt->accelerometer_z);
 
-		double dx,dy,dz;
-		freenect_get_mks_accel(tilt, &dx, &dy, &dz);
-		mksAccel.set(dx, dy, dz);
-	}
+	double dx,dy,dz;
+	freenect_get_mks_accel(tilt, &dx, &dy, &dz);
+	mksAccel.set(dx, dy, dz);
+}
+
+//---------------------------------------------------------------------------
+void ofxKinect::stopStreams(){
     
 	// finish up a tilt on exit
 	if(bTiltNeedsApplying) {
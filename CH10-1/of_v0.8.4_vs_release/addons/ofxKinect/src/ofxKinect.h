@@ -44,8 +44,10 @@
 
 
 #include "ofxBase3DVideo.h"
+#include "ofxKinectTripleBuffer.h"
 
 class ofxKinectContext;
+class ofxKinectGroup;
 
 /// \class ofxKinect
 ///
@@ -89,6 +91,8 @@ public:
 	/// if you don't set the id (ie id=-1), the first available kinect will be used
 	///
 	/// note: this is the freenct bus id and may change each time the app is run
+	///
+	/// kinects added to an ofxKinectGroup are opened by ofxKinectGroup::open()
 	bool open(int id=-1);
 	
 	/// open using a kinect unique serial number
@@ -98,6 +102,8 @@ public:
 	bool open(string serial);
 
 	/// close the connection and stop grabbing images
+	///
+	/// closing a kinect in a running ofxKinectGroup closes the whole group
 	void close();
 
 	/// is the connection currently open?
@@ -111,6 +117,8 @@ public:
 	/// updates the pixel buffers and textures
 	///
 	/// make sure to call this to update to the latest incoming frames
+	///
+	/// does nothing for a kinect in an ofxKinectGroup, use ofxKinectGroup::update()
 	void update();
 
 /// \section Depth Data
@@ -125,6 +133,23 @@ public:
 	ofVec3f getWorldCoordinateAt(int cx, int cy);
 	ofVec3f getWorldCoordinateAt(float cx, float cy, float wz);
 
+	/// calculates the world coordinates of a whole block of depth points at once
+	///
+	/// same as getWorldCoordinateAt(x, y) for every step-th pixel inside roi
+	/// (default is the whole image), without a libfreenect call per point.
+	/// points without depth are at (0, 0, 0)
+	///
+	/// xyz is allocated to ceil(roi.width / step) x ceil(roi.height / step)
+	/// with 3 channels
+	void getWorldCoordinates(ofFloatPixels& xyz, int step=1, const ofRectangle& roi=ofRectangle());
+
+	/// same, but writes straight into the vertices of a mesh, ie. an ofVboMesh
+	/// drawn with OF_PRIMITIVE_POINTS
+	///
+	/// the vertex count only changes with step or roi, so the vbo
+	/// is updated in place
+	void getWorldCoordinates(ofMesh& mesh, int step=1, const ofRectangle& roi=ofRectangle());
+
 /// \section Intrinsic IR Sensor Parameters
 
 	/// these values are used when depth registration is enabled to align the
@@ -182,6 +207,32 @@ public:
 	/// get the grayscale depth texture
 	ofTexture& getDepthTextureReference();
 
+/// \section Frame Info
+
+	/// get the freenect timestamp of the current frame
+	uint32_t getDepthTimestamp();
+	uint32_t getVideoTimestamp();
+
+	/// get the number of the current frame, counting every frame
+	/// the kinect sent since open()
+	unsigned long long getDepthFrameNumber();
+	unsigned long long getVideoFrameNumber();
+
+	/// get the time the current frame arrived on the host in seconds, see now()
+	///
+	/// the freenect timestamps count on each kinect's own clock, these can be
+	/// compared between kinects
+	double getDepthTime();
+	double getVideoTime();
+
+	/// the host clock used for the frame times, in seconds
+	static double now();
+
+	/// get the number of frames the kinect sent that were replaced
+	/// by a newer frame before update() got to them
+	unsigned long long getNumDroppedDepthFrames();
+	unsigned long long getNumDroppedVideoFrames();
+
 /// \section Grayscale Depth Value
 
 	/// set the near value of the pixels in the grayscale depth image to white
@@ -202,6 +253,16 @@ public:
 	float getNearClipping();
 	float getFarClipping();
 
+	/// only convert the raw depth when the grayscale or distance pixels are used
+	///
+	/// by default update() fills both for every new depth frame. When enabled,
+	/// each is filled the first time it is asked for after update(), so a
+	/// pointer kept from getDepthPixels() or getDistancePixels() only sees the
+	/// new frame once the getter is called again. The depth texture needs the
+	/// grayscale pixels, so they are still filled in update() when using textures.
+	void enableLazyDepthPixels(bool bEnabled=true);
+	bool isLazyDepthPixels();
+
 /// \section Query Capabilities
 
 	/// check for device capabilites ...
@@ -364,23 +425,47 @@ protected:
 private:
 
 	friend class ofxKinectContext;
+	friend class ofxKinectGroup;
 
 	/// global statics shared between kinect instances
 	static ofxKinectContext kinectContext;
 
 	freenect_device* kinectDevice;      ///< kinect device handle
 
-	ofShortPixels depthPixelsRawIntra;	///< depth back
-	ofPixels videoPixelsIntra;			///< rgb back
-	ofShortPixels depthPixelsRawBack;	///< depth back
-	ofPixels videoPixelsBack;			///< rgb back
+	/// frames from the libfreenect callbacks, update() swaps the newest
+	/// into depthPixelsRaw & videoPixels without taking a lock
+	ofxKinectTripleBuffer<unsigned short> depthBuffer;
+	ofxKinectTripleBuffer<unsigned char> videoBuffer;
+
+	uint32_t depthTimestamp, videoTimestamp;
+	unsigned long long depthFrameNumber, videoFrameNumber;
+	double depthTime, videoTime;
+
+	ofxKinectGroup* group; ///< the group this kinect was added to, NULL if none
+
+	/// take a frame from the grabber thread into the pixels & textures
+	void updateVideo(ofxKinectTripleBuffer<unsigned char>::Frame& frame);
+	void updateDepth(ofxKinectTripleBuffer<unsigned short>::Frame& frame);
 
 	vector<unsigned char> depthLookupTable;
 	void updateDepthLookupTable();
-	void updateDepthPixels();
+
+	/// world x & y per unit of depth for each depth column & row, so that
+	/// wx = worldLookupX[x] * wz, same factors as freenect_camera_to_world()
+	vector<float> worldLookupX, worldLookupY;
+	double worldPixelSize, worldDistance;  ///< zero plane the tables are for
+	void updateWorldLookupTables();
+	/// clip roi to the image, returns false if nothing is left
+	bool getWorldRegion(int& step, const ofRectangle& roi, int& x, int& y, int& numX, int& numY);
+	void fillWorldCoordinates(float* xyz, int x, int y, int numX, int numY, int step);
+
+	/// fill the grayscale and/or distance pixels from the raw depth, if not
+	/// done yet for this frame
+	void updateDepthPixels(bool bGray=true, bool bDistance=true);
+	bool bLazyDepthPixels;
+	bool bDepthPixelsDirty, bDistancePixelsDirty;
 
 	bool bIsFrameNewVideo, bIsFrameNewDepth;
-	bool bNeedsUpdateVideo, bNeedsUpdateDepth;
 	bool bGrabVideo;
 	bool bUseRegistration;
 	bool bNearWhite;
@@ -396,6 +481,18 @@ private:
 
 	/// thread function
 	void threadedFunction();
+
+	/// the parts of threadedFunction() an ofxKinectGroup runs for each kinect
+	/// on its own thread
+	void startStreams();
+	void updateDeviceState(); ///< tilt, led & accelerometer
+	void stopStreams();
+
+	/// set up the buffers & callbacks of a device the context just opened
+	void prepareDevice();
+
+	/// forget the device after the streams were stopped
+	void clearConnection();
 };
 
 /// \class ofxKinectContext
@@ -0,0 +1,416 @@
+/*==============================================================================
+
+    Copyright (c) 2010, 2011 ofxKinect Team
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+
+==============================================================================*/
+#include "ofxKinectGroup.h"
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::FrameSet::swap(FrameSet& other) {
+	frames.swap(other.frames);
+	std::swap(number, other.number);
+	std::swap(skew, other.skew);
+	std::swap(meanSkew, other.meanSkew);
+	std::swap(maxSkew, other.maxSkew);
+	numUnmatched.swap(other.numUnmatched);
+}
+
+//--------------------------------------------------------------------
+ofxKinectGroup::ofxKinectGroup() {
+	tolerance = 0.02f;
+
+	numSets = 0;
+	skewSum = 0;
+	maxSkew = 0;
+
+	bNewSet = false;
+	numDroppedSets = 0;
+
+	bIsFrameNew = false;
+	numDroppedSetsFront = 0;
+
+	back.number = intra.number = front.number = 0;
+	back.skew = intra.skew = front.skew = 0;
+	back.meanSkew = intra.meanSkew = front.meanSkew = 0;
+	back.maxSkew = intra.maxSkew = front.maxSkew = 0;
+}
+
+//--------------------------------------------------------------------
+ofxKinectGroup::~ofxKinectGroup() {
+	close();
+	for(size_t i = 0; i < members.size(); i++) {
+		members[i].kinect->group = NULL;
+	}
+}
+
+//--------------------------------------------------------------------
+bool ofxKinectGroup::add(ofxKinect& kinect, int id) {
+	if(isConnected()) {
+		ofLogWarning("ofxKinectGroup") << "add(): cannot add, close the group first";
+		return false;
+	}
+	if(!kinect.bGrabberInited) {
+		ofLogWarning("ofxKinectGroup") << "add(): cannot add, init not called";
+		return false;
+	}
+	if(kinect.group != NULL || kinect.isConnected()) {
+		ofLogWarning("ofxKinectGroup") << "add(): cannot add, kinect is already open or in a group";
+		return false;
+	}
+
+	Member member;
+	member.kinect = &kinect;
+	member.id = id;
+	member.numUnmatched = 0;
+	members.push_back(member);
+	kinect.group = this;
+
+	return true;
+}
+
+//--------------------------------------------------------------------
+bool ofxKinectGroup::add(ofxKinect& kinect, string serial) {
+	if(!add(kinect, -1)) {
+		return false;
+	}
+	members.back().serial = serial;
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::remove(ofxKinect& kinect) {
+	for(size_t i = 0; i < members.size(); i++) {
+		if(members[i].kinect == &kinect) {
+			close();
+			kinect.group = NULL;
+			members.erase(members.begin() + i);
+			return;
+		}
+	}
+}
+
+//--------------------------------------------------------------------
+int ofxKinectGroup::size() {
+	return members.size();
+}
+
+//--------------------------------------------------------------------
+ofxKinect& ofxKinectGroup::getKinect(int i) {
+	return *members[i].kinect;
+}
+
+//--------------------------------------------------------------------
+bool ofxKinectGroup::open() {
+	if(isConnected()) {
+		ofLogWarning("ofxKinectGroup") << "open(): already open";
+		return false;
+	}
+	if(members.empty()) {
+		ofLogWarning("ofxKinectGroup") << "open(): cannot open, no kinects added";
+		return false;
+	}
+
+	for(size_t i = 0; i < members.size(); i++) {
+		Member& member = members[i];
+		bool bOpened = member.serial.empty() ?
+			ofxKinect::kinectContext.open(*member.kinect, member.id) :
+			ofxKinect::kinectContext.open(*member.kinect, member.serial);
+		if(!bOpened) {
+			ofLogWarning("ofxKinectGroup") << "open(): could not open kinect " << i << " of the group";
+			for(size_t j = 0; j < i; j++) {
+				ofxKinect::kinectContext.close(*members[j].kinect);
+				members[j].kinect->clearConnection();
+			}
+			return false;
+		}
+		member.kinect->prepareDevice();
+
+		while(!member.queue.empty()) {
+			dropFrame(i);
+		}
+		member.numUnmatched = 0;
+	}
+
+	back.frames.resize(members.size());
+	back.numUnmatched.assign(members.size(), 0);
+	numSets = 0;
+	skewSum = 0;
+	maxSkew = 0;
+
+	lock();
+	bNewSet = false;
+	numDroppedSets = 0;
+	unlock();
+
+	bIsFrameNew = false;
+	numDroppedSetsFront = 0;
+	front.number = 0;
+	front.skew = front.meanSkew = front.maxSkew = 0;
+	front.numUnmatched.assign(members.size(), 0);
+
+	startThread(true, false); // blocking, not verbose
+
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::close() {
+	if(isThreadRunning()) {
+		stopThread();
+		ofSleepMillis(10);
+		waitForThread(false);
+	}
+
+	for(size_t i = 0; i < members.size(); i++) {
+		if(members[i].kinect->deviceId != -1) {
+			members[i].kinect->clearConnection();
+		}
+	}
+	bIsFrameNew = false;
+}
+
+//--------------------------------------------------------------------
+bool ofxKinectGroup::isConnected() {
+	return isThreadRunning();
+}
+
+//--------------------------------------------------------------------
+bool ofxKinectGroup::isFrameNew() {
+	return bIsFrameNew;
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::update() {
+	lock();
+	bIsFrameNew = bNewSet;
+	if(bNewSet) {
+		front.swap(intra);
+		bNewSet = false;
+	}
+	numDroppedSetsFront = numDroppedSets;
+	unlock();
+
+	for(size_t i = 0; i < members.size(); i++) {
+		ofxKinect& kinect = *members[i].kinect;
+		if(!kinect.bGrabberInited) {
+			continue;
+		}
+
+		if(kinect.videoBuffer.update()) {
+			kinect.updateVideo(kinect.videoBuffer.getFront());
+		} else {
+			kinect.bIsFrameNewVideo = false;
+		}
+
+		if(bIsFrameNew && i < front.frames.size()) {
+			kinect.updateDepth(front.frames[i]);
+		} else {
+			kinect.bIsFrameNewDepth = false;
+		}
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::setTolerance(float seconds) {
+	tolerance = seconds;
+}
+
+//--------------------------------------------------------------------
+float ofxKinectGroup::getTolerance() {
+	return tolerance;
+}
+
+//--------------------------------------------------------------------
+double ofxKinectGroup::getSkew() {
+	return front.skew;
+}
+
+//--------------------------------------------------------------------
+double ofxKinectGroup::getMeanSkew() {
+	return front.meanSkew;
+}
+
+//--------------------------------------------------------------------
+double ofxKinectGroup::getMaxSkew() {
+	return front.maxSkew;
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxKinectGroup::getFrameNumber() {
+	return front.number;
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxKinectGroup::getNumUnmatchedFrames(int i) {
+	if(i < 0 || i >= (int)front.numUnmatched.size()) {
+		return 0;
+	}
+	return front.numUnmatched[i];
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxKinectGroup::getNumDroppedSets() {
+	return numDroppedSetsFront;
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::threadedFunction() {
+
+	freenect_context* context = ofxKinect::kinectContext.getContext();
+
+	for(size_t i = 0; i < members.size(); i++) {
+		members[i].kinect->startStreams();
+	}
+
+	while(isThreadRunning()) {
+		// return now and then even without frames, so stopThread() is noticed
+		timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100000;
+		if(freenect_process_events_timeout(context, &timeout) < 0) {
+			ofLogError("ofxKinectGroup") << "processing events failed, stopping";
+			break;
+		}
+
+		for(size_t i = 0; i < members.size(); i++) {
+			members[i].kinect->updateDeviceState();
+			if(members[i].kinect->depthBuffer.update()) {
+				queueFrame(i);
+			}
+		}
+		matchFrames();
+	}
+
+	for(size_t i = 0; i < members.size(); i++) {
+		members[i].kinect->stopStreams();
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::queueFrame(int i) {
+	Member& member = members[i];
+	if((int)member.queue.size() >= MAX_QUEUED) {
+		dropFrame(i);
+	}
+
+	// take the frame out of the triple buffer, leaving it a spare
+	// buffer of the same size
+	DepthFrame& source = member.kinect->depthBuffer.getFront();
+	member.queue.push_back(DepthFrame());
+	DepthFrame& frame = member.queue.back();
+	if(!spare.empty()) {
+		swap(frame.pixels, spare.back());
+		spare.pop_back();
+	}
+	if(frame.pixels.getWidth() != source.pixels.getWidth() || frame.pixels.getHeight() != source.pixels.getHeight()) {
+		frame.pixels.allocate(source.pixels.getWidth(), source.pixels.getHeight(), 1);
+	}
+	swap(frame.pixels, source.pixels);
+	frame.sequence = source.sequence;
+	frame.timestamp = source.timestamp;
+	frame.time = source.time;
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::dropFrame(int i) {
+	Member& member = members[i];
+	recycle(member.queue.front().pixels);
+	member.queue.pop_front();
+	member.numUnmatched++;
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::recycle(ofShortPixels& pixels) {
+	if(pixels.isAllocated()) {
+		spare.push_back(ofShortPixels());
+		swap(spare.back(), pixels);
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxKinectGroup::matchFrames() {
+	double maxDifference = tolerance;
+	int numMembers = members.size();
+
+	while(true) {
+		// a set needs a frame of every kinect
+		double newest = 0;
+		for(int i = 0; i < numMembers; i++) {
+			if(members[i].queue.empty()) {
+				return;
+			}
+			newest = MAX(newest, members[i].queue.front().time);
+		}
+
+		// frames too old for the newest one can't be in any later set either,
+		// as the later frames of that kinect are newer still
+		bool bDropped = false;
+		for(int i = 0; i < numMembers; i++) {
+			while(!members[i].queue.empty() && members[i].queue.front().time < newest - maxDifference) {
+				dropFrame(i);
+				bDropped = true;
+			}
+		}
+		if(bDropped) {
+			continue;
+		}
+
+		// every kinect's oldest frame is within the tolerance, make a set
+		double oldest = newest;
+		for(int i = 0; i < numMembers; i++) {
+			Member& member = members[i];
+			DepthFrame& frame = member.queue.front();
+			DepthFrame& target = back.frames[i];
+			oldest = MIN(oldest, frame.time);
+
+			swap(target.pixels, frame.pixels);
+			target.sequence = frame.sequence;
+			target.timestamp = frame.timestamp;
+			target.time = frame.time;
+
+			recycle(frame.pixels);
+			member.queue.pop_front();
+			back.numUnmatched[i] = member.numUnmatched;
+		}
+
+		double skew = newest - oldest;
+		numSets++;
+		skewSum += skew;
+		maxSkew = MAX(maxSkew, skew);
+		back.number = numSets;
+		back.skew = skew;
+		back.meanSkew = skewSum / numSets;
+		back.maxSkew = maxSkew;
+
+		lock();
+		back.swap(intra);
+		if(bNewSet) {
+			numDroppedSets++;
+		}
+		bNewSet = true;
+		unlock();
+
+		// keep the layout, the pixels back gets from intra are recycled
+		// on the next set
+		back.frames.resize(numMembers);
+		back.numUnmatched.resize(numMembers);
+	}
+}
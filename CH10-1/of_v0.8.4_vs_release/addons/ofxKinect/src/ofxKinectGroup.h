@@ -0,0 +1,187 @@
+/*==============================================================================
+
+    Copyright (c) 2010, 2011 ofxKinect Team
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+
+==============================================================================*/
+#pragma once
+
+#include "ofxKinect.h"
+
+#include <atomic>
+#include <deque>
+
+/// \class ofxKinectGroup
+///
+/// runs several kinects from one thread and hands their depth frames over
+/// in synchronized sets
+///
+/// libfreenect delivers the frames of every device in the context from
+/// freenect_process_events(), so the group runs a single event thread for
+/// all of its kinects instead of one per ofxKinect. The depth frames of each
+/// kinect are queued there and matched by the time they arrived on the host:
+/// a set has one frame of every kinect, none of them further apart than the
+/// tolerance. Frames left without a partner are dropped.
+///
+/// the kinects aren't genlocked, so the frames of two free running kinects
+/// at 30fps are up to half a frame (~17ms) apart, see getSkew()
+///
+/// usage:
+///
+///     kinect1.init();
+///     kinect2.init();
+///     group.add(kinect1, 0);
+///     group.add(kinect2, 1);
+///     group.open();
+///
+///     // in update()
+///     group.update();
+///     if(group.isFrameNew()) {
+///         // kinect1 & kinect2 hold the depth frames of the same moment
+///     }
+///
+class ofxKinectGroup : protected ofThread {
+
+public:
+
+	ofxKinectGroup();
+	virtual ~ofxKinectGroup();
+
+/// \section Main
+
+	/// add an inited kinect, to be opened by open()
+	///
+	/// id & serial choose the device as in ofxKinect::open(),
+	/// only call while the group is closed
+	bool add(ofxKinect& kinect, int id=-1);
+	bool add(ofxKinect& kinect, string serial);
+
+	/// take a kinect out of the group, closes the group if it is running
+	void remove(ofxKinect& kinect);
+
+	/// the number of kinects in the group
+	int size();
+
+	/// get the i-th kinect added
+	ofxKinect& getKinect(int i);
+
+	/// open all kinects and start the event thread, fails if any of them
+	/// can't be opened
+	bool open();
+
+	/// stop the event thread and close all kinects
+	void close();
+
+	/// is the event thread running?
+	bool isConnected();
+
+	/// was there a new set on the last update()?
+	bool isFrameNew();
+
+	/// load the newest set into the depth pixels & textures of the kinects,
+	/// the video pixels are updated to the newest frames as in ofxKinect::update()
+	///
+	/// call this instead of ofxKinect::update() for the kinects in the group
+	void update();
+
+/// \section Synchronization
+
+	/// set the largest difference in arrival time between the frames of
+	/// a set in seconds
+	///
+	/// keep it below a frame, default is 20ms which always finds a partner
+	/// for two kinects at 30fps
+	void setTolerance(float seconds=0.02);
+	float getTolerance();
+
+	/// get the skew of the current set: the time between the first and
+	/// the last of its frames arriving, in seconds
+	double getSkew();
+
+	/// get the mean & largest skew of all sets since open()
+	double getMeanSkew();
+	double getMaxSkew();
+
+	/// get the number of the current set, counting every set since open()
+	unsigned long long getFrameNumber();
+
+	/// get the number of depth frames of the i-th kinect that were dropped
+	/// without a partner since open()
+	unsigned long long getNumUnmatchedFrames(int i);
+
+	/// get the number of sets replaced by a newer one before update() got to them
+	unsigned long long getNumDroppedSets();
+
+private:
+
+	typedef ofxKinectTripleBuffer<unsigned short>::Frame DepthFrame;
+
+	/// the depth frames of all kinects, same order as added
+	struct FrameSet {
+		vector<DepthFrame> frames;
+		unsigned long long number;
+		double skew, meanSkew, maxSkew;
+		vector<unsigned long long> numUnmatched;
+
+		/// exchange the contents without copying pixels
+		void swap(FrameSet& other);
+	};
+
+	struct Member {
+		ofxKinect* kinect;
+		int id;
+		string serial;            ///< used instead of id if not empty
+		deque<DepthFrame> queue;  ///< frames waiting for a partner, oldest first
+		unsigned long long numUnmatched;
+	};
+
+	/// how many frames a kinect may queue while another one is late
+	static const int MAX_QUEUED = 4;
+
+	vector<Member> members;
+
+	std::atomic<float> tolerance;
+
+	/// group thread only
+	vector<ofShortPixels> spare; ///< pixels of dropped & handed over frames
+	FrameSet back;
+	unsigned long long numSets;
+	double skewSum, maxSkew;
+
+	/// shared, under lock()
+	FrameSet intra;
+	bool bNewSet;
+	unsigned long long numDroppedSets;
+
+	/// main thread only
+	FrameSet front;
+	bool bIsFrameNew;
+	unsigned long long numDroppedSetsFront;
+
+	void threadedFunction();
+
+	/// move the new depth frame of members[i] into its queue
+	void queueFrame(int i);
+	/// drop the oldest queued frame of members[i]
+	void dropFrame(int i);
+	/// hand over sets while every kinect has a frame queued
+	void matchFrames();
+	void recycle(ofShortPixels& pixels);
+};
@@ -0,0 +1,167 @@
+/*==============================================================================
+
+    Copyright (c) 2010, 2011 ofxKinect Team
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+
+==============================================================================*/
+#pragma once
+
+#include "ofMain.h"
+
+#include <atomic>
+#include <stdint.h>
+
+/// \class ofxKinectTripleBuffer
+///
+/// lock-free handoff of frames from one producer thread to one consumer
+///
+/// there are three slots: the back slot the producer writes into, the front
+/// slot the consumer reads from, and a middle slot. publish() exchanges the
+/// back slot with the middle one and update() exchanges the middle slot with
+/// the front one, each as a single atomic exchange of the slot index. So the
+/// libfreenect thread never waits for update() and update() never waits
+/// for libfreenect, and the consumer always gets the newest frame.
+///
+/// the slots are only touched by the side that owns them, the contents of a
+/// slot can be swapped with other pixels of the same size
+///
+template<typename PixelType>
+class ofxKinectTripleBuffer {
+
+public:
+
+	/// a frame and where it came from
+	struct Frame {
+		ofPixels_<PixelType> pixels;
+		unsigned long long sequence; ///< counts up from 1 with every published frame
+		uint32_t timestamp;          ///< freenect timestamp of the frame
+		double time;                 ///< host time the frame arrived, in seconds
+	};
+
+	ofxKinectTripleBuffer() {
+		back = 0;
+		middle = 1;
+		front = 2;
+		numPublished = 0;
+		numDropped = 0;
+		for(int i = 0; i < 3; i++) {
+			frames[i].sequence = 0;
+			frames[i].timestamp = 0;
+			frames[i].time = 0;
+		}
+	}
+
+	/// allocate all three slots, only call when neither side is running
+	void allocate(int width, int height, int channels) {
+		for(int i = 0; i < 3; i++) {
+			frames[i].pixels.allocate(width, height, channels);
+			frames[i].pixels.set(0);
+		}
+	}
+
+	/// free all three slots, only call when neither side is running
+	void clear() {
+		for(int i = 0; i < 3; i++) {
+			frames[i].pixels.clear();
+		}
+	}
+
+	/// forget any frame not taken yet and zero the counters,
+	/// only call when neither side is running
+	void reset() {
+		middle = middle & INDEX_MASK;
+		numPublished = 0;
+		numDropped = 0;
+	}
+
+/// \section Producer
+
+	/// the slot to write the next frame into
+	Frame& getBack() {
+		return frames[back];
+	}
+
+	/// hand the back slot to the consumer, returns the new back slot
+	Frame& publish(uint32_t timestamp, double time) {
+		Frame& frame = frames[back];
+		frame.sequence = numPublished.load(std::memory_order_relaxed) + 1;
+		frame.timestamp = timestamp;
+		frame.time = time;
+		numPublished.store(frame.sequence, std::memory_order_relaxed);
+
+		int previous = middle.exchange(back | NEW_FRAME, std::memory_order_acq_rel);
+		if(previous & NEW_FRAME) {
+			// the consumer never saw the frame we're taking back
+			numDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		back = previous & INDEX_MASK;
+		return frames[back];
+	}
+
+/// \section Consumer
+
+	/// is there a frame update() would take?
+	bool isFrameNew() const {
+		return (middle.load(std::memory_order_relaxed) & NEW_FRAME) != 0;
+	}
+
+	/// take the newest frame into the front slot, returns false and keeps
+	/// the current front slot if nothing was published since the last call
+	bool update() {
+		if(!isFrameNew()) {
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	/// the slot update() took last
+	Frame& getFront() {
+		return frames[front];
+	}
+
+/// \section Counters
+
+	/// frames published since reset()
+	unsigned long long getNumPublished() const {
+		return numPublished.load(std::memory_order_relaxed);
+	}
+
+	/// frames replaced by a newer one before update() took them
+	unsigned long long getNumDropped() const {
+		return numDropped.load(std::memory_order_relaxed);
+	}
+
+private:
+
+	ofxKinectTripleBuffer(const ofxKinectTripleBuffer&);
+	ofxKinectTripleBuffer& operator=(const ofxKinectTripleBuffer&);
+
+	static const int INDEX_MASK = 3;
+	static const int NEW_FRAME = 4;
+
+	Frame frames[3];
+	int back;                 ///< producer only
+	int front;                ///< consumer only
+	std::atomic<int> middle;  ///< slot index | NEW_FRAME when not taken yet
+
+	std::atomic<unsigned long long> numPublished;
+	std::atomic<unsigned long long> numDropped;
+};
@@ -0,0 +1,297 @@
+#include "fakeFreenect.h"
+
+#include "libfreenect.h"
+#include "libfreenect_registration.h"
+#include "freenect_internal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+FakeFreenectConfig fakeFreenectConfig;
+
+namespace {
+
+struct FakeDevice {
+	int index;
+	freenect_device* device;
+	void* depthBuffer;
+	void* videoBuffer;
+	freenect_depth_cb depthCallback;
+	freenect_video_cb videoCallback;
+	bool bDepthRunning;
+	bool bVideoRunning;
+	double nextCapture;    ///< capture time of the next frame
+	double nextDelivery;   ///< when it arrives, 0 until its delay is drawn
+	unsigned long long numFrames;
+	std::mt19937 random;
+};
+
+std::map<freenect_device*, FakeDevice*> devices;
+std::vector<std::string> serials;
+std::mutex devicesMutex;
+freenect_raw_tilt_state tiltState;
+
+double now() {
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+FakeDevice* find(freenect_device* device) {
+	std::lock_guard<std::mutex> lock(devicesMutex);
+	return devices[device];
+}
+
+std::vector<FakeDevice*> running() {
+	std::vector<FakeDevice*> list;
+	std::lock_guard<std::mutex> lock(devicesMutex);
+	for(std::map<freenect_device*, FakeDevice*>::iterator it = devices.begin(); it != devices.end(); ++it) {
+		if(it->second->bDepthRunning) {
+			list.push_back(it->second);
+		}
+	}
+	return list;
+}
+
+// deliver every frame whose transfer is done, returns how many
+int deliver() {
+	int count = 0;
+	double time = now();
+	std::vector<FakeDevice*> list = running();
+	for(size_t i = 0; i < list.size(); i++) {
+		FakeDevice& fake = *list[i];
+		if(fake.nextDelivery == 0) {
+			std::uniform_real_distribution<double> jitter(0, fakeFreenectConfig.maxJitter);
+			fake.nextDelivery = fake.nextCapture + fakeFreenectConfig.minDelay + jitter(fake.random);
+		}
+		if(time < fake.nextDelivery) {
+			continue;
+		}
+
+		unsigned short* depth = (unsigned short*)fake.depthBuffer;
+		unsigned long long micros = (unsigned long long)(fake.nextCapture * 1e6);
+		for(int k = 0; k < 4; k++) {
+			depth[k] = (unsigned short)(micros >> (16 * k));
+		}
+		std::fill(depth + 4, depth + FAKE_FREENECT_PIXELS, (unsigned short)(fake.index * 10007 + fake.numFrames));
+		fake.numFrames++;
+
+		// each device counts time on a clock of its own
+		uint32_t timestamp = (uint32_t)(fake.nextCapture * 60e6 * (1 + 0.01 * fake.index)) + 1234567 * fake.index;
+		fake.depthCallback(fake.device, fake.depthBuffer, timestamp);
+		if(fake.bVideoRunning && fake.videoCallback != NULL) {
+			fake.videoCallback(fake.device, fake.videoBuffer, timestamp);
+		}
+
+		fake.nextCapture += 1.0 / fakeFreenectConfig.fps[fake.index];
+		fake.nextDelivery = 0;
+		count++;
+	}
+	return count;
+}
+
+// when the next frame of any device arrives
+double nextDelivery() {
+	double next = 1e300;
+	std::vector<FakeDevice*> list = running();
+	for(size_t i = 0; i < list.size(); i++) {
+		double delivery = list[i]->nextDelivery;
+		if(delivery == 0) {
+			delivery = list[i]->nextCapture + fakeFreenectConfig.minDelay;
+		}
+		next = std::min(next, delivery);
+	}
+	return next;
+}
+
+}
+
+extern "C" {
+
+int freenect_init(freenect_context** ctx, freenect_usb_context*) {
+	*ctx = (freenect_context*)new char[16];
+	return 0;
+}
+
+int freenect_shutdown(freenect_context* ctx) {
+	delete[] (char*)ctx;
+	return 0;
+}
+
+void freenect_set_log_level(freenect_context*, freenect_loglevel) {}
+void freenect_select_subdevices(freenect_context*, freenect_device_flags) {}
+void freenect_set_fw_address_nui(freenect_context*, unsigned char*, unsigned int) {}
+void freenect_set_fw_address_k4w(freenect_context*, unsigned char*, unsigned int) {}
+
+int freenect_num_devices(freenect_context*) {
+	return fakeFreenectConfig.numDevices;
+}
+
+int freenect_list_device_attributes(freenect_context*, struct freenect_device_attributes** list) {
+	serials.clear();
+	for(int i = 0; i < fakeFreenectConfig.numDevices; i++) {
+		char serial[32];
+		snprintf(serial, sizeof(serial), "A000000%09d", i);
+		serials.push_back(serial);
+	}
+
+	freenect_device_attributes* head = NULL;
+	freenect_device_attributes** tail = &head;
+	for(size_t i = 0; i < serials.size(); i++) {
+		freenect_device_attributes* attributes = new freenect_device_attributes;
+		attributes->next = NULL;
+		attributes->camera_serial = serials[i].c_str();
+		*tail = attributes;
+		tail = &attributes->next;
+	}
+	*list = head;
+	return (int)serials.size();
+}
+
+void freenect_free_device_attributes(struct freenect_device_attributes* attributes) {
+	while(attributes != NULL) {
+		freenect_device_attributes* next = attributes->next;
+		delete attributes;
+		attributes = next;
+	}
+}
+
+int freenect_open_device(freenect_context*, freenect_device** device, int index) {
+	if(index < 0 || index >= fakeFreenectConfig.numDevices) {
+		return -1;
+	}
+	*device = new freenect_device();
+	memset(*device, 0, sizeof(freenect_device));
+
+	FakeDevice* fake = new FakeDevice();
+	fake->index = index;
+	fake->device = *device;
+	fake->random.seed(index + 1);
+	std::lock_guard<std::mutex> lock(devicesMutex);
+	devices[*device] = fake;
+	return 0;
+}
+
+int freenect_open_device_by_camera_serial(freenect_context* ctx, freenect_device** device, const char* serial) {
+	for(size_t i = 0; i < serials.size(); i++) {
+		if(serials[i] == serial) {
+			return freenect_open_device(ctx, device, (int)i);
+		}
+	}
+	return -1;
+}
+
+int freenect_close_device(freenect_device* device) {
+	std::lock_guard<std::mutex> lock(devicesMutex);
+	delete devices[device];
+	devices.erase(device);
+	delete device;
+	return 0;
+}
+
+void freenect_set_user(freenect_device* device, void* user) {
+	device->user_data = user;
+}
+
+void freenect_set_depth_callback(freenect_device* device, freenect_depth_cb callback) {
+	find(device)->depthCallback = callback;
+}
+
+void freenect_set_video_callback(freenect_device* device, freenect_video_cb callback) {
+	find(device)->videoCallback = callback;
+}
+
+int freenect_set_depth_buffer(freenect_device* device, void* buffer) {
+	find(device)->depthBuffer = buffer;
+	return 0;
+}
+
+int freenect_set_video_buffer(freenect_device* device, void* buffer) {
+	find(device)->videoBuffer = buffer;
+	return 0;
+}
+
+freenect_frame_mode freenect_find_video_mode(freenect_resolution, freenect_video_format) {
+	freenect_frame_mode mode;
+	memset(&mode, 0, sizeof(mode));
+	mode.is_valid = 1;
+	return mode;
+}
+
+freenect_frame_mode freenect_find_depth_mode(freenect_resolution, freenect_depth_format) {
+	freenect_frame_mode mode;
+	memset(&mode, 0, sizeof(mode));
+	mode.is_valid = 1;
+	return mode;
+}
+
+int freenect_set_video_mode(freenect_device*, freenect_frame_mode) { return 0; }
+int freenect_set_depth_mode(freenect_device*, const freenect_frame_mode) { return 0; }
+
+int freenect_start_depth(freenect_device* device) {
+	FakeDevice* fake = find(device);
+	fake->nextCapture = now() + fakeFreenectConfig.phase[fake->index] / fakeFreenectConfig.fps[fake->index];
+	fake->nextDelivery = 0;
+	fake->bDepthRunning = true;
+	return 0;
+}
+
+int freenect_start_video(freenect_device* device) {
+	find(device)->bVideoRunning = true;
+	return 0;
+}
+
+int freenect_stop_depth(freenect_device* device) {
+	find(device)->bDepthRunning = false;
+	return 0;
+}
+
+int freenect_stop_video(freenect_device* device) {
+	find(device)->bVideoRunning = false;
+	return 0;
+}
+
+int freenect_set_led(freenect_device*, freenect_led_options) { return 0; }
+int freenect_set_tilt_degs(freenect_device*, double) { return 0; }
+int freenect_update_tilt_state(freenect_device*) { return 0; }
+freenect_raw_tilt_state* freenect_get_tilt_state(freenect_device*) { return &tiltState; }
+double freenect_get_tilt_degs(freenect_raw_tilt_state*) { return 0; }
+
+void freenect_get_mks_accel(freenect_raw_tilt_state*, double* x, double* y, double* z) {
+	*x = *y = *z = 0;
+}
+
+void freenect_camera_to_world(freenect_device*, int cx, int cy, int wz, double* wx, double* wy) {
+	*wx = cx * wz;
+	*wy = cy * wz;
+}
+
+int freenect_process_events_timeout(freenect_context*, struct timeval* timeout) {
+	double limit = now() + timeout->tv_sec + timeout->tv_usec * 1e-6;
+	while(true) {
+		if(deliver() > 0) {
+			return 0;
+		}
+		double time = now();
+		if(time >= limit) {
+			return 0;
+		}
+		double wait = std::min(nextDelivery(), limit) - time;
+		std::this_thread::sleep_for(duration<double>(std::max(0.0, std::min(wait, 0.002))));
+	}
+}
+
+int freenect_process_events(freenect_context* ctx) {
+	timeval timeout = {60, 0};
+	return freenect_process_events_timeout(ctx, &timeout);
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// a fake libfreenect backend for the ofxKinect tests
+//
+// fakeFreenect.cpp implements the libfreenect calls ofxKinect makes. Each
+// device free runs at its own rate & phase and freenect_process_events()
+// delivers its depth frames after a short random transfer delay, like USB.
+// Every depth frame carries its capture time in microseconds in the first
+// 4 pixels and a value unique to the frame in all others, so a test can
+// tell whether a frame was torn.
+
+/// how the fake devices behave, set before opening them
+struct FakeFreenectConfig {
+	static const int MAX_DEVICES = 4;
+
+	int numDevices;
+	double fps[MAX_DEVICES];    ///< frames per second of each device
+	double phase[MAX_DEVICES];  ///< capture offset of each device, in frames
+	double minDelay;            ///< transfer delay is minDelay to minDelay + maxJitter seconds
+	double maxJitter;
+
+	FakeFreenectConfig() : numDevices(2), minDelay(0.002), maxJitter(0.003) {
+		for(int i = 0; i < MAX_DEVICES; i++) {
+			fps[i] = 30;
+			phase[i] = 0;
+		}
+	}
+};
+
+extern FakeFreenectConfig fakeFreenectConfig;
+
+/// number of pixels in a depth frame
+const int FAKE_FREENECT_PIXELS = 640 * 480;
@@ -0,0 +1,160 @@
+// tests for ofxKinectGroup, run against the fake libfreenect in fakeFreenect.cpp
+//
+// each scenario opens a group of free running fake kinects, takes sets for
+// a few seconds at 60Hz and checks that every set is complete, untorn, in
+// order and within the tolerance, then that closing, reopening and deleting
+// a kinect while the group runs leave everything closed
+
+#include "ofxKinectGroup.h"
+#include "fakeFreenect.h"
+
+#include <stdio.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what, int line) {
+	if(!ok) {
+		printf("failed line %d: %s\n", line, what);
+		failures++;
+	}
+}
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+struct Scenario {
+	const char* name;
+	int numDevices;
+	double fps[FakeFreenectConfig::MAX_DEVICES];
+	double phase[FakeFreenectConfig::MAX_DEVICES];
+	double seconds;
+	bool bCloseByKinect;  ///< close one of the kinects instead of the group
+};
+
+//--------------------------------------------------------------
+void run(const Scenario& scenario) {
+	const float tolerance = 0.02f;
+	int n = scenario.numDevices;
+	fakeFreenectConfig.numDevices = n;
+	for(int i = 0; i < n; i++) {
+		fakeFreenectConfig.fps[i] = scenario.fps[i];
+		fakeFreenectConfig.phase[i] = scenario.phase[i];
+	}
+
+	ofxKinectGroup* group = new ofxKinectGroup();
+	group->setTolerance(tolerance);
+	vector<ofxKinect*> kinects;
+	for(int i = 0; i < n; i++) {
+		kinects.push_back(new ofxKinect());
+		kinects.back()->init(false, true, false);
+		CHECK(group->add(*kinects.back(), i));
+	}
+	CHECK(group->size() == n);
+	CHECK(group->open());
+	CHECK(group->isConnected());
+	for(int i = 0; i < n; i++) {
+		CHECK(kinects[i]->isConnected());
+	}
+
+	unsigned long long sets = 0, lastNumber = 0, torn = 0, outOfOrder = 0, notNew = 0, badSkew = 0;
+	double maxSkew = 0;
+	float start = ofGetElapsedTimef();
+	while(ofGetElapsedTimef() - start < scenario.seconds) {
+		ofSleepMillis(16);
+		group->update();
+		if(!group->isFrameNew()) {
+			continue;
+		}
+		sets++;
+		if(group->getFrameNumber() <= lastNumber) {
+			outOfOrder++;
+		}
+		lastNumber = group->getFrameNumber();
+
+		// the skew is the spread of the arrival times of the set's frames
+		double first = 1e300, last = -1e300;
+		for(int i = 0; i < n; i++) {
+			ofxKinect& kinect = *kinects[i];
+			if(!kinect.isFrameNewDepth()) {
+				notNew++;
+			}
+			const unsigned short* depth = kinect.getRawDepthPixels();
+			for(int j = 5; j < FAKE_FREENECT_PIXELS; j++) {
+				if(depth[j] != depth[4]) {
+					torn++;
+					break;
+				}
+			}
+			first = MIN(first, kinect.getDepthTime());
+			last = MAX(last, kinect.getDepthTime());
+		}
+		if(fabs((last - first) - group->getSkew()) > 1e-9 || group->getSkew() > tolerance + 1e-6) {
+			badSkew++;
+		}
+		maxSkew = MAX(maxSkew, group->getSkew());
+	}
+
+	printf("%-24s sets %llu mean skew %.1f ms max %.1f ms unmatched", scenario.name, sets,
+		1e3 * group->getMeanSkew(), 1e3 * maxSkew);
+	for(int i = 0; i < n; i++) {
+		printf(" %llu", group->getNumUnmatchedFrames(i));
+	}
+	printf("\n");
+
+	// the slowest kinect sets the pace, allow for a slow machine
+	double slowest = scenario.fps[0];
+	for(int i = 1; i < n; i++) {
+		slowest = MIN(slowest, scenario.fps[i]);
+	}
+	CHECK(sets > slowest * scenario.seconds * 0.7);
+	CHECK(torn == 0);
+	CHECK(outOfOrder == 0);
+	CHECK(notNew == 0);
+	CHECK(badSkew == 0);
+	CHECK(group->getMaxSkew() <= tolerance + 1e-6);
+
+	if(scenario.bCloseByKinect) {
+		kinects[n - 1]->close();
+	} else {
+		group->close();
+	}
+	CHECK(!group->isConnected());
+	for(int i = 0; i < n; i++) {
+		CHECK(!kinects[i]->isConnected());
+		CHECK(kinects[i]->getDeviceId() == -1);
+	}
+
+	// reopen, then delete a kinect while running: it closes the group and leaves it
+	CHECK(group->open());
+	ofSleepMillis(200);
+	group->update();
+	delete kinects[0];
+	CHECK(group->size() == n - 1);
+	CHECK(!group->isConnected());
+
+	delete group;
+	for(int i = 1; i < n; i++) {
+		delete kinects[i];
+	}
+}
+
+}
+
+//--------------------------------------------------------------
+int main() {
+	const Scenario scenarios[] = {
+		{"2 x 30fps 5ms apart", 2, {30, 30}, {0, 0.15}, 3, false},
+		{"2 x 30fps 16ms apart", 2, {30, 30}, {0, 0.49}, 3, true},
+		{"3 x 30fps 0/5/16ms", 3, {30, 30, 30}, {0, 0.15, 0.5}, 3, false},
+		{"30fps + 15fps", 2, {30, 15}, {0, 0.15}, 3, false},
+		{"30fps + 30.3fps", 2, {30, 30.3}, {0, 0.15}, 4, false},
+		{"1 kinect", 1, {30}, {0}, 1, false},
+	};
+	for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		run(scenarios[i]);
+	}
+
+	printf("%s\n", failures == 0 ? "OK" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
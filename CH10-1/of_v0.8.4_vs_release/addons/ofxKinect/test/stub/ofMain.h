@@ -0,0 +1,219 @@
+#pragma once
+
+// the parts of openFrameworks the ofxKinect tests need, so they build and
+// run without the rest of the core. textures and drawing do nothing, logging
+// goes to stderr
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+using namespace std;
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+
+#define GL_RGB       0x1907
+#define GL_LUMINANCE 0x1909
+
+//--------------------------------------------------------------
+template<typename PixelType>
+class ofPixels_ {
+public:
+	ofPixels_() : width(0), height(0), channels(0) {}
+
+	void allocate(int w, int h, int c) {
+		width = w;
+		height = h;
+		channels = c;
+		pixels.assign((size_t)w * h * c, 0);
+	}
+
+	void set(PixelType value) { std::fill(pixels.begin(), pixels.end(), value); }
+	void clear() { pixels.clear(); width = height = channels = 0; }
+	void swap(ofPixels_& other) {
+		pixels.swap(other.pixels);
+		std::swap(width, other.width);
+		std::swap(height, other.height);
+		std::swap(channels, other.channels);
+	}
+
+	PixelType* getPixels() { return pixels.empty() ? NULL : &pixels[0]; }
+	const PixelType* getPixels() const { return pixels.empty() ? NULL : &pixels[0]; }
+	PixelType& operator[](int i) { return pixels[i]; }
+	int size() const { return (int)pixels.size(); }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getNumChannels() const { return channels; }
+	bool isAllocated() const { return !pixels.empty(); }
+
+private:
+	vector<PixelType> pixels;
+	int width, height, channels;
+};
+
+typedef ofPixels_<unsigned char> ofPixels;
+typedef ofPixels_<unsigned short> ofShortPixels;
+typedef ofPixels_<float> ofFloatPixels;
+
+template<typename PixelType>
+void swap(ofPixels_<PixelType>& a, ofPixels_<PixelType>& b) {
+	a.swap(b);
+}
+
+//--------------------------------------------------------------
+class ofTexture {
+public:
+	ofTexture() : allocated(false) {}
+	void allocate(int, int, int) { allocated = true; }
+	void clear() { allocated = false; }
+	bool bAllocated() const { return allocated; }
+	void loadData(const unsigned char*, int, int, int) {}
+	void draw(float, float, float, float) {}
+
+private:
+	bool allocated;
+};
+
+//--------------------------------------------------------------
+class ofVec3f {
+public:
+	float x, y, z;
+	ofVec3f(float x = 0, float y = 0, float z = 0) : x(x), y(y), z(z) {}
+	void set(float _x, float _y, float _z) { x = _x; y = _y; z = _z; }
+	float* getPtr() { return &x; }
+};
+
+typedef ofVec3f ofPoint;
+
+class ofRectangle {
+public:
+	float x, y, width, height;
+	ofRectangle() : x(0), y(0), width(0), height(0) {}
+	ofRectangle(float x, float y, float w, float h) : x(x), y(y), width(w), height(h) {}
+	void set(float _x, float _y, float w, float h) { x = _x; y = _y; width = w; height = h; }
+	bool isEmpty() const { return width == 0 && height == 0; }
+	float getMinX() const { return MIN(x, x + width); }
+	float getMaxX() const { return MAX(x, x + width); }
+	float getMinY() const { return MIN(y, y + height); }
+	float getMaxY() const { return MAX(y, y + height); }
+};
+
+class ofColor {
+public:
+	unsigned char r, g, b, a;
+	ofColor(int r = 0, int g = 0, int b = 0) : r(r), g(g), b(b), a(255) {}
+};
+
+class ofMesh {
+public:
+	vector<ofVec3f>& getVertices() { return vertices; }
+	int getNumVertices() const { return (int)vertices.size(); }
+	void clear() { vertices.clear(); }
+
+private:
+	vector<ofVec3f> vertices;
+};
+
+//--------------------------------------------------------------
+class ofBaseVideo {
+public:
+	virtual ~ofBaseVideo() {}
+	virtual bool isFrameNew() = 0;
+	virtual void close() = 0;
+	virtual unsigned char* getPixels() = 0;
+	virtual ofPixels& getPixelsRef() = 0;
+	virtual void update() = 0;
+};
+
+//--------------------------------------------------------------
+class ofThread {
+public:
+	ofThread() : running(false) {}
+	virtual ~ofThread() { waitForThread(true); }
+
+	void startThread(bool blocking = true, bool verbose = false) {
+		waitForThread(true);
+		running = true;
+		thread = std::thread(&ofThread::threadedFunction, this);
+	}
+	void stopThread() { running = false; }
+	bool isThreadRunning() { return running; }
+	void waitForThread(bool stop = true) {
+		if(stop) {
+			running = false;
+		}
+		if(thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+			thread.join();
+		}
+	}
+	bool lock() { mutex.lock(); return true; }
+	void unlock() { mutex.unlock(); }
+
+protected:
+	virtual void threadedFunction() {}
+
+private:
+	std::thread thread;
+	std::recursive_mutex mutex;
+	std::atomic<bool> running;
+};
+
+//--------------------------------------------------------------
+class ofLog {
+public:
+	ofLog(const char* level, const string& module) {
+		message << "[" << level << "] " << module << ": ";
+	}
+	~ofLog() {
+		message << "\n";
+		cerr << message.str();
+	}
+	template<typename T>
+	ofLog& operator<<(const T& value) {
+		message << value;
+		return *this;
+	}
+
+private:
+	ostringstream message;
+};
+
+class ofLogVerbose : public ofLog { public: ofLogVerbose(const string& module) : ofLog("verbose", module) {} };
+class ofLogNotice : public ofLog { public: ofLogNotice(const string& module) : ofLog("notice", module) {} };
+class ofLogWarning : public ofLog { public: ofLogWarning(const string& module) : ofLog("warning", module) {} };
+class ofLogError : public ofLog { public: ofLogError(const string& module) : ofLog("error", module) {} };
+
+//--------------------------------------------------------------
+inline float ofGetElapsedTimef() {
+	static chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	return chrono::duration<float>(chrono::steady_clock::now() - start).count();
+}
+
+inline void ofSleepMillis(int millis) {
+	this_thread::sleep_for(chrono::milliseconds(millis));
+}
+
+inline float ofClamp(float value, float min, float max) {
+	return value < min ? min : value > max ? max : value;
+}
+
+inline float ofMap(float value, float inputMin, float inputMax, float outputMin, float outputMax, bool clamp = false) {
+	float out = (value - inputMin) / (inputMax - inputMin) * (outputMax - outputMin) + outputMin;
+	return clamp ? ofClamp(out, MIN(outputMin, outputMax), MAX(outputMin, outputMax)) : out;
+}
+
+inline float ofRadToDeg(float radians) {
+	return radians * 57.29577951308232f;
+}
@@ -0,0 +1,165 @@
+// tests for ofxKinectTripleBuffer
+//
+// a producer thread stands in for the libfreenect callbacks: it fills the
+// back slot with a pattern derived from the frame's sequence number and
+// publishes it, the main thread takes frames at uneven intervals like a
+// stalling app and checks that no frame is torn, reordered or lost track of
+
+#include "ofxKinectTripleBuffer.h"
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <thread>
+
+using namespace std::chrono;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what, int line) {
+	if(!ok) {
+		printf("failed line %d: %s\n", line, what);
+		failures++;
+	}
+}
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+const int WIDTH = 640;
+const int HEIGHT = 480;
+
+typedef ofxKinectTripleBuffer<unsigned short> DepthBuffer;
+
+void fill(unsigned short* pixels, unsigned long long sequence) {
+	for(int i = 0; i < WIDTH * HEIGHT; i++) {
+		pixels[i] = (unsigned short)(sequence * 7 + i);
+	}
+}
+
+bool isIntact(const unsigned short* pixels, unsigned long long sequence) {
+	for(int i = 0; i < WIDTH * HEIGHT; i++) {
+		if(pixels[i] != (unsigned short)(sequence * 7 + i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+void testSingleThread() {
+	DepthBuffer buffer;
+	buffer.allocate(WIDTH, HEIGHT, 1);
+	CHECK(!buffer.isFrameNew());
+	CHECK(!buffer.update());
+
+	fill(buffer.getBack().pixels.getPixels(), 1);
+	buffer.publish(100, 1.5);
+	CHECK(buffer.isFrameNew());
+	CHECK(buffer.update());
+	CHECK(!buffer.isFrameNew());
+	CHECK(buffer.getFront().sequence == 1);
+	CHECK(buffer.getFront().timestamp == 100);
+	CHECK(buffer.getFront().time == 1.5);
+	CHECK(isIntact(buffer.getFront().pixels.getPixels(), 1));
+
+	// nothing new keeps the current front slot
+	CHECK(!buffer.update());
+	CHECK(buffer.getFront().sequence == 1);
+
+	// two frames before update(): the older one is dropped, the newer one taken
+	fill(buffer.getBack().pixels.getPixels(), 2);
+	buffer.publish(200, 2.0);
+	fill(buffer.getBack().pixels.getPixels(), 3);
+	buffer.publish(300, 2.5);
+	CHECK(buffer.getNumPublished() == 3);
+	CHECK(buffer.getNumDropped() == 1);
+	CHECK(buffer.update());
+	CHECK(buffer.getFront().sequence == 3);
+	CHECK(isIntact(buffer.getFront().pixels.getPixels(), 3));
+
+	// the front slot's pixels can be swapped out
+	ofShortPixels mine;
+	mine.allocate(WIDTH, HEIGHT, 1);
+	swap(mine, buffer.getFront().pixels);
+	CHECK(isIntact(mine.getPixels(), 3));
+	CHECK(buffer.getFront().pixels.getWidth() == WIDTH);
+
+	// reset() forgets the frame not taken yet
+	buffer.publish(400, 3.0);
+	buffer.reset();
+	CHECK(!buffer.isFrameNew());
+	CHECK(buffer.getNumPublished() == 0 && buffer.getNumDropped() == 0);
+}
+
+//--------------------------------------------------------------
+void testThreads(double hz, double seconds) {
+	DepthBuffer buffer;
+	buffer.allocate(WIDTH, HEIGHT, 1);
+
+	std::atomic<bool> running(true);
+	std::thread producer([&] {
+		unsigned short* back = buffer.getBack().pixels.getPixels();
+		steady_clock::time_point next = steady_clock::now();
+		uint32_t timestamp = 0;
+		while(running) {
+			fill(back, buffer.getNumPublished() + 1);
+			timestamp += (uint32_t)(60000000 / hz);
+			back = buffer.publish(timestamp, duration<double>(steady_clock::now().time_since_epoch()).count()).pixels.getPixels();
+			next += duration_cast<steady_clock::duration>(duration<double>(1.0 / hz));
+			std::this_thread::sleep_until(next);
+		}
+	});
+
+	// 16 ms between updates on average, sometimes much longer
+	std::mt19937 rng(1);
+	std::exponential_distribution<double> interval(60);
+	ofShortPixels app;
+	app.allocate(WIDTH, HEIGHT, 1);
+	unsigned long long taken = 0, lastSequence = 0, torn = 0, outOfOrder = 0;
+	uint32_t lastTimestamp = 0;
+
+	steady_clock::time_point start = steady_clock::now();
+	while(duration<double>(steady_clock::now() - start).count() < seconds) {
+		if(buffer.update()) {
+			DepthBuffer::Frame& frame = buffer.getFront();
+			swap(app, frame.pixels);
+			if(frame.sequence <= lastSequence || (lastSequence > 0 && frame.timestamp <= lastTimestamp)) {
+				outOfOrder++;
+			}
+			if(!isIntact(app.getPixels(), frame.sequence)) {
+				torn++;
+			}
+			lastSequence = frame.sequence;
+			lastTimestamp = frame.timestamp;
+			taken++;
+		}
+		std::this_thread::sleep_for(duration<double>(interval(rng)));
+	}
+	running = false;
+	producer.join();
+	if(buffer.update()) {
+		taken++;
+	}
+
+	unsigned long long published = buffer.getNumPublished(), dropped = buffer.getNumDropped();
+	printf("%.0f Hz: published %llu taken %llu dropped %llu torn %llu out of order %llu\n",
+		hz, published, taken, dropped, torn, outOfOrder);
+	CHECK(published > 0);
+	CHECK(taken + dropped == published);
+	CHECK(torn == 0);
+	CHECK(outOfOrder == 0);
+}
+
+}
+
+//--------------------------------------------------------------
+int main() {
+	testSingleThread();
+	testThreads(30, 2);    // the Kinect's rate, slower than the app
+	testThreads(1000, 1);  // much faster than the app, most frames dropped
+
+	printf("%s\n", failures == 0 ? "OK" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
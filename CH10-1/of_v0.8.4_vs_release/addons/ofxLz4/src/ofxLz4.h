@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/// LZ4 block compression, https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+///
+/// a greedy single probe matcher, the output can be read by any LZ4 block
+/// decoder. decompress() checks every length and offset against both
+/// buffers, so corrupt or hostile data only makes it return false
+///
+/// header only, shared by ofxGpuParticles (ParticleSnapshot) and
+/// ofxDepthPlayer (ofxDepthCodec)
+class ofxLz4 {
+
+public:
+
+	/// size of the hash table compress() works with
+	static const int HASH_LOG = 16;
+	static const size_t HASH_SIZE = (size_t)1 << HASH_LOG;
+
+	/// a block expands at most this many times when decompressed
+	/// (a 1 byte match length codes 255 bytes)
+	static const unsigned int MAX_RATIO = 255;
+
+	/// worst case compressed size of size bytes
+	static size_t compressBound(size_t size) {
+		return size + size / 255 + 16;
+	}
+
+	/// compress size bytes of src into dst, which must hold
+	/// compressBound(size) bytes, returns the compressed size
+	///
+	/// hashTable holds HASH_SIZE entries and can be reused between calls
+	/// without clearing, positions left from earlier data are only
+	/// candidates and every match is checked
+	static size_t compress(const unsigned char* src, size_t size, unsigned char* dst, unsigned int* hashTable) {
+		unsigned char* op = dst;
+		size_t anchor = 0;
+
+		if(size > MF_LIMIT) {
+			const size_t limit = size - MF_LIMIT;
+			size_t ip = 0;
+			while(ip < limit) {
+				unsigned int sequence = read32(src + ip);
+				unsigned int h = (sequence * 2654435761u) >> (32 - HASH_LOG);
+				size_t ref = hashTable[h];
+				hashTable[h] = (unsigned int)ip;
+
+				if(ref < ip && ip - ref <= MAX_OFFSET && read32(src + ref) == sequence) {
+					size_t length = MIN_MATCH;
+					while(ip + length < size - LAST_LITERALS && src[ref + length] == src[ip + length]) {
+						++length;
+					}
+
+					op = writeSequence(op, src + anchor, ip - anchor, ip - ref, length);
+					ip += length;
+					anchor = ip;
+				} else {
+					// skip faster through data that does not compress
+					ip += 1 + ((ip - anchor) >> 6);
+				}
+			}
+		}
+
+		return writeSequence(op, src + anchor, size - anchor, 0, 0) - dst;
+	}
+
+	/// same with a hash table of its own
+	static size_t compress(const unsigned char* src, size_t size, unsigned char* dst) {
+		std::vector<unsigned int> hashTable(HASH_SIZE, 0);
+		return compress(src, size, dst, &hashTable[0]);
+	}
+
+	/// decompress a block into exactly dstSize bytes, false if the data is
+	/// corrupt or doesn't decompress to dstSize bytes
+	static bool decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t dstSize) {
+		const unsigned char* ip = src;
+		const unsigned char* end = src + size;
+		unsigned char* op = dst;
+		unsigned char* dstEnd = dst + dstSize;
+
+		while(true) {
+			if(ip >= end) {
+				return false;
+			}
+			unsigned int token = *ip++;
+
+			size_t literalLength = token >> 4;
+			if(literalLength == 15 && !readLength(ip, end, literalLength)) {
+				return false;
+			}
+			if((size_t)(end - ip) < literalLength || (size_t)(dstEnd - op) < literalLength) {
+				return false;
+			}
+			memcpy(op, ip, literalLength);
+			op += literalLength;
+			ip += literalLength;
+
+			// the last sequence ends with its literals
+			if(ip == end) {
+				return op == dstEnd;
+			}
+
+			if(end - ip < 2) {
+				return false;
+			}
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if(offset == 0 || offset > (size_t)(op - dst)) {
+				return false;
+			}
+
+			size_t matchLength = token & 15;
+			if(matchLength == 15 && !readLength(ip, end, matchLength)) {
+				return false;
+			}
+			matchLength += MIN_MATCH;
+			if((size_t)(dstEnd - op) < matchLength) {
+				return false;
+			}
+
+			// overlapping matches repeat the last bytes, so copy forwards one by one
+			const unsigned char* match = op - offset;
+			if(offset >= matchLength) {
+				memcpy(op, match, matchLength);
+			} else {
+				for(size_t i = 0; i < matchLength; i++) {
+					op[i] = match[i];
+				}
+			}
+			op += matchLength;
+		}
+	}
+
+private:
+
+	static const size_t MIN_MATCH = 4;
+	static const size_t LAST_LITERALS = 5;
+	static const size_t MF_LIMIT = 12;
+	static const size_t MAX_OFFSET = 65535;
+
+	static unsigned int read32(const unsigned char* p) {
+		unsigned int v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static unsigned char* writeLength(unsigned char* op, size_t length) {
+		while(length >= 255) {
+			*op++ = 255;
+			length -= 255;
+		}
+		*op++ = (unsigned char)length;
+		return op;
+	}
+
+	static unsigned char* writeSequence(unsigned char* op, const unsigned char* literals, size_t literalLength,
+										size_t offset, size_t matchLength) {
+		unsigned char* token = op++;
+		*token = (unsigned char)((literalLength < 15 ? literalLength : 15) << 4);
+		if(literalLength >= 15) {
+			op = writeLength(op, literalLength - 15);
+		}
+		if(literalLength > 0) {
+			memcpy(op, literals, literalLength);  // literals is NULL for empty input
+		}
+		op += literalLength;
+
+		// the last sequence has literals only
+		if(matchLength == 0) {
+			return op;
+		}
+
+		*op++ = (unsigned char)(offset & 0xff);
+		*op++ = (unsigned char)(offset >> 8);
+		matchLength -= MIN_MATCH;
+		*token |= (unsigned char)(matchLength < 15 ? matchLength : 15);
+		if(matchLength >= 15) {
+			op = writeLength(op, matchLength - 15);
+		}
+		return op;
+	}
+
+	static bool readLength(const unsigned char*& ip, const unsigned char* end, size_t& length) {
+		unsigned char b;
+		do {
+			if(ip >= end) {
+				return false;
+			}
+			b = *ip++;
+			length += b;
+		} while(b == 255);
+		return true;
+	}
+};
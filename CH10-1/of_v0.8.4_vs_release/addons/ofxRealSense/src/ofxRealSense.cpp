@@ -0,0 +1,272 @@
+#include "ofxRealSense.h"
+
+#ifdef TARGET_WIN32
+	#include <windows.h>
+#else
+	#include <chrono>
+#endif
+
+//--------------------------------------------------------------------
+ofxRealSense::ofxRealSense() {
+	source = NULL;
+	width = 640;
+	height = 480;
+	fps = 30;
+	timeoutMs = 100;
+
+	bUseTexture = true;
+	bGrabberInited = false;
+	bNeedsUpdateDepth = false;
+	bIsFrameNewDepth = false;
+	bTextureDirty = false;
+
+	farClip = 1000;
+
+	numGrabbed = 0;
+	numDropped = 0;
+}
+
+//--------------------------------------------------------------------
+ofxRealSense::~ofxRealSense() {
+	close();
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSense::init(bool texture) {
+	if(isConnected()) {
+		ofLogWarning("ofxRealSense") << "init(): do not call init while ofxRealSense is running!";
+		return false;
+	}
+
+	bUseTexture = texture;
+	bGrabberInited = true;
+	return true;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSense::open(ofxRealSenseSource* newSource) {
+	if(!bGrabberInited) {
+		ofLogWarning("ofxRealSense") << "open(): cannot open, init not called";
+		delete newSource;
+		return false;
+	}
+	close();
+
+	if(newSource == NULL) {
+		newSource = new ofxRealSenseDevice();
+	}
+	if(!newSource->open(width, height, fps)) {
+		ofLogError("ofxRealSense") << "open(): could not open source";
+		delete newSource;
+		return false;
+	}
+	source = newSource;
+
+	// the source may not support the requested size
+	int w = source->getWidth();
+	int h = source->getHeight();
+	frame.depth.allocate(w, h, 1);
+	frameIntra.depth.allocate(w, h, 1);
+	frameBack.depth.allocate(w, h, 1);
+	frame.depth.set(0);
+	frame.hands.clear();
+	depthPixels.allocate(w, h, 1);
+	if(bUseTexture) {
+		depthTex.allocate(w, h, GL_LUMINANCE);
+	}
+
+	bNeedsUpdateDepth = false;
+	bIsFrameNewDepth = false;
+	bTextureDirty = true;
+	numGrabbed = 0;
+	numDropped = 0;
+
+	startThread(true);
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::close() {
+	if(isThreadRunning()) {
+		waitForThread(true);
+	}
+	if(source != NULL) {
+		source->close();
+		delete source;
+		source = NULL;
+	}
+	bIsFrameNewDepth = false;
+	bNeedsUpdateDepth = false;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSense::isConnected() {
+	return source != NULL && isThreadRunning();
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSense::isFrameNew() {
+	return isFrameNewDepth();
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSense::isFrameNewDepth() {
+	return bIsFrameNewDepth;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::update() {
+	if(source == NULL) {
+		return;
+	}
+
+	bool bNew = false;
+	lock();
+	if(bNeedsUpdateDepth) {
+		frame.swap(frameIntra);
+		bNeedsUpdateDepth = false;
+		bNew = true;
+	}
+	unlock();
+
+	bIsFrameNewDepth = bNew;
+	if(bNew) {
+		// upload later, only if someone asks for the texture
+		bTextureDirty = true;
+	}
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::setTimeout(int timeoutMs) {
+	this->timeoutMs = timeoutMs;
+}
+
+//--------------------------------------------------------------------
+ofShortPixels& ofxRealSense::getDepthPixelsRef() {
+	return frame.depth;
+}
+
+//--------------------------------------------------------------------
+const vector<ofxRealSenseHand>& ofxRealSense::getHands() {
+	return frame.hands;
+}
+
+//--------------------------------------------------------------------
+ofTexture& ofxRealSense::getDepthTextureReference() {
+	if(bUseTexture && bTextureDirty && frame.depth.isAllocated()) {
+		const unsigned short* src = frame.depth.getPixels();
+		unsigned char* dst = depthPixels.getPixels();
+		int n = frame.depth.getWidth() * frame.depth.getHeight();
+		float scale = 255.f / farClip;
+		for(int i = 0; i < n; i++) {
+			// near is white, no data and beyond farClip are black
+			int d = src[i];
+			dst[i] = (d == 0 || d >= farClip) ? 0 : 255 - (unsigned char)(d * scale);
+		}
+		depthTex.loadData(depthPixels);
+		bTextureDirty = false;
+	}
+	return depthTex;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::setDepthClipping(float farClip) {
+	this->farClip = farClip;
+	bTextureDirty = true;
+}
+
+//--------------------------------------------------------------------
+float ofxRealSense::getDistanceAt(int x, int y) {
+	if(x < 0 || y < 0 || x >= frame.depth.getWidth() || y >= frame.depth.getHeight()) {
+		return 0;
+	}
+	return frame.depth[y * frame.depth.getWidth() + x];
+}
+
+//--------------------------------------------------------------------
+double ofxRealSense::getFrameTimestamp() {
+	return frame.timestamp;
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxRealSense::getFrameNumber() {
+	return frame.frameNumber;
+}
+
+//--------------------------------------------------------------------
+unsigned long long ofxRealSense::getNumDroppedFrames() {
+	lock();
+	unsigned long long n = numDropped;
+	unlock();
+	return n;
+}
+
+//--------------------------------------------------------------------
+double ofxRealSense::now() {
+#ifdef TARGET_WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::setUseTexture(bool bUse) {
+	bUseTexture = bUse;
+}
+
+//----------------------------------------------------------
+void ofxRealSense::drawDepth(float x, float y, float w, float h) {
+	if(bUseTexture) {
+		getDepthTextureReference().draw(x, y, w, h);
+	}
+}
+
+//----------------------------------------------------------
+void ofxRealSense::drawDepth(float x, float y) {
+	drawDepth(x, y, getWidth(), getHeight());
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::setSize(int width, int height, int fps) {
+	if(isConnected()) {
+		ofLogWarning("ofxRealSense") << "setSize(): takes effect on the next open()";
+	}
+	this->width = width;
+	this->height = height;
+	this->fps = fps;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSense::getWidth() {
+	return source != NULL ? source->getWidth() : width;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSense::getHeight() {
+	return source != NULL ? source->getHeight() : height;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSense::threadedFunction() {
+	while(isThreadRunning()) {
+		// time out now and then so close() doesn't wait on a stalled camera
+		if(!source->grab(frameBack, timeoutMs)) {
+			continue;
+		}
+		frameBack.frameNumber = numGrabbed++;
+		ofNotifyEvent(newFrameEvent, frameBack, this);
+
+		lock();
+		if(bNeedsUpdateDepth) {
+			// update() didn't take the last one
+			numDropped++;
+		}
+		frameIntra.swap(frameBack);
+		bNeedsUpdateDepth = true;
+		unlock();
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxRealSenseSource.h"
+#include "ofxRealSenseDevice.h"
+#include "ofxRealSenseSynthetic.h"
+#include "ofxRealSensePlayer.h"
+
+/// \class ofxRealSense
+///
+/// grabs depth frames and hand data from a RealSense camera on its own thread
+///
+/// AcquireFrame() blocks until the camera delivers, so it runs here instead
+/// of in ofApp::update(). Frames go through the same back/intra/front buffers
+/// as ofxKinect: the grabber thread fills the back buffer and swaps it with
+/// the intra buffer under the lock, update() swaps intra with the front buffer
+/// the app reads from. Neither side waits on the other longer than a swap.
+///
+/// any ofxRealSenseSource can be passed to open(), use ofxRealSenseSynthetic
+/// or ofxRealSensePlayer to run without a camera
+class ofxRealSense : protected ofThread {
+
+public:
+
+	ofxRealSense();
+	virtual ~ofxRealSense();
+
+/// \section Main
+
+	/// allocate the buffers, call this before open()
+	///
+	/// set texture = false to never upload the depth to a texture,
+	/// for instance when only using the hand data
+	bool init(bool texture=true);
+
+	/// start grabbing from source, the grabber takes ownership of it
+	///
+	/// with source = NULL, opens the first camera with ofxRealSenseDevice
+	/// (windows + RSSDK only)
+	bool open(ofxRealSenseSource* source=NULL);
+
+	/// stop the thread and close the source
+	void close();
+
+	/// is the source open and the thread running?
+	bool isConnected();
+
+	/// is the current frame new? updated by update()
+	bool isFrameNew();
+	bool isFrameNewDepth();
+
+	/// swap in the latest frame from the grabber thread, call this in
+	/// ofApp::update()
+	void update();
+
+	/// fired on the grabber thread for every grabbed frame, before it is
+	/// handed to update()
+	///
+	/// listeners get the frame still in the back buffer, they must not keep
+	/// references to it and should return quickly
+	ofEvent<ofxRealSenseFrame> newFrameEvent;
+
+	/// grab timeout, after which the thread checks if it should stop
+	/// default is 100 ms
+	void setTimeout(int timeoutMs);
+
+/// \section Data
+
+	/// depth in mm of the current frame
+	ofShortPixels& getDepthPixelsRef();
+
+	/// hands in the current frame
+	const vector<ofxRealSenseHand>& getHands();
+
+	/// depth texture of the current frame, uploaded the first time it's
+	/// asked for after update()
+	///
+	/// depth is scaled so that farClip is white, see setDepthClipping()
+	ofTexture& getDepthTextureReference();
+
+	/// far clipping plane in mm for the depth texture, default is 1 m
+	void setDepthClipping(float farClip=1000);
+
+	/// distance in mm at a depth pixel, 0 if unknown
+	float getDistanceAt(int x, int y);
+
+	/// capture time and frame number of the current frame
+	double getFrameTimestamp();
+	unsigned long long getFrameNumber();
+
+	/// frames grabbed but replaced before update() got to them
+	unsigned long long getNumDroppedFrames();
+
+	/// clock used for the frame timestamps, in seconds
+	static double now();
+
+/// \section Draw
+
+	/// enable/disable the depth texture
+	void setUseTexture(bool bUse);
+
+	void drawDepth(float x, float y, float w, float h);
+	void drawDepth(float x, float y);
+
+/// \section Size
+
+	/// requested depth size, set before open()
+	void setSize(int width, int height, int fps=30);
+
+	int getWidth();
+	int getHeight();
+
+protected:
+
+	void threadedFunction();
+
+private:
+
+	ofxRealSenseSource* source;
+	int width, height, fps;
+	int timeoutMs;
+
+	bool bUseTexture;
+	bool bGrabberInited;
+	bool bNeedsUpdateDepth;  ///< set by the thread when the intra buffer is new
+	bool bIsFrameNewDepth;
+	bool bTextureDirty;      ///< front buffer changed since the last upload
+
+	// front is used by the app, back by the grabber thread,
+	// intra is passed between them under the lock
+	ofxRealSenseFrame frame, frameIntra, frameBack;
+
+	ofTexture depthTex;
+	ofPixels depthPixels;   ///< 8 bit depth for the texture
+	float farClip;
+
+	unsigned long long numGrabbed;
+	unsigned long long numDropped;
+};
@@ -0,0 +1,221 @@
+#include "ofxRealSenseDevice.h"
+#include "ofxRealSense.h"
+
+#ifdef TARGET_WIN32
+	#include "pxccapture.h"
+	#include "pxchandmodule.h"
+	#include "pxchandconfiguration.h"
+	#include "pxchanddata.h"
+	#include "pxcsensemanager.h"
+#endif
+
+//--------------------------------------------------------------------
+ofxRealSenseDevice::ofxRealSenseDevice() {
+	senseManager = NULL;
+	handData = NULL;
+	width = 0;
+	height = 0;
+	latency = 0.05;
+	bUseHands = true;
+}
+
+//--------------------------------------------------------------------
+ofxRealSenseDevice::~ofxRealSenseDevice() {
+	close();
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseDevice::setLatency(double latency) {
+	this->latency = latency;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseDevice::setUseHands(bool bUse) {
+	bUseHands = bUse;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSenseDevice::getWidth() const {
+	return width;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSenseDevice::getHeight() const {
+	return height;
+}
+
+#ifdef TARGET_WIN32
+
+//--------------------------------------------------------------------
+bool ofxRealSenseDevice::open(int width, int height, int fps) {
+	close();
+
+	senseManager = PXCSenseManager::CreateInstance();
+	if(senseManager == NULL) {
+		ofLogError("ofxRealSenseDevice") << "open(): could not create the sense manager";
+		return false;
+	}
+
+	pxcStatus sts = senseManager->EnableStream(PXCCapture::StreamType::STREAM_TYPE_DEPTH, width, height, (pxcF32)fps);
+	if(sts < PXC_STATUS_NO_ERROR) {
+		ofLogError("ofxRealSenseDevice") << "open(): could not enable the " << width << "x" << height << " depth stream";
+		close();
+		return false;
+	}
+	if(bUseHands) {
+		sts = senseManager->EnableHand();
+		if(sts < PXC_STATUS_NO_ERROR) {
+			ofLogError("ofxRealSenseDevice") << "open(): could not enable hand tracking";
+			close();
+			return false;
+		}
+	}
+	sts = senseManager->Init();
+	if(sts < PXC_STATUS_NO_ERROR) {
+		ofLogError("ofxRealSenseDevice") << "open(): could not init the pipeline, is a camera connected?";
+		close();
+		return false;
+	}
+	if(bUseHands && !initHandTracking()) {
+		close();
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseDevice::close() {
+	if(handData != NULL) {
+		handData->Release();
+		handData = NULL;
+	}
+	if(senseManager != NULL) {
+		senseManager->Release();
+		senseManager = NULL;
+	}
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseDevice::initHandTracking() {
+	PXCHandModule* handAnalyzer = senseManager->QueryHand();
+	if(handAnalyzer == NULL) {
+		ofLogError("ofxRealSenseDevice") << "open(): could not get the hand module";
+		return false;
+	}
+	handData = handAnalyzer->CreateOutput();
+	if(handData == NULL) {
+		ofLogError("ofxRealSenseDevice") << "open(): could not create the hand data";
+		return false;
+	}
+
+	PXCCapture::Device* device = senseManager->QueryCaptureManager()->QueryDevice();
+	PXCCapture::DeviceInfo dinfo;
+	device->QueryDeviceInfo(&dinfo);
+	if(dinfo.model == PXCCapture::DEVICE_MODEL_IVCAM) {
+		device->SetDepthConfidenceThreshold(1);
+		device->SetIVCAMFilterOption(6);
+	}
+
+	PXCHandConfiguration* config = handAnalyzer->CreateActiveConfiguration();
+	config->EnableSegmentationImage(true);
+	config->ApplyChanges();
+	config->Update();
+	config->Release();
+	return true;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseDevice::grab(ofxRealSenseFrame& frame, int timeoutMs) {
+	if(senseManager == NULL) {
+		return false;
+	}
+	pxcStatus sts = senseManager->AcquireFrame(true, timeoutMs);
+	if(sts < PXC_STATUS_NO_ERROR) {
+		return false;
+	}
+	// AcquireFrame() returns a while after the capture
+	frame.timestamp = ofxRealSense::now() - latency;
+
+	bool bGotDepth = false;
+	PXCCapture::Sample* sample = senseManager->QuerySample();
+	if(sample != NULL && sample->depth != NULL) {
+		PXCImage::ImageInfo info = sample->depth->QueryInfo();
+		PXCImage::ImageData data;
+		sts = sample->depth->AcquireAccess(PXCImage::Access::ACCESS_READ,
+			PXCImage::PixelFormat::PIXEL_FORMAT_DEPTH, &data);
+		if(sts >= PXC_STATUS_NO_ERROR) {
+			int w = MIN(info.width, width);
+			int h = MIN(info.height, height);
+			unsigned short* dst = frame.depth.getPixels();
+			for(int y = 0; y < h; y++) {
+				memcpy(dst + y * width, data.planes[0] + y * data.pitches[0], w * sizeof(unsigned short));
+			}
+			sample->depth->ReleaseAccess(&data);
+			bGotDepth = true;
+		}
+	}
+
+	if(handData != NULL) {
+		updateHands(frame);
+	} else {
+		frame.hands.clear();
+	}
+
+	senseManager->ReleaseFrame();
+	return bGotDepth;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseDevice::updateHands(ofxRealSenseFrame& frame) {
+	frame.hands.clear();
+	handData->Update();
+
+	int numHands = handData->QueryNumberOfHands();
+	for(int i = 0; i < numHands; i++) {
+		PXCHandData::IHand* hand;
+		pxcStatus sts = handData->QueryHandData(
+			PXCHandData::AccessOrderType::ACCESS_ORDER_BY_ID, i, hand);
+		if(sts < PXC_STATUS_NO_ERROR) {
+			continue;
+		}
+		PXCPointF32 center = hand->QueryMassCenterImage();
+
+		ofxRealSenseHand h;
+		h.id = hand->QueryUniqueId();
+		h.side = hand->QueryBodySide();
+		h.center.set(center.x, center.y);
+		h.openness = (float)hand->QueryOpenness();
+		frame.hands.push_back(h);
+	}
+}
+
+#else
+
+//--------------------------------------------------------------------
+bool ofxRealSenseDevice::open(int width, int height, int fps) {
+	ofLogError("ofxRealSenseDevice") << "open(): the RealSense SDK is only available on windows";
+	return false;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseDevice::close() {
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseDevice::initHandTracking() {
+	return false;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseDevice::grab(ofxRealSenseFrame& frame, int timeoutMs) {
+	return false;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseDevice::updateHands(ofxRealSenseFrame& frame) {
+}
+
+#endif
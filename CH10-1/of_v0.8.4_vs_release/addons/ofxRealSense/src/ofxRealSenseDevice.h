@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofxRealSenseSource.h"
+
+class PXCSenseManager;
+class PXCHandData;
+
+/// depth and hand tracking from the first RealSense camera, via the RSSDK
+///
+/// only available on windows, open() fails elsewhere
+class ofxRealSenseDevice : public ofxRealSenseSource {
+
+public:
+
+	ofxRealSenseDevice();
+	virtual ~ofxRealSenseDevice();
+
+	bool open(int width, int height, int fps);
+	void close();
+	bool grab(ofxRealSenseFrame& frame, int timeoutMs);
+
+	int getWidth() const;
+	int getHeight() const;
+
+	/// time in seconds from capture to AcquireFrame() returning, subtracted
+	/// from the frame timestamps, default is 0.05
+	void setLatency(double latency);
+
+	/// enable/disable hand tracking, set before open(), default is true
+	void setUseHands(bool bUse);
+
+private:
+
+	bool initHandTracking();
+	void updateHands(ofxRealSenseFrame& frame);
+
+	PXCSenseManager* senseManager;
+	PXCHandData* handData;
+	int width, height;
+	double latency;
+	bool bUseHands;
+};
@@ -0,0 +1,293 @@
+#include "ofxRealSensePlayer.h"
+#include "ofxRealSense.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+	const char MAGIC[4] = {'R', 'S', 'R', 'C'};
+	const unsigned int VERSION = 1;
+
+	// the SDK tracks at most 2 hands, and no depth camera is larger than
+	// this, anything more comes from a corrupt file
+	const unsigned int MAX_HANDS = 2;
+	const int MAX_SIZE = 4096;
+
+	struct Header {
+		char magic[4];
+		unsigned int version;
+		int width, height, fps;
+	};
+
+	struct HandRecord {
+		int id, side;
+		float x, y, openness;
+	};
+}
+
+//--------------------------------------------------------------------
+ofxRealSenseRecorder::ofxRealSenseRecorder() {
+	file = NULL;
+	width = 0;
+	height = 0;
+	numFrames = 0;
+}
+
+//--------------------------------------------------------------------
+ofxRealSenseRecorder::~ofxRealSenseRecorder() {
+	close();
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseRecorder::open(const string& fileName, int width, int height, int fps) {
+	std::lock_guard<std::mutex> lock(mutex);
+	closeLocked();
+	file = fopen(ofToDataPath(fileName).c_str(), "wb");
+	if(file == NULL) {
+		ofLogError("ofxRealSenseRecorder") << "open(): could not open " << fileName;
+		return false;
+	}
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.width = width;
+	header.height = height;
+	header.fps = fps;
+	fwrite(&header, sizeof(header), 1, file);
+
+	this->width = width;
+	this->height = height;
+	numFrames = 0;
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseRecorder::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	closeLocked();
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseRecorder::closeLocked() {
+	if(file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseRecorder::isOpen() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return file != NULL;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSenseRecorder::getNumFrames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return numFrames;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseRecorder::write(ofxRealSenseFrame& frame) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(file == NULL) {
+		return;
+	}
+	if(frame.depth.getWidth() != width || frame.depth.getHeight() != height) {
+		ofLogWarning("ofxRealSenseRecorder") << "write(): frame is "
+			<< frame.depth.getWidth() << "x" << frame.depth.getHeight()
+			<< ", expected " << width << "x" << height << ", skipping";
+		return;
+	}
+
+	// the player rejects frames with more hands than that
+	unsigned int numHands = MIN((unsigned int)frame.hands.size(), MAX_HANDS);
+	fwrite(&frame.timestamp, sizeof(frame.timestamp), 1, file);
+	fwrite(&numHands, sizeof(numHands), 1, file);
+	for(unsigned int i = 0; i < numHands; i++) {
+		const ofxRealSenseHand& hand = frame.hands[i];
+		HandRecord record = {hand.id, hand.side, hand.center.x, hand.center.y, hand.openness};
+		fwrite(&record, sizeof(record), 1, file);
+	}
+	fwrite(frame.depth.getPixels(), sizeof(unsigned short), width * height, file);
+	numFrames++;
+}
+
+//--------------------------------------------------------------------
+ofxRealSensePlayer::ofxRealSensePlayer(const string& fileName) {
+	this->fileName = fileName;
+	file = NULL;
+	firstFrameOffset = 0;
+	width = 0;
+	height = 0;
+	fps = 0;
+	bLoop = true;
+	bDone = false;
+	speed = 1;
+	startTime = 0;
+	firstTimestamp = 0;
+	bHasPending = false;
+}
+
+//--------------------------------------------------------------------
+ofxRealSensePlayer::~ofxRealSensePlayer() {
+	close();
+}
+
+//--------------------------------------------------------------------
+void ofxRealSensePlayer::setFile(const string& fileName) {
+	this->fileName = fileName;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSensePlayer::setLoop(bool bLoop) {
+	this->bLoop = bLoop;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSensePlayer::setSpeed(float speed) {
+	this->speed = speed;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSensePlayer::isDone() const {
+	return bDone;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSensePlayer::open(int width, int height, int fps) {
+	close();
+	file = fopen(ofToDataPath(fileName).c_str(), "rb");
+	if(file == NULL) {
+		ofLogError("ofxRealSensePlayer") << "open(): could not open \"" << fileName << "\"";
+		return false;
+	}
+	Header header;
+	if(fread(&header, sizeof(header), 1, file) != 1
+	   || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+	   || header.width <= 0 || header.height <= 0 || header.width > MAX_SIZE || header.height > MAX_SIZE) {
+		ofLogError("ofxRealSensePlayer") << "open(): \"" << fileName << "\" is not a recording";
+		close();
+		return false;
+	}
+	if(header.width != width || header.height != height) {
+		ofLogNotice("ofxRealSensePlayer") << "open(): playing at the recorded size "
+			<< header.width << "x" << header.height;
+	}
+	this->width = header.width;
+	this->height = header.height;
+	this->fps = header.fps;
+	firstFrameOffset = ftell(file);
+
+	pending.depth.allocate(this->width, this->height, 1);
+	rewind();
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSensePlayer::close() {
+	if(file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+	bHasPending = false;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSensePlayer::getWidth() const {
+	return width;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSensePlayer::getHeight() const {
+	return height;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSensePlayer::getFps() const {
+	return fps;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSensePlayer::rewind() {
+	fseek(file, firstFrameOffset, SEEK_SET);
+	bDone = false;
+	bHasPending = false;
+	startTime = -1;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSensePlayer::readFrame(ofxRealSenseFrame& frame) {
+	unsigned int numHands;
+	if(fread(&frame.timestamp, sizeof(frame.timestamp), 1, file) != 1
+	   || fread(&numHands, sizeof(numHands), 1, file) != 1) {
+		return false;
+	}
+	if(numHands > MAX_HANDS) {
+		ofLogError("ofxRealSensePlayer") << "readFrame(): \"" << fileName << "\" is corrupt, "
+			<< numHands << " hands in a frame";
+		return false;
+	}
+	frame.hands.resize(numHands);
+	for(unsigned int i = 0; i < numHands; i++) {
+		HandRecord record;
+		if(fread(&record, sizeof(record), 1, file) != 1) {
+			return false;
+		}
+		ofxRealSenseHand& hand = frame.hands[i];
+		hand.id = record.id;
+		hand.side = record.side;
+		hand.center.set(record.x, record.y);
+		hand.openness = record.openness;
+	}
+	size_t n = (size_t)width * height;
+	return fread(frame.depth.getPixels(), sizeof(unsigned short), n, file) == n;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSensePlayer::grab(ofxRealSenseFrame& frame, int timeoutMs) {
+	if(file == NULL) {
+		return false;
+	}
+
+	if(!bHasPending) {
+		if(bDone) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+			return false;
+		}
+		if(!readFrame(pending)) {
+			// end of the file (or a cut off last frame)
+			if(!bLoop) {
+				bDone = true;
+				return false;
+			}
+			rewind();
+			if(!readFrame(pending)) {
+				ofLogError("ofxRealSensePlayer") << "grab(): \"" << fileName << "\" has no frames";
+				bDone = true;
+				return false;
+			}
+		}
+		bHasPending = true;
+		if(startTime < 0) {
+			startTime = ofxRealSense::now();
+			firstTimestamp = pending.timestamp;
+		}
+	}
+
+	// wait until the frame is due
+	double due = startTime + (pending.timestamp - firstTimestamp) / speed;
+	double wait = due - ofxRealSense::now();
+	if(wait * 1000 > timeoutMs) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		return false;
+	}
+	if(wait > 0) {
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1000000)));
+	}
+
+	frame.swap(pending);
+	frame.timestamp = due;
+	bHasPending = false;
+	return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ofxRealSenseSource.h"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+/// writes frames to a file ofxRealSensePlayer can play back
+///
+/// the file is a small header and then each frame as is: timestamp, hands
+/// and the raw 16 bit depth, so about 600 KB per 640x480 frame. To record
+/// a grabber, add write() as a listener to its newFrameEvent:
+///
+///     recorder.open("hands.rsr", grabber.getWidth(), grabber.getHeight());
+///     ofAddListener(grabber.newFrameEvent, &recorder, &ofxRealSenseRecorder::write);
+///
+/// write() runs on the grabber thread, open() and close() can be called
+/// from the app at the same time
+class ofxRealSenseRecorder {
+
+public:
+
+	ofxRealSenseRecorder();
+	~ofxRealSenseRecorder();
+
+	bool open(const string& fileName, int width, int height, int fps=30);
+	void close();
+	bool isOpen() const;
+
+	void write(ofxRealSenseFrame& frame);
+
+	int getNumFrames() const;
+
+private:
+
+	void closeLocked();
+
+	mutable std::mutex mutex;  ///< guards the file against write() on the grabber thread
+	FILE* file;
+	int width, height;
+	int numFrames;
+};
+
+/// plays back a file written by ofxRealSenseRecorder
+///
+/// frames are delivered with the same spacing as they were recorded, and
+/// restamped with the time they are played at
+class ofxRealSensePlayer : public ofxRealSenseSource {
+
+public:
+
+	ofxRealSensePlayer(const string& fileName="");
+	virtual ~ofxRealSensePlayer();
+
+	/// the file to play, set before opening
+	void setFile(const string& fileName);
+
+	/// start over at the end of the file, default is true
+	void setLoop(bool bLoop);
+
+	/// 2 plays twice as fast, default is 1
+	void setSpeed(float speed);
+
+	/// is the file played to the end? (never with loop on)
+	/// safe to call from the app while the grabber is running
+	bool isDone() const;
+
+	/// width, height and fps come from the file, not from the grabber
+	bool open(int width, int height, int fps);
+	void close();
+	bool grab(ofxRealSenseFrame& frame, int timeoutMs);
+
+	int getWidth() const;
+	int getHeight() const;
+	int getFps() const;
+
+private:
+
+	bool readFrame(ofxRealSenseFrame& frame);
+	void rewind();
+
+	string fileName;
+	FILE* file;
+	long firstFrameOffset;
+	int width, height, fps;
+	bool bLoop;
+	std::atomic<bool> bDone;
+	float speed;
+
+	double startTime;        ///< when the first frame of this pass was played
+	double firstTimestamp;   ///< recorded time of the first frame
+	bool bHasPending;
+	ofxRealSenseFrame pending;  ///< read but not yet due
+};
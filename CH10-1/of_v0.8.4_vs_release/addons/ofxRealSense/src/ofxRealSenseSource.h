@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ofMain.h"
+
+/// a tracked hand, in depth image coordinates
+struct ofxRealSenseHand {
+	int id;          ///< unique while the hand stays tracked
+	int side;        ///< PXCHandData::BodySideType, 0 when unknown
+	ofVec2f center;  ///< mass center in depth pixels
+	float openness;  ///< 0 (closed) - 100 (open)
+};
+
+/// one depth frame and the hands found in it
+struct ofxRealSenseFrame {
+	ofxRealSenseFrame() : timestamp(0), frameNumber(0) {}
+
+	ofShortPixels depth;             ///< depth in mm, 0 = no data
+	vector<ofxRealSenseHand> hands;
+	double timestamp;                ///< capture time in seconds, see ofxRealSense::now()
+	unsigned long long frameNumber;  ///< counts up from 0 for each grabbed frame
+
+	void swap(ofxRealSenseFrame& other) {
+		depth.swap(other.depth);
+		hands.swap(other.hands);
+		std::swap(timestamp, other.timestamp);
+		std::swap(frameNumber, other.frameNumber);
+	}
+};
+
+/// where ofxRealSense gets its frames from
+///
+/// grab() is only ever called from the grabber thread, so sources don't
+/// need to lock anything themselves
+class ofxRealSenseSource {
+
+public:
+
+	virtual ~ofxRealSenseSource() {}
+
+	/// returns false if the source couldn't be opened
+	virtual bool open(int width, int height, int fps) = 0;
+	virtual void close() = 0;
+
+	/// wait up to timeoutMs for the next frame and fill in everything but
+	/// the frame number, returns false on timeout
+	///
+	/// the depth pixels are already allocated to getWidth() x getHeight()
+	virtual bool grab(ofxRealSenseFrame& frame, int timeoutMs) = 0;
+
+	virtual int getWidth() const = 0;
+	virtual int getHeight() const = 0;
+};
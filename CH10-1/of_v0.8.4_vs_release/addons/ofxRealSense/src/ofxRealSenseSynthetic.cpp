@@ -0,0 +1,128 @@
+#include "ofxRealSenseSynthetic.h"
+#include "ofxRealSense.h"
+
+#include <chrono>
+#include <thread>
+
+//--------------------------------------------------------------------
+ofxRealSenseSynthetic::ofxRealSenseSynthetic() {
+	width = 0;
+	height = 0;
+	fps = 30;
+	period = 4;
+	noise = 0;
+	wallDepth = 900;
+	handDepth = 450;
+	startTime = 0;
+	numFrames = 0;
+	seed = 1;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseSynthetic::open(int width, int height, int fps) {
+	if(width <= 0 || height <= 0 || fps <= 0) {
+		ofLogError("ofxRealSenseSynthetic") << "open(): bad size " << width << "x" << height << " @ " << fps;
+		return false;
+	}
+	this->width = width;
+	this->height = height;
+	this->fps = fps;
+	startTime = ofxRealSense::now();
+	numFrames = 0;
+	seed = 1;
+	return true;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseSynthetic::close() {
+}
+
+//--------------------------------------------------------------------
+int ofxRealSenseSynthetic::getWidth() const {
+	return width;
+}
+
+//--------------------------------------------------------------------
+int ofxRealSenseSynthetic::getHeight() const {
+	return height;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseSynthetic::setPeriod(float seconds) {
+	period = seconds;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseSynthetic::setNoise(float pixels) {
+	noise = pixels;
+}
+
+//--------------------------------------------------------------------
+void ofxRealSenseSynthetic::setDepth(float wall, float hand) {
+	wallDepth = wall;
+	handDepth = hand;
+}
+
+//--------------------------------------------------------------------
+ofxRealSenseHand ofxRealSenseSynthetic::getHand(double time) const {
+	double phase = TWO_PI * time / period;
+
+	ofxRealSenseHand hand;
+	hand.id = 1;
+	hand.side = 0;
+	hand.center.set(width * (0.5f + 0.3f * sin(phase)),
+	                height * (0.5f + 0.3f * sin(2 * phase)));
+	hand.openness = 50 + 50 * cos(3 * phase);
+	return hand;
+}
+
+//--------------------------------------------------------------------
+float ofxRealSenseSynthetic::random() {
+	// own generator, ofRandom() isn't safe on the grabber thread
+	seed = seed * 1664525 + 1013904223;
+	return (seed >> 8) / 16777216.f * 2 - 1;
+}
+
+//--------------------------------------------------------------------
+bool ofxRealSenseSynthetic::grab(ofxRealSenseFrame& frame, int timeoutMs) {
+	if(width == 0) {
+		return false;
+	}
+
+	// wait for the frame like a camera would
+	double frameTime = startTime + (double)numFrames / fps;
+	double wait = frameTime - ofxRealSense::now();
+	if(wait * 1000 > timeoutMs) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		return false;
+	}
+	if(wait > 0) {
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1000000)));
+	}
+
+	ofxRealSenseHand hand = getHand((double)numFrames / fps);
+	numFrames++;
+
+	// the wall leans back towards the top, the hand is a disc
+	// that gets bigger as it opens
+	float radius = height * (0.05f + 0.05f * hand.openness / 100);
+	float radiusSquared = radius * radius;
+	unsigned short* depth = frame.depth.getPixels();
+	for(int y = 0; y < height; y++) {
+		unsigned short wall = (unsigned short)(wallDepth + 200.f * (height - y) / height);
+		float dy = y - hand.center.y;
+		unsigned short* row = depth + y * width;
+		for(int x = 0; x < width; x++) {
+			float dx = x - hand.center.x;
+			row[x] = (dx * dx + dy * dy < radiusSquared) ? (unsigned short)handDepth : wall;
+		}
+	}
+
+	if(noise > 0) {
+		hand.center.x += noise * random();
+		hand.center.y += noise * random();
+	}
+	frame.hands.assign(1, hand);
+	frame.timestamp = frameTime;
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ofxRealSenseSource.h"
+
+/// made up depth frames with a hand moving in front of a wall
+///
+/// for running and testing without a camera: the hand follows a lissajous
+/// curve and opens and closes, the depth image has the matching disc and
+/// getHands() reports its exact center (plus optional noise). Frames come
+/// at the requested fps and the motion only depends on the frame number,
+/// so two runs see the same hand path.
+class ofxRealSenseSynthetic : public ofxRealSenseSource {
+
+public:
+
+	ofxRealSenseSynthetic();
+
+	bool open(int width, int height, int fps);
+	void close();
+	bool grab(ofxRealSenseFrame& frame, int timeoutMs);
+
+	int getWidth() const;
+	int getHeight() const;
+
+	/// seconds for the hand to go around its path once, default is 4
+	void setPeriod(float seconds);
+
+	/// random offset in pixels added to the reported hand centers,
+	/// like tracking jitter, default is 0
+	void setNoise(float pixels);
+
+	/// distances in mm of the wall and the hand, defaults are 900 and 450
+	void setDepth(float wall, float hand);
+
+	/// where the hand is at a time in seconds, without noise
+	ofxRealSenseHand getHand(double time) const;
+
+private:
+
+	float random();
+
+	int width, height, fps;
+	float period;
+	float noise;
+	float wallDepth, handDepth;
+
+	double startTime;
+	unsigned long long numFrames;
+	unsigned int seed;
+};
@@ -0,0 +1,46 @@
+#include "HandInput.h"
+
+HandInput::HandInput()
+	: grabber(0)
+{
+}
+
+HandInput::~HandInput()
+{
+	clear();
+}
+
+void HandInput::setup(ofxRealSense& grabber)
+{
+	clear();
+	this->grabber = &grabber;
+	ofAddListener(grabber.newFrameEvent, this, &HandInput::onNewFrame);
+}
+
+void HandInput::clear()
+{
+	if (grabber != 0) {
+		ofRemoveListener(grabber->newFrameEvent, this, &HandInput::onNewFrame);
+		grabber = 0;
+	}
+}
+
+// ofxRealSense ̃XbhĂ΂
+void HandInput::onNewFrame(ofxRealSenseFrame& frame)
+{
+	HandSample samples[HandPredictor::MAX_HANDS] = {};
+
+	int numOfHands = std::min((int)frame.hands.size(), HandPredictor::MAX_HANDS);
+	for (int i = 0; i < numOfHands; i++) {
+		const ofxRealSenseHand& hand = frame.hands[i];
+		samples[i].isTracked = true;
+		samples[i].id = hand.id;
+		samples[i].side = hand.side;
+		samples[i].x = hand.center.x;
+		samples[i].y = hand.center.y;
+		samples[i].openness = hand.openness;
+	}
+
+	// āA`Xbhɓn
+	predictor.update(samples, HandPredictor::MAX_HANDS, frame.timestamp);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxRealSense.h"
+#include "HandPredictor.h"
+
+// RealSense ̎̃f[^𕽊E\ĕ`Xbhɓn
+//
+// t[̎擾(AcquireFrame) ofxRealSense ̃XbhōsB
+// newFrameEvent Ŏ󂯎̃f[^̂܂ HandPredictor ɓn̂ŁA
+// `Xbh update() ҂ɔfA
+// `Xbh sample() ŕ\鎞̎̏Ԃ󂯎B
+class HandInput
+{
+public:
+	HandInput();
+	~HandInput();
+
+	// grabber ̃t[󂯎n߂
+	void setup(ofxRealSense& grabber);
+	// 󂯎߂
+	void clear();
+
+	// time ̎_̎̏(\l)
+	HandPredictor::Snapshot sample(double time) const { return predictor.predict(time); }
+	// sample() ɓn(t[̎Ɠv)
+	static double now() { return ofxRealSense::now(); }
+
+	static const int DEPTH_WIDTH = 640;
+	static const int DEPTH_HEIGHT = 480;
+	static const int DEPTH_FPS = 30;
+
+private:
+	void onNewFrame(ofxRealSenseFrame& frame);
+
+	ofxRealSense* grabber;
+	HandPredictor predictor;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+// One Euro tB^ (Casiez et al. 2012)
+// 肪xƂ͋ėh}AƂ͒x
+class OneEuroFilter
+{
+public:
+	OneEuroFilter(float minCutoff = 1.0f, float beta = 0.0f, float derivativeCutoff = 1.0f)
+		: minCutoff(minCutoff), beta(beta), derivativeCutoff(derivativeCutoff)
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		isInitialized = false;
+		value = 0.0f;
+		velocity = 0.0f;
+	}
+
+	// dt ͑O̒ľoߎ(b)
+	float filter(float x, float dt)
+	{
+		if (!isInitialized || dt <= 0.0f) {
+			if (!isInitialized) {
+				value = x;
+				velocity = 0.0f;
+				isInitialized = true;
+			}
+			return value;
+		}
+
+		// x𕽊āAxɉăJbgItgグ
+		float dx = (x - value) / dt;
+		velocity += alpha(derivativeCutoff, dt) * (dx - velocity);
+		float cutoff = minCutoff + beta * std::abs(velocity);
+		value += alpha(cutoff, dt) * (x - value);
+		return value;
+	}
+
+	float getValue() const { return value; }
+	float getVelocity() const { return velocity; }
+
+private:
+	static float alpha(float cutoff, float dt)
+	{
+		float tau = 1.0f / (2.0f * 3.14159265f * cutoff);
+		return 1.0f / (1.0f + tau / dt);
+	}
+
+	float minCutoff;
+	float beta;
+	float derivativeCutoff;
+	bool isInitialized;
+	float value;
+	float velocity;
+};
+
+// ̃f[^(1t[)
+struct HandSample
+{
+	bool isTracked;
+	int id;					// ID(ςtB^Zbg)
+	int side;
+	float x, y;				// dS̈ʒu(Depth摜̍W)
+	float openness;			// J(0-100)
+};
+
+// ̏
+struct HandState
+{
+	bool isTracked;
+	int side;
+	float x, y;
+	float openness;
+	float vx, vy;			// x(1b)
+	float vOpenness;
+	double time;			// Beꂽ(b)
+};
+
+// ̈ʒu𕽊A\
+//
+// update() ͎̃XbhApredict() ͕`XbhĂԁB
+// Ԃ seqlock Ŏ󂯓n̂ŁA`XbhbNő҂Ƃ͂ȂB
+// (ݒɓǂ񂾂Ƃ́Aǂݒ)
+// ݂Ɠǂݍ݂dȂĂf[^ɂȂȂ悤ɁA
+// LԂ std::atomic ̌Pʂ1ꂸRs[B
+class HandPredictor
+{
+public:
+	static const int MAX_HANDS = 2;
+
+	struct Snapshot
+	{
+		HandState hands[MAX_HANDS];
+		unsigned frame;		// update() ̉
+	};
+
+	//   minCutoff, beta, derivativeCutoff : One Euro tB^̃p[^
+	//   maxPrediction : \鎞Ԃ̏(b)
+	// ĺAĂł͒xꂪ(beta 傫)A~܂Ăł͗h}(minCutoff )悤ɂĂ
+	HandPredictor(float minCutoff = 0.3f, float beta = 0.2f, float derivativeCutoff = 2.0f, double maxPrediction = 0.15)
+		: maxPrediction(maxPrediction)
+	{
+		for (int i = 0; i < MAX_HANDS; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				filters[i][j] = OneEuroFilter(minCutoff, beta, derivativeCutoff);
+			}
+			ids[i] = -1;
+			HandState& hand = current.hands[i];
+			hand.isTracked = false;
+			hand.side = 0;
+			hand.x = hand.y = hand.openness = 0.0f;
+			hand.vx = hand.vy = hand.vOpenness = 0.0f;
+			hand.time = 0.0;
+		}
+		current.frame = 0;
+		sequence = 0;
+		store(current);
+	}
+
+	// Vt[̎n(̃XbhĂ)
+	//   time : Beꂽ(predict() ɓnƓv)
+	void update(const HandSample* samples, int count, double time)
+	{
+		for (int i = 0; i < MAX_HANDS; ++i) {
+			HandState& hand = current.hands[i];
+			if ((i >= count) || !samples[i].isTracked) {
+				// Ō̈ʒuŎ~߂
+				hand.isTracked = false;
+				hand.vx = hand.vy = hand.vOpenness = 0.0f;
+				ids[i] = -1;
+				continue;
+			}
+
+			const HandSample& sample = samples[i];
+			if (ids[i] != sample.id) {
+				for (int j = 0; j < 3; ++j) {
+					filters[i][j].reset();
+				}
+				ids[i] = sample.id;
+			}
+
+			float dt = (float)(time - hand.time);
+			hand.isTracked = true;
+			hand.side = sample.side;
+			hand.x = filters[i][0].filter(sample.x, dt);
+			hand.y = filters[i][1].filter(sample.y, dt);
+			hand.openness = filters[i][2].filter(sample.openness, dt);
+			hand.vx = filters[i][0].getVelocity();
+			hand.vy = filters[i][1].getVelocity();
+			hand.vOpenness = filters[i][2].getVelocity();
+			hand.time = time;
+		}
+		++current.frame;
+
+		// seqlock: ݒ sequence ɂ
+		unsigned s = sequence.load(std::memory_order_relaxed);
+		sequence.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		store(current);
+		sequence.store(s + 2, std::memory_order_release);
+	}
+
+	// ŐV̏Ԃǂ(ǂ̃XbhłĂׂ)
+	Snapshot read() const
+	{
+		Snapshot snapshot;
+		while (true) {
+			unsigned s = sequence.load(std::memory_order_acquire);
+			if ((s & 1) == 0) {
+				load(snapshot);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == s) {
+					return snapshot;
+				}
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	// time ̎_̎̏ԂAxƂė\
+	Snapshot predict(double time) const
+	{
+		Snapshot snapshot = read();
+		for (int i = 0; i < MAX_HANDS; ++i) {
+			HandState& hand = snapshot.hands[i];
+			if (!hand.isTracked) {
+				continue;
+			}
+			float dt = (float)std::min(std::max(time - hand.time, 0.0), maxPrediction);
+			hand.x += hand.vx * dt;
+			hand.y += hand.vy * dt;
+			hand.openness = std::min(std::max(hand.openness + hand.vOpenness * dt, 0.0f), 100.0f);
+		}
+		return snapshot;
+	}
+
+private:
+	HandPredictor(const HandPredictor&);
+	HandPredictor& operator=(const HandPredictor&);
+
+	static const int SHARED_WORDS = (sizeof(Snapshot) + sizeof(unsigned) - 1) / sizeof(unsigned);
+
+	// LԂ1ꂸAǂ
+	void store(const Snapshot& snapshot)
+	{
+		unsigned words[SHARED_WORDS] = {};
+		memcpy(words, &snapshot, sizeof(snapshot));
+		for (int i = 0; i < SHARED_WORDS; ++i) {
+			shared[i].store(words[i], std::memory_order_relaxed);
+		}
+	}
+
+	void load(Snapshot& snapshot) const
+	{
+		unsigned words[SHARED_WORDS];
+		for (int i = 0; i < SHARED_WORDS; ++i) {
+			words[i] = shared[i].load(std::memory_order_relaxed);
+		}
+		memcpy(&snapshot, words, sizeof(snapshot));
+	}
+
+	double maxPrediction;
+
+	// ̃Xbhg
+	OneEuroFilter filters[MAX_HANDS][3];
+	int ids[MAX_HANDS];
+	Snapshot current;
+
+	// `XbhƋL
+	std::atomic<unsigned> shared[SHARED_WORDS];
+	std::atomic<unsigned> sequence;
+};
@@ -2,12 +2,20 @@
 #include "ofApp.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
+	// --synthetic runs on synthetic hand motion instead of the camera
+	bool useSyntheticHands = false;
+	for(int i = 1; i < argc; i++){
+		if(string(argv[i]) == "--synthetic"){
+			useSyntheticHands = true;
+		}
+	}
+
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(new ofApp(useSyntheticHands));
 
 }
@@ -1,49 +1,11 @@
 #include "ofApp.h"
 
-#include "pxccapture.h"
-#include "pxchandmodule.h"
-#include "pxchandconfiguration.h"
-#include "pxchanddata.h"
-#include "pxcsensemanager.h"
-
-PXCSenseManager* senseManager = 0;
-PXCHandModule* handAnalyzer = 0;
-PXCHandData* handData = 0;
-
-const int DEPTH_WIDTH = 640;
-const int DEPTH_HEIGHT = 480;
-const int DEPTH_FPS = 30;
-
-int sides[2];
-float openesses[2];
-ofPoint centers[2];
 ofColor circleColor;
 
-void ofApp::initializeHandTracking()
+//--------------------------------------------------------------
+ofApp::ofApp(bool useSyntheticHands)
+	: useSyntheticHands(useSyntheticHands)
 {
-	// ̌o擾
-	handAnalyzer = senseManager->QueryHand();
-	if (handAnalyzer == 0) {
-		throw std::runtime_error("̌o̎擾Ɏs܂");
-	}
-	// ̃f[^쐬
-	handData = handAnalyzer->CreateOutput();
-	if (handData == 0) {
-		throw std::runtime_error("̌o̍쐬Ɏs܂");
-	}
-	PXCCapture::Device *device = senseManager->QueryCaptureManager()->QueryDevice();
-	PXCCapture::DeviceInfo dinfo;
-	device->QueryDeviceInfo(&dinfo);
-	if (dinfo.model == PXCCapture::DEVICE_MODEL_IVCAM) {
-		device->SetDepthConfidenceThreshold(1);
-		//device->SetMirrorMode( PXCCapture::Device::MIRROR_MODE_DISABLED );
-		device->SetIVCAMFilterOption(6);
-	}
-	// ̌o̐ݒ
-	PXCHandConfiguration* config = handAnalyzer->CreateActiveConfiguration();
-	config->EnableSegmentationImage(true);
-	config->ApplyChanges();
-	config->Update();
 }
 
 //--------------------------------------------------------------
@@ -58,22 +20,9 @@ void ofApp::setup(){
 	particles.init(w, h);
 
 	// initial positions
-	// use new to allocate 4,000,000 floats on the heap rather than
-	// the stack
-	float* particlePosns = new float[w * h * 4];
-	for (unsigned y = 0; y < h; ++y)
-	{
-		for (unsigned x = 0; x < w; ++x)
-		{
-			unsigned idx = y * w + x;
-			particlePosns[idx * 4] = 400.f * x / (float)w - 200.f; // particle x
-			particlePosns[idx * 4 + 1] = 400.f * y / (float)h - 200.f; // particle y
-			particlePosns[idx * 4 + 2] = 0.f; // particle z
-			particlePosns[idx * 4 + 3] = 0.f; // dummy
-		}
-	}
-	particles.loadDataTexture(ofxGpuParticles::POSITION, particlePosns);
-	delete[] particlePosns;
+	// generated a band of rows at a time straight into the texture,
+	// so no 16MB position array is needed
+	particles.loadDataTexture(ofxGpuParticles::POSITION, itg::ParticleGrid(w, h, -200.f, -200.f, 400.f, 400.f));
 
 	// initial velocities
 	particles.zeroDataTexture(ofxGpuParticles::VELOCITY);
@@ -85,37 +34,28 @@ void ofApp::setup(){
 	circleColor.b = 0;
 	circleColor.a = 128;
 
-	senseManager = PXCSenseManager::CreateInstance();
-	if (senseManager == 0) {
-		throw std::runtime_error("SenseManager̐Ɏs܂");
-	}
-
-	// DepthXg[Lɂ
-	auto sts = senseManager->EnableStream(PXCCapture::StreamType::STREAM_TYPE_DEPTH,
-		DEPTH_WIDTH, DEPTH_HEIGHT, DEPTH_FPS);
-	if (sts < PXC_STATUS_NO_ERROR) {
-		throw std::runtime_error("DepthXg[̗LɎs܂");
+	// RealSense ̃t[ʂ̃XbhŎ擾Ãf[^󂯎
+	// (Depth摜͎gȂ̂ŃeNX`͍Ȃ)
+	realSense.init(false);
+	realSense.setSize(HandInput::DEPTH_WIDTH, HandInput::DEPTH_HEIGHT, HandInput::DEPTH_FPS);
+	handInput.setup(realSense);
+	if (useSyntheticHands) {
+		// --synthetic ̂ƂAJ̑ɍ̓œ
+		ofLogWarning("ofApp") << "--synthetic: using synthetic hand motion instead of the camera";
+		realSense.open(new ofxRealSenseSynthetic());
 	}
-	// ̌oLɂ
-	sts = senseManager->EnableHand();
-	if (sts < PXC_STATUS_NO_ERROR) {
-		throw std::runtime_error("̌o̗LɎs܂");
+	else if (!realSense.open()) {
+		ofLogError("ofApp") << "no RealSense camera could be opened, run with --synthetic to test without one";
+		throw std::runtime_error("RealSenseJJ܂ł");
 	}
-	// pCvC
-	sts = senseManager->Init();
-	if (sts < PXC_STATUS_NO_ERROR) {
-		throw std::runtime_error("pCvC̏Ɏs܂");
-	}
-
-	initializeHandTracking();
-
 }
 
 // set any update uniforms in this function
 void ofApp::onParticlesUpdate(ofShader& shader)
 {
 	// ̈ʒuVF[_[̍Wnɍ킹ČvZ
-	ofVec3f mouse(-1.0f * (centers[0].x * ofGetWidth() / DEPTH_WIDTH - .5f * ofGetWidth()), .5f * ofGetHeight() - (centers[0].y * ofGetHeight() / DEPTH_HEIGHT), 0.f);
+	const HandState& hand = hands.hands[0];
+	ofVec3f mouse(-1.0f * (hand.x * ofGetWidth() / HandInput::DEPTH_WIDTH - .5f * ofGetWidth()), .5f * ofGetHeight() - (hand.y * ofGetHeight() / HandInput::DEPTH_HEIGHT), 0.f);
 
 	// vZ̈ʒuVF[_[ɃZbg
 	shader.setUniform3fv("mouse", mouse.getPtr());
@@ -123,59 +63,26 @@ void ofApp::onParticlesUpdate(ofShader& shader)
 
 	// ̊JlŃp[eBN̏W܂ω
 	float openForRad;
-	if (openesses[0] < 10.0f){
+	if (hand.openness < 10.0f){
 		openForRad = 10.0f;
 	}
-	else if (openesses[0] > 100.0f){
+	else if (hand.openness > 100.0f){
 		openForRad = 100.0f;
 	}
 	else{
-		openForRad = openesses[0];
+		openForRad = hand.openness;
 	}
 	openForRad = 1.0f - (openForRad / 100.0f) + 0.01f;
 
 	shader.setUniform1f("radiusSquared", 200.f * 200.f * 10.0f * openForRad);
 }
 
-void ofApp::updateHandFrame(){
-
-	handData->Update();
-	// o̐擾
-	auto numOfHands = handData->QueryNumberOfHands();
-	for (int i = 0; i < numOfHands; i++) {
-		// 擾
-		pxcUID handID;
-		PXCHandData::IHand* hand;
-		auto sts = handData->QueryHandData(
-			PXCHandData::AccessOrderType::ACCESS_ORDER_BY_ID, i, hand);
-		if (sts < PXC_STATUS_NO_ERROR) {
-			continue;
-		}
-
-		auto side = hand->QueryBodySide();
-		auto openness = hand->QueryOpenness();
-		auto center = hand->QueryMassCenterImage();
-
-		if (i < 2){
-			sides[i] = side;
-			openesses[i] = openness;
-			centers[i].x = center.x;
-			centers[i].y = center.y;
-		}
-	}
-}
-
 //--------------------------------------------------------------
 void ofApp::update(){
+	realSense.update();
 
-	pxcStatus sts = senseManager->AcquireFrame(false);
-	if (sts < PXC_STATUS_NO_ERROR) {
-		return;
-	}
-	// ̃f[^XV
-	updateHandFrame();
-	// t[
-	senseManager->ReleaseFrame();
+	// ̐ŕ\鎞̎̈ʒu\Ďg
+	hands = handInput.sample(HandInput::now() + 1.0 / ofGetTargetFrameRate());
 
 	ofSetWindowTitle(ofToString(ofGetFrameRate(), 2));
 	particles.update();
@@ -189,20 +96,48 @@ void ofApp::draw(){
 	ofDisableBlendMode();
 
 	// ~̈ʒǔvZ
-	ofVec3f handPoint(-1.0f * (centers[0].x * ofGetWidth() / DEPTH_WIDTH - .5f * ofGetWidth()), .5f * ofGetHeight() - (centers[0].y * ofGetHeight() / DEPTH_HEIGHT), 0.f);
+	const HandState& hand = hands.hands[0];
+	ofVec3f handPoint(-1.0f * (hand.x * ofGetWidth() / HandInput::DEPTH_WIDTH - .5f * ofGetWidth()), .5f * ofGetHeight() - (hand.y * ofGetHeight() / HandInput::DEPTH_HEIGHT), 0.f);
 	// ~̐F̎w
 	ofSetColor(circleColor);
 	// AEgĈݕ`
 	ofNoFill();
 	// ~̕`
-	ofCircle(handPoint.x, handPoint.y, 2.0f * openesses[0]);
+	ofCircle(handPoint.x, handPoint.y, 2.0f * hand.openness);
 
 	cam.end();
+
+	// œĂ邱Ƃʂł킩悤ɂ
+	if (useSyntheticHands) {
+		ofDrawBitmapStringHighlight("SYNTHETIC HANDS (--synthetic), not the camera", 20, 20, ofColor::red, ofColor::white);
+	}
 }
 
 //--------------------------------------------------------------
-void ofApp::keyPressed(int key){
+void ofApp::exit(){
+	realSense.close();
+	handInput.clear();
+}
 
+//--------------------------------------------------------------
+void ofApp::keyPressed(int key){
+	// p[eBN̏ԂۑAǂݍ݂
+	if (key == 's') {
+		particles.saveBinary("particles.bin");
+	}
+	else if (key == 'c') {
+		// xɗƂĈk̂ŁA's'̕ۑƂ͕ʂ̃t@Cɂ
+		particles.saveBinary("particles_half.bin", itg::ParticleSnapshot::FLOAT16, itg::ParticleSnapshot::LZ4);
+	}
+	else if (key == 't') {
+		particles.save("particles.txt");
+	}
+	else if (key == 'l') {
+		particles.load("particles.bin");
+	}
+	else if (key == 'L') {
+		particles.load("particles_half.bin");
+	}
 }
 
 //--------------------------------------------------------------
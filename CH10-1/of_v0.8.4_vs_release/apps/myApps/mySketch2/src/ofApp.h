@@ -2,15 +2,18 @@
 
 #include "ofMain.h"
 #include "ofxGpuParticles.h"
+#include "ofxRealSense.h"
+#include "HandInput.h"
 
 class ofApp : public ofBaseApp{
 
 public:
+	ofApp(bool useSyntheticHands = false);
+
 	void setup();
 	void update();
 	void draw();
-	void initializeHandTracking();
-	void updateHandFrame();
+	void exit();
 
 	void keyPressed(int key);
 	void keyReleased(int key);
@@ -29,4 +32,9 @@ private:
 	ofxGpuParticles particles;
 	ofEasyCam cam;
 
+	ofxRealSense realSense;
+	HandInput handInput;
+	HandPredictor::Snapshot hands;
+	bool useSyntheticHands;
+
 };
\ No newline at end of file
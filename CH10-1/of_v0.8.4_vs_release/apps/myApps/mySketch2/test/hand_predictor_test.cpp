@@ -0,0 +1,226 @@
+// HandPredictor.h ̃eXg
+//
+// One Euro tB^̕A̗\Aseqlock ł̎󂯓nm߂B
+// ̓͌vZō(RealSense ͎gȂ)B
+#include "HandPredictor.h"
+
+#include <stdio.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what, int line)
+{
+	if (!ok) {
+		printf("NG line %d : %s\n", line, what);
+		++failures;
+	}
+}
+
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+const double PI = 3.14159265358979;
+
+HandSample makeSample(int id, float x, float y, float openness)
+{
+	HandSample sample = { true, id, 0, x, y, openness };
+	return sample;
+}
+
+void testOneEuroFilter()
+{
+	// ŏ̒l͂̂܂܁AlΕςȂ
+	OneEuroFilter still(1.0f, 0.0f, 1.0f);
+	CHECK(still.filter(10.0f, 0.033f) == 10.0f);
+	for (int i = 0; i < 30; ++i) {
+		still.filter(10.0f, 0.033f);
+	}
+	CHECK(std::abs(still.getValue() - 10.0f) < 1e-4f);
+	CHECK(std::abs(still.getVelocity()) < 1e-4f);
+
+	// oߎԂ0ȉȂO̒lԂ
+	CHECK(still.filter(50.0f, 0.0f) == still.getValue());
+
+	// ~܂Ă̗h}
+	std::mt19937 rng(1);
+	std::normal_distribution<float> noise(0.0f, 2.0f);
+	OneEuroFilter filter(0.3f, 0.2f, 2.0f);
+	double rawError = 0.0, filteredError = 0.0;
+	for (int i = 0; i < 300; ++i) {
+		float x = 100.0f + noise(rng);
+		float y = filter.filter(x, 1.0f / 30);
+		if (i >= 30) {
+			rawError += std::abs(x - 100.0f);
+			filteredError += std::abs(y - 100.0f);
+		}
+	}
+	printf("still : raw %.2f filtered %.2f\n", rawError / 270, filteredError / 270);
+	CHECK(filteredError < rawError * 0.8);
+
+	// beta 傫قǁAĂƂ̒xꂪ
+	OneEuroFilter slow(0.3f, 0.0f, 2.0f), fast(0.3f, 0.2f, 2.0f);
+	float slowLag = 0.0f, fastLag = 0.0f;
+	for (int i = 0; i < 60; ++i) {
+		float x = i * 10.0f;
+		slowLag = x - slow.filter(x, 1.0f / 30);
+		fastLag = x - fast.filter(x, 1.0f / 30);
+	}
+	printf("ramp 300px/s : lag beta 0 %.1f px, beta 0.2 %.1f px\n", slowLag, fastLag);
+	CHECK(fastLag < slowLag / 2);
+
+	// œl̑x܂(lƂ̍狁߂̂ŁA傫߂ɂȂ)
+	CHECK(std::abs(fast.getVelocity() - 300.0f) < 30.0f);
+}
+
+void testPrediction()
+{
+	HandPredictor predictor;
+	HandPredictor::Snapshot snapshot = predictor.read();
+	CHECK(snapshot.frame == 0);
+	CHECK(!snapshot.hands[0].isTracked && !snapshot.hands[1].isTracked);
+
+	// x  200px/s œ
+	for (int i = 0; i <= 60; ++i) {
+		double time = i / 30.0;
+		HandSample sample = makeSample(1, 100.0f + 200.0f * (float)time, 50.0f, 50.0f);
+		predictor.update(&sample, 1, time);
+	}
+	snapshot = predictor.read();
+	CHECK(snapshot.frame == 61);
+	CHECK(snapshot.hands[0].isTracked && !snapshot.hands[1].isTracked);
+
+	// 50ms ̈ʒu
+	HandPredictor::Snapshot predicted = predictor.predict(2.05);
+	printf("prediction : %.1f px (truth %.1f)\n", predicted.hands[0].x, 510.0f);
+	CHECK(std::abs(predicted.hands[0].x - 510.0f) < 5.0f);
+	CHECK(std::abs(predicted.hands[0].y - 50.0f) < 0.5f);
+
+	// \ 150ms Ŏ~߁Aߋ͗\Ȃ
+	HandPredictor::Snapshot far = predictor.predict(3.0);
+	HandPredictor::Snapshot capped = predictor.predict(2.15);
+	CHECK(far.hands[0].x == capped.hands[0].x);
+	CHECK(predictor.predict(1.0).hands[0].x == snapshot.hands[0].x);
+
+	// J 0-100 Ɏ߂
+	HandPredictor opening;
+	for (int i = 0; i <= 30; ++i) {
+		HandSample sample = makeSample(1, 0.0f, 0.0f, 3.0f * i);
+		opening.update(&sample, 1, i / 30.0);
+	}
+	CHECK(opening.predict(1.15).hands[0].openness <= 100.0f);
+
+	// ID ςtB^ZbgāAV̈ʒun߂
+	HandSample other = makeSample(2, 400.0f, 300.0f, 10.0f);
+	predictor.update(&other, 1, 2.1);
+	snapshot = predictor.read();
+	CHECK(snapshot.hands[0].x == 400.0f && snapshot.hands[0].y == 300.0f);
+	CHECK(snapshot.hands[0].vx == 0.0f);
+
+	// Ō̈ʒuŎ~߂
+	predictor.update(NULL, 0, 2.2);
+	snapshot = predictor.read();
+	CHECK(!snapshot.hands[0].isTracked);
+	CHECK(snapshot.hands[0].x == 400.0f);
+	CHECK(predictor.predict(2.3).hands[0].x == 400.0f);
+}
+
+// ȉ~`Axē͂t[\
+//   Be 30fps(hꂠ)A͂܂ 60msA` 60fps(Ƃǂ 50ms ~܂)
+void testLatency()
+{
+	const double latency = 0.060;
+	struct Event { double capture, arrive; float x, y; };
+
+	std::mt19937 rng(7);
+	std::normal_distribution<float> noise(0.0f, 1.5f);
+	std::uniform_real_distribution<double> jitter(-1.0, 1.0);
+
+	std::vector<Event> events;
+	for (double t = 0.0; t < 20.0; t += 1.0 / 30 + 0.004 * jitter(rng)) {
+		Event e = { t, t + latency + 0.010 * jitter(rng),
+			320.0f + 150.0f * (float)cos(PI * t) + noise(rng), 240.0f + 100.0f * (float)sin(PI * t) + noise(rng) };
+		events.push_back(e);
+	}
+
+	HandPredictor predictor;
+	size_t next = 0;
+	float rawX = 0.0f, rawY = 0.0f;
+	double rawError = 0.0, predictedError = 0.0;
+	int count = 0, frame = 0;
+	for (double t = 0.5; t < 19.5; t += 1.0 / 60 + 0.003 * jitter(rng) + ((++frame % 97) == 0 ? 0.050 : 0.0)) {
+		while (next < events.size() && events[next].arrive <= t) {
+			const Event& e = events[next++];
+			HandSample sample = makeSample(1, e.x, e.y, 50.0f);
+			predictor.update(&sample, 1, e.arrive - latency);
+			rawX = e.x;
+			rawY = e.y;
+		}
+
+		// ̐ŕ\鎞
+		double display = t + 1.0 / 60;
+		float x = 320.0f + 150.0f * (float)cos(PI * display), y = 240.0f + 100.0f * (float)sin(PI * display);
+		HandPredictor::Snapshot predicted = predictor.predict(display);
+		rawError += std::hypot(rawX - x, rawY - y);
+		predictedError += std::hypot(predicted.hands[0].x - x, predicted.hands[0].y - y);
+		++count;
+	}
+	printf("latency : mean error raw %.1f px predicted %.1f px\n", rawError / count, predictedError / count);
+	CHECK(predictedError < rawError * 0.6);
+}
+
+// ݂Ɠǂݍ݂dȂĂAr܂ŏԂ͓ǂ܂Ȃ
+void testSeqlock()
+{
+	HandPredictor predictor;
+	std::atomic<bool> isDone(false);
+	const int FRAMES = 1000000;
+
+	std::thread writer([&] {
+		for (int i = 0; i < FRAMES; ++i) {
+			float v = (float)(i % 1000);
+			HandSample samples[2] = { makeSample(1, v, v, v), makeSample(2, v, v, v) };
+			predictor.update(samples, 2, i * 0.001);
+		}
+		isDone = true;
+	});
+
+	unsigned long long reads = 0, torn = 0;
+	unsigned last = 0;
+	while (!isDone) {
+		HandPredictor::Snapshot snapshot = predictor.read();
+		for (int i = 0; i < 2; ++i) {
+			const HandState& hand = snapshot.hands[i];
+			// l𓯂tB^ɒʂĂ̂ŁAx, y, J͂
+			if (hand.x != hand.y || hand.y != hand.openness || hand.time != snapshot.hands[0].time) {
+				++torn;
+			}
+		}
+		if (snapshot.frame < last) {
+			++torn;
+		}
+		last = snapshot.frame;
+		++reads;
+	}
+	writer.join();
+
+	printf("seqlock : %llu reads, %llu torn\n", reads, torn);
+	CHECK(torn == 0);
+	CHECK(predictor.read().frame == FRAMES);
+}
+
+}
+
+int main()
+{
+	testOneEuroFilter();
+	testPrediction();
+	testLatency();
+	testSeqlock();
+
+	printf("%s\n", (failures == 0) ? "OK" : "FAILED");
+	return (failures == 0) ? 0 : 1;
+}
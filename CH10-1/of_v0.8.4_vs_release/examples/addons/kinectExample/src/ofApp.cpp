@@ -55,6 +55,11 @@ void ofApp::update() {
 	
 	kinect.update();
 	
+	// record the raw depth while 'r' is on
+	if(recorder.isOpen() && kinect.isFrameNewDepth()) {
+		recorder.write(kinect.getRawDepthPixelsRef(), kinect.getPixelsRef(), kinect.getDepthTime());
+	}
+	
 	// there is a new frame and we are connected
 	if(kinect.isFrameNew()) {
 		
@@ -137,7 +142,12 @@ void ofApp::draw() {
 	<< "set near threshold " << nearThreshold << " (press: + -)" << endl
 	<< "set far threshold " << farThreshold << " (press: < >) num blobs found " << contourFinder.nBlobs
 	<< ", fps: " << ofGetFrameRate() << endl
-	<< "press c to close the connection and o to open it again, connection is: " << kinect.isConnected() << endl;
+	<< "press c to close the connection and o to open it again, connection is: " << kinect.isConnected() << endl
+	<< "press r to start / stop recording, recording: " << recorder.isOpen();
+	if(recorder.isOpen()) {
+		reportStream << " (" << recorder.getNumFrames() << " frames, " << recorder.getNumBytes() / (1024 * 1024) << " MB)";
+	}
+	reportStream << endl;
 
     if(kinect.hasCamTiltControl()) {
     	reportStream << "press UP and DOWN to change the tilt angle: " << angle << " degrees" << endl
@@ -175,6 +185,7 @@ void ofApp::drawPointCloud() {
 
 //--------------------------------------------------------------
 void ofApp::exit() {
+	recorder.close();
 	kinect.setCameraTiltAngle(0); // zero the tilt on exit
 	kinect.close();
 	
@@ -231,6 +242,15 @@ void ofApp::keyPressed (int key) {
 			kinect.close();
 			break;
 			
+		case 'r':
+			if(recorder.isOpen()) {
+				recorder.close();
+			} else if(kinect.isConnected()) {
+				// 3 channels for rgb, 1 for infrared
+				recorder.open("kinect_" + ofGetTimestampString() + ".depth", kinect.width, kinect.height, kinect.getPixelsRef().getNumChannels());
+			}
+			break;
+			
 		case '1':
 			kinect.setLed(ofxKinect::LED_GREEN);
 			break;
@@ -3,6 +3,7 @@
 #include "ofMain.h"
 #include "ofxOpenCv.h"
 #include "ofxKinect.h"
+#include "ofxDepthPlayer.h"
 
 // Windows users:
 // You MUST install the libfreenect kinect drivers in order to be able to use
@@ -40,6 +41,9 @@ public:
 	
 	ofxKinect kinect;
 	
+	// records the raw depth & video, play the file back with ofxDepthPlayer
+	ofxDepthRecorder recorder;
+	
 #ifdef USE_TWO_KINECTS
 	ofxKinect kinect2;
 #endif
@@ -3,6 +3,8 @@
 
 #include <opencv2\opencv.hpp>
 
+#include "mask_stabilizer.h"
+
 class RealSenseApp
 {
 public:
@@ -109,27 +111,30 @@ private:
             throw std::runtime_error("J[摜̎擾Ɏs");
         }
 
-        // f[^Rs[
-        colorImage = cv::Mat::zeros( info.height, info.width, CV_8UC4 );
+        // J[摜ƃl(}XN)o
+        cv::Mat rgba( info.height, info.width, CV_8UC4, data.planes[0], data.pitches[0] );
+        rgba.copyTo( segmentedImage );
+        cv::extractChannel( segmentedImage, alphaImage, 3 );
+
+        // }XN̂}
+        stabilizer.process( segmentedImage, alphaImage, stableAlpha );
+
+        // 艻lŔwi()ƍ
+        colorImage = cv::Mat( info.height, info.width, CV_8UC4 );
 
         auto dst = colorImage.data;
-        auto src = data.planes[0];
+        auto src = segmentedImage.data;
+        auto alpha = stableAlpha.data;
 
         for ( int i = 0; i < (info.height * info.width); i++ ) {
             auto index = i * BYTE_PER_PIXEL;
 
-            // l0łȂꍇɂ͗LȏꏊƂĐFRs[
-            if ( src[index + 3] > 0 ){
-                dst[index + 0] = src[index + 0];
-                dst[index + 1] = src[index + 1];
-                dst[index + 2] = src[index + 2];
-            }
-            // l0̏ꍇ͔ɂ
-            else {
-                dst[index + 0] = 255;
-                dst[index + 1] = 255;
-                dst[index + 2] = 255;
-            }
+            // lŐFƔ
+            int a = alpha[i];
+            dst[index + 0] = (uchar)((src[index + 0] * a + 255 * (255 - a)) / 255);
+            dst[index + 1] = (uchar)((src[index + 1] * a + 255 * (255 - a)) / 255);
+            dst[index + 2] = (uchar)((src[index + 2] * a + 255 * (255 - a)) / 255);
+            dst[index + 3] = 255;
         }
 
         // f[^
@@ -143,6 +148,12 @@ private:
             return true;
         }
 
+        // }XN艻̏Ԃ\
+        std::stringstream ss;
+        ss << "stabilizer : " << stabilizer.lastProcessMs() << " ms";
+        cv::putText( colorImage, ss.str(), cv::Point( 10, 20 ),
+            cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar( 0, 0, 255 ) );
+
         // \
         cv::imshow( "Color Image", colorImage );
 
@@ -151,6 +162,11 @@ private:
             // ESC|q|Q for Exit
             return false;
         }
+        // t|T Ń^C񏈗؂ւ
+        else if ( (c == 't') || (c == 'T') ){
+            isTileMode = !isTileMode;
+            stabilizer.setTileCount( isTileMode ? TILE_COUNT : 1 );
+        }
 
         return true;
     }
@@ -158,9 +174,17 @@ private:
 private:
 
     cv::Mat colorImage;
+    cv::Mat segmentedImage;
+    cv::Mat alphaImage;
+    cv::Mat stableAlpha;
     PXCSenseManager *senseManager = 0;
     PXC3DSeg* segmentation = 0;
 
+    // }XN艻
+    MaskStabilizer stabilizer;
+    bool isTileMode = false;
+    const int TILE_COUNT = 4;
+
     // sNZ̃oCg
     const int BYTE_PER_PIXEL = 4;
 
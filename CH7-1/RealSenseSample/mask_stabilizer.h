@@ -0,0 +1,309 @@
+﻿// セグメンテーションマスクの時間方向安定化
+//
+// 3Dセグメンテーションのα値(マスク)は毎フレーム独立に計算されるため、
+// 輪郭がちらつく。ここでは過去Nフレームのマスクを保持し、
+//   1. 画素ごとの時間方向メディアン(SSE2)
+//   2. ヒステリシスしきい値(前フレームの結果を使う)
+//   3. カラー画像をガイドにした縮小グリッド上のガイデッドフィルタ
+// を順にかけて、エッジを保ったままマスクを安定させる。
+// 全解像度で行う処理はタイル(行の帯)単位で並列化できる。
+#pragma once
+
+#include <vector>
+#include <emmintrin.h>
+
+#include <opencv2\opencv.hpp>
+
+class MaskStabilizer
+{
+public:
+
+    // 保持できる最大フレーム数
+    enum { MAX_HISTORY = 9 };
+
+    MaskStabilizer( int history = 5 )
+    {
+        setHistory( history );
+    }
+
+    // メディアンを取るフレーム数を設定する(奇数、1～MAX_HISTORY)
+    void setHistory( int history )
+    {
+        history = std::max( 1, std::min( (int)MAX_HISTORY, history ) );
+        if ( (history % 2) == 0 ){
+            history++;
+        }
+
+        historySize = history;
+        reset();
+    }
+
+    // ヒステリシスのしきい値を設定する
+    // high以上は前景、low以下は背景、その間は前フレームの状態を維持する
+    void setThreshold( uchar low, uchar high )
+    {
+        thresholdLow = std::min( low, high );
+        thresholdHigh = std::max( low, high );
+    }
+
+    // ガイデッドフィルタのパラメーターを設定する
+    //   radius : 縮小後の画像でのボックスフィルタ半径
+    //   eps    : 正則化項(大きいほど滑らかになる)
+    //   scale  : 縮小率(2なら1/2の解像度で計算する)
+    void setGuidedFilter( int radius, float eps, int scale )
+    {
+        guidedRadius = std::max( 1, radius );
+        guidedEps = eps;
+        guidedScale = std::max( 1, scale );
+    }
+
+    // 全解像度の処理を分割するタイル数を設定する(1ならシングルスレッド)
+    void setTileCount( int count )
+    {
+        tileCount = std::max( 1, count );
+    }
+
+    // 履歴を破棄する
+    void reset()
+    {
+        history.clear();
+        historyIndex = 0;
+        binaryMask.release();
+    }
+
+    // マスクを安定化する
+    //   color  : ガイドにするカラー画像(CV_8UC3 または CV_8UC4)
+    //   alpha  : セグメンテーションのα値(CV_8UC1)
+    //   result : 安定化したα値(CV_8UC1)
+    void process( const cv::Mat& color, const cv::Mat& alpha, cv::Mat& result )
+    {
+        CV_Assert( alpha.type() == CV_8UC1 );
+        CV_Assert( (color.type() == CV_8UC3) || (color.type() == CV_8UC4) );
+        CV_Assert( color.size() == alpha.size() );
+
+        int64 start = cv::getTickCount();
+
+        // 解像度が変わったら履歴を作り直す
+        if ( binaryMask.size() != alpha.size() ){
+            reset();
+            binaryMask = cv::Mat::zeros( alpha.size(), CV_8UC1 );
+        }
+
+        // 履歴に追加する(リングバッファ)
+        if ( (int)history.size() < historySize ){
+            history.push_back( alpha.clone() );
+        }
+        else {
+            alpha.copyTo( history[historyIndex] );
+        }
+        historyIndex = (historyIndex + 1) % historySize;
+
+        // メディアンとヒステリシスしきい値を求める
+        cv::parallel_for_( cv::Range( 0, tileCount ),
+            TemporalBody( *this, alpha.rows ) );
+
+        // ガイデッドフィルタでエッジをカラー画像に合わせる
+        guidedFilter( color, binaryMask, result );
+
+        lastMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    }
+
+    // 直前のprocess()にかかった時間[ms]
+    double lastProcessMs() const
+    {
+        return lastMs;
+    }
+
+private:
+
+    // 時間方向メディアン+ヒステリシスをタイル単位で行う
+    class TemporalBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        TemporalBody( MaskStabilizer& owner, int rows )
+            : owner( owner )
+            , rows( rows )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            int tiles = owner.tileCount;
+            int begin = rows * range.start / tiles;
+            int end = rows * range.end / tiles;
+            for ( int y = begin; y < end; ++y ){
+                owner.temporalRow( y );
+            }
+        }
+
+    private:
+
+        MaskStabilizer& owner;
+        int rows;
+    };
+
+    // ガイデッドフィルタの全解像度部分(q = a * I + b)をタイル単位で行う
+    class ComposeBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        ComposeBody( const MaskStabilizer& owner, const cv::Mat& guide,
+            const cv::Mat& a, const cv::Mat& b, cv::Mat& result )
+            : owner( owner ), guide( guide ), a( a ), b( b ), result( result )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            int tiles = owner.tileCount;
+            int begin = guide.rows * range.start / tiles;
+            int end = guide.rows * range.end / tiles;
+            for ( int y = begin; y < end; ++y ){
+                const float* i = guide.ptr<float>( y );
+                const float* pa = a.ptr<float>( y );
+                const float* pb = b.ptr<float>( y );
+                uchar* dst = result.ptr<uchar>( y );
+                for ( int x = 0; x < guide.cols; ++x ){
+                    float q = (pa[x] * i[x] + pb[x]) * 255.0f;
+                    dst[x] = cv::saturate_cast<uchar>( q );
+                }
+            }
+        }
+
+    private:
+
+        const MaskStabilizer& owner;
+        const cv::Mat& guide;
+        const cv::Mat& a;
+        const cv::Mat& b;
+        cv::Mat& result;
+    };
+
+    // 1行分のメディアンとヒステリシスしきい値を求める
+    void temporalRow( int y )
+    {
+        int count = (int)history.size();
+        int cols = binaryMask.cols;
+
+        const uchar* src[MAX_HISTORY];
+        for ( int i = 0; i < count; ++i ){
+            src[i] = history[i].ptr<uchar>( y );
+        }
+
+        uchar* dst = binaryMask.ptr<uchar>( y );
+
+        // 履歴が偶数枚のとき(起動直後)は中央の2つのうち大きいほうを使う
+        int mid = count / 2;
+
+        int x = 0;
+        __m128i low = _mm_set1_epi8( (char)thresholdLow );
+        __m128i high = _mm_set1_epi8( (char)thresholdHigh );
+        for ( ; x + 16 <= cols; x += 16 ){
+            __m128i v[MAX_HISTORY];
+            for ( int i = 0; i < count; ++i ){
+                v[i] = _mm_loadu_si128( (const __m128i*)(src[i] + x) );
+            }
+
+            // 奇偶転置ソートで16画素分を同時に並べ替える
+            for ( int pass = 0; pass < count; ++pass ){
+                for ( int i = pass & 1; i + 1 < count; i += 2 ){
+                    __m128i lo = _mm_min_epu8( v[i], v[i + 1] );
+                    v[i + 1] = _mm_max_epu8( v[i], v[i + 1] );
+                    v[i] = lo;
+                }
+            }
+            __m128i median = v[mid];
+
+            // median >= high なら前景、median <= low なら背景
+            __m128i isHigh = _mm_cmpeq_epi8( _mm_max_epu8( median, high ), median );
+            __m128i isLow = _mm_cmpeq_epi8( _mm_min_epu8( median, low ), median );
+            __m128i prev = _mm_loadu_si128( (const __m128i*)(dst + x) );
+            __m128i out = _mm_or_si128( isHigh, _mm_andnot_si128( isLow, prev ) );
+            _mm_storeu_si128( (__m128i*)(dst + x), out );
+        }
+
+        // 端数の画素
+        for ( ; x < cols; ++x ){
+            uchar v[MAX_HISTORY];
+            for ( int i = 0; i < count; ++i ){
+                v[i] = src[i][x];
+            }
+            std::nth_element( v, v + mid, v + count );
+            uchar median = v[mid];
+
+            if ( median >= thresholdHigh ){
+                dst[x] = 255;
+            }
+            else if ( median <= thresholdLow ){
+                dst[x] = 0;
+            }
+        }
+    }
+
+    // 縮小グリッド上でガイデッドフィルタをかける(Fast Guided Filter)
+    void guidedFilter( const cv::Mat& color, const cv::Mat& mask, cv::Mat& result )
+    {
+        // ガイド画像は輝度を使う
+        cv::cvtColor( color, gray, (color.channels() == 4) ? CV_BGRA2GRAY : CV_BGR2GRAY );
+        gray.convertTo( guide, CV_32F, 1.0 / 255.0 );
+
+        // 縮小する
+        cv::Size small( std::max( 1, color.cols / guidedScale ),
+                        std::max( 1, color.rows / guidedScale ) );
+        cv::resize( guide, smallI, small, 0, 0, cv::INTER_AREA );
+        cv::resize( mask, smallMask, small, 0, 0, cv::INTER_AREA );
+        smallMask.convertTo( smallP, CV_32F, 1.0 / 255.0 );
+
+        // 局所平均と分散から線形係数a,bを求める
+        cv::Size window( guidedRadius * 2 + 1, guidedRadius * 2 + 1 );
+        cv::boxFilter( smallI, meanI, CV_32F, window );
+        cv::boxFilter( smallP, meanP, CV_32F, window );
+        cv::boxFilter( smallI.mul( smallI ), corrII, CV_32F, window );
+        cv::boxFilter( smallI.mul( smallP ), corrIP, CV_32F, window );
+
+        cv::Mat varI = corrII - meanI.mul( meanI );
+        cv::Mat covIP = corrIP - meanI.mul( meanP );
+
+        cv::divide( covIP, varI + guidedEps, coefA );
+        coefB = meanP - coefA.mul( meanI );
+
+        cv::boxFilter( coefA, meanA, CV_32F, window );
+        cv::boxFilter( coefB, meanB, CV_32F, window );
+
+        // 係数を元の解像度に戻してマスクを計算する
+        cv::resize( meanA, fullA, color.size(), 0, 0, cv::INTER_LINEAR );
+        cv::resize( meanB, fullB, color.size(), 0, 0, cv::INTER_LINEAR );
+
+        result.create( color.size(), CV_8UC1 );
+        cv::parallel_for_( cv::Range( 0, tileCount ),
+            ComposeBody( *this, guide, fullA, fullB, result ) );
+    }
+
+private:
+
+    // マスクの履歴
+    std::vector<cv::Mat> history;
+    int historySize = 5;
+    int historyIndex = 0;
+
+    // ヒステリシスしきい値の結果(0 or 255)
+    cv::Mat binaryMask;
+    uchar thresholdLow = 64;
+    uchar thresholdHigh = 192;
+
+    // ガイデッドフィルタのパラメーター
+    int guidedRadius = 4;
+    float guidedEps = 1e-3f;
+    int guidedScale = 4;
+
+    // 作業用バッファ(毎フレーム確保しないように保持しておく)
+    cv::Mat gray, guide;
+    cv::Mat smallI, smallMask, smallP;
+    cv::Mat meanI, meanP, corrII, corrIP;
+    cv::Mat coefA, coefB, meanA, meanB;
+    cv::Mat fullA, fullB;
+
+    int tileCount = 1;
+    double lastMs = 0;
+};
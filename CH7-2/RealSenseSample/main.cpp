@@ -2,11 +2,12 @@
 #include "pxcsensemanager.h"
 #include "PXCTracker.h"
 
-#define _USE_MATH_DEFINES
-#include <math.h>
-
 #include <opencv2\opencv.hpp>
 
+#include "pose_math.h"
+#include "target_cache.h"
+#include "planar_tracker.h"
+
 class RealSenseApp
 {
 public:
@@ -82,11 +83,29 @@ private:
             throw std::runtime_error( "IuWFNggbJ[̎擾Ɏs܂" );
         }
 
-        // ǐՂ摜ݒ
-        auto sts = tracker->Set2DTrackFromFile( L"targetEarth.jpg", targetId );
+        // ǐՂ摜ݒ(2ڈȍ~̓fR[hς݂̃LbVg)
+        auto start = cv::getTickCount();
+
+        TargetCache target( L"targetEarth.jpg" );
+        target.load();
+
+        // PXCTrackergȂgbJ[ɂ摜o^
+        cv::Mat targetImage( target.height(), target.width(), CV_8UC4,
+            (void*)target.pixels(), target.pitch() );
+        planarTracker.setCamera( COLOR_WIDTH, COLOR_HEIGHT );
+        planarTracker.addTarget( targetImage, TARGET_WIDTH_MM );
+
+        auto image = target.createImage( senseManager->QuerySession() );
+        auto sts = tracker->Set2DTrackFromImage( image, targetId );
+        image->Release();
         if ( sts < PXC_STATUS_NO_ERROR ) {
             throw std::runtime_error( "ǐՂ摜̐ݒɎs܂" );
         }
+
+        // ǂݍ݂ɂԂ\
+        double ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+        std::cout << "targetEarth.jpg : " << ms << " ms"
+                  << (target.isWarm() ? " (cache)" : " (decode)") << std::endl;
     }
 
     void updateFrame()
@@ -115,6 +134,14 @@ private:
     // IuWFNggbLOXV
     void updateObjectTracking()
     {
+        trackedPoses.clear();
+
+        // PXCTrackergȂgbJ[ŒǐՂ
+        if ( useNativeTracker ) {
+            updateNativeTracking();
+            return;
+        }
+
         // ǐՂĂIuWFNg\
         PXCTracker::TrackingValues trackData;
         auto sts = tracker->QueryTrackingValues( targetId, trackData );
@@ -124,135 +151,72 @@ private:
 
         // IuWFNgǐՂĂΕ\
         if ( PXCTracker::IsTracking( trackData.state ) ) {
-            showTrackingValue( &trackData );
+            addTrackedPose( trackData );
         }
+
+        // ǐՂĂIuWFNg\
+        showTrackingValues();
     }
-    
-    void showTrackingValue( PXCTracker::TrackingValues* arrData )
+
+    // PXCTrackergȂgbJ[ŒǐՂ
+    void updateNativeTracking()
+    {
+        if ( colorImage.empty() ) {
+            return;
+        }
+
+        planarTracker.track( colorImage );
+        for ( const auto& result : planarTracker.getResults() ) {
+            if ( result.isTracking ) {
+                trackedPoses.push_back( result.pose );
+            }
+        }
+
+        // ǐՂĂIuWFNg\
+        showTrackingValues();
+
+        // Ԃ\
+        std::stringstream ss;
+        ss << "native : " << planarTracker.getTargetCount() << " targets, "
+           << planarTracker.lastTrackMs() << " ms";
+        cv::putText( colorImage, ss.str(), cv::Point( 10, 20 ),
+            cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar( 0, 0, 255 ) );
+    }
+
+    // ǐՂĂIuWFNg̈ʒuƌ\
+    void showTrackingValues()
+    {
+        // S^[Qbg̍W܂Ƃ߂ċ߂
+        projector.project( trackedPoses, axes );
+
+        for ( const auto& axis : axes ) {
+            cv::Point origin( axis.originX, axis.originY );
+
+            // S_\
+            cv::circle( colorImage, origin, 5, cv::Scalar( 255, 0, 0 ), -1 );
+
+            // eW̌\
+            const cv::Scalar colors[] = {
+                cv::Scalar( 0, 0, 255 ), cv::Scalar( 0, 255, 0 ), cv::Scalar( 255, 0, 0 ) };
+            for ( int k = 0; k < 3; ++k ) {
+                cv::line( colorImage, origin,
+                    cv::Point( axis.axisX[k], axis.axisY[k] ), colors[k] );
+            }
+        }
+    }
+
+    // ǐՂĂIuWFNg̎pǉ
+    void addTrackedPose( const PXCTracker::TrackingValues& trackData )
     {
-        // for the middleware being a left hand coordinate system.
-        float depthnum = 630;
-
-        //correction values for translation and movement dependent on z values
-        float depthcorrectionfactor = (arrData->translation.z / depthnum);
-        arrData->translation.x = arrData->translation.x / depthcorrectionfactor;
-        arrData->translation.y = arrData->translation.y / depthcorrectionfactor;
-
-        // IuWFNg̃JW(ʂ̒S_)
-        auto translation = arrData->translation;
-
-        arrData->translation.y = -arrData->translation.y;
-        arrData->translation.x += COLOR_WIDTH / 2;
-        arrData->translation.y += COLOR_HEIGHT / 2;
-
-        // S_\
-        cv::circle( colorImage,
-            cv::Point( arrData->translation.x, arrData->translation.y ),
-            5, cv::Scalar( 255, 0, 0 ), -1 );
-
-
-        //3x1 points for scaling
-        PXCPoint3DF32 trans1;
-        PXCPoint3DF32 trans2;
-        PXCPoint3DF32 trans3;
-
-        //changes the size of the arrows
-        int scalefactor = 150000; //150000
-        float height = scalefactor / translation.z;
-        float width = scalefactor / translation.z;
-        float depth = scalefactor / translation.z;
-
-        //creates the point vectors
-        trans1.x = width;   trans2.x = 0;       trans3.x = 0;
-        trans1.y = 0;       trans2.y = height;  trans3.y = 0;
-        trans1.z = 0;       trans2.z = 0;       trans3.z = depth;
-
-        PXCPoint4DF32 rot = arrData->rotation;
-
-        //put into 3x1 vector point for matrix multiplication purposes
-        PXCPoint3DF32 q;
-        q.x = rot.x;
-        q.y = rot.y;
-        q.z = rot.z;
-        float s = rot.w;
-
-        // 摜̌opx()߂
-        double heading;
-        double attitude;
-        double bank;
-
-        float sqw = s*s;
-        float sqx = q.x*q.x;
-        float sqy = q.y*q.y;
-        float sqz = q.z*q.z;
-        float unit = sqx + sqy + sqz + sqw;
-        float check = q.x*q.y + q.z*s;
-        float rad2deg = 180 / M_PI;
-
-        heading = atan2( 2 * q.y*s - 2 * q.x*q.z, sqx - sqy - sqz + sqw ) * rad2deg;
-        attitude = asin( 2.0*check / unit ) * rad2deg;
-        bank = atan2( 2 * q.x*s - 2 * q.y*q.z, -sqx + sqy - sqz + sqw ) * rad2deg;
-
-
-        // ̕ɐL΂_(̐̏I_)vZ
-        PXCPoint3DF32 prime1; PXCPoint3DF32 prime2; PXCPoint3DF32 prime3;
-        float rotmat[3][3];
-
-        // rotation matrix using quaternion values
-        rotmat[0][0] = (1 - (2 * (q.y*q.y)) - (2 * (q.z*q.z)));
-        rotmat[0][1] = ((2 * q.x*q.y) - (2 * s*q.z));
-        rotmat[0][2] = ((2 * q.x*q.z) + (2 * s*q.y));
-        rotmat[1][0] = ((2 * q.x*q.y) + (2 * s*q.z));
-        rotmat[1][1] = (1 - (2 * q.x*q.x) - (2 * q.z*q.z));
-        rotmat[1][2] = ((2 * q.y*q.z) - (2 * s*q.x));
-        rotmat[2][0] = ((2 * q.x*q.z) - (2 * s*q.y));
-        rotmat[2][1] = ((2 * q.y*q.z) + (2 * s*q.x));
-        rotmat[2][2] = (1 - (2 * q.x*q.x) - (2 * q.y*q.y));
-
-        //rotation for x point	
-        prime1.x = (rotmat[0][0] * trans1.x) +
-                   (rotmat[0][1] * trans1.y) +
-                   (rotmat[0][2] * trans1.z);
-        prime1.y = (rotmat[1][0] * trans1.x) +
-                   (rotmat[1][1] * trans1.y) +
-                   (rotmat[1][2] * trans1.z);
-        prime1.z = (rotmat[2][0] * trans1.x) +
-                   (rotmat[1][2] * trans1.y) +
-                   (rotmat[2][2] * trans1.z);
-
-        //rotation for y point
-        prime2.x = (rotmat[0][0] * trans2.x) +
-                   (rotmat[0][1] * trans2.y) +
-                   (rotmat[0][2] * trans2.z);
-        prime2.y = (rotmat[1][0] * trans2.x) +
-                   (rotmat[1][1] * trans2.y) +
-                   (rotmat[1][2] * trans2.z);
-        prime2.z = (rotmat[2][0] * trans2.x) +
-                   (rotmat[1][2] * trans2.y) +
-                   (rotmat[2][2] * trans2.z);
-
-        //rotation for z point
-        prime3.x = (rotmat[0][0] * trans3.x) +
-                   (rotmat[0][1] * trans3.y) +
-                   (rotmat[0][2] * trans3.z);
-        prime3.y = (rotmat[1][0] * trans3.x) +
-                   (rotmat[1][1] * trans3.y) +
-                   (rotmat[1][2] * trans3.z);
-        prime3.z = (rotmat[2][0] * trans3.x) +
-                   (rotmat[1][2] * trans3.y) +
-                   (rotmat[2][2] * trans3.z);
-
-        // eW̌\
-        translation = arrData->translation;
-        cv::line( colorImage, cv::Point( translation.x, translation.y ),
-            cv::Point( translation.x + prime1.x, translation.y - prime1.y ),
-            cv::Scalar( 0, 0, 255 ) );
-        cv::line( colorImage, cv::Point( translation.x, translation.y ),
-            cv::Point( translation.x + prime2.x, translation.y - prime2.y ),
-            cv::Scalar( 0, 255, 0 ) );
-        cv::line( colorImage, cv::Point( translation.x, translation.y ),
-            cv::Point( translation.x + prime3.x, translation.y - prime3.y ),
-            cv::Scalar( 255, 0, 0 ) );
+        TrackingPose pose;
+        pose.translation.x = trackData.translation.x;
+        pose.translation.y = trackData.translation.y;
+        pose.translation.z = trackData.translation.z;
+        pose.rotation.x = trackData.rotation.x;
+        pose.rotation.y = trackData.rotation.y;
+        pose.rotation.z = trackData.rotation.z;
+        pose.rotation.w = trackData.rotation.w;
+        trackedPoses.push_back( pose );
     }
 
     // J[摜XV
@@ -295,6 +259,10 @@ private:
             // ESC|q|Q for Exit
             return false;
         }
+        // n|N PXCTrackerPXCTrackergȂgbJ[؂ւ
+        else if ( (c == 'n') || (c == 'N') ){
+            useNativeTracker = !useNativeTracker;
+        }
 
         return true;
     }
@@ -314,6 +282,18 @@ private:
     //const int COLOR_WIDTH = 1920;
     //const int COLOR_HEIGHT = 1080;
     //const int COLOR_FPS = 30;
+
+    // PXCTrackergȂgbJ[
+    PlanarTracker planarTracker;
+    bool useNativeTracker = false;
+
+    // ǐՂ摜̎ۂ̕[mm]
+    const float TARGET_WIDTH_MM = 200;
+
+    // ǐՂĂIuWFNg̎pƉʏ̍W
+    std::vector<TrackingPose> trackedPoses;
+    std::vector<AxisProjection> axes;
+    AxisProjector projector = AxisProjector( COLOR_WIDTH, COLOR_HEIGHT, 150000 );
 };
 
 void main()
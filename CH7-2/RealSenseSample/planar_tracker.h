@@ -0,0 +1,257 @@
+﻿// 平面画像のオブジェクトトラッカー(PXCTrackerを使わない実装)
+//
+// フレームごとにORB特徴点を1回だけ抽出し、ターゲットごとの
+//   特徴量マッチング -> RANSACによるホモグラフィ推定 -> PnPで姿勢推定
+// をターゲット単位で並列に行う。
+// 結果はPXCTracker::TrackingValuesと同じく、カメラ座標系(左手系、y上向き)の
+// 並進[mm]と回転(クォータニオン)で返す。
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "pose_math.h"
+
+class PlanarTracker
+{
+public:
+
+    // 追跡結果
+    struct Result
+    {
+        bool isTracking;
+        TrackingPose pose;
+        int inliers;
+    };
+
+    PlanarTracker()
+        : orb( MAX_FEATURES )
+    {
+    }
+
+    // カメラのパラメーターを設定する
+    //   width, height : カメラ画像のサイズ
+    //   focalLength   : 焦点距離[pixel]
+    void setCamera( int width, int height, float focalLength = 630 )
+    {
+        cameraMatrix = (cv::Mat_<double>( 3, 3 ) <<
+            focalLength, 0, width / 2.0,
+            0, focalLength, height / 2.0,
+            0, 0, 1);
+    }
+
+    // 追跡する画像を登録して、ターゲットのIDを返す
+    //   image   : ターゲット画像(BGR または BGRA)
+    //   widthMM : ターゲットの実際の幅[mm]
+    int addTarget( const cv::Mat& image, float widthMM )
+    {
+        Target target;
+
+        cv::Mat gray;
+        toGray( image, gray );
+        orb( gray, cv::noArray(), target.keypoints, target.descriptors );
+
+        // 特徴点の画像座標を、ターゲットの中心を原点とした平面上の座標[mm]にする
+        float scale = widthMM / image.cols;
+        for ( const auto& kp : target.keypoints ){
+            target.points.push_back( cv::Point3f(
+                (kp.pt.x - image.cols / 2.0f) * scale,
+                (kp.pt.y - image.rows / 2.0f) * scale,
+                0 ) );
+        }
+
+        targets.push_back( target );
+        results.resize( targets.size() );
+        return (int)targets.size() - 1;
+    }
+
+    // カメラ画像から全ターゲットを追跡する
+    void track( const cv::Mat& frame )
+    {
+        int64 start = cv::getTickCount();
+
+        // 特徴点の抽出はフレームにつき1回だけ行う
+        toGray( frame, frameGray );
+        frameKeypoints.clear();
+        orb( frameGray, cv::noArray(), frameKeypoints, frameDescriptors );
+
+        // ターゲットごとに並列に追跡する
+        cv::parallel_for_( cv::Range( 0, (int)targets.size() ), TrackBody( *this ) );
+
+        lastMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    }
+
+    const std::vector<Result>& getResults() const
+    {
+        return results;
+    }
+
+    int getTargetCount() const
+    {
+        return (int)targets.size();
+    }
+
+    // 直前のtrack()にかかった時間[ms]
+    double lastTrackMs() const
+    {
+        return lastMs;
+    }
+
+private:
+
+    enum { MAX_FEATURES = 500 };
+
+    // マッチングの条件
+    enum { MIN_MATCHES = 15, MIN_INLIERS = 10 };
+
+    struct Target
+    {
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat descriptors;
+        std::vector<cv::Point3f> points;
+    };
+
+    class TrackBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        TrackBody( PlanarTracker& owner )
+            : owner( owner )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            for ( int i = range.start; i < range.end; ++i ){
+                owner.trackTarget( owner.targets[i], owner.results[i] );
+            }
+        }
+
+    private:
+
+        PlanarTracker& owner;
+    };
+
+    static void toGray( const cv::Mat& src, cv::Mat& dst )
+    {
+        if ( src.channels() == 4 ){
+            cv::cvtColor( src, dst, CV_BGRA2GRAY );
+        }
+        else if ( src.channels() == 3 ){
+            cv::cvtColor( src, dst, CV_BGR2GRAY );
+        }
+        else {
+            dst = src;
+        }
+    }
+
+    // 1つのターゲットを追跡する
+    void trackTarget( const Target& target, Result& result ) const
+    {
+        result.isTracking = false;
+        result.inliers = 0;
+
+        if ( target.descriptors.empty() || frameDescriptors.empty() ){
+            return;
+        }
+
+        // 特徴量をマッチングして、比率テストで曖昧な対応を捨てる
+        cv::BFMatcher matcher( cv::NORM_HAMMING );
+        std::vector<std::vector<cv::DMatch>> knn;
+        matcher.knnMatch( target.descriptors, frameDescriptors, knn, 2 );
+
+        std::vector<cv::Point2f> targetPoints;
+        std::vector<cv::Point2f> imagePoints;
+        std::vector<cv::Point3f> objectPoints;
+        std::vector<int> frameIndices;
+        for ( const auto& m : knn ){
+            if ( (m.size() == 2) && (m[0].distance < 0.8f * m[1].distance) ){
+                targetPoints.push_back( target.keypoints[m[0].queryIdx].pt );
+                imagePoints.push_back( frameKeypoints[m[0].trainIdx].pt );
+                objectPoints.push_back( target.points[m[0].queryIdx] );
+                frameIndices.push_back( m[0].trainIdx );
+            }
+        }
+
+        if ( (int)imagePoints.size() < MIN_MATCHES ){
+            return;
+        }
+
+        // ホモグラフィをRANSACで求めて、外れ値を取り除く
+        std::vector<uchar> mask;
+        cv::Mat homography = cv::findHomography( targetPoints, imagePoints, CV_RANSAC, 3.0, mask );
+        if ( homography.empty() ){
+            return;
+        }
+
+        // 複数のターゲット特徴点がフレームの同じ特徴点に対応することがあるので、
+        // フレーム側の特徴点ごとに最初の対応だけを残す(同じ点ばかりだとsolvePnPが例外を投げる)
+        std::vector<cv::Point2f> inlierImage;
+        std::vector<cv::Point3f> inlierObject;
+        std::vector<bool> used( frameKeypoints.size(), false );
+        for ( size_t i = 0; i < mask.size(); ++i ){
+            if ( mask[i] && !used[frameIndices[i]] ){
+                used[frameIndices[i]] = true;
+                inlierImage.push_back( imagePoints[i] );
+                inlierObject.push_back( objectPoints[i] );
+            }
+        }
+
+        if ( (int)inlierImage.size() < MIN_INLIERS ){
+            return;
+        }
+
+        // 姿勢を求める
+        // 前回の姿勢を初期値にすると、ターゲットが大きく動いたときに収束しないので、
+        // 毎フレーム平面の初期推定から求める
+        cv::Mat rvec, tvec;
+        bool ok = cv::solvePnP( inlierObject, inlierImage, cameraMatrix, cv::noArray(),
+            rvec, tvec, false, CV_ITERATIVE );
+        if ( !ok || (tvec.at<double>( 2 ) <= 0) ){
+            return;
+        }
+
+        result.isTracking = true;
+        result.inliers = (int)inlierImage.size();
+        result.pose = toTrackingPose( rvec, tvec );
+    }
+
+    // OpenCVの座標系(y下向き)からトラッカーの座標系(y上向き)に変換する
+    static TrackingPose toTrackingPose( const cv::Mat& rvec, const cv::Mat& tvec )
+    {
+        cv::Mat rotation;
+        cv::Rodrigues( rvec, rotation );
+
+        // y軸を反転する(S * R * S, S = diag(1, -1, 1))
+        Matrix3x3 r;
+        for ( int i = 0; i < 3; ++i ){
+            for ( int j = 0; j < 3; ++j ){
+                float sign = ((i == 1) != (j == 1)) ? -1.0f : 1.0f;
+                r.m[i][j] = sign * (float)rotation.at<double>( i, j );
+            }
+        }
+
+        TrackingPose pose;
+        pose.translation.x = (float)tvec.at<double>( 0 );
+        pose.translation.y = -(float)tvec.at<double>( 1 );
+        pose.translation.z = (float)tvec.at<double>( 2 );
+        pose.rotation = r.toQuaternion();
+        return pose;
+    }
+
+private:
+
+    cv::ORB orb;
+    cv::Mat cameraMatrix;
+
+    std::vector<Target> targets;
+    std::vector<Result> results;
+
+    // フレームの特徴点
+    cv::Mat frameGray;
+    std::vector<cv::KeyPoint> frameKeypoints;
+    cv::Mat frameDescriptors;
+
+    double lastMs = 0;
+};
@@ -0,0 +1,248 @@
+﻿// トラッキング結果の姿勢計算
+//
+// PXCTracker::TrackingValues の回転(クォータニオン)と並進から、
+// 画像上に表示する座標軸(原点とX,Y,Z軸の終点)を求める。
+// 複数のターゲットはSSEで4つずつまとめて計算する。
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include <xmmintrin.h>
+
+// 3次元ベクトル
+struct Vector3
+{
+    float x, y, z;
+};
+
+// クォータニオン(wが実部)
+struct Quaternion
+{
+    float x, y, z, w;
+};
+
+// 3x3行列(m[行][列])
+struct Matrix3x3
+{
+    float m[3][3];
+
+    // クォータニオンから回転行列を作る
+    static Matrix3x3 fromQuaternion( const Quaternion& q )
+    {
+        float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+        float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+        float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+        Matrix3x3 r = { {
+            { 1 - 2 * (yy + zz), 2 * (xy - wz), 2 * (xz + wy) },
+            { 2 * (xy + wz), 1 - 2 * (xx + zz), 2 * (yz - wx) },
+            { 2 * (xz - wy), 2 * (yz + wx), 1 - 2 * (xx + yy) },
+        } };
+        return r;
+    }
+
+    // 回転行列からクォータニオンを求める
+    Quaternion toQuaternion() const
+    {
+        Quaternion q;
+        float trace = m[0][0] + m[1][1] + m[2][2];
+        if ( trace > 0 ){
+            float s = sqrtf( trace + 1.0f ) * 2;
+            q.w = 0.25f * s;
+            q.x = (m[2][1] - m[1][2]) / s;
+            q.y = (m[0][2] - m[2][0]) / s;
+            q.z = (m[1][0] - m[0][1]) / s;
+        }
+        else if ( (m[0][0] > m[1][1]) && (m[0][0] > m[2][2]) ){
+            float s = sqrtf( 1.0f + m[0][0] - m[1][1] - m[2][2] ) * 2;
+            q.w = (m[2][1] - m[1][2]) / s;
+            q.x = 0.25f * s;
+            q.y = (m[0][1] + m[1][0]) / s;
+            q.z = (m[0][2] + m[2][0]) / s;
+        }
+        else if ( m[1][1] > m[2][2] ){
+            float s = sqrtf( 1.0f + m[1][1] - m[0][0] - m[2][2] ) * 2;
+            q.w = (m[0][2] - m[2][0]) / s;
+            q.x = (m[0][1] + m[1][0]) / s;
+            q.y = 0.25f * s;
+            q.z = (m[1][2] + m[2][1]) / s;
+        }
+        else {
+            float s = sqrtf( 1.0f + m[2][2] - m[0][0] - m[1][1] ) * 2;
+            q.w = (m[1][0] - m[0][1]) / s;
+            q.x = (m[0][2] + m[2][0]) / s;
+            q.y = (m[1][2] + m[2][1]) / s;
+            q.z = 0.25f * s;
+        }
+        return q;
+    }
+
+    // ベクトルを変換する
+    Vector3 operator*( const Vector3& v ) const
+    {
+        Vector3 r = {
+            m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+            m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+            m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z,
+        };
+        return r;
+    }
+
+    // 行列を掛ける
+    Matrix3x3 operator*( const Matrix3x3& b ) const
+    {
+        Matrix3x3 r;
+        for ( int i = 0; i < 3; ++i ){
+            for ( int j = 0; j < 3; ++j ){
+                r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j];
+            }
+        }
+        return r;
+    }
+};
+
+// ターゲットの姿勢(カメラ座標系、単位はmm)
+struct TrackingPose
+{
+    Vector3 translation;
+    Quaternion rotation;
+};
+
+// 画像上の座標軸(原点と各軸の終点)
+struct AxisProjection
+{
+    float originX, originY;
+    float axisX[3];     // X,Y,Z軸の終点のx座標
+    float axisY[3];     // X,Y,Z軸の終点のy座標
+};
+
+// 姿勢を画像上の座標軸に変換する
+class AxisProjector
+{
+public:
+
+    // width, height : 画像サイズ
+    // axisScale     : 軸の長さの係数(距離で割った値が画素数になる)
+    // focalLength   : 並進を画素に変換する係数
+    AxisProjector( int width, int height, float axisScale, float focalLength = 630 )
+        : centerX( width / 2.0f )
+        , centerY( height / 2.0f )
+        , axisScale( axisScale )
+        , focalLength( focalLength )
+    {
+    }
+
+    // 1つのターゲットの座標軸を求める
+    AxisProjection project( const TrackingPose& pose ) const
+    {
+        AxisProjection out;
+        project( &pose, 1, &out );
+        return out;
+    }
+
+    // 複数のターゲットの座標軸をまとめて求める
+    void project( const TrackingPose* poses, int count, AxisProjection* out ) const
+    {
+        int i = 0;
+
+        // 4ターゲットずつSSEで計算する
+        for ( ; i + 4 <= count; i += 4 ){
+            projectSSE( poses + i, out + i );
+        }
+
+        // 残り
+        for ( ; i < count; ++i ){
+            projectScalar( poses[i], out[i] );
+        }
+    }
+
+    void project( const std::vector<TrackingPose>& poses, std::vector<AxisProjection>& out ) const
+    {
+        out.resize( poses.size() );
+        if ( !poses.empty() ){
+            project( &poses[0], (int)poses.size(), &out[0] );
+        }
+    }
+
+private:
+
+    void projectScalar( const TrackingPose& pose, AxisProjection& out ) const
+    {
+        const Vector3& t = pose.translation;
+
+        // 距離に応じて並進を補正して、画面の中心を原点にする
+        float inv = 1.0f / t.z;
+        out.originX = t.x * focalLength * inv + centerX;
+        out.originY = -t.y * focalLength * inv + centerY;
+
+        // 各軸の終点は回転行列の列ベクトルを伸ばしたもの(画像のyは下向き)
+        Matrix3x3 r = Matrix3x3::fromQuaternion( pose.rotation );
+        float length = axisScale * inv;
+        for ( int k = 0; k < 3; ++k ){
+            out.axisX[k] = out.originX + length * r.m[0][k];
+            out.axisY[k] = out.originY - length * r.m[1][k];
+        }
+    }
+
+    void projectSSE( const TrackingPose* p, AxisProjection* out ) const
+    {
+        // 4ターゲット分を要素ごとに並べ替える(AoS -> SoA)
+        __m128 tx = _mm_setr_ps( p[0].translation.x, p[1].translation.x, p[2].translation.x, p[3].translation.x );
+        __m128 ty = _mm_setr_ps( p[0].translation.y, p[1].translation.y, p[2].translation.y, p[3].translation.y );
+        __m128 tz = _mm_setr_ps( p[0].translation.z, p[1].translation.z, p[2].translation.z, p[3].translation.z );
+        __m128 qx = _mm_setr_ps( p[0].rotation.x, p[1].rotation.x, p[2].rotation.x, p[3].rotation.x );
+        __m128 qy = _mm_setr_ps( p[0].rotation.y, p[1].rotation.y, p[2].rotation.y, p[3].rotation.y );
+        __m128 qz = _mm_setr_ps( p[0].rotation.z, p[1].rotation.z, p[2].rotation.z, p[3].rotation.z );
+        __m128 qw = _mm_setr_ps( p[0].rotation.w, p[1].rotation.w, p[2].rotation.w, p[3].rotation.w );
+
+        __m128 one = _mm_set1_ps( 1.0f );
+        __m128 two = _mm_set1_ps( 2.0f );
+        __m128 inv = _mm_div_ps( one, tz );
+
+        // 原点
+        __m128 ox = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( tx, _mm_set1_ps( focalLength ) ), inv ),
+                                _mm_set1_ps( centerX ) );
+        __m128 oy = _mm_sub_ps( _mm_set1_ps( centerY ),
+                                _mm_mul_ps( _mm_mul_ps( ty, _mm_set1_ps( focalLength ) ), inv ) );
+
+        // 回転行列の上2行(画像に投影するのはx,y成分だけ)
+        __m128 xx = _mm_mul_ps( qx, qx ), yy = _mm_mul_ps( qy, qy ), zz = _mm_mul_ps( qz, qz );
+        __m128 xy = _mm_mul_ps( qx, qy ), xz = _mm_mul_ps( qx, qz ), yz = _mm_mul_ps( qy, qz );
+        __m128 wx = _mm_mul_ps( qw, qx ), wy = _mm_mul_ps( qw, qy ), wz = _mm_mul_ps( qw, qz );
+
+        __m128 r[2][3];
+        r[0][0] = _mm_sub_ps( one, _mm_mul_ps( two, _mm_add_ps( yy, zz ) ) );
+        r[0][1] = _mm_mul_ps( two, _mm_sub_ps( xy, wz ) );
+        r[0][2] = _mm_mul_ps( two, _mm_add_ps( xz, wy ) );
+        r[1][0] = _mm_mul_ps( two, _mm_add_ps( xy, wz ) );
+        r[1][1] = _mm_sub_ps( one, _mm_mul_ps( two, _mm_add_ps( xx, zz ) ) );
+        r[1][2] = _mm_mul_ps( two, _mm_sub_ps( yz, wx ) );
+
+        __m128 length = _mm_mul_ps( _mm_set1_ps( axisScale ), inv );
+
+        float result[2 + 6][4];
+        _mm_storeu_ps( result[0], ox );
+        _mm_storeu_ps( result[1], oy );
+        for ( int k = 0; k < 3; ++k ){
+            _mm_storeu_ps( result[2 + k], _mm_add_ps( ox, _mm_mul_ps( length, r[0][k] ) ) );
+            _mm_storeu_ps( result[5 + k], _mm_sub_ps( oy, _mm_mul_ps( length, r[1][k] ) ) );
+        }
+
+        // SoA -> AoS
+        for ( int i = 0; i < 4; ++i ){
+            out[i].originX = result[0][i];
+            out[i].originY = result[1][i];
+            for ( int k = 0; k < 3; ++k ){
+                out[i].axisX[k] = result[2 + k][i];
+                out[i].axisY[k] = result[5 + k][i];
+            }
+        }
+    }
+
+private:
+
+    float centerX;
+    float centerY;
+    float axisScale;
+    float focalLength;
+};
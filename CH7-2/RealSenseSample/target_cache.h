@@ -0,0 +1,343 @@
+﻿// 追跡対象画像のキャッシュ
+//
+// 初回はJPEGなどの画像をデコードして、BGRA(PXCImageのRGB32と同じ並び)の
+// 画素データを元ファイルの隣に "<元ファイル名>.cache" として保存する。
+// 次回以降はキャッシュをメモリマップして、デコードせずにそのまま使う。
+// キャッシュには形式のバージョンと元ファイルのサイズ、更新日時、ハッシュを持たせる。
+// サイズと更新日時が同じなら元ファイルは読まない(ハッシュも計算しない)。
+// 更新日時だけが違うとき(コピーされたなど)はハッシュで内容を比べ、
+// 同じならキャッシュの更新日時を書き直し、違えば作り直す。
+// 同じサイズのまま更新日時の分解能以内に書き換えられた場合は検出できない。
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include "pxcsession.h"
+#include "pxcimage.h"
+
+#include <opencv2\opencv.hpp>
+
+// ファイルを読み込み専用でメモリマップする
+class MappedFile
+{
+public:
+
+    MappedFile()
+    {
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open( const std::wstring& path )
+    {
+        close();
+
+        file = CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+        if ( file == INVALID_HANDLE_VALUE ){
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if ( !GetFileSizeEx( file, &fileSize ) || (fileSize.QuadPart == 0) ){
+            close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+
+        mapping = CreateFileMappingW( file, 0, PAGE_READONLY, 0, 0, 0 );
+        if ( mapping == 0 ){
+            close();
+            return false;
+        }
+
+        data = (const unsigned char*)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        if ( data == 0 ){
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if ( data != 0 ){
+            UnmapViewOfFile( data );
+            data = 0;
+        }
+
+        if ( mapping != 0 ){
+            CloseHandle( mapping );
+            mapping = 0;
+        }
+
+        if ( file != INVALID_HANDLE_VALUE ){
+            CloseHandle( file );
+            file = INVALID_HANDLE_VALUE;
+        }
+
+        size = 0;
+    }
+
+    const unsigned char* ptr() const { return data; }
+    size_t length() const { return size; }
+
+private:
+
+    MappedFile( const MappedFile& );
+    MappedFile& operator=( const MappedFile& );
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = 0;
+    const unsigned char* data = 0;
+    size_t size = 0;
+};
+
+class TargetCache
+{
+public:
+
+    // キャッシュ形式のバージョン(形式を変えたら上げる)
+    enum { VERSION = 2 };
+
+    // キャッシュファイルの先頭
+    struct Header
+    {
+        char magic[4];              // "RSTC"
+        unsigned int version;
+        unsigned long long sourceHash;
+        unsigned long long sourceSize;
+        unsigned long long sourceWriteTime;     // FILETIME
+        int width;
+        int height;
+        int pitch;
+        int reserved;
+    };
+
+    TargetCache( const std::wstring& sourcePath )
+        : sourcePath( sourcePath )
+        , cachePath( sourcePath + L".cache" )
+    {
+    }
+
+    // キャッシュを読み込む(なければ作る)
+    void load()
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if ( !GetFileAttributesExW( sourcePath.c_str(), GetFileExInfoStandard, &attributes ) ){
+            throw std::runtime_error( "追跡する画像が開けませんでした" );
+        }
+        sourceSize = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+        sourceWriteTime = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+                          attributes.ftLastWriteTime.dwLowDateTime;
+
+        // サイズと更新日時が同じなら、元ファイルを読まずにキャッシュを使う
+        warm = openCache( false );
+        if ( warm ){
+            return;
+        }
+
+        if ( !source.open( sourcePath ) ){
+            throw std::runtime_error( "追跡する画像が開けませんでした" );
+        }
+
+        sourceHash = hash( source.ptr(), source.length() );
+
+        // 内容が同じならキャッシュを使い、次回のために更新日時を書き直す
+        warm = openCache( true );
+        if ( warm ){
+            updateWriteTime();
+        }
+        else {
+            // キャッシュが書けない場合はデコードした画像をそのまま使う
+            if ( !build() || !openCache( false ) ){
+                cache.close();
+            }
+        }
+
+        source.close();
+    }
+
+    // キャッシュを使えたかどうか
+    bool isWarm() const { return warm; }
+
+    int width() const { return isCached() ? header().width : decoded.cols; }
+    int height() const { return isCached() ? header().height : decoded.rows; }
+    int pitch() const { return isCached() ? header().pitch : (int)decoded.step; }
+
+    // BGRAの画素データ
+    const unsigned char* pixels() const
+    {
+        return isCached() ? (cache.ptr() + sizeof(Header)) : decoded.data;
+    }
+
+    // PXCImage(RGB32)に画素データをコピーする
+    PXCImage* createImage( PXCSession* session ) const
+    {
+        PXCImage::ImageInfo info = {};
+        info.width = width();
+        info.height = height();
+        info.format = PXCImage::PixelFormat::PIXEL_FORMAT_RGB32;
+
+        auto image = session->CreateImage( &info );
+        if ( image == 0 ){
+            throw std::runtime_error( "追跡する画像の作成に失敗しました" );
+        }
+
+        PXCImage::ImageData data;
+        auto sts = image->AcquireAccess( PXCImage::Access::ACCESS_WRITE,
+            PXCImage::PixelFormat::PIXEL_FORMAT_RGB32, &data );
+        if ( sts < PXC_STATUS_NO_ERROR ) {
+            image->Release();
+            throw std::runtime_error( "追跡する画像の作成に失敗しました" );
+        }
+
+        int rowBytes = width() * 4;
+        for ( int y = 0; y < height(); ++y ){
+            memcpy( data.planes[0] + y * data.pitches[0], pixels() + y * pitch(), rowBytes );
+        }
+
+        image->ReleaseAccess( &data );
+        return image;
+    }
+
+private:
+
+    bool isCached() const
+    {
+        return cache.ptr() != 0;
+    }
+
+    const Header& header() const
+    {
+        return *(const Header*)cache.ptr();
+    }
+
+    // キャッシュを開いて、元ファイルと一致しているか確認する
+    // (checkHash : 更新日時が違うときにハッシュで比べる)
+    bool openCache( bool checkHash )
+    {
+        if ( !cache.open( cachePath ) ){
+            return false;
+        }
+
+        if ( cache.length() < sizeof(Header) ){
+            cache.close();
+            return false;
+        }
+
+        const Header& h = header();
+        bool valid = (memcmp( h.magic, "RSTC", 4 ) == 0) &&
+                     (h.version == VERSION) &&
+                     (h.sourceSize == sourceSize) &&
+                     ((h.sourceWriteTime == sourceWriteTime) || (checkHash && (h.sourceHash == sourceHash))) &&
+                     (h.width > 0) && (h.height > 0) && ((long long)h.pitch >= (long long)h.width * 4);
+        // 画素の大きさは31bit同士の積なので64bitで溢れずに比べられる
+        valid = valid &&
+                ((unsigned long long)(cache.length() - sizeof(Header)) >=
+                 (unsigned long long)h.pitch * (unsigned long long)h.height);
+        if ( !valid ){
+            cache.close();
+        }
+
+        return valid;
+    }
+
+    // キャッシュに記録した元ファイルの更新日時を書き直す
+    void updateWriteTime()
+    {
+        cache.close();
+
+        FILE* file = 0;
+        _wfopen_s( &file, cachePath.c_str(), L"r+b" );
+        if ( file != 0 ){
+            if ( fseek( file, offsetof( Header, sourceWriteTime ), SEEK_SET ) == 0 ){
+                fwrite( &sourceWriteTime, sizeof(sourceWriteTime), 1, file );
+            }
+            fclose( file );
+        }
+
+        // 書き直せなくても内容は同じなのでそのまま使う
+        warm = openCache( true );
+    }
+
+    // 元ファイルをデコードしてキャッシュを作る
+    bool build()
+    {
+        cache.close();
+
+        cv::Mat encoded( 1, (int)source.length(), CV_8UC1, (void*)source.ptr() );
+        cv::Mat image = cv::imdecode( encoded, CV_LOAD_IMAGE_COLOR );
+        if ( image.empty() ){
+            throw std::runtime_error( "追跡する画像のデコードに失敗しました" );
+        }
+
+        cv::Mat& bgra = decoded;
+        cv::cvtColor( image, bgra, CV_BGR2BGRA );
+
+        Header h = {};
+        memcpy( h.magic, "RSTC", 4 );
+        h.version = VERSION;
+        h.sourceHash = sourceHash;
+        h.sourceSize = sourceSize;
+        h.sourceWriteTime = sourceWriteTime;
+        h.width = bgra.cols;
+        h.height = bgra.rows;
+        h.pitch = bgra.cols * 4;
+
+        // 一時ファイルに書いてから置き換える(途中で落ちても壊れたキャッシュを残さない)
+        std::wstring tempPath = cachePath + L".tmp";
+        FILE* file = 0;
+        _wfopen_s( &file, tempPath.c_str(), L"wb" );
+        if ( file == 0 ){
+            return false;
+        }
+
+        fwrite( &h, sizeof(h), 1, file );
+        for ( int y = 0; y < bgra.rows; ++y ){
+            fwrite( bgra.ptr( y ), 1, h.pitch, file );
+        }
+        bool written = (ferror( file ) == 0);
+        fclose( file );
+
+        if ( !written ){
+            DeleteFileW( tempPath.c_str() );
+            return false;
+        }
+
+        return MoveFileExW( tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+    }
+
+    // FNV-1a 64bit
+    static unsigned long long hash( const unsigned char* data, size_t size )
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        for ( size_t i = 0; i < size; ++i ){
+            h ^= data[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+private:
+
+    std::wstring sourcePath;
+    std::wstring cachePath;
+
+    MappedFile source;
+    MappedFile cache;
+    unsigned long long sourceSize = 0;
+    unsigned long long sourceWriteTime = 0;
+    unsigned long long sourceHash = 0;
+    bool warm = false;
+
+    // キャッシュが使えないときのデコード結果
+    cv::Mat decoded;
+};
@@ -0,0 +1,266 @@
+// PlanarTrackerのテスト
+//
+// targetEarth.jpgを既知の姿勢で射影した合成画像を追跡して、
+//   ・姿勢の精度(並進と回転の誤差)
+//   ・登録したターゲット数ごとの処理時間(fps)
+// を調べる。精度が基準を満たさないときは1を返す。
+#include "planar_tracker.h"
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+const int WIDTH = 640;
+const int HEIGHT = 480;
+const float FOCAL_LENGTH = 630;
+const float TARGET_MM = 200;
+
+cv::Mat cameraMatrix()
+{
+    return (cv::Mat_<double>( 3, 3 ) <<
+        FOCAL_LENGTH, 0, WIDTH / 2.0,
+        0, FOCAL_LENGTH, HEIGHT / 2.0,
+        0, 0, 1);
+}
+
+// x, y, z軸まわりの回転[度]を順にかけた回転行列
+cv::Mat rotation( double ax, double ay, double az )
+{
+    cv::Mat vx = (cv::Mat_<double>( 3, 1 ) << ax * CV_PI / 180, 0, 0);
+    cv::Mat vy = (cv::Mat_<double>( 3, 1 ) << 0, ay * CV_PI / 180, 0);
+    cv::Mat vz = (cv::Mat_<double>( 3, 1 ) << 0, 0, az * CV_PI / 180);
+
+    cv::Mat rx, ry, rz;
+    cv::Rodrigues( vx, rx );
+    cv::Rodrigues( vy, ry );
+    cv::Rodrigues( vz, rz );
+    return rx * ry * rz;
+}
+
+// ターゲット画像 -> カメラ画像のホモグラフィ(OpenCVの座標系、y下向き)
+cv::Mat targetToImage( const cv::Mat& image, const cv::Mat& r, const cv::Mat& t )
+{
+    double s = TARGET_MM / image.cols;
+    cv::Mat toPlane = (cv::Mat_<double>( 3, 3 ) <<
+        s, 0, -image.cols / 2.0 * s,
+        0, s, -image.rows / 2.0 * s,
+        0, 0, 1);
+
+    // 平面(z = 0)の点は回転の1,2列目と並進で射影される
+    cv::Mat rt = (cv::Mat_<double>( 3, 3 ) <<
+        r.at<double>( 0, 0 ), r.at<double>( 0, 1 ), t.at<double>( 0 ),
+        r.at<double>( 1, 0 ), r.at<double>( 1, 1 ), t.at<double>( 1 ),
+        r.at<double>( 2, 0 ), r.at<double>( 2, 1 ), t.at<double>( 2 ));
+    return cameraMatrix() * rt * toPlane;
+}
+
+// なめらかなランダム模様の背景
+cv::Mat background( cv::RNG& rng )
+{
+    cv::Mat small( HEIGHT / 8, WIDTH / 8, CV_8UC3 );
+    rng.fill( small, cv::RNG::UNIFORM, 60, 200 );
+
+    cv::Mat frame;
+    cv::resize( small, frame, cv::Size( WIDTH, HEIGHT ), 0, 0, cv::INTER_CUBIC );
+    cv::GaussianBlur( frame, frame, cv::Size(), 3 );
+    return frame;
+}
+
+void render( cv::Mat& frame, const cv::Mat& image, const cv::Mat& homography )
+{
+    cv::Mat warped, mask;
+    cv::warpPerspective( image, warped, homography, frame.size() );
+    cv::warpPerspective( cv::Mat( image.size(), CV_8UC1, cv::Scalar( 255 ) ), mask, homography, frame.size() );
+    warped.copyTo( frame, mask );
+}
+
+// カメラのノイズ(標準偏差3)
+void addNoise( cv::Mat& frame, cv::RNG& rng )
+{
+    cv::Mat noise( frame.size(), CV_16SC3 );
+    rng.fill( noise, cv::RNG::NORMAL, 0, 3 );
+
+    cv::Mat noisy;
+    frame.convertTo( noisy, CV_16SC3 );
+    noisy += noise;
+    noisy.convertTo( frame, CV_8UC3 );
+}
+
+// 正解の姿勢をトラッカーの座標系(y上向き)にする
+TrackingPose truth( const cv::Mat& r, const cv::Mat& t )
+{
+    Matrix3x3 m;
+    for ( int i = 0; i < 3; ++i ){
+        for ( int j = 0; j < 3; ++j ){
+            float sign = ((i == 1) != (j == 1)) ? -1.0f : 1.0f;
+            m.m[i][j] = sign * (float)r.at<double>( i, j );
+        }
+    }
+
+    TrackingPose pose;
+    pose.translation.x = (float)t.at<double>( 0 );
+    pose.translation.y = -(float)t.at<double>( 1 );
+    pose.translation.z = (float)t.at<double>( 2 );
+    pose.rotation = m.toQuaternion();
+    return pose;
+}
+
+double distance( const Vector3& a, const Vector3& b )
+{
+    double dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return sqrt( dx * dx + dy * dy + dz * dz );
+}
+
+// 2つの回転の差[度]
+double angle( const Quaternion& a, const Quaternion& b )
+{
+    double na = sqrt( a.x * a.x + a.y * a.y + a.z * a.z + a.w * a.w );
+    double nb = sqrt( b.x * b.x + b.y * b.y + b.z * b.z + b.w * b.w );
+    double dot = fabs( a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w ) / (na * nb);
+    return 2 * acos( std::min( dot, 1.0 ) ) * 180 / CV_PI;
+}
+
+double median( std::vector<double> values )
+{
+    if ( values.empty() ){
+        return 0;
+    }
+    std::sort( values.begin(), values.end() );
+    return values[values.size() / 2];
+}
+
+// 1つのターゲットをランダムな姿勢で追跡して精度を調べる
+bool testAccuracy( const cv::Mat& image, int count, double maxTilt, double minMM, double maxMM )
+{
+    cv::RNG rng( 7 );
+
+    PlanarTracker tracker;
+    tracker.setCamera( WIDTH, HEIGHT, FOCAL_LENGTH );
+    tracker.addTarget( image, TARGET_MM );
+
+    int tracked = 0;
+    std::vector<double> translationErrors;  // 距離に対する割合
+    std::vector<double> rotationErrors;
+    for ( int i = 0; i < count; ++i ){
+        cv::Mat r = rotation( rng.uniform( -maxTilt, maxTilt ), rng.uniform( -maxTilt, maxTilt ), rng.uniform( -180.0, 180.0 ) );
+        double z = rng.uniform( minMM, maxMM );
+        cv::Mat t = (cv::Mat_<double>( 3, 1 ) << rng.uniform( -0.15, 0.15 ) * z, rng.uniform( -0.1, 0.1 ) * z, z);
+
+        cv::Mat frame = background( rng );
+        render( frame, image, targetToImage( image, r, t ) );
+        addNoise( frame, rng );
+
+        tracker.track( frame );
+        const PlanarTracker::Result& result = tracker.getResults()[0];
+        if ( !result.isTracking ){
+            continue;
+        }
+
+        ++tracked;
+        TrackingPose expected = truth( r, t );
+        translationErrors.push_back( distance( result.pose.translation, expected.translation ) / z );
+        rotationErrors.push_back( angle( result.pose.rotation, expected.rotation ) );
+    }
+
+    double t = median( translationErrors ) * 100;
+    double r = median( rotationErrors );
+    bool ok = (tracked >= count * 9 / 10) && (t < 1.0) && (r < 5.0);
+    printf( "tilt <= %2.0f, %3.0f-%3.0fmm : tracked %3d/%d, translation %.2f%%, rotation %.2f deg %s\n",
+        maxTilt, minMM, maxMM, tracked, count, t, r, ok ? "" : "NG" );
+    return ok;
+}
+
+// fps測定用のランダムな図形のターゲット
+cv::Mat texture( int seed )
+{
+    cv::RNG rng( seed );
+    cv::Mat image( 240, 240, CV_8UC3, cv::Scalar::all( 255 ) );
+    for ( int i = 0; i < 60; ++i ){
+        cv::Scalar color( rng.uniform( 0, 255 ), rng.uniform( 0, 255 ), rng.uniform( 0, 255 ) );
+        cv::Point p( rng.uniform( 0, 240 ), rng.uniform( 0, 240 ) );
+        if ( rng.uniform( 0, 2 ) == 0 ){
+            cv::circle( image, p, rng.uniform( 4, 30 ), color, -1 );
+        }
+        else {
+            cv::rectangle( image, p, p + cv::Point( rng.uniform( 5, 50 ), rng.uniform( 5, 50 ) ), color, -1 );
+        }
+    }
+    return image;
+}
+
+// 登録したターゲット数ごとの処理時間(画面に映るのは最大4つ)
+void measureFps( const cv::Mat& image )
+{
+    const int FRAMES = 20;
+
+    std::vector<cv::Mat> images( 1, image );
+    for ( int i = 1; i < 16; ++i ){
+        images.push_back( texture( 100 + i ) );
+    }
+
+    printf( "\nthreads %d\n", cv::getNumThreads() );
+    printf( " targets | visible | ms/frame |   fps | found/frame\n" );
+    for ( int n = 1; n <= 16; n *= 2 ){
+        cv::RNG rng( n );
+
+        PlanarTracker tracker;
+        tracker.setCamera( WIDTH, HEIGHT, FOCAL_LENGTH );
+        for ( int i = 0; i < n; ++i ){
+            tracker.addTarget( images[i], TARGET_MM );
+        }
+
+        int visible = std::min( n, 4 );
+        std::vector<cv::Mat> frames;
+        for ( int f = 0; f < FRAMES; ++f ){
+            cv::Mat frame = background( rng );
+            for ( int v = 0; v < visible; ++v ){
+                double z = (visible > 1) ? 700 : 450;
+                double x = (visible > 1) ? ((v % 2) ? 0.25 : -0.25) * z : 0;
+                double y = (visible > 1) ? ((v / 2) ? 0.22 : -0.22) * z : 0;
+                cv::Mat r = rotation( rng.uniform( -15.0, 15.0 ), rng.uniform( -15.0, 15.0 ), rng.uniform( -30.0, 30.0 ) );
+                cv::Mat t = (cv::Mat_<double>( 3, 1 ) << x, y, z);
+                render( frame, images[v], targetToImage( images[v], r, t ) );
+            }
+            addNoise( frame, rng );
+            frames.push_back( frame );
+        }
+
+        tracker.track( frames[0] );
+
+        double ms = 0;
+        int found = 0;
+        for ( int f = 0; f < FRAMES; ++f ){
+            tracker.track( frames[f] );
+            ms += tracker.lastTrackMs();
+            for ( int i = 0; i < visible; ++i ){
+                found += tracker.getResults()[i].isTracking;
+            }
+        }
+        ms /= FRAMES;
+        printf( " %7d | %7d | %8.2f | %5.1f | %.2f\n", n, visible, ms, 1000 / ms, (double)found / FRAMES );
+    }
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+    cv::Mat image = cv::imread( (argc > 1) ? argv[1] : "../targetEarth.jpg" );
+    if ( image.empty() ){
+        printf( "targetEarth.jpg could not be read\n" );
+        return 1;
+    }
+
+    bool ok = true;
+    ok &= testAccuracy( image, 100, 20, 300, 500 );
+    ok &= testAccuracy( image, 100, 40, 300, 500 );
+    ok &= testAccuracy( image, 100, 20, 500, 800 );
+
+    measureFps( image );
+
+    printf( "\n%s\n", ok ? "OK" : "FAILED" );
+    return ok ? 0 : 1;
+}
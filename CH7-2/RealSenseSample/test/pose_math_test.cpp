@@ -0,0 +1,201 @@
+// pose_math.h のテスト
+//
+// 回転行列とクォータニオンの変換、行列の計算、座標軸の投影を、
+// 手で求めた値と比べる。SSEでまとめて投影した結果は1つずつ投影した結果と比べる。
+#include "pose_math.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what, int line )
+{
+    if ( !ok ){
+        printf( "NG line %d : %s\n", line, what );
+        ++failures;
+    }
+}
+
+#define CHECK( expr ) check( (expr), #expr, __LINE__ )
+
+bool near( float a, float b, float eps = 1e-5f )
+{
+    return fabsf( a - b ) <= eps;
+}
+
+bool near( const Matrix3x3& a, const Matrix3x3& b, float eps = 1e-5f )
+{
+    for ( int i = 0; i < 3; ++i ){
+        for ( int j = 0; j < 3; ++j ){
+            if ( !near( a.m[i][j], b.m[i][j], eps ) ){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 同じ回転か(q と -q は同じ回転)
+bool sameRotation( const Quaternion& a, const Quaternion& b, float eps = 1e-4f )
+{
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    return near( fabsf( dot ), 1.0f, eps );
+}
+
+Quaternion axisAngle( float x, float y, float z, float degree )
+{
+    float half = degree * 3.14159265f / 360;
+    Quaternion q = { x * sinf( half ), y * sinf( half ), z * sinf( half ), cosf( half ) };
+    return q;
+}
+
+Quaternion randomQuaternion()
+{
+    Quaternion q;
+    float n;
+    do {
+        q.x = rand() / (float)RAND_MAX * 2 - 1;
+        q.y = rand() / (float)RAND_MAX * 2 - 1;
+        q.z = rand() / (float)RAND_MAX * 2 - 1;
+        q.w = rand() / (float)RAND_MAX * 2 - 1;
+        n = sqrtf( q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w );
+    } while ( n < 0.1f );
+
+    q.x /= n;
+    q.y /= n;
+    q.z /= n;
+    q.w /= n;
+    return q;
+}
+
+void testFromQuaternion()
+{
+    Matrix3x3 identity = { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } };
+    Quaternion none = { 0, 0, 0, 1 };
+    CHECK( near( Matrix3x3::fromQuaternion( none ), identity ) );
+
+    // z軸まわりに90度 : x軸がy軸に向く
+    Matrix3x3 z90 = { { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } } };
+    CHECK( near( Matrix3x3::fromQuaternion( axisAngle( 0, 0, 1, 90 ) ), z90 ) );
+
+    // x軸まわりに180度
+    Matrix3x3 x180 = { { { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 } } };
+    CHECK( near( Matrix3x3::fromQuaternion( axisAngle( 1, 0, 0, 180 ) ), x180 ) );
+
+    // y軸まわりに90度 : z軸がx軸に向く
+    Matrix3x3 y90 = { { { 0, 0, 1 }, { 0, 1, 0 }, { -1, 0, 0 } } };
+    CHECK( near( Matrix3x3::fromQuaternion( axisAngle( 0, 1, 0, 90 ) ), y90 ) );
+}
+
+void testToQuaternion()
+{
+    // トレースが負になる回転(x, y, z軸まわりに180度)も含めて、元のクォータニオンに戻る
+    Quaternion fixed[] = {
+        axisAngle( 1, 0, 0, 180 ), axisAngle( 0, 1, 0, 180 ), axisAngle( 0, 0, 1, 180 ),
+        axisAngle( 0, 0, 1, 90 ), { 0, 0, 0, 1 },
+    };
+    for ( const auto& q : fixed ){
+        CHECK( sameRotation( Matrix3x3::fromQuaternion( q ).toQuaternion(), q ) );
+    }
+
+    srand( 1 );
+    int bad = 0;
+    for ( int i = 0; i < 10000; ++i ){
+        Quaternion q = randomQuaternion();
+        bad += !sameRotation( Matrix3x3::fromQuaternion( q ).toQuaternion(), q );
+    }
+    CHECK( bad == 0 );
+}
+
+void testProducts()
+{
+    Matrix3x3 z90 = Matrix3x3::fromQuaternion( axisAngle( 0, 0, 1, 90 ) );
+    Matrix3x3 z180 = Matrix3x3::fromQuaternion( axisAngle( 0, 0, 1, 180 ) );
+    CHECK( near( z90 * z90, z180 ) );
+
+    Vector3 x = { 1, 0, 0 };
+    Vector3 y = z90 * x;
+    CHECK( near( y.x, 0 ) && near( y.y, 1 ) && near( y.z, 0 ) );
+
+    // 回転の合成はクォータニオンの積と同じ
+    Quaternion a = axisAngle( 1, 0, 0, 30 ), b = axisAngle( 0, 1, 0, 45 );
+    Quaternion ab = {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+    CHECK( near( Matrix3x3::fromQuaternion( a ) * Matrix3x3::fromQuaternion( b ), Matrix3x3::fromQuaternion( ab ) ) );
+}
+
+void testProjection()
+{
+    AxisProjector projector( 640, 480, 100000, 630 );
+
+    // 正面 1000mm : 原点は画像の中心、X軸は右、Y軸は上(画像では上向き)に100画素
+    TrackingPose front = { { 0, 0, 1000 }, { 0, 0, 0, 1 } };
+    AxisProjection p = projector.project( front );
+    CHECK( near( p.originX, 320 ) && near( p.originY, 240 ) );
+    CHECK( near( p.axisX[0], 420, 1e-3f ) && near( p.axisY[0], 240, 1e-3f ) );
+    CHECK( near( p.axisX[1], 320, 1e-3f ) && near( p.axisY[1], 140, 1e-3f ) );
+    CHECK( near( p.axisX[2], 320, 1e-3f ) && near( p.axisY[2], 240, 1e-3f ) );
+
+    // 並進 (100, 50, 500) : 原点は (100 * 630 / 500 + 320, -50 * 630 / 500 + 240)
+    TrackingPose moved = { { 100, 50, 500 }, axisAngle( 0, 0, 1, 90 ) };
+    p = projector.project( moved );
+    CHECK( near( p.originX, 446, 1e-3f ) && near( p.originY, 177, 1e-3f ) );
+    // z軸まわりに90度なので、X軸は上に200画素
+    CHECK( near( p.axisX[0], 446, 1e-3f ) && near( p.axisY[0], -23, 1e-3f ) );
+}
+
+void testBatchProjection()
+{
+    // SSEで4つずつ + 残りを1つずつ
+    srand( 2 );
+    std::vector<TrackingPose> poses( 11 );
+    for ( auto& pose : poses ){
+        pose.translation.x = (float)(rand() % 400 - 200);
+        pose.translation.y = (float)(rand() % 400 - 200);
+        pose.translation.z = (float)(300 + rand() % 700);
+        pose.rotation = randomQuaternion();
+    }
+
+    AxisProjector projector( 640, 480, 150000 );
+    std::vector<AxisProjection> batch;
+    projector.project( poses, batch );
+    CHECK( batch.size() == poses.size() );
+
+    float maxError = 0;
+    for ( size_t i = 0; i < poses.size(); ++i ){
+        AxisProjection single = projector.project( poses[i] );
+        maxError = std::max( maxError, fabsf( single.originX - batch[i].originX ) );
+        maxError = std::max( maxError, fabsf( single.originY - batch[i].originY ) );
+        for ( int k = 0; k < 3; ++k ){
+            maxError = std::max( maxError, fabsf( single.axisX[k] - batch[i].axisX[k] ) );
+            maxError = std::max( maxError, fabsf( single.axisY[k] - batch[i].axisY[k] ) );
+        }
+    }
+    CHECK( maxError < 1e-3f );
+
+    std::vector<TrackingPose> none;
+    projector.project( none, batch );
+    CHECK( batch.empty() );
+}
+
+}
+
+int main()
+{
+    testFromQuaternion();
+    testToQuaternion();
+    testProducts();
+    testProjection();
+    testBatchProjection();
+
+    printf( "%s\n", (failures == 0) ? "OK" : "FAILED" );
+    return (failures == 0) ? 0 : 1;
+}
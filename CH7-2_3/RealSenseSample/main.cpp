@@ -2,11 +2,11 @@
 #include "pxcsensemanager.h"
 #include "PXCTracker.h"
 
-#define _USE_MATH_DEFINES
-#include <math.h>
-
 #include <opencv2\opencv.hpp>
 
+#include "pose_math.h"
+#include "tracking_table.h"
+
 class RealSenseAsenseManager
 {
 public:
@@ -109,120 +109,64 @@ private:
     // IuWFNggbLOXV
     void updateObjectTracking()
     {
-        // ǐՂĂIuWFNg̐擾
-        pxcI32 numTracked = tracker->QueryNumberTrackingValues();
-        if ( numTracked == 0 ){
-            return;
+        trackedPoses.clear();
+
+        // ǐՌʂXV
+        double now = cv::getTickCount() * 1000.0 / cv::getTickFrequency();
+        trackingTable.update( tracker, now );
+
+        for ( const auto& entry : trackingTable.getEntries() ) {
+            // Ԃς\
+            if ( entry.transition == TrackingTable::TRANSITION_FOUND ) {
+                std::cout << "found : " << entry.values.cosID << std::endl;
+            }
+            else if ( entry.transition == TrackingTable::TRANSITION_LOST ) {
+                std::cout << "lost : " << entry.values.cosID << std::endl;
+            }
+
+            if ( entry.isTracking ) {
+                addTrackedPose( entry.values );
+            }
         }
 
         // ǐՂĂIuWFNg\
-        std::vector<PXCTracker::TrackingValues> trackArr( numTracked );
-        tracker->QueryAllTrackingValues( &trackArr[0] );
-        for ( auto& arr : trackArr ) {
-            if ( PXCTracker::IsTracking( arr.state ) ) {
-                showTrackingValue( &arr );
+        showTrackingValues();
+    }
+
+    // ǐՂĂIuWFNg̈ʒuƌ\
+    void showTrackingValues()
+    {
+        // S^[Qbg̍W܂Ƃ߂ċ߂
+        projector.project( trackedPoses, axes );
+
+        for ( const auto& axis : axes ) {
+            cv::Point origin( axis.originX, axis.originY );
+
+            // S_\
+            cv::circle( colorImage, origin, 5, cv::Scalar( 255, 0, 0 ), -1 );
+
+            // eW̌\
+            const cv::Scalar colors[] = {
+                cv::Scalar( 0, 0, 255 ), cv::Scalar( 0, 255, 0 ), cv::Scalar( 255, 0, 0 ) };
+            for ( int k = 0; k < 3; ++k ) {
+                cv::line( colorImage, origin,
+                    cv::Point( axis.axisX[k], axis.axisY[k] ), colors[k] );
             }
         }
     }
 
-    void showTrackingValue( PXCTracker::TrackingValues* arrData )
+    // ǐՂĂIuWFNg̎pǉ
+    void addTrackedPose( const PXCTracker::TrackingValues& trackData )
     {
-        // for the middleware being a left hand coordinate system.
-        float depthnum = 630;
-
-        //correction values for translation and movement dependent on z values
-        float depthcorrectionfactor = (arrData->translation.z / depthnum);
-        arrData->translation.x = arrData->translation.x / depthcorrectionfactor;
-        arrData->translation.y = arrData->translation.y / depthcorrectionfactor;
-
-        auto translation = arrData->translation;
-
-        arrData->translation.y = -arrData->translation.y;
-        arrData->translation.x += COLOR_WIDTH / 2;
-        arrData->translation.y += COLOR_HEIGHT / 2;
-
-        // S_\
-        cv::circle( colorImage,
-            cv::Point( arrData->translation.x, arrData->translation.y ),
-            5, cv::Scalar( 255, 0, 0 ), -1 );
-
-
-        //3x1 points for scaling
-        PXCPoint3DF32 trans1;
-        PXCPoint3DF32 trans2;
-        PXCPoint3DF32 trans3;
-
-        //changes the size of the arrows
-        int scalefactor = 60000; //150000
-        float height = scalefactor / translation.z;
-        float width = scalefactor / translation.z;
-        float depth = scalefactor / translation.z;
-
-        //creates the point vectors
-        trans1.x = width;	trans2.x = 0;		trans3.x = 0;
-        trans1.y = 0;		trans2.y = height;	trans3.y = 0;
-        trans1.z = 0;		trans2.z = 0;		trans3.z = depth;
-
-        PXCPoint4DF32 rot = arrData->rotation;
-
-        //put into 3x1 vector point for matrix multiplication purposes
-        PXCPoint3DF32 q;
-        q.x = rot.x;
-        q.y = rot.y;
-        q.z = rot.z;
-        float s = rot.w;
-
-        /**--determine the degrees of rotation and display to screen-- **/
-        //converts quaternion values to degrees
-        double heading; double attitude; double bank;
-        float sqw = s*s;	float sqx = q.x*q.x;	float sqy = q.y*q.y;	float sqz = q.z*q.z;
-        float unit = sqx + sqy + sqz + sqw;
-        float check = q.x*q.y + q.z*s;
-        float rad2deg = 180 / M_PI;
-        heading = atan2( 2 * q.y*s - 2 * q.x*q.z, sqx - sqy - sqz + sqw ) * rad2deg;
-        attitude = asin( 2.0*check / unit ) * rad2deg;
-        bank = atan2( 2 * q.x*s - 2 * q.y*q.z, -sqx + sqy - sqz + sqw ) * rad2deg;
-
-
-        /** rotations with matrix multiplication **/
-        PXCPoint3DF32 prime1; PXCPoint3DF32 prime2; PXCPoint3DF32 prime3;
-        float rotmat[3][3];
-        //rotation matrix using quaternion values
-        rotmat[0][0] = (1 - (2 * (q.y*q.y)) - (2 * (q.z*q.z)));
-        rotmat[0][1] = ((2 * q.x*q.y) - (2 * s*q.z));
-        rotmat[0][2] = ((2 * q.x*q.z) + (2 * s*q.y));
-        rotmat[1][0] = ((2 * q.x*q.y) + (2 * s*q.z));
-        rotmat[1][1] = (1 - (2 * q.x*q.x) - (2 * q.z*q.z));
-        rotmat[1][2] = ((2 * q.y*q.z) - (2 * s*q.x));
-        rotmat[2][0] = ((2 * q.x*q.z) - (2 * s*q.y));
-        rotmat[2][1] = ((2 * q.y*q.z) + (2 * s*q.x));
-        rotmat[2][2] = (1 - (2 * q.x*q.x) - (2 * q.y*q.y));
-
-        //rotation for x point	
-        prime1.x = (rotmat[0][0] * trans1.x) + (rotmat[0][1] * trans1.y) + (rotmat[0][2] * trans1.z);
-        prime1.y = (rotmat[1][0] * trans1.x) + (rotmat[1][1] * trans1.y) + (rotmat[1][2] * trans1.z);
-        prime1.z = (rotmat[2][0] * trans1.x) + (rotmat[1][2] * trans1.y) + (rotmat[2][2] * trans1.z);
-
-        //rotation for y point
-        prime2.x = (rotmat[0][0] * trans2.x) + (rotmat[0][1] * trans2.y) + (rotmat[0][2] * trans2.z);
-        prime2.y = (rotmat[1][0] * trans2.x) + (rotmat[1][1] * trans2.y) + (rotmat[1][2] * trans2.z);
-        prime2.z = (rotmat[2][0] * trans2.x) + (rotmat[1][2] * trans2.y) + (rotmat[2][2] * trans2.z);
-
-        //rotation for z point
-        prime3.x = (rotmat[0][0] * trans3.x) + (rotmat[0][1] * trans3.y) + (rotmat[0][2] * trans3.z);
-        prime3.y = (rotmat[1][0] * trans3.x) + (rotmat[1][1] * trans3.y) + (rotmat[1][2] * trans3.z);
-        prime3.z = (rotmat[2][0] * trans3.x) + (rotmat[1][2] * trans3.y) + (rotmat[2][2] * trans3.z);
-
-        // eW̌\
-        cv::line( colorImage, cv::Point( arrData->translation.x, arrData->translation.y ),
-            cv::Point( arrData->translation.x + prime1.x, arrData->translation.y - prime1.y ),
-            cv::Scalar( 0, 0, 255 ) );
-        cv::line( colorImage, cv::Point( arrData->translation.x, arrData->translation.y ),
-            cv::Point( arrData->translation.x + prime2.x, arrData->translation.y - prime2.y ),
-            cv::Scalar( 0, 255, 0 ) );
-        cv::line( colorImage, cv::Point( arrData->translation.x, arrData->translation.y ),
-            cv::Point( arrData->translation.x + prime3.x, arrData->translation.y - prime3.y ),
-            cv::Scalar( 255, 0, 0 ) );
+        TrackingPose pose;
+        pose.translation.x = trackData.translation.x;
+        pose.translation.y = trackData.translation.y;
+        pose.translation.z = trackData.translation.z;
+        pose.rotation.x = trackData.rotation.x;
+        pose.rotation.y = trackData.rotation.y;
+        pose.rotation.z = trackData.rotation.z;
+        pose.rotation.w = trackData.rotation.w;
+        trackedPoses.push_back( pose );
     }
 
     // J[摜XV
@@ -283,6 +227,14 @@ private:
     //const int COLOR_WIDTH = 1920;
     //const int COLOR_HEIGHT = 1080;
     //const int COLOR_FPS = 30;
+
+    // ǐՏ
+    TrackingTable trackingTable;
+
+    // ǐՂĂIuWFNg̎pƉʏ̍W
+    std::vector<TrackingPose> trackedPoses;
+    std::vector<AxisProjection> axes;
+    AxisProjector projector = AxisProjector( COLOR_WIDTH, COLOR_HEIGHT, 60000 );
 };
 
 void main()
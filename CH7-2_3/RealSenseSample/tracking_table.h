@@ -0,0 +1,133 @@
+﻿// 追跡状態テーブル
+//
+// QueryAllTrackingValues() の結果を、毎フレーム確保し直さずに保持する。
+// 領域は追跡数が増えたときだけ広げ、ターゲット(cosID)ごとに
+// 見つかった/見失った/推定中 の状態遷移と、見失った時刻を記録する。
+#pragma once
+
+#include <vector>
+
+#include "PXCTracker.h"
+
+class TrackingTable
+{
+public:
+
+    // 前フレームからの状態遷移
+    enum Transition
+    {
+        TRANSITION_NONE = 0,        // 変化なし
+        TRANSITION_FOUND,           // 見つかった
+        TRANSITION_LOST,            // 見失った
+        TRANSITION_EXTRAPOLATED,    // 推定(外挿)に切り替わった
+    };
+
+    // ターゲットごとの状態
+    struct Entry
+    {
+        PXCTracker::TrackingValues values;  // 最新の追跡結果
+        bool isTracking;                    // 追跡しているか
+        bool isUpdated;                     // このフレームで結果が得られたか
+        Transition transition;              // このフレームでの状態遷移
+        double foundTime;                   // 最後に見つかった時刻[ms]
+        double lostTime;                    // 最後に見失った時刻[ms](見失っていなければ負)
+    };
+
+    // 追跡結果を更新する
+    //   now : 現在の時刻[ms]
+    void update( PXCTracker* tracker, double now )
+    {
+        // 追跡しているオブジェクトの数を取得する
+        int count = tracker->QueryNumberTrackingValues();
+
+        // 足りないときだけ領域を広げる
+        if ( (int)values.size() < count ){
+            values.resize( count );
+        }
+
+        if ( count > 0 ){
+            tracker->QueryAllTrackingValues( &values[0] );
+        }
+
+        for ( auto& entry : entries ){
+            entry.isUpdated = false;
+        }
+
+        for ( int i = 0; i < count; ++i ){
+            const auto& value = values[i];
+            auto& entry = findEntry( value.cosID );
+
+            bool isTracking = PXCTracker::IsTracking( value.state );
+            bool wasExtrapolated = (entry.values.state == PXCTracker::ETS_EXTRAPOLATED);
+
+            if ( isTracking && !entry.isTracking ){
+                entry.transition = TRANSITION_FOUND;
+                entry.foundTime = now;
+                entry.lostTime = -1;
+            }
+            else if ( !isTracking && entry.isTracking ){
+                entry.transition = TRANSITION_LOST;
+                entry.lostTime = now;
+            }
+            else if ( (value.state == PXCTracker::ETS_EXTRAPOLATED) && !wasExtrapolated ){
+                entry.transition = TRANSITION_EXTRAPOLATED;
+            }
+            else {
+                entry.transition = TRANSITION_NONE;
+            }
+
+            entry.values = value;
+            entry.isTracking = isTracking;
+            entry.isUpdated = true;
+        }
+
+        // 結果が返ってこなかったターゲットは見失ったことにする
+        for ( auto& entry : entries ){
+            if ( entry.isUpdated ){
+                continue;
+            }
+
+            if ( entry.isTracking ){
+                entry.transition = TRANSITION_LOST;
+                entry.lostTime = now;
+                entry.isTracking = false;
+            }
+            else {
+                entry.transition = TRANSITION_NONE;
+            }
+        }
+    }
+
+    // 全ターゲットの状態(一度でも結果が返ってきたターゲット)
+    const std::vector<Entry>& getEntries() const
+    {
+        return entries;
+    }
+
+private:
+
+    Entry& findEntry( pxcUID cosID )
+    {
+        for ( auto& entry : entries ){
+            if ( entry.values.cosID == cosID ){
+                return entry;
+            }
+        }
+
+        Entry entry = {};
+        entry.values.cosID = cosID;
+        entry.isTracking = false;
+        entry.transition = TRANSITION_NONE;
+        entry.lostTime = -1;
+        entries.push_back( entry );
+        return entries.back();
+    }
+
+private:
+
+    // QueryAllTrackingValues()の結果を受け取る領域(縮めない)
+    std::vector<PXCTracker::TrackingValues> values;
+
+    // ターゲットごとの状態
+    std::vector<Entry> entries;
+};
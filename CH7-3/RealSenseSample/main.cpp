@@ -3,6 +3,8 @@
 
 #include <opencv2\opencv.hpp>
 
+#include "speech_event_queue.h"
+
 class RealSenseApp : public PXCSpeechRecognition::Handler
 {
 public:
@@ -210,17 +212,30 @@ private:
         return 0;
     }
 
+    // 音声認識ハンドラ(SDKのスレッドから呼ばれるので、キューに積むだけにする)
     virtual void PXCAPI OnRecognition( const PXCSpeechRecognition::RecognitionData *data ) {
-        std::cout << "Dictation" << std::endl;
+        speechEvents.push( SpeechEvent::fromScore( *data, data->scores[0] ) );
+    }
+
+    // 音声認識の結果をまとめて取り出す
+    void updateSpeechEvents()
+    {
+        SpeechEvent ev;
+        while ( speechEvents.pop( ev ) ) {
+            std::cout << "Dictation" << std::endl;
 
-        // ディクテーションモードの時はラベルがマイナスの値になる
-        if ( data->scores[0].label < 0 ) {
-            std::wcout << data->scores[0].sentence << std::endl;
+            // ディクテーションモードの時はラベルがマイナスの値になる
+            if ( ev.label < 0 ) {
+                std::wcout << ev.sentence << std::endl;
+            }
         }
     }
 
     void updateFrame()
     {
+        // 音声認識の結果を処理する
+        updateSpeechEvents();
+
         // フレームを取得する
         pxcStatus sts = senseManager->AcquireFrame( false );
         if ( sts < PXC_STATUS_NO_ERROR ) {
@@ -285,6 +300,9 @@ private:
     PXCAudioSource *audioSource = nullptr;
     PXCSpeechRecognition *recognition = nullptr;
 
+    // 音声認識の結果
+    EventQueue<SpeechEvent, 64> speechEvents;
+
     const int COLOR_WIDTH = 640;
     const int COLOR_HEIGHT = 480;
     const int COLOR_FPS = 30;
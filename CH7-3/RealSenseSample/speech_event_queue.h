@@ -0,0 +1,130 @@
+﻿// 音声認識イベントのキュー
+//
+// OnRecognition() はSDKのスレッドから呼ばれるため、そこでは結果を
+// 固定長のレコードにしてキューに積むだけにし、メインループで
+// フレームごとにまとめて取り出す。
+// キューは複数スレッドから積めて(Multi Producer)、1つのスレッドで
+// 取り出す(Single Consumer)ロックフリーのリングバッファ。
+// いっぱいのときは待たずに捨てて、捨てた数を数える。
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cwchar>
+
+#include "PXCSpeechRecognition.h"
+
+// 音声認識の結果1件分
+struct SpeechEvent
+{
+    enum { SENTENCE_SIZE = 256 };
+
+    pxcI32 label;                       // コマンドのインデックス(ディクテーションでは負)
+    pxcI32 confidence;                  // 信頼度
+    pxcI64 timeStamp;                   // 認識した時刻
+    wchar_t sentence[SENTENCE_SIZE];    // 認識した文
+
+    static SpeechEvent fromScore( const PXCSpeechRecognition::RecognitionData& data,
+        const PXCSpeechRecognition::NBestScore& score )
+    {
+        SpeechEvent ev;
+        ev.label = score.label;
+        ev.confidence = score.confidence;
+        ev.timeStamp = data.timeStamp;
+        wcsncpy_s( ev.sentence, score.sentence, _TRUNCATE );
+        return ev;
+    }
+};
+
+// 固定長のロックフリーキュー(Capacityは2のべき乗)
+template<typename T, size_t Capacity>
+class EventQueue
+{
+    static_assert( (Capacity >= 2) && ((Capacity & (Capacity - 1)) == 0),
+        "Capacity must be a power of two" );
+
+public:
+
+    EventQueue()
+        : cells( new Cell[Capacity] )
+    {
+        for ( size_t i = 0; i < Capacity; ++i ){
+            cells[i].sequence.store( i, std::memory_order_relaxed );
+        }
+        enqueuePos.store( 0, std::memory_order_relaxed );
+        dequeuePos = 0;
+        dropped.store( 0, std::memory_order_relaxed );
+    }
+
+    // 積む(どのスレッドからでも呼べる。いっぱいならfalseを返す)
+    bool push( const T& value )
+    {
+        Cell* cell;
+        size_t pos = enqueuePos.load( std::memory_order_relaxed );
+        for ( ;; ){
+            cell = &cells[pos & (Capacity - 1)];
+            size_t seq = cell->sequence.load( std::memory_order_acquire );
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if ( diff == 0 ){
+                // 空いているセルを取り合う
+                if ( enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ){
+                    break;
+                }
+            }
+            else if ( diff < 0 ){
+                // いっぱい
+                dropped.fetch_add( 1, std::memory_order_relaxed );
+                return false;
+            }
+            else {
+                pos = enqueuePos.load( std::memory_order_relaxed );
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store( pos + 1, std::memory_order_release );
+        return true;
+    }
+
+    // 取り出す(1つのスレッドからだけ呼ぶ。空ならfalseを返す)
+    bool pop( T& value )
+    {
+        Cell* cell = &cells[dequeuePos & (Capacity - 1)];
+        size_t seq = cell->sequence.load( std::memory_order_acquire );
+        if ( (intptr_t)seq - (intptr_t)(dequeuePos + 1) < 0 ){
+            return false;
+        }
+
+        value = cell->value;
+        cell->sequence.store( dequeuePos + Capacity, std::memory_order_release );
+        ++dequeuePos;
+        return true;
+    }
+
+    // いっぱいで捨てた数
+    size_t droppedCount() const
+    {
+        return dropped.load( std::memory_order_relaxed );
+    }
+
+private:
+
+    EventQueue( const EventQueue& );
+    EventQueue& operator=( const EventQueue& );
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+
+    // 積む側と取り出す側が同じキャッシュラインに載らないように離す
+    char pad0[64];
+    std::atomic<size_t> enqueuePos;
+    char pad1[64];
+    size_t dequeuePos;
+    char pad2[64];
+    std::atomic<size_t> dropped;
+};
@@ -0,0 +1,150 @@
+// speech_event_queue.h のテスト
+//
+// 複数のスレッドから積み、1つのスレッドで取り出して、
+// イベントがなくならず、壊れず、スレッドごとに積んだ順で出てくることを確かめる。
+#include "speech_event_queue.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what, int line )
+{
+    if ( !ok ){
+        printf( "NG line %d : %s\n", line, what );
+        ++failures;
+    }
+}
+
+#define CHECK( expr ) check( (expr), #expr, __LINE__ )
+
+// labelに積んだスレッド、confidenceに通し番号、sentenceにその両方を書く
+SpeechEvent makeEvent( int producer, int index )
+{
+    SpeechEvent ev = {};
+    ev.label = producer;
+    ev.confidence = index;
+    ev.timeStamp = ((pxcI64)producer << 32) | index;
+    swprintf( ev.sentence, SpeechEvent::SENTENCE_SIZE, L"%d-%d", producer, index );
+    return ev;
+}
+
+bool isIntact( const SpeechEvent& ev )
+{
+    wchar_t expected[SpeechEvent::SENTENCE_SIZE];
+    swprintf( expected, SpeechEvent::SENTENCE_SIZE, L"%d-%d", ev.label, ev.confidence );
+    return (ev.timeStamp == (((pxcI64)ev.label << 32) | ev.confidence)) &&
+        (wcscmp( expected, ev.sentence ) == 0);
+}
+
+void testSingleThread()
+{
+    EventQueue<SpeechEvent, 4> queue;
+    SpeechEvent ev;
+    CHECK( !queue.pop( ev ) );
+
+    // いっぱいになったら捨てて数える
+    for ( int i = 0; i < 4; ++i ){
+        CHECK( queue.push( makeEvent( 0, i ) ) );
+    }
+    CHECK( !queue.push( makeEvent( 0, 4 ) ) );
+    CHECK( queue.droppedCount() == 1 );
+
+    for ( int i = 0; i < 4; ++i ){
+        CHECK( queue.pop( ev ) && (ev.confidence == i) && isIntact( ev ) );
+    }
+    CHECK( !queue.pop( ev ) );
+
+    // 一周したあとも使える
+    for ( int i = 0; i < 10; ++i ){
+        CHECK( queue.push( makeEvent( 1, i ) ) );
+        CHECK( queue.pop( ev ) && (ev.confidence == i) );
+    }
+}
+
+void testFromScore()
+{
+    PXCSpeechRecognition::RecognitionData data = {};
+    data.timeStamp = 1234;
+    data.scores[0].label = 3;
+    data.scores[0].confidence = 80;
+    for ( int i = 0; i < 1023; ++i ){
+        data.scores[0].sentence[i] = L'a';
+    }
+
+    // 長い文は切り詰めて、必ず終端する
+    SpeechEvent ev = SpeechEvent::fromScore( data, data.scores[0] );
+    CHECK( (ev.label == 3) && (ev.confidence == 80) && (ev.timeStamp == 1234) );
+    CHECK( wcslen( ev.sentence ) == SpeechEvent::SENTENCE_SIZE - 1 );
+}
+
+// SDKのスレッドが何本も同時に積む場合
+void testStress()
+{
+    const int PRODUCERS = 6;
+    const int EVENTS = 200000;
+
+    EventQueue<SpeechEvent, 256> queue;
+    std::atomic<int> finished( 0 );
+
+    std::vector<std::thread> producers;
+    for ( int p = 0; p < PRODUCERS; ++p ){
+        producers.emplace_back( [&, p]{
+            for ( int i = 0; i < EVENTS; ++i ){
+                SpeechEvent ev = makeEvent( p, i );
+                while ( !queue.push( ev ) ){
+                    std::this_thread::yield();
+                }
+            }
+            ++finished;
+        } );
+    }
+
+    std::vector<int> last( PRODUCERS, -1 );
+    long received = 0;
+    int badOrder = 0, badContent = 0;
+    SpeechEvent ev;
+    for ( ;; ){
+        bool done = (finished.load() == PRODUCERS);
+        while ( queue.pop( ev ) ){
+            if ( (ev.label < 0) || (ev.label >= PRODUCERS) || !isIntact( ev ) ){
+                ++badContent;
+                continue;
+            }
+            if ( ev.confidence != last[ev.label] + 1 ){
+                ++badOrder;
+            }
+            last[ev.label] = ev.confidence;
+            ++received;
+        }
+        // 全部積み終わったあとに空になるまで取り出した
+        if ( done ){
+            break;
+        }
+    }
+
+    for ( auto& producer : producers ){
+        producer.join();
+    }
+
+    CHECK( badContent == 0 );
+    CHECK( badOrder == 0 );
+    CHECK( received == (long)PRODUCERS * EVENTS );
+    printf( "stress : %ld events, %zu pushes retried\n", received, queue.droppedCount() );
+}
+
+}
+
+int main()
+{
+    testSingleThread();
+    testFromScore();
+    testStress();
+
+    printf( "%s\n", (failures == 0) ? "OK" : "FAILED" );
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+// テスト用の PXCSpeechRecognition.h
+//
+// speech_event_queue.h が使う型だけを、RealSense SDK と同じ名前で置き換える。
+// Windows以外でもビルドできるように wcsncpy_s も用意する。
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cwchar>
+
+typedef int32_t pxcI32;
+typedef int64_t pxcI64;
+
+class PXCSpeechRecognition
+{
+public:
+
+    struct NBestScore
+    {
+        pxcI32 label;
+        pxcI32 confidence;
+        wchar_t sentence[1024];
+    };
+
+    struct RecognitionData
+    {
+        pxcI64 timeStamp;
+        NBestScore scores[4];
+    };
+};
+
+#ifndef _MSC_VER
+#define _TRUNCATE ((size_t)-1)
+
+template<size_t N>
+inline int wcsncpy_s( wchar_t (&dest)[N], const wchar_t* src, size_t )
+{
+    wcsncpy( dest, src, N - 1 );
+    dest[N - 1] = L'\0';
+    return 0;
+}
+#endif
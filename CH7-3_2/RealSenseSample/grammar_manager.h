@@ -0,0 +1,349 @@
+﻿// コマンドモードの文法(グラマー)の管理
+//
+// コマンドの一覧ごとに文法を一度だけ解析(ビルド)して、以降はIDで切り替える。
+// 同じ一覧はハッシュで見分けて、同じIDを返す。
+// 登録した文法は起動時にバックグラウンドのスレッドで先にビルドしておける。
+// 音声認識エンジンへの操作は GrammarRecognizer を通すので、
+// 実機がなくても偽の実装に差し替えて動かせる。
+//
+// ロックは2つ:
+//   recognizerMutex ... 音声認識エンジンへの操作(ビルド、切り替え、開始、停止)を一つずつにする
+//   mutex           ... 文法の一覧と統計を守る。エンジンを操作している間は持たない
+// 認識のスレッド(OnRecognition)はどちらのロックも取らず、
+// 使っているコマンドの一覧を shared_ptr で読むだけにする。
+// (StopRec は認識のスレッドを待つので、そこでロックを待つとデッドロックする)
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include "PXCSpeechRecognition.h"
+
+// 文法をビルドして切り替える先
+class GrammarRecognizer
+{
+public:
+
+    virtual ~GrammarRecognizer() {}
+
+    // 文法をビルドする
+    virtual bool build( pxcUID grammar, const std::vector<std::wstring>& commands ) = 0;
+
+    // 文法を切り替える
+    virtual bool activate( pxcUID grammar ) = 0;
+};
+
+// PXCSpeechRecognition を使う実装
+//
+// 認識中に文法を切り替えるときは、認識を止めて切り替えてから再開する
+class PXCGrammarRecognizer : public GrammarRecognizer
+{
+public:
+
+    PXCGrammarRecognizer( PXCSpeechRecognition* recognition )
+        : recognition( recognition )
+        , source( 0 )
+        , handler( 0 )
+        , isRecognizing( false )
+    {
+    }
+
+    ~PXCGrammarRecognizer()
+    {
+        stop();
+    }
+
+    // 音声認識を開始する
+    bool start( PXCAudioSource* source, PXCSpeechRecognition::Handler* handler )
+    {
+        this->source = source;
+        this->handler = handler;
+
+        auto sts = recognition->StartRec( source, handler );
+        isRecognizing = (sts >= PXC_STATUS_NO_ERROR);
+        return isRecognizing;
+    }
+
+    // 音声認識を停止する
+    void stop()
+    {
+        if ( isRecognizing ){
+            recognition->StopRec();
+            isRecognizing = false;
+        }
+    }
+
+    virtual bool build( pxcUID grammar, const std::vector<std::wstring>& commands )
+    {
+        std::vector<pxcCHAR*> list;
+        for ( const auto& command : commands ){
+            list.push_back( (pxcCHAR*)command.c_str() );
+        }
+
+        // ラベルは一覧のインデックスになる
+        auto sts = recognition->BuildGrammarFromStringList( grammar,
+            list.empty() ? 0 : &list[0], 0, (pxcI32)list.size() );
+        return sts >= PXC_STATUS_NO_ERROR;
+    }
+
+    virtual bool activate( pxcUID grammar )
+    {
+        bool restart = isRecognizing;
+        stop();
+
+        auto sts = recognition->SetGrammar( grammar );
+        if ( sts < PXC_STATUS_NO_ERROR ){
+            return false;
+        }
+
+        if ( restart ){
+            return start( source, handler );
+        }
+
+        return true;
+    }
+
+private:
+
+    PXCSpeechRecognition* recognition;
+
+    // 再開するときに使う
+    PXCAudioSource* source;
+    PXCSpeechRecognition::Handler* handler;
+    bool isRecognizing;
+};
+
+class GrammarManager
+{
+public:
+
+    // 切り替えにかかった時間の統計
+    struct Metrics
+    {
+        int switchCount;        // 切り替えた回数
+        int buildOnSwitch;      // 切り替え時にビルドが必要だった回数
+        double lastMs;          // 直前の切り替え時間[ms](認識の停止と再開を含む)
+        double maxMs;           // 最大の切り替え時間[ms]
+        double totalMs;         // 切り替え時間の合計[ms]
+    };
+
+    typedef std::vector<std::wstring> Commands;
+
+    GrammarManager( GrammarRecognizer& recognizer )
+        : recognizer( recognizer )
+        , active( 0 )
+    {
+        metrics = Metrics();
+    }
+
+    ~GrammarManager()
+    {
+        wait();
+    }
+
+    // コマンドの一覧を登録して、文法のIDを返す(まだビルドはしない)
+    pxcUID add( const Commands& commands )
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+
+        // 同じ一覧が登録済みならそのIDを返す
+        auto key = hash( commands );
+        auto range = ids.equal_range( key );
+        for ( auto it = range.first; it != range.second; ++it ){
+            if ( *grammars[it->second].commands == commands ){
+                return it->second;
+            }
+        }
+
+        pxcUID id = nextId++;
+        Grammar grammar;
+        grammar.commands = std::make_shared<const Commands>( commands );
+        grammar.isBuilt = false;
+        grammars[id] = grammar;
+        ids.insert( std::make_pair( key, id ) );
+        return id;
+    }
+
+    // 登録済みでまだビルドしていない文法を、バックグラウンドでビルドする
+    void preload()
+    {
+        wait();
+
+        worker = std::thread( [this]{
+            std::vector<pxcUID> pending;
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                for ( const auto& grammar : grammars ){
+                    if ( !grammar.second.isBuilt ){
+                        pending.push_back( grammar.first );
+                    }
+                }
+            }
+
+            for ( auto id : pending ){
+                std::lock_guard<std::mutex> lock( recognizerMutex );
+                buildLocked( id );
+            }
+        } );
+    }
+
+    // バックグラウンドのビルドが終わるのを待つ
+    void wait()
+    {
+        if ( worker.joinable() ){
+            worker.join();
+        }
+    }
+
+    // 文法を切り替える(ビルドしていなければここでビルドする)
+    bool select( pxcUID id )
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::lock_guard<std::mutex> recognizerLock( recognizerMutex );
+
+        std::shared_ptr<const Commands> commands;
+        bool isBuilt;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            auto it = grammars.find( id );
+            if ( it == grammars.end() ){
+                return false;
+            }
+            commands = it->second.commands;
+            isBuilt = it->second.isBuilt;
+            if ( !isBuilt ){
+                metrics.buildOnSwitch++;
+            }
+        }
+
+        if ( !isBuilt && !buildLocked( id ) ){
+            return false;
+        }
+
+        // 認識を止めて再開するので、mutex は持たずに呼ぶ
+        if ( !recognizer.activate( id ) ){
+            return false;
+        }
+        std::atomic_store( &activeCommands, commands );
+        active = id;
+
+        // 切り替え時間を記録する
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>( elapsed ).count() / 1000.0;
+        std::lock_guard<std::mutex> lock( mutex );
+        metrics.switchCount++;
+        metrics.lastMs = ms;
+        metrics.maxMs = std::max( metrics.maxMs, ms );
+        metrics.totalMs += ms;
+        return true;
+    }
+
+    // 使っている文法のID(なければ0)
+    pxcUID activeGrammar() const
+    {
+        return active;
+    }
+
+    // 使っている文法で認識したラベルのコマンドを返す
+    // (認識のスレッドから呼ぶので、ロックしない)
+    std::wstring activeCommand( int label ) const
+    {
+        auto commands = std::atomic_load( &activeCommands );
+        if ( !commands || (label < 0) || (label >= (int)commands->size()) ){
+            return L"";
+        }
+
+        return (*commands)[label];
+    }
+
+    // 音声認識エンジンへの他の操作(認識の開始、停止など)を、
+    // バックグラウンドのビルドや切り替えと重ならないように実行する
+    template<typename Func>
+    auto invoke( Func func ) -> decltype( func() )
+    {
+        std::lock_guard<std::mutex> lock( recognizerMutex );
+        return func();
+    }
+
+    Metrics getMetrics()
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        return metrics;
+    }
+
+private:
+
+    GrammarManager( const GrammarManager& );
+    GrammarManager& operator=( const GrammarManager& );
+
+    struct Grammar
+    {
+        std::shared_ptr<const Commands> commands;
+        bool isBuilt;
+    };
+
+    // recognizerMutexをロックした状態で呼ぶ
+    // (ビルドの間は mutex を持たないので、add() や getMetrics() は待たされない)
+    bool buildLocked( pxcUID id )
+    {
+        std::shared_ptr<const Commands> commands;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            auto& grammar = grammars[id];
+            if ( grammar.isBuilt ){
+                return true;
+            }
+            commands = grammar.commands;
+        }
+
+        bool isBuilt = recognizer.build( id, *commands );
+
+        std::lock_guard<std::mutex> lock( mutex );
+        grammars[id].isBuilt = isBuilt;
+        return isBuilt;
+    }
+
+    // コマンドの一覧のハッシュ(FNV-1a 64bit)
+    static unsigned long long hash( const Commands& commands )
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        for ( const auto& command : commands ){
+            for ( auto c : command ){
+                h ^= (unsigned long long)c;
+                h *= 1099511628211ULL;
+            }
+
+            // 区切り
+            h ^= 0xffff;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+private:
+
+    GrammarRecognizer& recognizer;
+
+    // 文法の一覧とハッシュからの検索
+    std::map<pxcUID, Grammar> grammars;
+    std::multimap<unsigned long long, pxcUID> ids;
+    pxcUID nextId = 1;
+    std::atomic<pxcUID> active;
+
+    // 使っている文法のコマンドの一覧(std::atomic_load/atomic_store で読み書きする)
+    std::shared_ptr<const Commands> activeCommands;
+
+    std::mutex recognizerMutex;
+    std::mutex mutex;
+    std::thread worker;
+
+    Metrics metrics;
+};
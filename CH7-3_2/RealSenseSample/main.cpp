@@ -1,14 +1,25 @@
 ﻿#include "pxcsensemanager.h"
 #include "PXCSpeechRecognition.h"
 
+#include <memory>
+
 #include <opencv2\opencv.hpp>
 
+#include "grammar_manager.h"
+
 class RealSenseAsenseManager : public PXCSpeechRecognition::Handler
 {
 public:
 
     ~RealSenseAsenseManager()
     {
+        // 音声認識を停止して、文法の管理を終了する(バックグラウンドのビルドを待つ)
+        if ( grammarManager != 0 ){
+            grammarManager->invoke( [this]{ grammarRecognizer->stop(); } );
+        }
+        grammarManager.reset();
+        grammarRecognizer.reset();
+
         // 音声認識エンジンオブジェクトを解放する
         if ( recognition != 0 ){
             recognition->Release();
@@ -166,34 +177,56 @@ private:
         setCommandMode();
 
         // 音声認識を開始する
-        sts = recognition->StartRec( audioSource, this );
-        if ( sts < PXC_STATUS_NO_ERROR ) {
+        // (文法の切り替え時に止めて再開するので GrammarRecognizer から開始する。
+        //  バックグラウンドのビルドと重ならないように GrammarManager を通す)
+        bool started = grammarManager->invoke( [this]{
+            return grammarRecognizer->start( audioSource, this );
+        } );
+        if ( !started ) {
             throw std::runtime_error( "音声認識の開始に失敗しました" );
         }
     }
 
     void setCommandMode()
     {
-        pxcUID grammar = 1;
-
-        // 認識させたいコマンド
-        pxcCHAR* commands[] = {
-            L"こんにちは",
-            L"インテルはいってる",
-            L"いいね",
+        grammarRecognizer.reset( new PXCGrammarRecognizer( recognition ) );
+        grammarManager.reset( new GrammarManager( *grammarRecognizer ) );
+
+        // 認識させたいコマンド(画面の状態ごとに切り替える)
+        const wchar_t* commandSets[][3] = {
+            { L"こんにちは", L"インテルはいってる", L"いいね" },
+            { L"はい", L"いいえ", L"もどる" },
+            { L"つぎ", L"まえ", L"おわり" },
         };
 
-        // 認識させたいコマンドを解析する
-        auto sts = recognition->BuildGrammarFromStringList( grammar, commands, 0, 3 );
-        if ( sts < PXC_STATUS_NO_ERROR ) {
-            throw std::runtime_error( "コマンドの解析に失敗しました" );
+        for ( const auto& commands : commandSets ) {
+            grammars.push_back( grammarManager->add(
+                std::vector<std::wstring>( commands, commands + 3 ) ) );
         }
 
-        // 認識させたいコマンドを登録する
-        sts = recognition->SetGrammar( grammar );
-        if ( sts < PXC_STATUS_NO_ERROR ) {
+        // 認識させたいコマンドをバックグラウンドで解析しておく
+        grammarManager->preload();
+
+        // 最初のコマンドを登録する
+        selectGrammar( 0 );
+    }
+
+    // コマンドを切り替える
+    void selectGrammar( int index )
+    {
+        if ( (index < 0) || (index >= (int)grammars.size()) ) {
+            return;
+        }
+
+        if ( !grammarManager->select( grammars[index] ) ) {
             throw std::runtime_error( "コマンドの設定に失敗しました" );
         }
+
+        // 切り替えにかかった時間を表示する
+        auto metrics = grammarManager->getMetrics();
+        std::cout << "grammar " << index << " : " << metrics.lastMs << " ms"
+                  << " (max " << metrics.maxMs << " ms, "
+                  << "avg " << (metrics.totalMs / metrics.switchCount) << " ms)" << std::endl;
     }
 
     // voice_recognition サンプルより
@@ -223,9 +256,11 @@ private:
             }
 
             // 認識した語が信頼性の高い順に設定される
+            // ラベルは使っている文法のコマンドの一覧のインデックス
             std::wcout << data->scores[i].label << " "
                 << data->scores[i].confidence << " "
-                << data->scores[i].sentence << std::endl;
+                << data->scores[i].sentence << " "
+                << grammarManager->activeCommand( data->scores[i].label ) << std::endl;
         }
     }
 
@@ -283,6 +318,10 @@ private:
             // ESC|q|Q for Exit
             return false;
         }
+        // 1～3 でコマンドを切り替える
+        else if ( ('1' <= c) && (c <= '3') ){
+            selectGrammar( c - '1' );
+        }
 
         return true;
     }
@@ -295,6 +334,11 @@ private:
     PXCAudioSource *audioSource = 0;
     PXCSpeechRecognition *recognition = 0;
 
+    // コマンドの文法
+    std::unique_ptr<PXCGrammarRecognizer> grammarRecognizer;
+    std::unique_ptr<GrammarManager> grammarManager;
+    std::vector<pxcUID> grammars;
+
     const int COLOR_WIDTH = 640;
     const int COLOR_HEIGHT = 480;
     const int COLOR_FPS = 30;
@@ -0,0 +1,526 @@
+﻿// 音声の出力先(シンク)
+//
+// 音声合成したPCMデータはロックフリーのリングバッファに積むだけにして、
+// 出力側のスレッドがリングバッファから取り出して再生(または書き出し)する。
+// 積む側はリングバッファがいっぱいのときだけ空きを待つので、
+// RenderAudio()が再生の終わりまで待つことはなく、長い文でも音声を捨てない。
+//   NullAudioSink    : 取り出して捨てる(実時間の速さで取り出すこともできる)
+//   FileAudioSink    : 取り出してWAVファイルに書き出す
+//   WaveOutAudioSink : waveOutで再生する(Windowsのみ)
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+#include "wav_writer.h"
+
+// 16bitのPCMデータのリングバッファ
+// 積むスレッドと取り出すスレッドがそれぞれ1つずつ(Single Producer/Single Consumer)
+class AudioRing
+{
+public:
+
+    // capacity : 格納できるサンプル数(2のべき乗に切り上げる)
+    AudioRing( size_t capacity )
+    {
+        size = 2;
+        while ( size < capacity ){
+            size *= 2;
+        }
+        mask = size - 1;
+        buffer.reset( new short[size] );
+
+        head.store( 0, std::memory_order_relaxed );
+        tail.store( 0, std::memory_order_relaxed );
+    }
+
+    // 積めるだけ積んで、積んだサンプル数を返す
+    size_t write( const short* data, size_t count )
+    {
+        size_t h = head.load( std::memory_order_relaxed );
+        size_t t = tail.load( std::memory_order_acquire );
+        size_t n = std::min( count, size - (h - t) );
+
+        // 終端で折り返す
+        size_t offset = h & mask;
+        size_t first = std::min( n, size - offset );
+        memcpy( &buffer[offset], data, first * sizeof(short) );
+        memcpy( &buffer[0], data + first, (n - first) * sizeof(short) );
+
+        head.store( h + n, std::memory_order_release );
+        return n;
+    }
+
+    // 取り出せるだけ取り出して、取り出したサンプル数を返す
+    size_t read( short* data, size_t count )
+    {
+        size_t t = tail.load( std::memory_order_relaxed );
+        size_t h = head.load( std::memory_order_acquire );
+        size_t n = std::min( count, h - t );
+
+        size_t offset = t & mask;
+        size_t first = std::min( n, size - offset );
+        memcpy( data, &buffer[offset], first * sizeof(short) );
+        memcpy( data + first, &buffer[0], (n - first) * sizeof(short) );
+
+        tail.store( t + n, std::memory_order_release );
+        return n;
+    }
+
+    // 取り出せるサンプル数
+    size_t available() const
+    {
+        return head.load( std::memory_order_acquire ) - tail.load( std::memory_order_acquire );
+    }
+
+    size_t capacity() const
+    {
+        return size;
+    }
+
+private:
+
+    AudioRing( const AudioRing& );
+    AudioRing& operator=( const AudioRing& );
+
+    std::unique_ptr<short[]> buffer;
+    size_t size;
+    size_t mask;
+
+    // 積む側と取り出す側が同じキャッシュラインに載らないように離す
+    char pad0[64];
+    std::atomic<size_t> head;
+    char pad1[64];
+    std::atomic<size_t> tail;
+    char pad2[64];
+};
+
+// 出力先の基底クラス
+class AudioSink
+{
+public:
+
+    // リングバッファの状態
+    struct Stats
+    {
+        size_t capacity;        // リングバッファの大きさ[サンプル]
+        size_t queued;          // まだ出力していないサンプル数
+        unsigned int underruns; // 出力中にデータが足りなくなった回数
+        unsigned int overruns;  // 出力が止まっていて積めなかった回数
+    };
+
+    // ringSamples : リングバッファの大きさ[サンプル](全チャンネル合わせた数)
+    AudioSink( size_t ringSamples )
+        : ring( ringSamples )
+    {
+        underruns.store( 0 );
+        overruns.store( 0 );
+        flushing.store( false );
+        running.store( false );
+    }
+
+    virtual ~AudioSink() {}
+
+    // 出力を開始する
+    virtual bool open( int channels, int sampleRate ) = 0;
+
+    // 出力を止める(残っているデータは捨てる)
+    virtual void close() = 0;
+
+    // PCMデータを積んで、積んだサンプル数を返す
+    // リングバッファがいっぱいのときは、出力側が取り出して空くのを待つ。
+    // 出力が止まっている(開いていない、閉じた)ときは、積めなかった分を捨てる
+    size_t write( const short* samples, size_t count )
+    {
+        size_t written = ring.write( samples, count );
+        while ( written < count ){
+            {
+                std::unique_lock<std::mutex> lock( mutex );
+                spaceAvailable.wait( lock, [this]{
+                    return (ring.available() < ring.capacity()) || !running.load();
+                } );
+            }
+
+            if ( !running.load() ){
+                overruns.fetch_add( 1, std::memory_order_relaxed );
+                break;
+            }
+
+            written += ring.write( samples + written, count - written );
+        }
+        return written;
+    }
+
+    // 積んだデータをすべて出力し終わるまで待つ(出力が止まっていれば待たない)
+    void drain()
+    {
+        flushing.store( true );
+        while ( running.load() && ((ring.available() > 0) || !isIdle()) ){
+            std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+        }
+        flushing.store( false );
+    }
+
+    // 出力側のスレッドが動いているか
+    bool isRunning() const
+    {
+        return running.load();
+    }
+
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.capacity = ring.capacity();
+        stats.queued = ring.available();
+        stats.underruns = underruns.load( std::memory_order_relaxed );
+        stats.overruns = overruns.load( std::memory_order_relaxed );
+        return stats;
+    }
+
+protected:
+
+    // 出力側のスレッドから、出力するデータを取り出す
+    size_t pull( short* samples, size_t count )
+    {
+        size_t got = ring.read( samples, count );
+
+        // 空くのを待っている積む側を起こす
+        // (積む側が空きを確かめてから待つまでの間に通知しないようにロックを通す)
+        if ( got > 0 ){
+            { std::lock_guard<std::mutex> lock( mutex ); }
+            spaceAvailable.notify_all();
+        }
+
+        // 出力の途中で足りなくなったら数える(drain()中の最後の端数は数えない)
+        if ( (got < count) && (active || (got > 0)) && !flushing.load() ){
+            underruns.fetch_add( 1, std::memory_order_relaxed );
+        }
+        active = (got == count);
+        return got;
+    }
+
+    // 出力側のスレッドを開始、停止したときに呼ぶ(止めたときは待っている積む側を起こす)
+    void setRunning( bool running )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            this->running.store( running );
+        }
+        spaceAvailable.notify_all();
+    }
+
+    // 出力中のデータがないか
+    virtual bool isIdle() const = 0;
+
+private:
+
+    AudioSink( const AudioSink& );
+    AudioSink& operator=( const AudioSink& );
+
+    AudioRing ring;
+
+    std::atomic<unsigned int> underruns;
+    std::atomic<unsigned int> overruns;
+    std::atomic<bool> flushing;
+    std::atomic<bool> running;
+
+    // 積む側が空きを待つ
+    std::mutex mutex;
+    std::condition_variable spaceAvailable;
+
+    // 出力側のスレッドだけが使う
+    bool active = false;
+};
+
+// 取り出して捨てる出力先
+class NullAudioSink : public AudioSink
+{
+public:
+
+    // realtime : 実時間の速さで取り出すか(falseならすぐに取り出す)
+    NullAudioSink( size_t ringSamples, bool realtime = true )
+        : AudioSink( ringSamples )
+        , realtime( realtime )
+    {
+        busy.store( false );
+    }
+
+    virtual ~NullAudioSink()
+    {
+        close();
+    }
+
+    virtual bool open( int channels, int sampleRate )
+    {
+        // 派生クラスのclose()は呼ばない(開いたファイルを閉じてしまうため)
+        NullAudioSink::close();
+
+        // 10msごとに取り出す
+        blockSamples = std::max( sampleRate / 100, 1 ) * channels;
+        block.resize( blockSamples );
+
+        setRunning( true );
+        worker = std::thread( [this]{ drainLoop(); } );
+        return true;
+    }
+
+    virtual void close()
+    {
+        setRunning( false );
+        if ( worker.joinable() ){
+            worker.join();
+        }
+    }
+
+protected:
+
+    // 取り出したデータを使う
+    virtual void consume( const short* samples, size_t count )
+    {
+    }
+
+    virtual bool isIdle() const
+    {
+        return !busy.load();
+    }
+
+private:
+
+    void drainLoop()
+    {
+        auto next = std::chrono::steady_clock::now();
+        while ( isRunning() ){
+            busy.store( true );
+            size_t got = pull( &block[0], blockSamples );
+            if ( got > 0 ){
+                consume( &block[0], got );
+            }
+            busy.store( false );
+
+            if ( realtime ){
+                next += std::chrono::milliseconds( 10 );
+                std::this_thread::sleep_until( next );
+            }
+            else if ( got == 0 ){
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            }
+        }
+    }
+
+private:
+
+    bool realtime;
+    size_t blockSamples = 0;
+    std::vector<short> block;
+
+    std::thread worker;
+    std::atomic<bool> busy;
+};
+
+// 取り出してWAVファイルに書き出す出力先
+class FileAudioSink : public NullAudioSink
+{
+public:
+
+    FileAudioSink( const std::wstring& fname, size_t ringSamples, bool realtime = false )
+        : NullAudioSink( ringSamples, realtime )
+        , fname( fname )
+    {
+    }
+
+    virtual ~FileAudioSink()
+    {
+        close();
+    }
+
+    virtual bool open( int channels, int sampleRate )
+    {
+        close();
+
+        if ( !writer.open( fname.c_str(), channels, sampleRate ) ){
+            return false;
+        }
+
+        return NullAudioSink::open( channels, sampleRate );
+    }
+
+    virtual void close()
+    {
+        NullAudioSink::close();
+        writer.close();
+    }
+
+protected:
+
+    virtual void consume( const short* samples, size_t count )
+    {
+        writer.write( samples, count );
+    }
+
+private:
+
+    std::wstring fname;
+    WavWriter writer;
+};
+
+#ifdef _WIN32
+// waveOutで再生する出力先
+class WaveOutAudioSink : public AudioSink
+{
+public:
+
+    // blockMs : waveOutに渡す1ブロックの長さ[ms]
+    WaveOutAudioSink( size_t ringSamples, int blockMs = 20 )
+        : AudioSink( ringSamples )
+        , blockMs( blockMs )
+    {
+        memset( headers, 0, sizeof(headers) );
+        busy.store( false );
+    }
+
+    virtual ~WaveOutAudioSink()
+    {
+        close();
+    }
+
+    virtual bool open( int channels, int sampleRate )
+    {
+        close();
+
+        WAVEFORMATEX wfx = {};
+        wfx.wFormatTag = WAVE_FORMAT_PCM;
+        wfx.nSamplesPerSec = sampleRate;
+        wfx.wBitsPerSample = 16;
+        wfx.nChannels = (WORD)channels;
+        wfx.nBlockAlign = (wfx.wBitsPerSample / 8) * wfx.nChannels;
+        wfx.nAvgBytesPerSec = wfx.nBlockAlign * wfx.nSamplesPerSec;
+
+        // 再生し終わったブロックはイベントで知らせてもらう
+        event = CreateEvent( 0, FALSE, FALSE, 0 );
+        if ( waveOutOpen( &hwo, WAVE_MAPPER, &wfx, (DWORD_PTR)event, 0, CALLBACK_EVENT ) != MMSYSERR_NOERROR ){
+            CloseHandle( event );
+            event = 0;
+            hwo = 0;
+            return false;
+        }
+
+        // ブロックは最初に一度だけ準備して、使いまわす
+        blockSamples = std::max( sampleRate * blockMs / 1000, 1 ) * channels;
+        for ( int i = 0; i < BLOCK_COUNT; ++i ){
+            blocks[i].resize( blockSamples );
+            memset( &headers[i], 0, sizeof(WAVEHDR) );
+            headers[i].lpData = (LPSTR)&blocks[i][0];
+            headers[i].dwBufferLength = (DWORD)(blockSamples * sizeof(short));
+            waveOutPrepareHeader( hwo, &headers[i], sizeof(WAVEHDR) );
+        }
+
+        setRunning( true );
+        worker = std::thread( [this]{ outputLoop(); } );
+        return true;
+    }
+
+    virtual void close()
+    {
+        if ( hwo == 0 ){
+            return;
+        }
+
+        setRunning( false );
+        SetEvent( event );
+        if ( worker.joinable() ){
+            worker.join();
+        }
+
+        waveOutReset( hwo );
+        for ( int i = 0; i < BLOCK_COUNT; ++i ){
+            waveOutUnprepareHeader( hwo, &headers[i], sizeof(WAVEHDR) );
+        }
+        waveOutClose( hwo );
+        hwo = 0;
+
+        CloseHandle( event );
+        event = 0;
+    }
+
+protected:
+
+    virtual bool isIdle() const
+    {
+        if ( busy.load() ){
+            return false;
+        }
+
+        for ( int i = 0; i < BLOCK_COUNT; ++i ){
+            if ( isQueued( headers[i] ) ){
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+
+    enum { BLOCK_COUNT = 4 };
+
+    // ブロックがwaveOutに渡したままか
+    // dwFlagsはwaveOutのスレッドが書き換えるので、不可分に読む
+    // (比較する値と書く値が同じなので、InterlockedCompareExchange()は値を変えない)
+    static bool isQueued( const WAVEHDR& header )
+    {
+        volatile LONG* flags = (volatile LONG*)&const_cast<WAVEHDR&>( header ).dwFlags;
+        return (InterlockedCompareExchange( flags, 0, 0 ) & WHDR_INQUEUE) != 0;
+    }
+
+    // 空いたブロックにリングバッファから詰めて、waveOutに渡す
+    void outputLoop()
+    {
+        while ( isRunning() ){
+            // 取り出してからwaveOutWrite()するまでは出力中とみなす
+            busy.store( true );
+            for ( int i = 0; i < BLOCK_COUNT; ++i ){
+                if ( isQueued( headers[i] ) ){
+                    continue;
+                }
+
+                size_t got = pull( &blocks[i][0], blockSamples );
+                if ( got == 0 ){
+                    break;
+                }
+
+                headers[i].dwBufferLength = (DWORD)(got * sizeof(short));
+                waveOutWrite( hwo, &headers[i], sizeof(WAVEHDR) );
+            }
+            busy.store( false );
+
+            // ブロックの再生が終わるか、データが積まれるのを待つ
+            WaitForSingleObject( event, blockMs / 2 + 1 );
+        }
+    }
+
+private:
+
+    int blockMs;
+    size_t blockSamples = 0;
+
+    HWAVEOUT hwo = 0;
+    HANDLE event = 0;
+    WAVEHDR headers[BLOCK_COUNT];
+    std::vector<short> blocks[BLOCK_COUNT];
+
+    std::thread worker;
+    std::atomic<bool> busy;
+};
+#endif
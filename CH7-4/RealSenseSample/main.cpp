@@ -3,7 +3,7 @@
 
 #include <opencv2\opencv.hpp>
 
-#include "voice_out.h"
+#include "synthesis_pipeline.h"
 
 class RealSenseApp
 {
@@ -11,6 +11,10 @@ public:
 
     ~RealSenseApp()
     {
+        // 合成中、再生中の音声は捨てる
+        pipeline.reset();
+        sink.reset();
+
         if ( senseManager != nullptr ){
             senseManager->Release();
             senseManager = nullptr;
@@ -133,22 +137,30 @@ private:
         if ( sts < PXC_STATUS_NO_ERROR ) {
             throw std::runtime_error( "音声合成エンジンオブジェクトの設定に失敗しました" );
         }
+
+        // 出力デバイスは開きっぱなしにして、文ごとに開き直さない
+        int channels = profile.outputs.nchannels;
+        int sampleRate = profile.outputs.sampleRate;
+        sink.reset( new WaveOutAudioSink( sampleRate * channels * RING_SECONDS ) );
+        if ( !sink->open( channels, sampleRate ) ) {
+            throw std::runtime_error( "音声出力デバイスのオープンに失敗しました" );
+        }
+
+        // 次の文を1つ先読みして合成する
+        pipeline.reset( new SynthesisPipeline( synthesis, profile, *sink, 1 ) );
     }
 
     void speechSynthesis( const std::wstring& sentence )
     {
-        auto sts = synthesis->BuildSentence( 1, (pxcCHAR*)sentence.c_str() );
-        if ( sts < PXC_STATUS_NO_ERROR ) {
-            throw std::runtime_error( "センテンスのビルドに失敗しました" );
-        }
-
-        // 音声合成した結果を出力する
-        VoiceOut vo( &profile );
-        int bufferNum = synthesis->QueryBufferNum( 1 );
-        for ( int i = 0; i < bufferNum; ++i ) {
-            auto sample = synthesis->QueryBuffer( 1, i );
-            vo.RenderAudio( sample );
-        }
+        // 合成を依頼して、最初の音声が出るまで待つ(残りは再生中に合成する)
+        pipeline->speak( sentence );
+        double firstAudioMs = pipeline->waitFirstAudio();
+
+        auto metrics = pipeline->getMetrics();
+        auto stats = sink->getStats();
+        std::cout << "最初の音声まで : " << firstAudioMs << " ms"
+                  << " (キャッシュ " << metrics.cacheHits << "/" << (metrics.cacheHits + metrics.cacheMisses)
+                  << ", アンダーラン " << stats.underruns << ")" << std::endl;
     }
 
     pxcCHAR *LanguageToString( PXCSpeechSynthesis::LanguageType language ) {
@@ -174,6 +186,12 @@ private:
 
     PXCSpeechSynthesis *synthesis = nullptr;
     PXCSpeechSynthesis::ProfileInfo profile;
+
+    // 出力先のリングバッファの長さ[秒]
+    const int RING_SECONDS = 30;
+
+    std::unique_ptr<AudioSink> sink;
+    std::unique_ptr<SynthesisPipeline> pipeline;
 };
 
 void main()
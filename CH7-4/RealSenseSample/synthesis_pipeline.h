@@ -0,0 +1,410 @@
+﻿// 音声合成のパイプライン
+//
+// 入力を文に区切り、合成用のスレッドで文を順に合成する。
+// 合成した音声は出力用のスレッドが開きっぱなしの出力先(AudioSink)に流すので、
+// N番目の文を再生している間に、N+1番目の文を合成しておける(先読み)。
+// 最近合成した文は、文とプロファイルのハッシュでキャッシュしておき、合成し直さない。
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cwctype>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2\opencv.hpp>
+
+#include "PXCSpeechSynthesis.h"
+#include "audio_sink.h"
+
+class SynthesisPipeline
+{
+public:
+
+    struct Metrics
+    {
+        double firstAudioMs;    // speak()から最初の音声を出力先に渡すまでの時間[ms]
+        double lastSynthesisMs; // 直前の文の合成時間[ms]
+        int sentences;          // 出力した文の数
+        int cacheHits;          // キャッシュから出力した文の数
+        int cacheMisses;        // 合成した文の数
+    };
+
+    //   lookAhead : 再生中の文より先に合成しておく文の数
+    //   cacheSize : キャッシュしておく文の数
+    SynthesisPipeline( PXCSpeechSynthesis* synthesis, const PXCSpeechSynthesis::ProfileInfo& profile,
+        AudioSink& sink, int lookAhead = 1, size_t cacheSize = 32 )
+        : synthesis( synthesis )
+        , profile( profile )
+        , sink( sink )
+        , lookAhead( std::max( lookAhead, 1 ) )
+        , cacheSize( cacheSize )
+    {
+        metrics = Metrics();
+
+        // 1回で出力先に渡すサンプル数(100ms分)
+        chunkSamples = std::max( profile.outputs.sampleRate / 10, 1 ) * profile.outputs.nchannels;
+
+        synthesisWorker = std::thread( [this]{ synthesisLoop(); } );
+        outputWorker = std::thread( [this]{ outputLoop(); } );
+    }
+
+    ~SynthesisPipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            stopping = true;
+        }
+        changed.notify_all();
+
+        synthesisWorker.join();
+        outputWorker.join();
+    }
+
+    // 文に区切って、合成を依頼する(待たない)
+    void speak( const std::wstring& text )
+    {
+        auto sentences = splitSentences( text );
+
+        std::lock_guard<std::mutex> lock( mutex );
+        int request = ++lastRequest;
+        int64 start = cv::getTickCount();
+        if ( sentences.empty() ){
+            // 出力する音声がないので、すぐに終わったことにする
+            metrics.firstAudioMs = 0;
+            firstAudioRequest = request;
+        }
+        for ( size_t i = 0; i < sentences.size(); ++i ){
+            Sentence sentence;
+            sentence.text = sentences[i];
+            sentence.request = request;
+            sentence.requestStart = start;
+            sentence.isFirst = (i == 0);
+            pending.push_back( sentence );
+        }
+        changed.notify_all();
+    }
+
+    // 直前のspeak()の最初の音声を出力先に渡すまで待って、その時間[ms]を返す
+    // (前の依頼の文がまだ残っていても、その文では返らない)
+    double waitFirstAudio()
+    {
+        std::unique_lock<std::mutex> lock( mutex );
+        changed.wait( lock, [this]{ return (firstAudioRequest >= lastRequest) || stopping; } );
+        return metrics.firstAudioMs;
+    }
+
+    // 依頼したすべての文を出力先に渡すまで待つ
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock( mutex );
+        changed.wait( lock, [this]{
+            return (pending.empty() && ready.empty() && !synthesizing && !outputting) || stopping;
+        } );
+    }
+
+    Metrics getMetrics()
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        return metrics;
+    }
+
+    // 文に区切る(句点、感嘆符、疑問符、改行、空白が続くピリオド)
+    static std::vector<std::wstring> splitSentences( const std::wstring& text )
+    {
+        std::vector<std::wstring> sentences;
+        std::wstring sentence;
+
+        for ( size_t i = 0; i < text.size(); ++i ){
+            wchar_t c = text[i];
+            if ( (c != L'\n') && (c != L'\r') ){
+                sentence += c;
+            }
+
+            bool isEnd = (c == L'。') || (c == L'．') || (c == L'！') || (c == L'？') ||
+                         (c == L'!') || (c == L'?') || (c == L'\n') || (c == L'\r') ||
+                         ((c == L'.') && ((i + 1 == text.size()) || iswspace( text[i + 1] )));
+            if ( isEnd ){
+                addSentence( sentences, sentence );
+            }
+        }
+        addSentence( sentences, sentence );
+
+        return sentences;
+    }
+
+private:
+
+    SynthesisPipeline( const SynthesisPipeline& );
+    SynthesisPipeline& operator=( const SynthesisPipeline& );
+
+    typedef std::shared_ptr<const std::vector<short>> Pcm;
+
+    struct Sentence
+    {
+        std::wstring text;
+        int request;        // speak()の依頼のID
+        int64 requestStart; // その依頼のspeak()の時刻
+        bool isFirst;       // 依頼の最初の文か
+        Pcm pcm;
+    };
+
+    struct CacheEntry
+    {
+        unsigned long long key;
+        std::wstring text;
+        Pcm pcm;
+    };
+
+    static void addSentence( std::vector<std::wstring>& sentences, std::wstring& sentence )
+    {
+        // 前後の空白を取り除く
+        size_t begin = sentence.find_first_not_of( L" \t　" );
+        if ( begin != std::wstring::npos ){
+            size_t end = sentence.find_last_not_of( L" \t　" );
+            sentences.push_back( sentence.substr( begin, end - begin + 1 ) );
+        }
+        sentence.clear();
+    }
+
+    // 合成用のスレッド
+    void synthesisLoop()
+    {
+        for ( ;; ){
+            Sentence sentence;
+            {
+                // 先読みしすぎないように、出力待ちが少なくなるまで待つ
+                std::unique_lock<std::mutex> lock( mutex );
+                changed.wait( lock, [this]{
+                    return (!pending.empty() && ((int)ready.size() < lookAhead)) || stopping;
+                } );
+                if ( stopping ){
+                    return;
+                }
+
+                sentence = pending.front();
+                pending.pop_front();
+                synthesizing = true;
+            }
+
+            // キャッシュになければ合成する
+            auto key = hash( sentence.text );
+            sentence.pcm = findCache( key, sentence.text );
+            bool isHit = (sentence.pcm != nullptr);
+            double synthesisMs = 0;
+            if ( !isHit ){
+                int64 start = cv::getTickCount();
+                sentence.pcm = synthesize( sentence.text );
+                synthesisMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+                addCache( key, sentence.text, sentence.pcm );
+            }
+
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                if ( isHit ){
+                    metrics.cacheHits++;
+                }
+                else {
+                    metrics.cacheMisses++;
+                    metrics.lastSynthesisMs = synthesisMs;
+                }
+
+                ready.push_back( sentence );
+                synthesizing = false;
+            }
+            changed.notify_all();
+        }
+    }
+
+    // 出力用のスレッド
+    void outputLoop()
+    {
+        for ( ;; ){
+            Sentence sentence;
+            {
+                std::unique_lock<std::mutex> lock( mutex );
+                changed.wait( lock, [this]{ return !ready.empty() || stopping; } );
+                if ( stopping ){
+                    return;
+                }
+
+                sentence = ready.front();
+                ready.pop_front();
+                outputting = true;
+            }
+            changed.notify_all();
+
+            // 出力先のリングバッファに空きができるのを待ちながら渡す
+            const auto& pcm = *sentence.pcm;
+            size_t offset = 0;
+            while ( (offset < pcm.size()) && !isStopping() ){
+                auto stats = sink.getStats();
+                size_t length = std::min( std::min( chunkSamples, stats.capacity ), pcm.size() - offset );
+                if ( stats.capacity - stats.queued < length ){
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+                    continue;
+                }
+
+                sink.write( &pcm[offset], length );
+                offset += length;
+
+                if ( sentence.isFirst ){
+                    sentence.isFirst = false;
+                    setFirstAudio( sentence );
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                if ( sentence.isFirst ){
+                    // 音声が空の文だった
+                    sentence.isFirst = false;
+                    setFirstAudioLocked( sentence );
+                }
+                metrics.sentences++;
+                outputting = false;
+            }
+            changed.notify_all();
+        }
+    }
+
+    // 依頼の最初の文を出力先に渡した
+    void setFirstAudio( const Sentence& sentence )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            setFirstAudioLocked( sentence );
+        }
+        changed.notify_all();
+    }
+
+    void setFirstAudioLocked( const Sentence& sentence )
+    {
+        // 後の空の依頼が先に終わっていたら、その結果を残す
+        if ( sentence.request > firstAudioRequest ){
+            metrics.firstAudioMs = (cv::getTickCount() - sentence.requestStart) * 1000.0 / cv::getTickFrequency();
+            firstAudioRequest = sentence.request;
+        }
+    }
+
+    bool isStopping()
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        return stopping;
+    }
+
+    // 1文を合成して、PCMデータを返す
+    Pcm synthesize( const std::wstring& text )
+    {
+        auto pcm = std::make_shared<std::vector<short>>();
+
+        auto sts = synthesis->BuildSentence( SENTENCE_ID, (pxcCHAR*)text.c_str() );
+        if ( sts < PXC_STATUS_NO_ERROR ){
+            return pcm;
+        }
+
+        int bufferNum = synthesis->QueryBufferNum( SENTENCE_ID );
+        for ( int i = 0; i < bufferNum; ++i ){
+            auto audio = synthesis->QueryBuffer( SENTENCE_ID, i );
+
+            PXCAudio::AudioData data;
+            sts = audio->AcquireAccess( PXCAudio::ACCESS_READ, PXCAudio::AUDIO_FORMAT_PCM, &data );
+            if ( sts >= PXC_STATUS_NO_ERROR ){
+                auto samples = (const short*)data.dataPtr;
+                pcm->insert( pcm->end(), samples, samples + data.dataSize );
+                audio->ReleaseAccess( &data );
+            }
+        }
+
+        synthesis->ReleaseSentence( SENTENCE_ID );
+        return pcm;
+    }
+
+    // キャッシュを探す(見つかったら先頭に移す)
+    Pcm findCache( unsigned long long key, const std::wstring& text )
+    {
+        for ( auto it = cache.begin(); it != cache.end(); ++it ){
+            if ( (it->key == key) && (it->text == text) ){
+                cache.splice( cache.begin(), cache, it );
+                return cache.front().pcm;
+            }
+        }
+        return nullptr;
+    }
+
+    // キャッシュに追加する(いっぱいなら一番古いものを捨てる)
+    void addCache( unsigned long long key, const std::wstring& text, const Pcm& pcm )
+    {
+        if ( cacheSize == 0 ){
+            return;
+        }
+
+        CacheEntry entry;
+        entry.key = key;
+        entry.text = text;
+        entry.pcm = pcm;
+        cache.push_front( entry );
+
+        if ( cache.size() > cacheSize ){
+            cache.pop_back();
+        }
+    }
+
+    // 文とプロファイルのハッシュ(FNV-1a 64bit)
+    unsigned long long hash( const std::wstring& text ) const
+    {
+        unsigned long long h = 14695981039346656037ULL;
+        auto add = [&h]( unsigned long long value ){
+            h ^= value;
+            h *= 1099511628211ULL;
+        };
+
+        add( profile.language );
+        add( profile.voice );
+        add( profile.volume );
+        add( (unsigned long long)(profile.pitch * 1000) );
+        add( (unsigned long long)(profile.rate * 1000) );
+        for ( auto c : text ){
+            add( (unsigned long long)c );
+        }
+        return h;
+    }
+
+private:
+
+    enum { SENTENCE_ID = 1 };
+
+    PXCSpeechSynthesis* synthesis;
+    PXCSpeechSynthesis::ProfileInfo profile;
+    AudioSink& sink;
+    int lookAhead;
+    size_t chunkSamples;
+
+    // 合成を待っている文と、出力を待っている文
+    std::deque<Sentence> pending;
+    std::deque<Sentence> ready;
+    bool synthesizing = false;
+    bool outputting = false;
+    bool stopping = false;
+
+    // 最初の音声までの時間の計測
+    // (依頼は順に出力されるので、最初の音声を出力した最後の依頼のIDだけ覚えておく)
+    int lastRequest = 0;
+    int firstAudioRequest = 0;
+
+    // 合成用のスレッドだけが使う
+    std::list<CacheEntry> cache;
+    size_t cacheSize;
+
+    Metrics metrics;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread synthesisWorker;
+    std::thread outputWorker;
+};
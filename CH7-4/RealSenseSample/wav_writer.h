@@ -0,0 +1,321 @@
+﻿// ストリーミングでWAVファイルを書き出す
+//
+// 先にRIFFヘッダーを書いておき、音声データはアラインした大きなバッファに
+// ためてからまとめて書き込む。閉じるときにヘッダーのサイズを書き直す。
+// 1ファイルの上限サイズを決めると、超えたところで次のファイルに切り替える。
+// 出力のサンプリングレートを変えると線形補間でリサンプリングする。
+// 書き込みや次のファイルを開くのに失敗したら閉じた状態になり、以降の書き込みは失敗する。
+#pragma once
+
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class WavWriter
+{
+public:
+
+    WavWriter( size_t bufferSize = 1024 * 1024 )
+        : bufferSize( bufferSize )
+    {
+        buffer = (unsigned char*)_aligned_malloc( bufferSize, 4096 );
+    }
+
+    ~WavWriter()
+    {
+        close();
+        _aligned_free( buffer );
+    }
+
+    // ファイルを開く
+    //   fname       : ファイル名
+    //   channels    : チャンネル数
+    //   sampleRate  : 入力のサンプリングレート
+    //   outputRate  : 出力のサンプリングレート(0なら入力と同じ)
+    //   maxFileSize : 1ファイルの最大サイズ[byte](0なら分割しない)
+    bool open( const wchar_t* fname, int channels, int sampleRate,
+        int outputRate = 0, unsigned int maxFileSize = 0 )
+    {
+        close();
+
+        basePath = fname;
+        this->channels = channels;
+        inputRate = sampleRate;
+        this->outputRate = (outputRate > 0) ? outputRate : sampleRate;
+        this->maxFileSize = (maxFileSize > 0) ? std::max( maxFileSize, 4096u ) : MAX_RIFF_SIZE;
+        fileIndex = 0;
+
+        resamplePos = 0;
+        history.assign( channels, 0 );
+        hasHistory = false;
+
+        return openFile( basePath );
+    }
+
+    // 16bitのPCMデータを追加する(sampleCountは全チャンネル合わせた数)
+    // ファイルが開いていないか、書き込みに失敗したらfalseを返す
+    bool write( const short* samples, size_t sampleCount )
+    {
+        if ( file == 0 ){
+            return false;
+        }
+
+        if ( outputRate == inputRate ){
+            return writeBytes( (const unsigned char*)samples, sampleCount * sizeof(short) );
+        }
+        else {
+            return resample( samples, sampleCount / channels );
+        }
+    }
+
+    // ファイルを閉じる(ヘッダーのサイズを書き直す)
+    void close()
+    {
+        if ( file == 0 ){
+            return;
+        }
+
+        // 書き込みに失敗したときはflush()の中で閉じている
+        if ( !flush() ){
+            return;
+        }
+
+        unsigned int chunkSize = dataSize + 36;
+        fseek( file, 4, SEEK_SET );
+        fwrite( &chunkSize, 4, 1, file );
+        fseek( file, 40, SEEK_SET );
+        fwrite( &dataSize, 4, 1, file );
+
+        fclose( file );
+        file = 0;
+    }
+
+    bool isOpen() const
+    {
+        return file != 0;
+    }
+
+    // 今のファイルに書いた音声データのサイズ[byte]
+    unsigned int size() const
+    {
+        return dataSize;
+    }
+
+private:
+
+    WavWriter( const WavWriter& );
+    WavWriter& operator=( const WavWriter& );
+
+    enum { HEADER_SIZE = 44 };
+
+    // RIFFのサイズは32bitなので、余裕をみて分割する
+    static const unsigned int MAX_RIFF_SIZE = 0xF0000000;
+
+    bool openFile( const std::wstring& path )
+    {
+        _wfopen_s( &file, path.c_str(), L"wb" );
+        if ( file == 0 ){
+            return false;
+        }
+
+        // 自前でバッファリングするので、CRTのバッファは使わない
+        setvbuf( file, 0, _IONBF, 0 );
+
+        dataSize = 0;
+        buffered = 0;
+        writeHeader();
+        return true;
+    }
+
+    // サイズは仮の値で書いておき、close()で書き直す
+    void writeHeader()
+    {
+        short blockAlign = (short)(channels * 2);
+        int byteRate = outputRate * blockAlign;
+        short channelCount = (short)channels;
+        short bitsPerSample = 16;
+        short audioFormat = 1;
+        int subchunk1 = 16;
+        int zero = 0;
+
+        unsigned char header[HEADER_SIZE];
+        memcpy( header + 0, "RIFF", 4 );                        // [0,3] - Chunk ID
+        memcpy( header + 4, &zero, 4 );                         // [4, 7] - Chunk size (close()で書く)
+        memcpy( header + 8, "WAVE", 4 );                        // [8,11] - Format
+        memcpy( header + 12, "fmt ", 4 );                       // [12,15] - Subchunk1 ID
+        memcpy( header + 16, &subchunk1, 4 );                   // [16, 19] - Subchunk1 size
+        memcpy( header + 20, &audioFormat, 2 );                 // [20, 21] - AudioFormat: PCM = 1
+        memcpy( header + 22, &channelCount, 2 );                // [22, 23] - Number of channels
+        memcpy( header + 24, &outputRate, 4 );                  // [24, 27] - SampeRate
+        memcpy( header + 28, &byteRate, 4 );                    // [28, 31] - ByteRate
+        memcpy( header + 32, &blockAlign, 2 );                  // [32, 33] - BlockAlign
+        memcpy( header + 34, &bitsPerSample, 2 );               // [34, 35] - BitsPerSample
+        memcpy( header + 36, "data", 4 );                       // [36,39] - Subchunk2 ID
+        memcpy( header + 40, &zero, 4 );                        // [40, 43] - Subchunk2 size (close()で書く)
+
+        fwrite( header, 1, HEADER_SIZE, file );
+    }
+
+    bool writeBytes( const unsigned char* data, size_t size )
+    {
+        // 1サンプル(全チャンネル)の途中で分割しないようにする
+        size_t blockAlign = channels * 2;
+
+        while ( size > 0 ){
+            // ファイルの上限に達したら次のファイルにする
+            size_t room = (maxFileSize - dataSize) / blockAlign * blockAlign;
+            if ( room == 0 ){
+                if ( !rotate() ){
+                    return false;
+                }
+                continue;
+            }
+
+            size_t length = std::min( size, room );
+            if ( !append( data, length ) ){
+                return false;
+            }
+            dataSize += (unsigned int)length;
+            data += length;
+            size -= length;
+        }
+
+        return true;
+    }
+
+    bool append( const unsigned char* data, size_t size )
+    {
+        if ( file == 0 ){
+            return false;
+        }
+
+        // バッファに入りきらない大きなデータは直接書く
+        if ( buffered + size > bufferSize ){
+            if ( !flush() ){
+                return false;
+            }
+            if ( size >= bufferSize ){
+                return writeFile( data, size );
+            }
+        }
+
+        memcpy( buffer + buffered, data, size );
+        buffered += size;
+        return true;
+    }
+
+    bool flush()
+    {
+        if ( file == 0 ){
+            return false;
+        }
+
+        if ( buffered > 0 ){
+            size_t size = buffered;
+            buffered = 0;
+            return writeFile( buffer, size );
+        }
+
+        return true;
+    }
+
+    // ファイルに直接書く(書けなければファイルを閉じる)
+    bool writeFile( const unsigned char* data, size_t size )
+    {
+        if ( fwrite( data, 1, size, file ) != size ){
+            fclose( file );
+            file = 0;
+            return false;
+        }
+
+        return true;
+    }
+
+    // 次のファイルに切り替える(name.wav -> name_001.wav, name_002.wav, ...)
+    bool rotate()
+    {
+        close();
+
+        wchar_t suffix[16];
+        swprintf_s( suffix, L"_%03d", ++fileIndex );
+
+        std::wstring path = basePath;
+        auto dot = path.rfind( L'.' );
+        if ( dot == std::wstring::npos ){
+            dot = path.size();
+        }
+        path.insert( dot, suffix );
+
+        // 開けなければ閉じたままにする(file == 0)
+        return openFile( path );
+    }
+
+    // 線形補間でリサンプリングする
+    bool resample( const short* samples, size_t frames )
+    {
+        if ( frames == 0 ){
+            return true;
+        }
+
+        // 前のブロックの最後のサンプルを、このブロックの-1番目として使う
+        if ( !hasHistory ){
+            for ( int c = 0; c < channels; ++c ){
+                history[c] = samples[c];
+            }
+            hasHistory = true;
+        }
+
+        double step = (double)inputRate / outputRate;
+        std::vector<short>& out = resampled;
+        out.clear();
+
+        // resamplePosは前のブロックの最後のサンプルを0とした位置
+        while ( resamplePos < (double)frames ){
+            int index = (int)resamplePos;
+            double t = resamplePos - index;
+            for ( int c = 0; c < channels; ++c ){
+                double a = (index == 0) ? history[c] : samples[(index - 1) * channels + c];
+                double b = samples[index * channels + c];
+                out.push_back( (short)(a + (b - a) * t) );
+            }
+            resamplePos += step;
+        }
+        resamplePos -= frames;
+
+        for ( int c = 0; c < channels; ++c ){
+            history[c] = samples[(frames - 1) * channels + c];
+        }
+
+        if ( !out.empty() ){
+            return writeBytes( (const unsigned char*)&out[0], out.size() * sizeof(short) );
+        }
+
+        return true;
+    }
+
+private:
+
+    FILE* file = 0;
+    std::wstring basePath;
+    int fileIndex = 0;
+
+    int channels = 1;
+    int inputRate = 0;
+    int outputRate = 0;
+    unsigned int maxFileSize = 0;
+    unsigned int dataSize = 0;
+
+    // 書き込み用のバッファ
+    unsigned char* buffer = 0;
+    size_t bufferSize = 0;
+    size_t buffered = 0;
+
+    // リサンプリングの状態
+    double resamplePos = 0;
+    std::vector<short> history;
+    std::vector<short> resampled;
+    bool hasHistory = false;
+};
@@ -0,0 +1,571 @@
+﻿// 点と面の距離を使ったICP(Iterative Closest Point)によるカメラの姿勢の推定
+//
+// 今のフレームの点を、推定中の姿勢で参照(前のフレームや、モデルから作った点と法線)の
+// カメラに投影して、同じ画素の点と対応させる(projective data association)。
+// 点と参照の面の距離の二乗和を最小にする 6x6 の正規方程式を、行ごとに並列に足し合わせて作り、
+// 縮小したデプスから順に(粗いものから細かいものへ)解いていく。
+// 足し合わせは SSE が使えれば 4つずつまとめて計算する。
+#pragma once
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define ICP_USE_SSE
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include "scan_math.h"
+
+class IcpTracker
+{
+public:
+
+    enum { LEVELS = 3 };
+
+    // 推定の結果
+    struct Result
+    {
+        bool isTracked;         // 姿勢を求められたか
+        int iterations;         // 繰り返した回数(全段の合計)
+        int inliers;            // 一番細かい段で対応がとれた点の数
+        float inlierRatio;      // 一番細かい段で対応がとれた点の割合
+        float rmse;             // 一番細かい段の点と面の距離の二乗平均平方根[m]
+        double ms;              // かかった時間[ms]
+    };
+
+    //   distanceThreshold : 対応させる点どうしの距離の上限[m]
+    //   angleThreshold    : 対応させる点どうしの法線の角度の上限[rad]
+    IcpTracker( float distanceThreshold = 0.05f, float angleThreshold = 0.5f )
+        : distanceThreshold( distanceThreshold )
+        , minNormalDot( cosf( angleThreshold ) )
+    {
+        // 段ごとの繰り返しの回数(0が一番細かい)
+        iterations[0] = 10;
+        iterations[1] = 5;
+        iterations[2] = 4;
+    }
+
+    void setIterations( int level, int count )
+    {
+        iterations[level] = count;
+    }
+
+    // 参照をデプス画像から作る
+    //   cameraToWorld : 参照のデプス画像を撮ったときのカメラの姿勢
+    void setReference( const cv::Mat& depth, const CameraIntrinsics& intrinsics,
+        const RigidTransform& cameraToWorld, float depthScale = 0.001f, float maxDepth = 3.0f )
+    {
+        buildPyramid( depth, intrinsics, depthScale, maxDepth, reference );
+
+        // ワールド座標系にする
+        for ( int level = 0; level < LEVELS; ++level ){
+            auto& map = reference[level];
+            for ( size_t i = 0; i < map.points.size(); ++i ){
+                if ( PointMap::isValid( map.points[i] ) ){
+                    map.points[i] = cameraToWorld * map.points[i];
+                    map.normals[i] = cameraToWorld.rotate( map.normals[i] );
+                }
+            }
+        }
+
+        setReferencePose( intrinsics, cameraToWorld );
+    }
+
+    // 参照をモデルの点と法線(ワールド座標系)から作る
+    void setReference( const PointMap& map, const CameraIntrinsics& intrinsics,
+        const RigidTransform& cameraToWorld )
+    {
+        reference[0] = map;
+        for ( int level = 1; level < LEVELS; ++level ){
+            downsample( reference[level - 1], reference[level] );
+        }
+
+        setReferencePose( intrinsics, cameraToWorld );
+    }
+
+    bool hasReference() const
+    {
+        return isReferenceSet;
+    }
+
+    // 今のフレームのカメラの姿勢を求める
+    //   cameraToWorld : 姿勢の初期値(求めた姿勢で上書きする。求められなければ変えない)
+    Result track( const cv::Mat& depth, const CameraIntrinsics& intrinsics,
+        RigidTransform& cameraToWorld, float depthScale = 0.001f, float maxDepth = 3.0f )
+    {
+        int64 start = cv::getTickCount();
+
+        Result result = {};
+        if ( !isReferenceSet ){
+            return result;
+        }
+
+        buildPyramid( depth, intrinsics, depthScale, maxDepth, current );
+
+        RigidTransform pose = cameraToWorld;
+        bool isSolved = true;
+        for ( int level = LEVELS - 1; (level >= 0) && isSolved; --level ){
+            CameraIntrinsics K = referenceIntrinsics.scaled( level );
+            for ( int i = 0; i < iterations[level]; ++i ){
+                Equation eq = reduce( current[level], reference[level], K, pose );
+                ++result.iterations;
+
+                // 未知数が6つなので、対応する点が少なすぎると解けない
+                double twist[6];
+                if ( (eq.count < 6) || !solve( eq, twist ) ){
+                    isSolved = false;
+                    break;
+                }
+
+                // 求めた変化を今の姿勢の前にかける
+                pose = RigidTransform::fromTwist( twist ) * pose;
+
+                if ( level == 0 ){
+                    result.inliers = eq.count;
+                    result.rmse = (float)sqrt( eq.error / eq.count );
+                }
+
+                // 変化が十分に小さくなったら次の段へ
+                double change = 0;
+                for ( int k = 0; k < 6; ++k ){
+                    change += twist[k] * twist[k];
+                }
+                if ( change < 1e-12 ){
+                    break;
+                }
+            }
+        }
+
+        int validCount = 0;
+        for ( const auto& p : current[0].points ){
+            validCount += PointMap::isValid( p ) ? 1 : 0;
+        }
+        result.inlierRatio = (validCount > 0) ? ((float)result.inliers / validCount) : 0;
+
+        // 対応がとれた点が少なければ失敗とする
+        result.isTracked = isSolved && (result.inlierRatio >= 0.1f);
+        if ( result.isTracked ){
+            cameraToWorld = pose;
+        }
+
+        result.ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+        return result;
+    }
+
+private:
+
+    IcpTracker( const IcpTracker& );
+    IcpTracker& operator=( const IcpTracker& );
+
+    // 正規方程式(J = [p x n, n] と残差 r をまとめた v = (J, r, 1) の外積の和)
+    // 対称なので上三角(j >= i)だけを使う
+    //   a[0..5][0..5] : JtJ
+    //   a[0..5][6]    : Jtr
+    //   a[6][6]       : 残差の二乗和
+    //   a[7][7]       : 点の数
+    struct Accumulator
+    {
+        double a[8][8];
+    };
+
+    struct Equation
+    {
+        double jtj[6][6];
+        double jtr[6];
+        double error;
+        int count;
+    };
+
+    struct ReduceParams
+    {
+        const PointMap* current;
+        const PointMap* reference;
+        CameraIntrinsics intrinsics;
+        RigidTransform cameraToWorld;
+        RigidTransform worldToReference;
+        float distanceThreshold;
+        float minNormalDot;
+    };
+
+    // 行のまとまり(ストライプ)ごとに足し合わせる
+    class ReduceBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        enum { ROWS_PER_STRIPE = 8 };
+
+        ReduceBody( const ReduceParams& params, std::vector<Accumulator>& sums )
+            : params( params )
+            , sums( sums )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            for ( int stripe = range.start; stripe < range.end; ++stripe ){
+                Accumulator& sum = sums[stripe];
+                memset( &sum, 0, sizeof(sum) );
+
+                int end = std::min( (stripe + 1) * ROWS_PER_STRIPE, params.current->height );
+                for ( int y = stripe * ROWS_PER_STRIPE; y < end; ++y ){
+                    reduceRow( y, sum );
+                }
+            }
+        }
+
+    private:
+
+        // 1行分を float で足してから、double に足す
+        void reduceRow( int y, Accumulator& sum ) const
+        {
+            const auto& cur = *params.current;
+            const auto& ref = *params.reference;
+            const auto& K = params.intrinsics;
+            const auto& T = params.cameraToWorld;
+            const auto& R = params.worldToReference;
+            float threshold2 = params.distanceThreshold * params.distanceThreshold;
+
+#ifdef ICP_USE_SSE
+            // 上三角だけなので、0～3行目は8列、4～7行目は後ろの4列を足す
+            // (12個にしてレジスタに収める)
+            __m128 acc[8][2];
+            for ( int i = 0; i < 8; ++i ){
+                acc[i][0] = acc[i][1] = _mm_setzero_ps();
+            }
+#else
+            float acc[8][8] = {};
+#endif
+
+            const Vec3f* points = &cur.points[y * cur.width];
+            const Vec3f* normals = &cur.normals[y * cur.width];
+            for ( int x = 0; x < cur.width; ++x ){
+                if ( !PointMap::isValid( points[x] ) ){
+                    continue;
+                }
+
+                // 参照のカメラに投影して、同じ画素の点と対応させる
+                Vec3f p = T * points[x];
+                Vec3f pr = R * p;
+                if ( pr.z <= 0 ){
+                    continue;
+                }
+
+                float invZ = 1.0f / pr.z;
+                int u = (int)floorf( pr.x * K.fx * invZ + K.cx + 0.5f );
+                int v = (int)floorf( pr.y * K.fy * invZ + K.cy + 0.5f );
+                if ( (u < 0) || (v < 0) || (u >= ref.width) || (v >= ref.height) ){
+                    continue;
+                }
+
+                const Vec3f& q = ref.points[v * ref.width + u];
+                if ( !PointMap::isValid( q ) ){
+                    continue;
+                }
+
+                // 離れすぎている点や、向きが違う面は対応させない
+                const Vec3f& n = ref.normals[v * ref.width + u];
+                Vec3f d = p - q;
+                if ( (dot( d, d ) > threshold2) || (dot( T.rotate( normals[x] ), n ) < params.minNormalDot) ){
+                    continue;
+                }
+
+                // 点と面の距離と、微小な回転・並進についての微分
+                float r = dot( n, d );
+                Vec3f pn = cross( p, n );
+
+#ifdef ICP_USE_SSE
+                __m128 lo = _mm_setr_ps( pn.x, pn.y, pn.z, n.x );
+                __m128 hi = _mm_setr_ps( n.y, n.z, r, 1.0f );
+                float v8[8] = { pn.x, pn.y, pn.z, n.x, n.y, n.z, r, 1.0f };
+                for ( int i = 0; i < 4; ++i ){
+                    __m128 s = _mm_set1_ps( v8[i] );
+                    acc[i][0] = _mm_add_ps( acc[i][0], _mm_mul_ps( s, lo ) );
+                    acc[i][1] = _mm_add_ps( acc[i][1], _mm_mul_ps( s, hi ) );
+                }
+                for ( int i = 4; i < 8; ++i ){
+                    acc[i][1] = _mm_add_ps( acc[i][1], _mm_mul_ps( _mm_set1_ps( v8[i] ), hi ) );
+                }
+#else
+                float v8[8] = { pn.x, pn.y, pn.z, n.x, n.y, n.z, r, 1.0f };
+                for ( int i = 0; i < 8; ++i ){
+                    for ( int j = i; j < 8; ++j ){
+                        acc[i][j] += v8[i] * v8[j];
+                    }
+                }
+#endif
+            }
+
+#ifdef ICP_USE_SSE
+            for ( int i = 0; i < 8; ++i ){
+                float row[8];
+                _mm_storeu_ps( row, acc[i][0] );
+                _mm_storeu_ps( row + 4, acc[i][1] );
+                for ( int j = i; j < 8; ++j ){
+                    sum.a[i][j] += row[j];
+                }
+            }
+#else
+            for ( int i = 0; i < 8; ++i ){
+                for ( int j = i; j < 8; ++j ){
+                    sum.a[i][j] += acc[i][j];
+                }
+            }
+#endif
+        }
+
+    private:
+
+        const ReduceParams& params;
+        std::vector<Accumulator>& sums;
+    };
+
+    void setReferencePose( const CameraIntrinsics& intrinsics, const RigidTransform& cameraToWorld )
+    {
+        referenceIntrinsics = intrinsics;
+        worldToReference = cameraToWorld.inverse();
+        isReferenceSet = true;
+    }
+
+    // 正規方程式を作る
+    Equation reduce( const PointMap& cur, const PointMap& ref, const CameraIntrinsics& intrinsics,
+        const RigidTransform& cameraToWorld )
+    {
+        ReduceParams params;
+        params.current = &cur;
+        params.reference = &ref;
+        params.intrinsics = intrinsics;
+        params.cameraToWorld = cameraToWorld;
+        params.worldToReference = worldToReference;
+        params.distanceThreshold = distanceThreshold;
+        params.minNormalDot = minNormalDot;
+
+        int stripes = (cur.height + ReduceBody::ROWS_PER_STRIPE - 1) / ReduceBody::ROWS_PER_STRIPE;
+        sums.resize( stripes );
+        cv::parallel_for_( cv::Range( 0, stripes ), ReduceBody( params, sums ) );
+
+        // ストライプの順に足すので、スレッドの数によらず同じ結果になる
+        Accumulator total = {};
+        for ( const auto& sum : sums ){
+            for ( int i = 0; i < 8; ++i ){
+                for ( int j = 0; j < 8; ++j ){
+                    total.a[i][j] += sum.a[i][j];
+                }
+            }
+        }
+
+        Equation eq;
+        for ( int i = 0; i < 6; ++i ){
+            for ( int j = 0; j < 6; ++j ){
+                eq.jtj[i][j] = (j >= i) ? total.a[i][j] : total.a[j][i];
+            }
+            eq.jtr[i] = total.a[i][6];
+        }
+        eq.error = total.a[6][6];
+        eq.count = (int)total.a[7][7];
+        return eq;
+    }
+
+    // JtJ x = -Jtr をコレスキー分解で解く
+    static bool solve( const Equation& eq, double x[6] )
+    {
+        double l[6][6] = {};
+        for ( int i = 0; i < 6; ++i ){
+            for ( int j = 0; j <= i; ++j ){
+                double s = eq.jtj[i][j];
+                for ( int k = 0; k < j; ++k ){
+                    s -= l[i][k] * l[j][k];
+                }
+
+                if ( i == j ){
+                    if ( s <= 1e-12 ){
+                        return false;
+                    }
+                    l[i][i] = sqrt( s );
+                }
+                else {
+                    l[i][j] = s / l[j][j];
+                }
+            }
+        }
+
+        double y[6];
+        for ( int i = 0; i < 6; ++i ){
+            double s = -eq.jtr[i];
+            for ( int k = 0; k < i; ++k ){
+                s -= l[i][k] * y[k];
+            }
+            y[i] = s / l[i][i];
+        }
+
+        for ( int i = 5; i >= 0; --i ){
+            double s = y[i];
+            for ( int k = i + 1; k < 6; ++k ){
+                s -= l[k][i] * x[k];
+            }
+            x[i] = s / l[i][i];
+        }
+        return true;
+    }
+
+    // デプス画像から段ごとの点と法線(カメラ座標系)を作る
+    void buildPyramid( const cv::Mat& depth, const CameraIntrinsics& intrinsics,
+        float depthScale, float maxDepth, PointMap* maps )
+    {
+        // 一番細かい段のデプス[m]
+        depthLevels[0].resize( depth.rows * depth.cols );
+        for ( int y = 0; y < depth.rows; ++y ){
+            const unsigned short* row = depth.ptr<unsigned short>( y );
+            float* dst = &depthLevels[0][y * depth.cols];
+            for ( int x = 0; x < depth.cols; ++x ){
+                float d = row[x] * depthScale;
+                dst[x] = (d <= maxDepth) ? d : 0;
+            }
+        }
+
+        int width = depth.cols, height = depth.rows;
+        for ( int level = 0; level < LEVELS; ++level ){
+            if ( level > 0 ){
+                halveDepth( depthLevels[level - 1], width, height, depthLevels[level] );
+                width /= 2;
+                height /= 2;
+            }
+
+            computePoints( depthLevels[level], width, height, intrinsics.scaled( level ), maps[level] );
+        }
+    }
+
+    // デプスを縦横半分にする(2x2 の中で近いデプスだけを平均して、物の境目をぼかさない)
+    static void halveDepth( const std::vector<float>& src, int width, int height, std::vector<float>& dst )
+    {
+        const float MAX_DIFFERENCE = 0.03f;
+
+        int w = width / 2, h = height / 2;
+        dst.assign( w * h, 0.0f );
+        for ( int y = 0; y < h; ++y ){
+            for ( int x = 0; x < w; ++x ){
+                const float* s = &src[(y * 2) * width + x * 2];
+                float block[4] = { s[0], s[1], s[width], s[width + 1] };
+
+                float center = 0;
+                for ( int i = 0; (i < 4) && (center == 0); ++i ){
+                    center = block[i];
+                }
+
+                float sum = 0;
+                int count = 0;
+                for ( int i = 0; i < 4; ++i ){
+                    if ( (block[i] > 0) && (fabsf( block[i] - center ) < MAX_DIFFERENCE) ){
+                        sum += block[i];
+                        ++count;
+                    }
+                }
+                dst[y * w + x] = (count > 0) ? (sum / count) : 0;
+            }
+        }
+    }
+
+    // デプスから点を、隣の点との差から法線を求める
+    static void computePoints( const std::vector<float>& depth, int width, int height,
+        const CameraIntrinsics& K, PointMap& map )
+    {
+        const float MAX_DIFFERENCE = 0.05f;
+
+        map.create( width, height );
+        for ( int y = 0; y < height; ++y ){
+            for ( int x = 0; x < width; ++x ){
+                float d = depth[y * width + x];
+                if ( d > 0 ){
+                    map.points[y * width + x] = makeVec3f(
+                        (x - K.cx) / K.fx * d, (y - K.cy) / K.fy * d, d );
+                }
+            }
+        }
+
+        for ( int y = 0; y < height - 1; ++y ){
+            for ( int x = 0; x < width - 1; ++x ){
+                int i = y * width + x;
+                float d = depth[i], dr = depth[i + 1], dd = depth[i + width];
+                if ( (d <= 0) || (dr <= 0) || (dd <= 0) ||
+                     (fabsf( dr - d ) > MAX_DIFFERENCE) || (fabsf( dd - d ) > MAX_DIFFERENCE) ){
+                    continue;
+                }
+
+                const Vec3f& p = map.points[i];
+                Vec3f n = normalize( cross( map.points[i + 1] - p, map.points[i + width] - p ) );
+
+                // 法線はカメラの方を向ける
+                map.normals[i] = (dot( n, p ) > 0) ? n * -1.0f : n;
+            }
+        }
+
+        // 法線が求まらなかった点は使わない
+        float nan = std::numeric_limits<float>::quiet_NaN();
+        for ( size_t i = 0; i < map.points.size(); ++i ){
+            const Vec3f& n = map.normals[i];
+            if ( (n.x == 0) && (n.y == 0) && (n.z == 0) ){
+                map.points[i] = makeVec3f( nan, nan, nan );
+            }
+        }
+    }
+
+    // 点と法線を縦横半分にする
+    static void downsample( const PointMap& src, PointMap& dst )
+    {
+        const float MAX_DIFFERENCE = 0.03f;
+
+        dst.create( src.width / 2, src.height / 2 );
+        for ( int y = 0; y < dst.height; ++y ){
+            for ( int x = 0; x < dst.width; ++x ){
+                int base = (y * 2) * src.width + x * 2;
+                int block[4] = { base, base + 1, base + src.width, base + src.width + 1 };
+
+                const Vec3f* center = nullptr;
+                Vec3f p = makeVec3f( 0, 0, 0 ), n = makeVec3f( 0, 0, 0 );
+                int count = 0;
+                for ( int i = 0; i < 4; ++i ){
+                    const Vec3f& s = src.points[block[i]];
+                    if ( !PointMap::isValid( s ) ){
+                        continue;
+                    }
+                    if ( center == nullptr ){
+                        center = &s;
+                    }
+                    if ( length( s - *center ) < MAX_DIFFERENCE ){
+                        p = p + s;
+                        n = n + src.normals[block[i]];
+                        ++count;
+                    }
+                }
+
+                if ( count > 0 ){
+                    dst.points[y * dst.width + x] = p * (1.0f / count);
+                    dst.normals[y * dst.width + x] = normalize( n );
+                }
+            }
+        }
+    }
+
+private:
+
+    float distanceThreshold;
+    float minNormalDot;
+    int iterations[LEVELS];
+
+    // 参照
+    PointMap reference[LEVELS];
+    CameraIntrinsics referenceIntrinsics;
+    RigidTransform worldToReference;
+    bool isReferenceSet = false;
+
+    // 今のフレーム
+    PointMap current[LEVELS];
+    std::vector<float> depthLevels[LEVELS];
+
+    std::vector<Accumulator> sums;
+};
@@ -7,12 +7,22 @@
 
 #include <opencv2\opencv.hpp>
 
+#include "scan_profiler.h"
+#include "scan_log.h"
+#include "reconstruct_worker.h"
+#include "tsdf_volume.h"
+#include "icp_tracker.h"
+
 class RealSenseAsenseManager
 {
 public:
 
     ~RealSenseAsenseManager()
     {
+        // 쐬̃f͎̂Ă(XLi[OɏI点)
+        reconstructWorker.cancel();
+        reconstructWorker.wait();
+
         if ( scanner != nullptr ){
             scanner->Release();
             scanner = nullptr;
@@ -56,6 +66,18 @@ public:
     {
         // C[v
         while ( 1 ) {
+            // t[̊ԊuL^(f̍쐬́A쐬̂ƂɕʂɂL^)
+            double interval = profiler.frame();
+            if ( interval > 0 ){
+                if ( isSyncReconstructed ){
+                    profiler.record( syncExportFrameStage, interval );
+                }
+                else if ( reconstructWorker.isRunning() ){
+                    profiler.record( backgroundExportFrameStage, interval );
+                }
+            }
+            isSyncReconstructed = false;
+
             // t[f[^XV
             updateFrame();
 
@@ -64,7 +86,16 @@ public:
             if ( !ret ){
                 break;
             }
+
+            // obNOEhł̃f̍쐬ImF
+            checkReconstruct();
+
+            // vʂIɏo
+            profiler.dumpIfDue( "scan_profile", 5.0 );
         }
+
+        // ȑÕOƍ̌vʂr
+        writeReport();
     }
 
 private:
@@ -92,13 +123,25 @@ private:
     void updateFrame()
     {
         // t[擾
-        pxcStatus sts = senseManager->AcquireFrame( false );
+        pxcStatus sts;
+        {
+            ScanProfiler::Scope scope( profiler, acquireStage );
+            sts = senseManager->AcquireFrame( false );
+        }
         if ( sts < PXC_STATUS_NO_ERROR ) {
             return;
         }
 
         // t[f[^擾
-        updateColorImage( scanner->AcquirePreviewImage() );
+        {
+            ScanProfiler::Scope scope( profiler, previewStage );
+            updateColorImage( scanner->AcquirePreviewImage() );
+        }
+
+        // OTSDFɃfvX𓝍
+        if ( isNativeFusion ){
+            integrateNative( senseManager->QuerySample() );
+        }
 
         // t[
         senseManager->ReleaseFrame();
@@ -129,9 +172,132 @@ private:
         colorFrame->ReleaseAccess( &data );
     }
 
+    // fvX摜OTSDFɓ
+    // (J̎ṕAfCLXg_Ɩ@ɑ΂ICPŋ߂)
+    void integrateNative( const PXCCapture::Sample* sample )
+    {
+        if ( (sample == nullptr) || (sample->depth == nullptr) ){
+            return;
+        }
+
+        PXCImage::ImageInfo info = sample->depth->QueryInfo();
+
+        // f[^擾
+        PXCImage::ImageData data;
+        pxcStatus sts = sample->depth->AcquireAccess( PXCImage::Access::ACCESS_READ,
+            PXCImage::PixelFormat::PIXEL_FORMAT_DEPTH, &data );
+        if ( sts < PXC_STATUS_NO_ERROR ) {
+            throw std::runtime_error("Depth摜̎擾Ɏs");
+        }
+
+        // f[^Rs[
+        depthImage.create( info.height, info.width, CV_16UC1 );
+        for ( int y = 0; y < info.height; ++y ){
+            memcpy( depthImage.ptr<unsigned short>( y ),
+                data.planes[0] + y * data.pitches[0], info.width * sizeof(unsigned short) );
+        }
+
+        // f[^
+        sample->depth->ReleaseAccess( &data );
+
+        // p[^[̓foCX擾
+        // (~[\ōE]Ă̂ŁAfx 𕉂ɂČɖ߂)
+        auto device = senseManager->QueryCaptureManager()->QueryDevice();
+        PXCPointF32 focal = device->QueryDepthFocalLength();
+        PXCPointF32 center = device->QueryDepthPrincipalPoint();
+        CameraIntrinsics intrinsics = { info.width, info.height,
+            -focal.x, focal.y, info.width - 1 - center.x, center.y };
+
+        // fɍ킹ăJ̎p߂(CLXg͏cōs)
+        if ( volume.getBrickCount() > 0 ){
+            ScanProfiler::Scope scope( profiler, trackStage );
+
+            CameraIntrinsics half = intrinsics.scaled( 1 );
+            volume.raycast( half, nativePose, modelPoints );
+            tracker.setReference( modelPoints, half, nativePose );
+            trackResult = tracker.track( depthImage, intrinsics, nativePose );
+
+            // 瓝Ȃ(̎pɖ߂Ă̂҂)
+            if ( !trackResult.isTracked ){
+                return;
+            }
+        }
+
+        ScanProfiler::Scope scope( profiler, nativeStage );
+        volume.integrate( depthImage, intrinsics, nativePose );
+    }
+
+    // OTSDF烁bVoĕۑ
+    void saveNativeMesh()
+    {
+        static const char* extensions[] = { "obj", "stl", "ply" };
+
+        ScanMesh::Format format = ScanMesh::FORMAT_OBJ;
+        if ( fileFormat == PXC3DScan::FileFormat::STL ){
+            format = ScanMesh::FORMAT_STL;
+        }
+        else if ( fileFormat == PXC3DScan::FileFormat::PLY ){
+            format = ScanMesh::FORMAT_PLY;
+        }
+
+        // t@C쐬
+        char fileTitle[MAX_PATH];
+        GetTimeFormatA( LOCALE_USER_DEFAULT, 0, 0, "hhmmss", fileTitle, _countof( fileTitle ) );
+
+        std::stringstream ss;
+        ss << "native-" << fileTitle << "." << extensions[format];
+
+        ScanMesh mesh;
+        volume.extractMesh( mesh );
+
+        // of[^̍쐬͕ɍs
+        int64 start = cv::getTickCount();
+        if ( !mesh.save( ss.str(), format, true ) ){
+            std::cout << ss.str() << " ̕ۑɎs܂" << std::endl;
+            return;
+        }
+        double ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+
+        std::cout << "create " << ss.str() << " (" << mesh.vertices.size() << " vertices, "
+                  << mesh.triangleCount() << " triangles, " << ms << " ms)" << std::endl;
+    }
+
     // 摜\
     bool showImage()
     {
+        // Ԃ\
+        if ( showProfile && !colorImage.empty() ){
+            profiler.drawOverlay( colorImage );
+        }
+
+        // f̍쐬͌o߂\
+        if ( reconstructWorker.isRunning() && !colorImage.empty() ){
+            std::stringstream ss;
+            ss << "reconstructing... " << (int)(reconstructWorker.elapsedMs() / 1000) << " s, "
+               << (reconstructWorker.writtenBytes() / 1024) << " KB (c : cancel)";
+            cv::putText( colorImage, ss.str(), cv::Point( 10, colorImage.rows - 10 ),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar( 0, 255, 255 ) );
+        }
+
+        // OTSDF̏Ԃ\
+        if ( isNativeFusion && !colorImage.empty() ){
+            std::stringstream ss;
+            ss.precision( 1 );
+            ss << std::fixed << "native fusion : " << volume.getBrickCount() << " bricks, "
+               << (volume.getMemoryBytes() / (1024.0 * 1024.0)) << " MB, "
+               << volume.lastIntegrateMs() << " ms (m : save)";
+            cv::putText( colorImage, ss.str(), cv::Point( 10, colorImage.rows - 30 ),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar( 0, 255, 255 ) );
+
+            std::stringstream ts;
+            ts.precision( 1 );
+            ts << std::fixed << "icp : " << (trackResult.isTracked ? "tracked" : "lost") << ", "
+               << trackResult.iterations << " iterations, " << (trackResult.inlierRatio * 100) << " %, "
+               << (trackResult.rmse * 1000) << " mm, " << trackResult.ms << " ms";
+            cv::putText( colorImage, ts.str(), cv::Point( 10, colorImage.rows - 50 ),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar( 0, 255, 255 ) );
+        }
+
         // \
         cv::imshow( "Color Image", colorImage );
 
@@ -140,6 +306,10 @@ private:
             // ESC|q|Q for Exit
             return false;
         }
+        else if ( ((c == 't') || (c == 's')) && reconstructWorker.isRunning() ){
+            // f̍쐬̓XLi[̐ݒςȂ(Reconstruct()ƓɌĂ΂Ȃ)
+            std::cout << "f̍쐬ł" << std::endl;
+        }
         else if ( c == 't' ) {
             // ^[QbgIvVύX
             auto option = scanner->QueryTargetingOptions();
@@ -174,6 +344,32 @@ private:
             // f쐬
             reconstruct();
         }
+        else if ( c == 'p' ){
+            // Ԃ̕\؂ւ
+            showProfile = !showProfile;
+        }
+        else if ( c == 'b' ){
+            // fobNOEhō쐬邩؂ւ
+            isBackgroundReconstruct = !isBackgroundReconstruct;
+            std::cout << "Background Reconstruct : " << isBackgroundReconstruct << std::endl;
+        }
+        else if ( c == 'c' ){
+            // obNOEhł̃f̍쐬LZ
+            reconstructWorker.cancel();
+        }
+        else if ( c == 'n' ){
+            // OTSDFւ̓؂ւ(n߂Ƃ͋ɂ)
+            isNativeFusion = !isNativeFusion;
+            if ( isNativeFusion ){
+                volume.reset();
+                nativePose = RigidTransform::identity();
+            }
+            std::cout << "Native Fusion : " << isNativeFusion << std::endl;
+        }
+        else if ( c == 'm' ){
+            // OTSDF烂f쐬
+            saveNativeMesh();
+        }
 
         return true;
     }
@@ -262,15 +458,97 @@ private:
         std::wstringstream ss;
         ss << L"model-" << fileTitle << L"." << PXC3DScan::FileFormatToString( fileFormat );
 
+        // obNOEh3Df쐬
+        if ( isBackgroundReconstruct ){
+            if ( !reconstructWorker.start( scanner, fileFormat, ss.str(), reconstructionOption ) ){
+                std::cout << "f̍쐬ł" << std::endl;
+                return;
+            }
+
+            std::wcout << L"create " << ss.str() << L" in background..." << std::endl;
+            return;
+        }
+
         std::wcout << L"create " << ss.str() << "...";
 
 
         // 3Df쐬
-        scanner->Reconstruct( fileFormat, ss.str().c_str(), reconstructionOption );
+        {
+            ScanProfiler::Scope scope( profiler, reconstructStage );
+            scanner->Reconstruct( fileFormat, ss.str().c_str(), reconstructionOption );
+        }
+        isSyncReconstructed = true;
 
         std::cout << "done." << std::endl;
     }
 
+    // obNOEhł̃f̍쐬IAʂ\
+    void checkReconstruct()
+    {
+        auto state = reconstructWorker.getState();
+        if ( state == lastReconstructState ){
+            return;
+        }
+        lastReconstructState = state;
+
+        if ( state == ReconstructWorker::STATE_SUCCEEDED ){
+            profiler.record( reconstructStage, reconstructWorker.elapsedMs() );
+            std::wcout << L"create " << reconstructWorker.getFileName() << L" done. ("
+                       << reconstructWorker.elapsedMs() << L" ms)" << std::endl;
+        }
+        else if ( state == ReconstructWorker::STATE_FAILED ){
+            std::wcout << L"create " << reconstructWorker.getFileName() << L" failed." << std::endl;
+        }
+        else if ( state == ReconstructWorker::STATE_CANCELED ){
+            std::wcout << L"create " << reconstructWorker.getFileName() << L" canceled." << std::endl;
+        }
+    }
+
+    // SDK̃O(Logs/fuse.txt, Logs/frames.txt)ƍ̌vʂׂĕ\
+    void writeReport()
+    {
+        std::vector<ScanLog> sessions;
+
+        ScanLog history;
+        history.name = "Logs";
+        if ( history.load( "Logs/fuse.txt", "Logs/frames.txt" ) ){
+            sessions.push_back( history );
+        }
+
+        sessions.push_back( ScanLog::fromProfiler( profiler, "Live" ) );
+
+        ScanLog::writeReport( std::cout, sessions );
+        writeExportGapReport( std::cout );
+
+        std::ofstream ofs( "scan_report.txt" );
+        ScanLog::writeReport( ofs, sessions );
+        writeExportGapReport( ofs );
+    }
+
+    // f̍쐬Ƀvr[~܂ԂA쐬̂Ƃɔׂ
+    //   sync       : L[̒ō쐬(쐬̊ԂƎ~܂)
+    //   background : obNOEhō쐬
+    void writeExportGapReport( std::ostream& os )
+    {
+        os << "\nPreview gap during export [ms]\n";
+        for ( const auto& summary : profiler.summarize() ){
+            if ( (summary.name != "FrameDuringExport(sync)") &&
+                 (summary.name != "FrameDuringExport(background)") ){
+                continue;
+            }
+
+            os << std::setw( 30 ) << std::left << summary.name << std::right;
+            if ( summary.count == 0 ){
+                os << "  -\n";
+                continue;
+            }
+
+            os << "  frames " << std::setw( 6 ) << summary.count
+               << "  p95 " << std::setw( 10 ) << summary.p95Ms
+               << "  max " << std::setw( 10 ) << summary.maxMs << "\n";
+        }
+    }
+
 private:
 
     cv::Mat colorImage;
@@ -280,6 +558,34 @@ private:
     PXC3DScan::ReconstructionOption reconstructionOption =
         PXC3DScan::ReconstructionOption::NO_RECONSTRUCTION_OPTIONS;
     PXC3DScan::FileFormat fileFormat = PXC3DScan::FileFormat::OBJ;
+
+    // Ԃ̌v
+    ScanProfiler profiler;
+    int acquireStage = profiler.addStage( "AcquireFrame" );
+    int previewStage = profiler.addStage( "Preview" );
+    int reconstructStage = profiler.addStage( "Reconstruct" );
+    int syncExportFrameStage = profiler.addStage( "FrameDuringExport(sync)" );
+    int backgroundExportFrameStage = profiler.addStage( "FrameDuringExport(background)" );
+    int nativeStage = profiler.addStage( "NativeIntegrate" );
+    int trackStage = profiler.addStage( "NativeTrack" );
+    bool showProfile = true;
+
+    // f̃obNOEhł̍쐬
+    ReconstructWorker reconstructWorker;
+    ReconstructWorker::State lastReconstructState = ReconstructWorker::STATE_IDLE;
+    bool isBackgroundReconstruct = true;
+    bool isSyncReconstructed = false;
+
+    // SDKgȂfvX̓
+    TsdfVolume volume;
+    cv::Mat depthImage;
+    bool isNativeFusion = false;
+
+    // ICPɂJ̎p̐
+    IcpTracker tracker;
+    PointMap modelPoints;
+    RigidTransform nativePose = RigidTransform::identity();
+    IcpTracker::Result trackResult = {};
 };
 
 void main()
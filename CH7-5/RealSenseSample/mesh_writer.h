@@ -0,0 +1,342 @@
+﻿// メッシュの書き出し(PLY / STL / OBJ)
+//
+// ストリームに値を1つずつ << で書くと、数百万の三角形では書き出しに時間がかかる。
+// バイナリ(PLY, STL)はまとまった大きさのブロックを作って一度に書き、
+// テキスト(OBJ)は数値を自前で文字列にしてから、まとめて書く。
+// 並列モードでは、ブロックの作成と文字列への変換を cv::parallel_for_ で分担する。
+// 頂点などは配列で受け取るので、ScanMesh 以外(ofMesh など)のデータもそのまま書き出せる。
+// バイナリはリトルエンディアンのCPU(x86/x64)を前提にしている。
+#pragma once
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "scan_math.h"
+
+// 書き出すメッシュ(normals は nullptr でもよい)
+struct MeshData
+{
+    const Vec3f* vertices;
+    const Vec3f* normals;           // 頂点ごとの法線
+    size_t vertexCount;
+    const unsigned int* indices;    // 三角形の頂点番号(3つずつ)
+    size_t indexCount;
+
+    size_t triangleCount() const
+    {
+        return indexCount / 3;
+    }
+};
+
+class MeshWriter
+{
+public:
+
+    //   isParallel : ブロックの作成や文字列への変換を並列に行う
+    //   decimals   : OBJ の小数点以下の桁数
+    MeshWriter( bool isParallel = false, int decimals = 6 )
+        : isParallel( isParallel )
+        , decimals( std::min( std::max( decimals, 0 ), 9 ) )
+    {
+    }
+
+    // バイナリPLY
+    bool writePly( const std::string& path, const MeshData& mesh ) const
+    {
+        std::ofstream ofs( path, std::ios::binary );
+        if ( !ofs ){
+            return false;
+        }
+
+        bool hasNormal = (mesh.normals != nullptr);
+        std::stringstream header;
+        header << "ply\nformat binary_little_endian 1.0\n"
+               << "element vertex " << mesh.vertexCount << "\n"
+               << "property float x\nproperty float y\nproperty float z\n";
+        if ( hasNormal ){
+            header << "property float nx\nproperty float ny\nproperty float nz\n";
+        }
+        header << "element face " << mesh.triangleCount() << "\n"
+               << "property list uchar int vertex_indices\n"
+               << "end_header\n";
+        ofs << header.str();
+
+        // 頂点(法線がなければ配列をそのまま書く)
+        if ( !hasNormal ){
+            ofs.write( (const char*)mesh.vertices, mesh.vertexCount * sizeof(Vec3f) );
+        }
+        else {
+            writeBlocks( ofs, mesh.vertexCount, 24, [&]( size_t begin, size_t end, char* out ) -> size_t {
+                for ( size_t i = begin; i < end; ++i, out += 24 ){
+                    memcpy( out, &mesh.vertices[i], 12 );
+                    memcpy( out + 12, &mesh.normals[i], 12 );
+                }
+                return (end - begin) * 24;
+            } );
+        }
+
+        // 面(頂点の数 + 頂点番号3つ)
+        writeBlocks( ofs, mesh.triangleCount(), 13, [&]( size_t begin, size_t end, char* out ) -> size_t {
+            for ( size_t i = begin; i < end; ++i, out += 13 ){
+                out[0] = 3;
+                memcpy( out + 1, &mesh.indices[i * 3], 12 );
+            }
+            return (end - begin) * 13;
+        } );
+
+        return ofs.good();
+    }
+
+    // バイナリSTL
+    bool writeStl( const std::string& path, const MeshData& mesh ) const
+    {
+        std::ofstream ofs( path, std::ios::binary );
+        if ( !ofs ){
+            return false;
+        }
+
+        char header[80] = "RealSenseSample";
+        ofs.write( header, sizeof(header) );
+
+        unsigned int count = (unsigned int)mesh.triangleCount();
+        ofs.write( (const char*)&count, 4 );
+
+        // 面の法線 + 頂点3つ + 属性(2バイト)
+        writeBlocks( ofs, mesh.triangleCount(), 50, [&]( size_t begin, size_t end, char* out ) -> size_t {
+            for ( size_t i = begin; i < end; ++i, out += 50 ){
+                const Vec3f& a = mesh.vertices[mesh.indices[i * 3]];
+                const Vec3f& b = mesh.vertices[mesh.indices[i * 3 + 1]];
+                const Vec3f& c = mesh.vertices[mesh.indices[i * 3 + 2]];
+                Vec3f n = normalize( cross( b - a, c - a ) );
+
+                memcpy( out, &n, 12 );
+                memcpy( out + 12, &a, 12 );
+                memcpy( out + 24, &b, 12 );
+                memcpy( out + 36, &c, 12 );
+                out[48] = out[49] = 0;
+            }
+            return (end - begin) * 50;
+        } );
+
+        return ofs.good();
+    }
+
+    // OBJ(テキスト)
+    bool writeObj( const std::string& path, const MeshData& mesh ) const
+    {
+        std::ofstream ofs( path, std::ios::binary );
+        if ( !ofs ){
+            return false;
+        }
+
+        // 1行の長さの上限(数値は符号と整数部10桁、小数点以下9桁まで)
+        const size_t VERTEX_LINE = 2 + 3 * 22;
+        const size_t FACE_LINE = 2 + 3 * 24;
+
+        writeBlocks( ofs, mesh.vertexCount, VERTEX_LINE, [&]( size_t begin, size_t end, char* out ) -> size_t {
+            char* p = out;
+            for ( size_t i = begin; i < end; ++i ){
+                p = writeVector( p, "v ", mesh.vertices[i] );
+            }
+            return p - out;
+        } );
+
+        if ( mesh.normals != nullptr ){
+            writeBlocks( ofs, mesh.vertexCount, VERTEX_LINE + 1, [&]( size_t begin, size_t end, char* out ) -> size_t {
+                char* p = out;
+                for ( size_t i = begin; i < end; ++i ){
+                    p = writeVector( p, "vn ", mesh.normals[i] );
+                }
+                return p - out;
+            } );
+        }
+
+        bool hasNormal = (mesh.normals != nullptr);
+        writeBlocks( ofs, mesh.triangleCount(), FACE_LINE, [&]( size_t begin, size_t end, char* out ) -> size_t {
+            char* p = out;
+            for ( size_t i = begin; i < end; ++i ){
+                *p++ = 'f';
+                for ( int k = 0; k < 3; ++k ){
+                    unsigned long long index = mesh.indices[i * 3 + k] + 1ULL;
+                    *p++ = ' ';
+                    p = writeUInt( p, index );
+                    if ( hasNormal ){
+                        *p++ = '/';
+                        *p++ = '/';
+                        p = writeUInt( p, index );
+                    }
+                }
+                *p++ = '\n';
+            }
+            return p - out;
+        } );
+
+        return ofs.good();
+    }
+
+private:
+
+    enum
+    {
+        ITEMS_PER_CHUNK = 64 * 1024,    // 1つのチャンク(並列に処理する単位)の要素の数
+        CHUNKS_PER_BATCH = 16,          // 一度に作って書き出すチャンクの数
+    };
+
+    // チャンクを作る処理を cv::parallel_for_ で呼べるようにする
+    template<typename Fill>
+    class ChunkBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        ChunkBody( const Fill& fill, size_t first, size_t count, size_t itemBytes,
+            std::vector<char>& buffer, std::vector<size_t>& sizes )
+            : fill( fill )
+            , first( first )
+            , count( count )
+            , itemBytes( itemBytes )
+            , buffer( buffer )
+            , sizes( sizes )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            for ( int c = range.start; c < range.end; ++c ){
+                size_t begin = first + c * (size_t)ITEMS_PER_CHUNK;
+                size_t end = std::min( begin + ITEMS_PER_CHUNK, first + count );
+                char* out = &buffer[c * (size_t)ITEMS_PER_CHUNK * itemBytes];
+                sizes[c] = fill( begin, end, out );
+            }
+        }
+
+    private:
+
+        ChunkBody& operator=( const ChunkBody& );
+
+        const Fill& fill;
+        size_t first;
+        size_t count;
+        size_t itemBytes;
+        std::vector<char>& buffer;
+        std::vector<size_t>& sizes;
+    };
+
+    // count 個の要素をチャンクに分けて作り、まとめて書き出す
+    //   itemBytes : 1つの要素の大きさ(テキストなら上限)
+    //   fill      : [begin, end) の要素を out に書いて、書いた大きさを返す
+    template<typename Fill>
+    void writeBlocks( std::ofstream& ofs, size_t count, size_t itemBytes, const Fill& fill ) const
+    {
+        const size_t BATCH_ITEMS = (size_t)ITEMS_PER_CHUNK * CHUNKS_PER_BATCH;
+
+        std::vector<char> buffer( std::min( count, BATCH_ITEMS ) * itemBytes );
+        std::vector<size_t> sizes( CHUNKS_PER_BATCH );
+        for ( size_t first = 0; first < count; first += BATCH_ITEMS ){
+            size_t n = std::min( BATCH_ITEMS, count - first );
+            int chunks = (int)((n + ITEMS_PER_CHUNK - 1) / ITEMS_PER_CHUNK);
+
+            ChunkBody<Fill> body( fill, first, n, itemBytes, buffer, sizes );
+            if ( isParallel ){
+                cv::parallel_for_( cv::Range( 0, chunks ), body );
+            }
+            else {
+                body( cv::Range( 0, chunks ) );
+            }
+
+            // 大きさが決まっているチャンクは続いているので、一度に書く
+            for ( int c = 0; c < chunks; ){
+                size_t offset = c * (size_t)ITEMS_PER_CHUNK * itemBytes;
+                size_t size = sizes[c];
+                while ( (++c < chunks) && (size == (size_t)ITEMS_PER_CHUNK * itemBytes * c - offset) ){
+                    size += sizes[c];
+                }
+                ofs.write( &buffer[offset], size );
+            }
+        }
+    }
+
+    // "v x y z\n" を書く
+    char* writeVector( char* p, const char* tag, const Vec3f& v ) const
+    {
+        while ( *tag != '\0' ){
+            *p++ = *tag++;
+        }
+        p = writeFloat( p, v.x );
+        *p++ = ' ';
+        p = writeFloat( p, v.y );
+        *p++ = ' ';
+        p = writeFloat( p, v.z );
+        *p++ = '\n';
+        return p;
+    }
+
+    // 小数点以下 decimals 桁の固定小数点で書く(末尾の0は書かない)
+    char* writeFloat( char* p, float value ) const
+    {
+        static const double SCALES[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+        // NaNや大きすぎる値はめったにないので、標準の変換を使う
+        if ( !(fabsf( value ) < 1e9f) ){
+            std::stringstream ss;
+            ss << value;
+            std::string s = ss.str();
+            memcpy( p, s.c_str(), std::min( s.size(), (size_t)20 ) );
+            return p + std::min( s.size(), (size_t)20 );
+        }
+
+        double v = value;
+        if ( v < 0 ){
+            *p++ = '-';
+            v = -v;
+        }
+
+        unsigned long long scale = (unsigned long long)SCALES[decimals];
+        unsigned long long scaled = (unsigned long long)(v * SCALES[decimals] + 0.5);
+        p = writeUInt( p, scaled / scale );
+
+        unsigned long long fraction = scaled % scale;
+        if ( fraction == 0 ){
+            return p;
+        }
+
+        // 小数部を前を0で埋めて書いてから、末尾の0を削る
+        *p++ = '.';
+        for ( int i = decimals - 1; i >= 0; --i ){
+            p[i] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        p += decimals;
+        while ( p[-1] == '0' ){
+            --p;
+        }
+        return p;
+    }
+
+    static char* writeUInt( char* p, unsigned long long value )
+    {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = (char)('0' + value % 10);
+            value /= 10;
+        } while ( value != 0 );
+
+        while ( n > 0 ){
+            *p++ = digits[--n];
+        }
+        return p;
+    }
+
+private:
+
+    bool isParallel;
+    int decimals;
+};
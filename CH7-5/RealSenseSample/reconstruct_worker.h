@@ -0,0 +1,164 @@
+﻿// 3Dモデルの作成をバックグラウンドで行う
+//
+// PXC3DScan::Reconstruct() は終わるまで戻らないので、別のスレッドで呼び出して
+// プレビューのループを止めないようにする。
+// モデルは一時ファイルに書き出し、書き終わってから本来の名前に置き換える(MoveFileEx)ので、
+// 途中で終了しても書きかけのファイルが本来の名前で残ることはない。
+// Reconstruct() を途中で止める方法はないため、キャンセルすると書き終わった後に一時ファイルを捨てる。
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "pxcsensemanager.h"
+
+#include <opencv2\opencv.hpp>
+
+class ReconstructWorker
+{
+public:
+
+    enum State
+    {
+        STATE_IDLE = 0,     // 何もしていない
+        STATE_RUNNING,      // 作成中
+        STATE_SUCCEEDED,    // 作成した
+        STATE_FAILED,       // 失敗した
+        STATE_CANCELED,     // キャンセルした
+    };
+
+    ReconstructWorker()
+    {
+        state.store( STATE_IDLE );
+        canceled.store( false );
+    }
+
+    ~ReconstructWorker()
+    {
+        wait();
+    }
+
+    // モデルの作成を始める(作成中ならfalseを返す)
+    bool start( PXC3DScan* scanner, PXC3DScan::FileFormat fileFormat,
+        const std::wstring& fileName, PXC3DScan::ReconstructionOption option )
+    {
+        if ( isRunning() ){
+            return false;
+        }
+        wait();
+
+        this->fileName = fileName;
+        tempFileName = makeTempFileName( fileName );
+        canceled.store( false );
+        startTime = cv::getTickCount();
+        state.store( STATE_RUNNING );
+
+        worker = std::thread( [=]{
+            auto sts = scanner->Reconstruct( fileFormat, tempFileName.c_str(), option );
+            finish( sts >= PXC_STATUS_NO_ERROR );
+        } );
+        return true;
+    }
+
+    // キャンセルする(作成が終わったら一時ファイルを捨てる)
+    void cancel()
+    {
+        canceled.store( true );
+    }
+
+    // 作成が終わるまで待つ
+    void wait()
+    {
+        if ( worker.joinable() ){
+            worker.join();
+        }
+    }
+
+    bool isRunning() const
+    {
+        return state.load() == STATE_RUNNING;
+    }
+
+    State getState() const
+    {
+        return (State)state.load();
+    }
+
+    // 作成を始めてからの時間[ms](終わっていれば作成にかかった時間)
+    double elapsedMs() const
+    {
+        int64 end = isRunning() ? cv::getTickCount() : endTime;
+        return (end - startTime) * 1000.0 / cv::getTickFrequency();
+    }
+
+    // 一時ファイルに書き出したサイズ[byte](進み具合の目安)
+    unsigned long long writtenBytes() const
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if ( !GetFileAttributesExW( tempFileName.c_str(), GetFileExInfoStandard, &data ) ){
+            return 0;
+        }
+
+        return ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    }
+
+    const std::wstring& getFileName() const
+    {
+        return fileName;
+    }
+
+private:
+
+    ReconstructWorker( const ReconstructWorker& );
+    ReconstructWorker& operator=( const ReconstructWorker& );
+
+    // model.obj -> model.part.obj (拡張子でフォーマットを判断するソフトのために残す)
+    static std::wstring makeTempFileName( const std::wstring& fileName )
+    {
+        auto dot = fileName.rfind( L'.' );
+        if ( dot == std::wstring::npos ){
+            return fileName + L".part";
+        }
+
+        return fileName.substr( 0, dot ) + L".part" + fileName.substr( dot );
+    }
+
+    // ワーカースレッドで呼ぶ
+    void finish( bool isSucceeded )
+    {
+        State result;
+        if ( canceled.load() ){
+            DeleteFileW( tempFileName.c_str() );
+            result = STATE_CANCELED;
+        }
+        else if ( !isSucceeded ){
+            DeleteFileW( tempFileName.c_str() );
+            result = STATE_FAILED;
+        }
+        else if ( !MoveFileExW( tempFileName.c_str(), fileName.c_str(),
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) ){
+            result = STATE_FAILED;
+        }
+        else {
+            result = STATE_SUCCEEDED;
+        }
+
+        endTime = cv::getTickCount();
+        state.store( result );
+    }
+
+private:
+
+    std::wstring fileName;
+    std::wstring tempFileName;
+
+    int64 startTime = 0;
+    int64 endTime = 0;
+
+    std::atomic<int> state;
+    std::atomic<bool> canceled;
+    std::thread worker;
+};
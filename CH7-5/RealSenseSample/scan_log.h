@@ -0,0 +1,183 @@
+﻿// 3Dスキャンのログの読み込みと比較
+//
+// SDKが書き出す Logs/fuse.txt(ステージごとの時間)と Logs/frames.txt(フレームの時刻)を読み込み、
+// ScanProfiler で計測した結果と同じ形にそろえて、セッションどうしを表で比較する。
+// SDKの Frame は1フレームの処理時間、ScanProfiler の FrameInterval はメインループの間隔で、
+// 別の行に並べる。
+#pragma once
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scan_profiler.h"
+
+struct ScanLog
+{
+    struct Stage
+    {
+        std::string name;
+        double meanMs;      // 1スキャンあたりの平均時間[ms]
+    };
+
+    std::string name;               // セッションの名前
+    int scans = 0;                  // スキャン(フレーム)数
+    int trackingFailures = 0;       // トラッキングに失敗した回数
+    std::vector<Stage> stages;
+
+    // フレームの間隔[ms]
+    double frameP50Ms = 0;
+    double frameP95Ms = 0;
+    double frameMaxMs = 0;
+
+    // fuse.txt と frames.txt を読み込む(frames.txt はなくてもよい)
+    bool load( const std::string& fusePath, const std::string& framesPath )
+    {
+        std::ifstream fuse( fusePath );
+        if ( !fuse ){
+            return false;
+        }
+
+        // 「名前: 値s (合計s total)」または「名前: 値」の行を読む
+        std::vector<std::pair<std::string, double>> totals;
+        std::string line;
+        while ( std::getline( fuse, line ) ){
+            auto colon = line.find( ':' );
+            if ( colon == std::string::npos ){
+                continue;
+            }
+
+            std::string key = line.substr( 0, colon );
+            std::string value = line.substr( colon + 1 );
+            if ( key == "Scans" ){
+                scans = atoi( value.c_str() );
+            }
+            else if ( key == "Tracking Failures" ){
+                trackingFailures = atoi( value.c_str() );
+            }
+            else {
+                auto open = value.find( '(' );
+                if ( open != std::string::npos ){
+                    totals.push_back( std::make_pair( key, atof( value.c_str() + open + 1 ) ) );
+                }
+            }
+        }
+
+        stages.clear();
+        for ( const auto& total : totals ){
+            Stage stage;
+            stage.name = total.first;
+            stage.meanMs = (scans > 0) ? (total.second * 1000.0 / scans) : 0;
+            stages.push_back( stage );
+        }
+
+        // フレームの時刻から間隔を求める
+        std::ifstream frames( framesPath );
+        std::vector<double> timeStamps;
+        while ( std::getline( frames, line ) ){
+            auto colon = line.find( ':' );
+            if ( (colon != std::string::npos) && (line.compare( 0, 9, "TimeStamp" ) == 0) ){
+                timeStamps.push_back( atof( line.c_str() + colon + 1 ) );
+            }
+        }
+
+        std::vector<double> intervals;
+        for ( size_t i = 1; i < timeStamps.size(); ++i ){
+            intervals.push_back( (timeStamps[i] - timeStamps[i - 1]) * 1000.0 );
+        }
+        if ( !intervals.empty() ){
+            std::sort( intervals.begin(), intervals.end() );
+            frameP50Ms = intervals[(intervals.size() - 1) / 2];
+            frameP95Ms = intervals[(size_t)((intervals.size() - 1) * 0.95)];
+            frameMaxMs = intervals.back();
+        }
+
+        return true;
+    }
+
+    // 計測した結果から作る
+    static ScanLog fromProfiler( const ScanProfiler& profiler, const std::string& name )
+    {
+        ScanLog log;
+        log.name = name;
+
+        auto summaries = profiler.summarize();
+        for ( size_t i = 0; i < summaries.size(); ++i ){
+            const auto& summary = summaries[i];
+            Stage stage;
+            stage.name = summary.name;
+            stage.meanMs = summary.meanMs;
+            log.stages.push_back( stage );
+
+            if ( (int)i == profiler.getFrameStage() ){
+                log.scans = summary.count;
+                log.frameP50Ms = summary.p50Ms;
+                log.frameP95Ms = summary.p95Ms;
+                log.frameMaxMs = summary.maxMs;
+            }
+        }
+
+        return log;
+    }
+
+    // ステージの平均時間[ms](なければ負)
+    double meanMs( const std::string& stageName ) const
+    {
+        for ( const auto& stage : stages ){
+            if ( stage.name == stageName ){
+                return stage.meanMs;
+            }
+        }
+        return -1;
+    }
+
+    // セッションを並べて比較する表を書き出す
+    static void writeReport( std::ostream& os, const std::vector<ScanLog>& sessions )
+    {
+        // すべてのセッションに出てくるステージの名前(出てきた順)
+        std::vector<std::string> names;
+        for ( const auto& session : sessions ){
+            for ( const auto& stage : session.stages ){
+                if ( std::find( names.begin(), names.end(), stage.name ) == names.end() ){
+                    names.push_back( stage.name );
+                }
+            }
+        }
+
+        os << std::fixed << std::setprecision( 2 );
+        os << std::setw( 20 ) << std::left << "[ms]" << std::right;
+        for ( const auto& session : sessions ){
+            os << std::setw( 14 ) << session.name;
+        }
+        os << "\n";
+
+        auto row = [&]( const std::string& label, double (*value)( const ScanLog&, const std::string& ), const std::string& key ){
+            os << std::setw( 20 ) << std::left << label << std::right;
+            for ( const auto& session : sessions ){
+                double v = value( session, key );
+                if ( v < 0 ){
+                    os << std::setw( 14 ) << "-";
+                }
+                else {
+                    os << std::setw( 14 ) << v;
+                }
+            }
+            os << "\n";
+        };
+
+        for ( const auto& name : names ){
+            row( name, []( const ScanLog& s, const std::string& key ){ return s.meanMs( key ); }, name );
+        }
+        row( "Frame interval p50", []( const ScanLog& s, const std::string& ){ return s.frameP50Ms; }, "" );
+        row( "Frame interval p95", []( const ScanLog& s, const std::string& ){ return s.frameP95Ms; }, "" );
+        row( "Frame interval max", []( const ScanLog& s, const std::string& ){ return s.frameMaxMs; }, "" );
+        row( "Scans", []( const ScanLog& s, const std::string& ){ return (double)s.scans; }, "" );
+        row( "Tracking failures", []( const ScanLog& s, const std::string& ){ return (double)s.trackingFailures; }, "" );
+    }
+};
@@ -0,0 +1,178 @@
+﻿// 3Dスキャンで使う幾何計算
+//
+// ベクトル、剛体変換(回転と並進)、デプスカメラの内部パラメーター、画素ごとの点と法線。
+// 長さの単位はメートル。
+#pragma once
+
+#include <math.h>
+
+#include <limits>
+#include <vector>
+
+// 3次元ベクトル
+struct Vec3f
+{
+    float x, y, z;
+};
+
+inline Vec3f makeVec3f( float x, float y, float z )
+{
+    Vec3f v = { x, y, z };
+    return v;
+}
+
+inline Vec3f operator+( const Vec3f& a, const Vec3f& b )
+{
+    return makeVec3f( a.x + b.x, a.y + b.y, a.z + b.z );
+}
+
+inline Vec3f operator-( const Vec3f& a, const Vec3f& b )
+{
+    return makeVec3f( a.x - b.x, a.y - b.y, a.z - b.z );
+}
+
+inline Vec3f operator*( const Vec3f& a, float s )
+{
+    return makeVec3f( a.x * s, a.y * s, a.z * s );
+}
+
+inline float dot( const Vec3f& a, const Vec3f& b )
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3f cross( const Vec3f& a, const Vec3f& b )
+{
+    return makeVec3f( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+}
+
+inline float length( const Vec3f& a )
+{
+    return sqrtf( dot( a, a ) );
+}
+
+inline Vec3f normalize( const Vec3f& a )
+{
+    float l = length( a );
+    return (l > 0) ? a * (1.0f / l) : a;
+}
+
+// 剛体変換(p' = R * p + t)
+struct RigidTransform
+{
+    float r[3][3];
+    Vec3f t;
+
+    static RigidTransform identity()
+    {
+        RigidTransform m = { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } }, { 0, 0, 0 } };
+        return m;
+    }
+
+    // 回転ベクトル(rx, ry, rz)[rad]と並進(tx, ty, tz)から作る
+    static RigidTransform fromTwist( const double twist[6] )
+    {
+        RigidTransform m = identity();
+
+        // ロドリゲスの公式
+        double theta = sqrt( twist[0] * twist[0] + twist[1] * twist[1] + twist[2] * twist[2] );
+        if ( theta > 1e-12 ){
+            double kx = twist[0] / theta, ky = twist[1] / theta, kz = twist[2] / theta;
+            double c = cos( theta ), s = sin( theta ), v = 1 - c;
+            m.r[0][0] = (float)(kx * kx * v + c);
+            m.r[0][1] = (float)(kx * ky * v - kz * s);
+            m.r[0][2] = (float)(kx * kz * v + ky * s);
+            m.r[1][0] = (float)(ky * kx * v + kz * s);
+            m.r[1][1] = (float)(ky * ky * v + c);
+            m.r[1][2] = (float)(ky * kz * v - kx * s);
+            m.r[2][0] = (float)(kz * kx * v - ky * s);
+            m.r[2][1] = (float)(kz * ky * v + kx * s);
+            m.r[2][2] = (float)(kz * kz * v + c);
+        }
+
+        m.t = makeVec3f( (float)twist[3], (float)twist[4], (float)twist[5] );
+        return m;
+    }
+
+    // 点を変換する
+    Vec3f operator*( const Vec3f& p ) const
+    {
+        return rotate( p ) + t;
+    }
+
+    // ベクトルを回転だけする
+    Vec3f rotate( const Vec3f& v ) const
+    {
+        return makeVec3f(
+            r[0][0] * v.x + r[0][1] * v.y + r[0][2] * v.z,
+            r[1][0] * v.x + r[1][1] * v.y + r[1][2] * v.z,
+            r[2][0] * v.x + r[2][1] * v.y + r[2][2] * v.z );
+    }
+
+    // 変換をつなげる(先に b、次に this)
+    RigidTransform operator*( const RigidTransform& b ) const
+    {
+        RigidTransform m;
+        for ( int i = 0; i < 3; ++i ){
+            for ( int j = 0; j < 3; ++j ){
+                m.r[i][j] = r[i][0] * b.r[0][j] + r[i][1] * b.r[1][j] + r[i][2] * b.r[2][j];
+            }
+        }
+        m.t = rotate( b.t ) + t;
+        return m;
+    }
+
+    // 逆変換
+    RigidTransform inverse() const
+    {
+        RigidTransform m;
+        for ( int i = 0; i < 3; ++i ){
+            for ( int j = 0; j < 3; ++j ){
+                m.r[i][j] = r[j][i];
+            }
+        }
+        m.t = m.rotate( t ) * -1.0f;
+        return m;
+    }
+};
+
+// デプスカメラの内部パラメーター(画素単位)
+struct CameraIntrinsics
+{
+    int width, height;
+    float fx, fy;
+    float cx, cy;
+
+    // 画像を 1/2^level に縮小したときのパラメーター
+    CameraIntrinsics scaled( int level ) const
+    {
+        float s = 1.0f / (1 << level);
+        CameraIntrinsics c = { width >> level, height >> level,
+            fx * s, fy * s, (cx + 0.5f) * s - 0.5f, (cy + 0.5f) * s - 0.5f };
+        return c;
+    }
+};
+
+// 画素ごとの3次元の点と法線(点がない画素は x を NaN にする)
+struct PointMap
+{
+    int width = 0;
+    int height = 0;
+    std::vector<Vec3f> points;
+    std::vector<Vec3f> normals;
+
+    void create( int width, int height )
+    {
+        this->width = width;
+        this->height = height;
+
+        float nan = std::numeric_limits<float>::quiet_NaN();
+        points.assign( width * height, makeVec3f( nan, nan, nan ) );
+        normals.assign( width * height, makeVec3f( 0, 0, 0 ) );
+    }
+
+    static bool isValid( const Vec3f& p )
+    {
+        return p.x == p.x;
+    }
+};
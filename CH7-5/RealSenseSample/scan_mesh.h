@@ -0,0 +1,60 @@
+﻿// 3Dスキャンで作ったメッシュと、ファイルへの書き出し
+//
+// PXC3DScan と同じく OBJ / STL / PLY で書き出す(書き出しは MeshWriter で行う)。
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "scan_math.h"
+#include "mesh_writer.h"
+
+struct ScanMesh
+{
+    enum Format
+    {
+        FORMAT_OBJ = 0,
+        FORMAT_STL,
+        FORMAT_PLY,
+    };
+
+    std::vector<Vec3f> vertices;
+    std::vector<Vec3f> normals;             // 頂点ごとの法線
+    std::vector<unsigned int> indices;      // 三角形の頂点番号(3つずつ)
+
+    size_t triangleCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    void clear()
+    {
+        vertices.clear();
+        normals.clear();
+        indices.clear();
+    }
+
+    //   isParallel : 書き出すデータの作成を並列に行う
+    bool save( const std::string& path, Format format, bool isParallel = false ) const
+    {
+        MeshWriter writer( isParallel );
+        switch ( format ){
+        case FORMAT_OBJ:    return writer.writeObj( path, data() );
+        case FORMAT_STL:    return writer.writeStl( path, data() );
+        case FORMAT_PLY:    return writer.writePly( path, data() );
+        }
+        return false;
+    }
+
+    // 書き出すためのデータ(法線は頂点と同じ数のときだけ使う)
+    MeshData data() const
+    {
+        MeshData meshData = {
+            vertices.empty() ? nullptr : &vertices[0],
+            (!normals.empty() && (normals.size() == vertices.size())) ? &normals[0] : nullptr,
+            vertices.size(),
+            indices.empty() ? nullptr : &indices[0],
+            indices.size() };
+        return meshData;
+    }
+};
@@ -0,0 +1,371 @@
+﻿// 3Dスキャンの処理時間の計測
+//
+// 処理(ステージ)ごとの時間を、スレッドごとのヒストグラムに記録する。
+// 記録するスレッドは自分専用の領域にだけ書き込むので、ロックしない。
+// 領域は MAX_THREADS 個なので、記録したスレッドは終わる前に releaseThread() で返す
+// (足りなくなったら、そのスレッドの記録は捨てて一度だけ警告する)。
+// 集計はどのスレッドからでもでき、画面への表示と、JSON/CSVへの書き出しができる。
+// ヒストグラムの区間は 2^(1/8) 倍ずつ広がる(1us から約30秒まで)。
+#pragma once
+
+#include <windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2\opencv.hpp>
+
+class ScanProfiler
+{
+public:
+
+    enum { MAX_STAGES = 16, MAX_THREADS = 8, BUCKETS = 200, BUCKETS_PER_OCTAVE = 8 };
+
+    // ステージごとの集計結果
+    struct Summary
+    {
+        std::string name;
+        unsigned int count;
+        double meanMs;
+        double p50Ms;
+        double p95Ms;
+        double p99Ms;
+        double maxMs;
+    };
+
+    // スコープを抜けるまでの時間を記録する
+    class Scope
+    {
+    public:
+
+        Scope( ScanProfiler& profiler, int stage )
+            : profiler( profiler )
+            , stage( stage )
+            , start( cv::getTickCount() )
+        {
+        }
+
+        ~Scope()
+        {
+            profiler.record( stage, (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() );
+        }
+
+    private:
+
+        Scope( const Scope& );
+        Scope& operator=( const Scope& );
+
+        ScanProfiler& profiler;
+        int stage;
+        int64 start;
+    };
+
+    ScanProfiler()
+        : slots( new ThreadSlot[MAX_THREADS] )
+    {
+        for ( int i = 0; i < MAX_THREADS; ++i ){
+            slots[i].threadId.store( 0 );
+            for ( int s = 0; s < MAX_STAGES; ++s ){
+                slots[i].histograms[s].clear();
+            }
+        }
+        dropped.store( 0 );
+        isFullWarned.store( false );
+
+        // メインループの間隔は最初から用意しておく
+        // (SDKのログの Frame は1フレームの処理時間なので、別の名前にする)
+        frameStage = addStage( "FrameInterval" );
+    }
+
+    // ステージを登録して、IDを返す(記録を始める前に呼ぶ)
+    int addStage( const std::string& name )
+    {
+        for ( size_t i = 0; i < stages.size(); ++i ){
+            if ( stages[i] == name ){
+                return (int)i;
+            }
+        }
+
+        if ( stages.size() >= MAX_STAGES ){
+            throw std::runtime_error( "ステージの数が多すぎます" );
+        }
+
+        stages.push_back( name );
+        return (int)stages.size() - 1;
+    }
+
+    // 処理時間[ms]を記録する(どのスレッドからでも呼べる)
+    void record( int stage, double ms )
+    {
+        if ( (stage < 0) || (stage >= (int)stages.size()) ){
+            dropped.fetch_add( 1, std::memory_order_relaxed );
+            return;
+        }
+
+        auto slot = findSlot();
+        if ( slot == nullptr ){
+            if ( !isFullWarned.exchange( true ) ){
+                std::cerr << "ScanProfiler : 記録するスレッドが " << MAX_THREADS
+                          << " を超えたので、以降のスレッドの記録を捨てます" << std::endl;
+            }
+            dropped.fetch_add( 1, std::memory_order_relaxed );
+            return;
+        }
+
+        slot->histograms[stage].add( ms );
+    }
+
+    // 呼び出したスレッドの領域を返す(record()したスレッドが終わる前に呼ぶ)
+    // 記録は残るので、次に領域を使うスレッドの記録と合わせて集計される
+    void releaseThread()
+    {
+        unsigned long id = GetCurrentThreadId();
+        for ( int i = 0; i < MAX_THREADS; ++i ){
+            if ( slots[i].threadId.load( std::memory_order_relaxed ) == id ){
+                slots[i].threadId.store( 0, std::memory_order_release );
+                return;
+            }
+        }
+    }
+
+    // メインループの間隔を記録するステージのID
+    int getFrameStage() const
+    {
+        return frameStage;
+    }
+
+    // フレームの区切りを記録する(前のフレームからの間隔[ms]を FrameInterval に記録して返す)
+    double frame()
+    {
+        int64 now = cv::getTickCount();
+        double interval = 0;
+        if ( lastFrame != 0 ){
+            interval = (now - lastFrame) * 1000.0 / cv::getTickFrequency();
+            record( frameStage, interval );
+        }
+        lastFrame = now;
+        return interval;
+    }
+
+    // 全スレッドの記録を集計する
+    std::vector<Summary> summarize() const
+    {
+        std::vector<Summary> summaries;
+        for ( size_t s = 0; s < stages.size(); ++s ){
+            unsigned int buckets[BUCKETS] = {};
+            unsigned int count = 0;
+            unsigned long long sumUs = 0;
+            unsigned int maxUs = 0;
+
+            for ( int i = 0; i < MAX_THREADS; ++i ){
+                const auto& h = slots[i].histograms[s];
+                for ( int b = 0; b < BUCKETS; ++b ){
+                    buckets[b] += h.buckets[b].load( std::memory_order_relaxed );
+                }
+                count += h.count.load( std::memory_order_relaxed );
+                sumUs += h.sumUs.load( std::memory_order_relaxed );
+                maxUs = std::max( maxUs, h.maxUs.load( std::memory_order_relaxed ) );
+            }
+
+            Summary summary;
+            summary.name = stages[s];
+            summary.count = count;
+            summary.meanMs = (count > 0) ? (sumUs / 1000.0 / count) : 0;
+            summary.p50Ms = percentile( buckets, count, maxUs, 0.50 );
+            summary.p95Ms = percentile( buckets, count, maxUs, 0.95 );
+            summary.p99Ms = percentile( buckets, count, maxUs, 0.99 );
+            summary.maxMs = maxUs / 1000.0;
+            summaries.push_back( summary );
+        }
+
+        return summaries;
+    }
+
+    // 集計結果を画像に表示する
+    void drawOverlay( cv::Mat& image ) const
+    {
+        int y = 20;
+        for ( const auto& summary : summarize() ){
+            if ( summary.count == 0 ){
+                continue;
+            }
+
+            std::stringstream ss;
+            ss.precision( 1 );
+            ss << std::fixed << summary.name << " : " << summary.meanMs << " ms"
+               << " (p95 " << summary.p95Ms << ", max " << summary.maxMs << ")";
+            cv::putText( image, ss.str(), cv::Point( 10, y ),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar( 0, 0, 255 ) );
+            y += 20;
+        }
+    }
+
+    // JSONで書き出す
+    bool writeJson( const std::string& path ) const
+    {
+        std::ofstream ofs( path );
+        if ( !ofs ){
+            return false;
+        }
+
+        ofs << "{\n  \"dropped\": " << dropped.load() << ",\n  \"stages\": [\n";
+        auto summaries = summarize();
+        for ( size_t i = 0; i < summaries.size(); ++i ){
+            const auto& s = summaries[i];
+            ofs << "    { \"name\": \"" << s.name << "\", \"count\": " << s.count
+                << ", \"meanMs\": " << s.meanMs << ", \"p50Ms\": " << s.p50Ms
+                << ", \"p95Ms\": " << s.p95Ms << ", \"p99Ms\": " << s.p99Ms
+                << ", \"maxMs\": " << s.maxMs << " }"
+                << ((i + 1 < summaries.size()) ? ",\n" : "\n");
+        }
+        ofs << "  ]\n}\n";
+        return true;
+    }
+
+    // CSVで書き出す
+    bool writeCsv( const std::string& path ) const
+    {
+        std::ofstream ofs( path );
+        if ( !ofs ){
+            return false;
+        }
+
+        ofs << "stage,count,meanMs,p50Ms,p95Ms,p99Ms,maxMs\n";
+        for ( const auto& s : summarize() ){
+            ofs << s.name << "," << s.count << "," << s.meanMs << "," << s.p50Ms << ","
+                << s.p95Ms << "," << s.p99Ms << "," << s.maxMs << "\n";
+        }
+        return true;
+    }
+
+    // 前回から interval 秒たっていたら、basePath.json と basePath.csv に書き出す
+    void dumpIfDue( const std::string& basePath, double interval )
+    {
+        int64 now = cv::getTickCount();
+        if ( (lastDump != 0) && ((now - lastDump) / cv::getTickFrequency() < interval) ){
+            return;
+        }
+        lastDump = now;
+
+        writeJson( basePath + ".json" );
+        writeCsv( basePath + ".csv" );
+    }
+
+private:
+
+    ScanProfiler( const ScanProfiler& );
+    ScanProfiler& operator=( const ScanProfiler& );
+
+    // 1つのステージのヒストグラム(書き込むのは1つのスレッドだけ)
+    struct Histogram
+    {
+        std::atomic<unsigned int> buckets[BUCKETS];
+        std::atomic<unsigned int> count;
+        std::atomic<unsigned long long> sumUs;
+        std::atomic<unsigned int> maxUs;
+
+        void clear()
+        {
+            for ( int b = 0; b < BUCKETS; ++b ){
+                buckets[b].store( 0 );
+            }
+            count.store( 0 );
+            sumUs.store( 0 );
+            maxUs.store( 0 );
+        }
+
+        void add( double ms )
+        {
+            unsigned int us = (unsigned int)std::max( ms * 1000.0, 0.0 );
+            int b = bucketOf( us );
+
+            // 書き込むのは自分だけなので、読んで足して書く
+            buckets[b].store( buckets[b].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            count.store( count.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            sumUs.store( sumUs.load( std::memory_order_relaxed ) + us, std::memory_order_relaxed );
+            if ( us > maxUs.load( std::memory_order_relaxed ) ){
+                maxUs.store( us, std::memory_order_relaxed );
+            }
+        }
+    };
+
+    struct ThreadSlot
+    {
+        std::atomic<unsigned long> threadId;    // 0なら空き
+        Histogram histograms[MAX_STAGES];
+    };
+
+    // 呼び出したスレッドの領域を探す(なければ空きを確保する)
+    ThreadSlot* findSlot()
+    {
+        unsigned long id = GetCurrentThreadId();
+        for ( int i = 0; i < MAX_THREADS; ++i ){
+            if ( slots[i].threadId.load( std::memory_order_acquire ) == id ){
+                return &slots[i];
+            }
+        }
+
+        for ( int i = 0; i < MAX_THREADS; ++i ){
+            unsigned long empty = 0;
+            if ( slots[i].threadId.compare_exchange_strong( empty, id ) ){
+                return &slots[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    static int bucketOf( unsigned int us )
+    {
+        if ( us < 1 ){
+            return 0;
+        }
+
+        int b = 1 + (int)(BUCKETS_PER_OCTAVE * std::log( (double)us ) / std::log( 2.0 ));
+        return std::min( b, BUCKETS - 1 );
+    }
+
+    // 区間の代表値[us](上限と下限の相乗平均)
+    static double bucketValueUs( int b )
+    {
+        return (b == 0) ? 0.5 : std::pow( 2.0, (b - 0.5) / BUCKETS_PER_OCTAVE );
+    }
+
+    static double percentile( const unsigned int* buckets, unsigned int count,
+        unsigned int maxUs, double p )
+    {
+        if ( count == 0 ){
+            return 0;
+        }
+
+        unsigned int target = (unsigned int)std::ceil( count * p );
+        unsigned int sum = 0;
+        for ( int b = 0; b < BUCKETS; ++b ){
+            sum += buckets[b];
+            if ( sum >= target ){
+                return std::min( bucketValueUs( b ), (double)maxUs ) / 1000.0;
+            }
+        }
+        return maxUs / 1000.0;
+    }
+
+private:
+
+    std::vector<std::string> stages;
+    std::unique_ptr<ThreadSlot[]> slots;
+    std::atomic<unsigned int> dropped;
+    std::atomic<bool> isFullWarned;
+
+    int frameStage;
+
+    // メインループのスレッドだけが使う
+    int64 lastFrame = 0;
+    int64 lastDump = 0;
+};
@@ -0,0 +1,208 @@
+// icp_tracker.h のテスト
+//
+// 壁と床と箱と球でできた部屋のデプス画像を計算で作り、
+// 動かしたカメラの姿勢を ICP で正しく求められることを確かめる。
+// 320x240 と 640x480 の両方で、前のフレームに合わせる場合と、
+// TsdfVolume のモデルをレイキャストして合わせる場合を試す。
+#include "icp_tracker.h"
+#include "tsdf_volume.h"
+
+#include <cstdio>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what, int line )
+{
+    if ( !ok ){
+        printf( "NG line %d : %s\n", line, what );
+        ++failures;
+    }
+}
+
+#define CHECK( expr ) check( (expr), #expr, __LINE__ )
+
+// 視線が部屋に当たる距離(奥の壁 z=2、床 y=0.5、左の壁 x=-0.8、球、箱)
+float hitRoom( const Vec3f& origin, const Vec3f& dir )
+{
+    float best = 1e9f;
+
+    const Vec3f normals[3] = { { 0, 0, 1 }, { 0, 1, 0 }, { 1, 0, 0 } };
+    const float offsets[3] = { 2.0f, 0.5f, -0.8f };
+    for ( int i = 0; i < 3; ++i ){
+        float dn = dot( normals[i], dir );
+        if ( fabsf( dn ) > 1e-6f ){
+            float t = (offsets[i] - dot( normals[i], origin )) / dn;
+            if ( (t > 0) && (t < best) ){
+                best = t;
+            }
+        }
+    }
+
+    Vec3f oc = origin - makeVec3f( 0.2f, 0.1f, 1.2f );
+    float a = dot( dir, dir ), b = dot( oc, dir ), c = dot( oc, oc ) - 0.2f * 0.2f;
+    float disc = b * b - a * c;
+    if ( disc > 0 ){
+        float t = (-b - sqrtf( disc )) / a;
+        if ( (t > 0) && (t < best) ){
+            best = t;
+        }
+    }
+
+    const float lo[3] = { -0.4f, 0.2f, 1.0f }, hi[3] = { -0.1f, 0.5f, 1.3f };
+    const float o[3] = { origin.x, origin.y, origin.z }, d[3] = { dir.x, dir.y, dir.z };
+    float t0 = 0, t1 = 1e9f;
+    for ( int i = 0; i < 3; ++i ){
+        if ( fabsf( d[i] ) < 1e-9f ){
+            if ( (o[i] < lo[i]) || (o[i] > hi[i]) ){
+                t0 = 1e9f;
+            }
+            continue;
+        }
+        float ta = (lo[i] - o[i]) / d[i], tb = (hi[i] - o[i]) / d[i];
+        t0 = std::max( t0, std::min( ta, tb ) );
+        t1 = std::min( t1, std::max( ta, tb ) );
+    }
+    if ( (t0 <= t1) && (t0 > 0) && (t0 < best) ){
+        best = t0;
+    }
+
+    return best;
+}
+
+// 部屋のデプス画像[mm](3mより遠ければ0)
+cv::Mat renderRoom( const CameraIntrinsics& K, const RigidTransform& pose )
+{
+    cv::Mat depth( K.height, K.width, CV_16UC1 );
+    for ( int v = 0; v < K.height; ++v ){
+        for ( int u = 0; u < K.width; ++u ){
+            // 視線の z を1にしておけば、当たる距離がそのままデプスになる
+            Vec3f dir = pose.rotate( makeVec3f( (u - K.cx) / K.fx, (v - K.cy) / K.fy, 1 ) );
+            float t = hitRoom( pose.t, dir );
+            depth.at<unsigned short>( v, u ) = (t < 3) ? (unsigned short)(t * 1000 + 0.5f) : 0;
+        }
+    }
+    return depth;
+}
+
+// 2つの姿勢の差(回転[度]と並進[mm])
+void poseError( const RigidTransform& a, const RigidTransform& b, double& degree, double& mm )
+{
+    RigidTransform e = a.inverse() * b;
+    double trace = e.r[0][0] + e.r[1][1] + e.r[2][2];
+    degree = acos( std::min( 1.0, std::max( -1.0, (trace - 1) / 2 ) ) ) * 180 / 3.14159265;
+    mm = length( e.t ) * 1000;
+}
+
+CameraIntrinsics makeIntrinsics( int width, int height )
+{
+    float f = width * 570.0f / 640;
+    CameraIntrinsics K = { width, height, f, f, width / 2 - 0.5f, height / 2 - 0.5f };
+    return K;
+}
+
+// 前のフレームに合わせる
+void testFrameToFrame( const CameraIntrinsics& K )
+{
+    RigidTransform origin = RigidTransform::identity();
+    IcpTracker tracker;
+    tracker.setReference( renderRoom( K, origin ), K, origin );
+    CHECK( tracker.hasReference() );
+
+    // 1〜4度、2〜7cm 動かす
+    const double motions[][6] = {
+        { 0.02, 0.01, 0, 0.02, 0, 0.01 },
+        { 0, 0.035, 0.01, 0, 0.03, -0.02 },
+        { 0.01, -0.02, 0.03, -0.04, 0.02, 0.03 },
+        { 0.05, 0.05, 0, 0.05, 0.05, 0 },
+    };
+    for ( const auto& motion : motions ){
+        RigidTransform truth = RigidTransform::fromTwist( motion );
+        RigidTransform pose = origin;
+        IcpTracker::Result result = tracker.track( renderRoom( K, truth ), K, pose );
+
+        double degree, mm;
+        poseError( pose, truth, degree, mm );
+        printf( "%dx%d frame to frame : error %.3f deg %.3f mm, %d iterations, inliers %.2f, %.1f ms\n",
+            K.width, K.height, degree, mm, result.iterations, result.inlierRatio, result.ms );
+        CHECK( result.isTracked );
+        CHECK( (degree < 0.1) && (mm < 1) );
+        CHECK( result.inlierRatio > 0.8f );
+        CHECK( result.rmse < 0.001f );
+    }
+}
+
+// モデルをレイキャストして合わせながら統合していく
+void testFrameToModel( const CameraIntrinsics& K )
+{
+    TsdfVolume volume;
+    IcpTracker tracker;
+    PointMap model;
+    RigidTransform pose = RigidTransform::identity();
+    double maxDegree = 0, maxMm = 0;
+    int lost = 0;
+
+    for ( int frame = 0; frame < 20; ++frame ){
+        double motion[6] = { 0.004 * frame, -0.008 * frame, 0.002 * frame,
+            -0.01 * frame, 0.003 * frame, 0.005 * frame };
+        RigidTransform truth = RigidTransform::fromTwist( motion );
+        cv::Mat depth = renderRoom( K, truth );
+
+        if ( frame > 0 ){
+            volume.raycast( K, pose, model );
+            tracker.setReference( model, K, pose );
+            lost += !tracker.track( depth, K, pose ).isTracked;
+        }
+        volume.integrate( depth, K, pose );
+
+        double degree, mm;
+        poseError( pose, truth, degree, mm );
+        maxDegree = std::max( maxDegree, degree );
+        maxMm = std::max( maxMm, mm );
+    }
+
+    printf( "%dx%d frame to model : max drift %.3f deg %.3f mm over 20 frames\n",
+        K.width, K.height, maxDegree, maxMm );
+    CHECK( lost == 0 );
+    CHECK( (maxDegree < 0.2) && (maxMm < 2) );
+}
+
+void testLost()
+{
+    CameraIntrinsics K = makeIntrinsics( 320, 240 );
+    RigidTransform origin = RigidTransform::identity();
+    double motion[6] = { 0, 0, 0, 0.01, 0, 0 };
+    RigidTransform initial = RigidTransform::fromTwist( motion );
+
+    // 参照がなければ求めない
+    IcpTracker tracker;
+    RigidTransform pose = initial;
+    CHECK( !tracker.hasReference() );
+    CHECK( !tracker.track( renderRoom( K, origin ), K, pose ).isTracked );
+
+    // デプスがなければ求めず、姿勢も変えない
+    tracker.setReference( renderRoom( K, origin ), K, origin );
+    cv::Mat empty( K.height, K.width, CV_16UC1 );
+    memset( empty.data, 0, K.width * K.height * sizeof(unsigned short) );
+    CHECK( !tracker.track( empty, K, pose ).isTracked );
+    double degree, mm;
+    poseError( pose, initial, degree, mm );
+    CHECK( (degree == 0) && (mm == 0) );
+}
+
+}
+
+int main()
+{
+    const int sizes[2][2] = { { 320, 240 }, { 640, 480 } };
+    for ( const auto& size : sizes ){
+        CameraIntrinsics K = makeIntrinsics( size[0], size[1] );
+        testFrameToFrame( K );
+        testFrameToModel( K );
+    }
+    testLost();
+
+    printf( "%s\n", (failures == 0) ? "OK" : "FAILED" );
+    return (failures == 0) ? 0 : 1;
+}
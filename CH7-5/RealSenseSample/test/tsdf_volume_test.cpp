@@ -0,0 +1,220 @@
+// tsdf_volume.h のテスト
+//
+// 球を周りから撮ったデプス画像を計算で作って統合し、
+// 取り出したメッシュとレイキャストした表面が球に合うことを確かめる。
+#include "tsdf_volume.h"
+
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <utility>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what, int line )
+{
+    if ( !ok ){
+        printf( "NG line %d : %s\n", line, what );
+        ++failures;
+    }
+}
+
+#define CHECK( expr ) check( (expr), #expr, __LINE__ )
+
+const CameraIntrinsics INTRINSICS = { 320, 240, 300, 300, 159.5f, 119.5f };
+const Vec3f CENTER = { 0, 0, 1 };
+const float RADIUS = 0.2f;
+
+// 球の中心から 1m 離れて、中心を向いたカメラ(y軸まわりに angle[rad])
+RigidTransform viewPose( double angle )
+{
+    double twist[6] = { 0, -angle, 0, 0, 0, 0 };
+    RigidTransform pose = RigidTransform::fromTwist( twist );
+    pose.t = CENTER + pose.rotate( makeVec3f( 0, 0, -1 ) );
+    return pose;
+}
+
+// 画素の視線が球に当たる距離(当たらなければ負)
+float hitSphere( const RigidTransform& pose, int u, int v, const CameraIntrinsics& K )
+{
+    Vec3f dir = pose.rotate( normalize( makeVec3f( (u - K.cx) / K.fx, (v - K.cy) / K.fy, 1 ) ) );
+    Vec3f oc = pose.t - CENTER;
+    float b = dot( oc, dir ), c = dot( oc, oc ) - RADIUS * RADIUS;
+    float disc = b * b - c;
+    return (disc > 0) ? -b - sqrtf( disc ) : -1;
+}
+
+// 球のデプス画像[mm]
+cv::Mat renderSphere( const RigidTransform& pose, const CameraIntrinsics& K )
+{
+    RigidTransform worldToCamera = pose.inverse();
+    cv::Mat depth( K.height, K.width, CV_16UC1 );
+    for ( int v = 0; v < K.height; ++v ){
+        for ( int u = 0; u < K.width; ++u ){
+            float t = hitSphere( pose, u, v, K );
+            unsigned short value = 0;
+            if ( t > 0 ){
+                Vec3f dir = pose.rotate( normalize( makeVec3f( (u - K.cx) / K.fx, (v - K.cy) / K.fy, 1 ) ) );
+                Vec3f p = worldToCamera * (pose.t + dir * t);
+                value = (unsigned short)(p.z * 1000 + 0.5f);
+            }
+            depth.at<unsigned short>( v, u ) = value;
+        }
+    }
+    return depth;
+}
+
+void integrateAround( TsdfVolume& volume, int views )
+{
+    for ( int i = 0; i < views; ++i ){
+        RigidTransform pose = viewPose( i * 2 * 3.14159265 / views );
+        volume.integrate( renderSphere( pose, INTRINSICS ), INTRINSICS, pose );
+    }
+}
+
+void testMesh()
+{
+    TsdfVolume volume;
+    integrateAround( volume, 8 );
+
+    ScanMesh mesh;
+    volume.extractMesh( mesh );
+    CHECK( mesh.triangleCount() > 10000 );
+    CHECK( mesh.normals.size() == mesh.vertices.size() );
+
+    // 頂点は球の表面に乗る
+    double error = 0;
+    for ( const auto& p : mesh.vertices ){
+        error += fabs( length( p - CENTER ) - RADIUS );
+    }
+    error /= std::max( mesh.vertices.size(), (size_t)1 );
+    printf( "mesh : %zu triangles, mean error %.2f mm\n", mesh.triangleCount(), error * 1000 );
+    CHECK( error < volume.getVoxelSize() / 4 );
+
+    // 三角形は外向きで、同じ向きの辺を2つの三角形が共有しない(向きがそろっている)
+    std::map<std::pair<unsigned int, unsigned int>, int> edges;
+    int inward = 0;
+    for ( size_t i = 0; i + 2 < mesh.indices.size(); i += 3 ){
+        unsigned int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+        ++edges[std::make_pair( a, b )];
+        ++edges[std::make_pair( b, c )];
+        ++edges[std::make_pair( c, a )];
+
+        Vec3f n = cross( mesh.vertices[b] - mesh.vertices[a], mesh.vertices[c] - mesh.vertices[a] );
+        Vec3f center = (mesh.vertices[a] + mesh.vertices[b] + mesh.vertices[c]) * (1 / 3.0f);
+        inward += (dot( n, center - CENTER ) <= 0);
+    }
+    int shared = 0;
+    for ( const auto& edge : edges ){
+        shared += (edge.second > 1);
+    }
+    CHECK( shared == 0 );
+    CHECK( inward < (int)mesh.triangleCount() / 1000 );
+}
+
+void testRaycast()
+{
+    TsdfVolume volume;
+    integrateAround( volume, 8 );
+
+    // 統合したのとは違う向きから見る
+    RigidTransform pose = viewPose( 0.4 );
+    PointMap map;
+    volume.raycast( INTRINSICS, pose, map );
+    CHECK( (map.width == INTRINSICS.width) && (map.height == INTRINSICS.height) );
+
+    int expected = 0, found = 0, extra = 0;
+    double error = 0;
+    float minCos = 1;
+    for ( int v = 0; v < INTRINSICS.height; ++v ){
+        for ( int u = 0; u < INTRINSICS.width; ++u ){
+            bool isSphere = hitSphere( pose, u, v, INTRINSICS ) > 0;
+            const Vec3f& p = map.points[v * map.width + u];
+            if ( !PointMap::isValid( p ) ){
+                continue;
+            }
+            if ( !isSphere ){
+                ++extra;
+                continue;
+            }
+            ++found;
+            error += fabs( length( p - CENTER ) - RADIUS );
+            Vec3f n = map.normals[v * map.width + u];
+            minCos = std::min( minCos, dot( n, normalize( p - CENTER ) ) );
+        }
+    }
+    for ( int v = 0; v < INTRINSICS.height; ++v ){
+        for ( int u = 0; u < INTRINSICS.width; ++u ){
+            expected += hitSphere( pose, u, v, INTRINSICS ) > 0;
+        }
+    }
+    error /= std::max( found, 1 );
+    printf( "raycast : %d / %d pixels, %d outside, mean error %.2f mm\n", found, expected, extra, error * 1000 );
+    CHECK( found > expected * 0.95 );
+    CHECK( extra < expected / 100 );
+    CHECK( error < volume.getVoxelSize() / 4 );
+    CHECK( minCos > 0.7f );
+
+    // 2つのスレッドから同時に呼んでも、1つずつ呼んだときと同じ結果になる
+    RigidTransform other = viewPose( -0.4 );
+    PointMap single, a, b;
+    volume.raycast( INTRINSICS, other, single );
+    std::thread ta( [&]{ volume.raycast( INTRINSICS, pose, a ); } );
+    std::thread tb( [&]{ volume.raycast( INTRINSICS, other, b ); } );
+    ta.join();
+    tb.join();
+    bool isSame = true;
+    for ( size_t i = 0; i < map.points.size(); ++i ){
+        isSame &= (PointMap::isValid( map.points[i] ) == PointMap::isValid( a.points[i] ));
+        isSame &= (PointMap::isValid( single.points[i] ) == PointMap::isValid( b.points[i] ));
+        if ( PointMap::isValid( map.points[i] ) ){
+            isSame &= (length( map.points[i] - a.points[i] ) == 0);
+        }
+        if ( PointMap::isValid( single.points[i] ) ){
+            isSame &= (length( single.points[i] - b.points[i] ) == 0);
+        }
+    }
+    CHECK( isSame );
+}
+
+void testEviction()
+{
+    // 1周分のブリックが入らない上限
+    TsdfVolume full;
+    integrateAround( full, 8 );
+    size_t maxBricks = full.getBrickCount() / 2;
+
+    TsdfVolume volume( 0.004f, 0.016f, 64, maxBricks );
+    integrateAround( volume, 8 );
+    size_t memory = volume.getMemoryBytes();
+    CHECK( volume.getEvictedCount() > 0 );
+
+    // もう1周してもメモリは増えない
+    integrateAround( volume, 8 );
+    printf( "eviction : %zu bricks (max %zu), %zu evicted, %.2f MB -> %.2f MB\n",
+        volume.getBrickCount(), maxBricks, volume.getEvictedCount(), memory / 1e6, volume.getMemoryBytes() / 1e6 );
+    CHECK( volume.getMemoryBytes() == memory );
+    CHECK( volume.getMemoryBytes() < full.getMemoryBytes() );
+
+    // 最後に見ていた側のメッシュは残る
+    ScanMesh mesh;
+    volume.extractMesh( mesh );
+    CHECK( mesh.triangleCount() > 0 );
+
+    volume.reset();
+    CHECK( (volume.getBrickCount() == 0) && (volume.getEvictedCount() == 0) );
+}
+
+}
+
+int main()
+{
+    testMesh();
+    testRaycast();
+    testEviction();
+
+    printf( "%s\n", (failures == 0) ? "OK" : "FAILED" );
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,759 @@
+﻿// TSDF(Truncated Signed Distance Function)によるデプスの統合
+//
+// 空間を 8x8x8 ボクセルのブロック(ブリック)に分け、デプスが観測された
+// 表面の近くのブリックだけをハッシュで確保する(ボクセルハッシング)。
+// 統合はフレームで見えているブリックごとに並列に行い、
+// メッシュはマーチングキューブ法で取り出す。
+// カメラから見たモデルの表面は、レイキャストで点と法線として取り出せる(ICPの参照に使う)。
+// PXC3DScan を使わずに、姿勢がわかっているデプス画像からモデルを作る。
+//
+// ブリックの数には上限があり(既定で65536個、4mmのボクセルで約135MB)、超えると
+// 長く見えていないブリックから捨てて、そのメモリを新しいブリックに使いまわす。
+// 長いスキャンでもメモリは増え続けないが、捨てたブリックの表面はメッシュに残らない。
+// そのフレームで見えているブリックは捨てないので、新しく確保した分だけ一時的に上限を超えることがある。
+#pragma once
+
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "scan_math.h"
+#include "scan_mesh.h"
+#include "marching_cubes.h"
+
+class TsdfVolume
+{
+public:
+
+    enum { BRICK_SIZE = 8, BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE };
+    enum { RAY_TILE = 16 };     // レイキャストで奥行きの範囲を求めるタイルの大きさ[画素]
+
+    //   voxelSize  : ボクセルの大きさ[m]
+    //   truncation : 表面からこの距離[m]までを記録する
+    //   maxWeight  : 重みの上限(大きいほど平均するフレームが増える)
+    //   maxBricks  : ブリックの数の上限(1個あたり約2KB)
+    TsdfVolume( float voxelSize = 0.004f, float truncation = 0.016f, int maxWeight = 64,
+        size_t maxBricks = 65536 )
+        : voxelSize( voxelSize )
+        , truncation( truncation )
+        , maxWeight( maxWeight )
+        , maxBricks( std::max( maxBricks, (size_t)1 ) )
+    {
+    }
+
+    void reset()
+    {
+        bricks.clear();
+        brickMap.clear();
+        freeBricks.clear();
+        frameCount = 0;
+        evictedCount = 0;
+    }
+
+    // デプス画像を統合する
+    //   depth         : デプス画像(CV_16UC1)
+    //   intrinsics    : デプスカメラの内部パラメーター
+    //   cameraToWorld : カメラの姿勢
+    //   depthScale    : デプスの値の単位[m]
+    //   maxDepth      : これより遠いデプスは使わない[m]
+    void integrate( const cv::Mat& depth, const CameraIntrinsics& intrinsics,
+        const RigidTransform& cameraToWorld, float depthScale = 0.001f, float maxDepth = 3.0f )
+    {
+        int64 start = cv::getTickCount();
+
+        ++frameCount;
+        allocateBricks( depth, intrinsics, cameraToWorld, depthScale, maxDepth );
+        evictBricks();
+
+        IntegrateParams params;
+        params.depth = &depth;
+        params.intrinsics = intrinsics;
+        params.worldToCamera = cameraToWorld.inverse();
+        params.depthScale = depthScale;
+        params.maxDepth = maxDepth;
+        cv::parallel_for_( cv::Range( 0, (int)visible.size() ), IntegrateBody( *this, params ) );
+
+        lastMs = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    }
+
+    // マーチングキューブ法でメッシュを取り出す
+    void extractMesh( ScanMesh& mesh ) const
+    {
+        std::vector<const Brick*> all;
+        for ( const auto& brick : bricks ){
+            if ( brick.lastFrame >= 0 ){
+                all.push_back( &brick );
+            }
+        }
+
+        // ブリックごとに並列に三角形を求める
+        std::vector<BrickTriangles> triangles( all.size() );
+        cv::parallel_for_( cv::Range( 0, (int)all.size() ), ExtractBody( *this, all, triangles ) );
+
+        // 同じ辺の上の頂点を1つにまとめる
+        mesh.clear();
+        std::unordered_map<unsigned long long, unsigned int> vertexMap;
+        for ( const auto& t : triangles ){
+            for ( size_t i = 0; i < t.keys.size(); ++i ){
+                auto it = vertexMap.find( t.keys[i] );
+                if ( it == vertexMap.end() ){
+                    it = vertexMap.insert( std::make_pair( t.keys[i], (unsigned int)mesh.vertices.size() ) ).first;
+                    mesh.vertices.push_back( t.positions[i] );
+                }
+                mesh.indices.push_back( it->second );
+            }
+        }
+
+        // 頂点の法線は、周りの面の法線の和
+        mesh.normals.assign( mesh.vertices.size(), makeVec3f( 0, 0, 0 ) );
+        for ( size_t i = 0; i + 2 < mesh.indices.size(); i += 3 ){
+            unsigned int a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+            Vec3f n = cross( mesh.vertices[b] - mesh.vertices[a], mesh.vertices[c] - mesh.vertices[a] );
+            mesh.normals[a] = mesh.normals[a] + n;
+            mesh.normals[b] = mesh.normals[b] + n;
+            mesh.normals[c] = mesh.normals[c] + n;
+        }
+        for ( auto& n : mesh.normals ){
+            n = normalize( n );
+        }
+    }
+
+    // カメラから見たモデルの表面の点と法線(ワールド座標系)を求める
+    //   intrinsics    : 求める画像の内部パラメーター
+    //   cameraToWorld : カメラの姿勢
+    //   minDepth, maxDepth : 表面を探す範囲[m]
+    void raycast( const CameraIntrinsics& intrinsics, const RigidTransform& cameraToWorld,
+        PointMap& map, float minDepth = 0.2f, float maxDepth = 3.0f ) const
+    {
+        map.create( intrinsics.width, intrinsics.height );
+
+        RaycastParams params;
+        params.intrinsics = intrinsics;
+        params.cameraToWorld = cameraToWorld;
+        params.minDepth = minDepth;
+        params.maxDepth = maxDepth;
+
+        // タイルごとの奥行きの範囲は呼び出しごとに持つ(raycast()は同時に呼べる)
+        std::vector<float> nearZ, farZ;
+        computeRayRanges( params, nearZ, farZ );
+        cv::parallel_for_( cv::Range( 0, intrinsics.height ), RaycastBody( *this, params, map ) );
+    }
+
+    // 使っているブリックの数
+    size_t getBrickCount() const
+    {
+        return brickMap.size();
+    }
+
+    // ブリックのために確保したメモリ[byte](捨てて使いまわすのを待っているブリックも含む)
+    size_t getMemoryBytes() const
+    {
+        return bricks.size() * sizeof(Brick);
+    }
+
+    // 上限を超えて捨てたブリックの数(reset()からの合計)
+    size_t getEvictedCount() const
+    {
+        return evictedCount;
+    }
+
+    // 直前の integrate() にかかった時間[ms]
+    double lastIntegrateMs() const
+    {
+        return lastMs;
+    }
+
+    float getVoxelSize() const
+    {
+        return voxelSize;
+    }
+
+    float getTruncation() const
+    {
+        return truncation;
+    }
+
+private:
+
+    TsdfVolume( const TsdfVolume& );
+    TsdfVolume& operator=( const TsdfVolume& );
+
+    struct Voxel
+    {
+        short tsdf;                 // -1 ～ 1 を -32767 ～ 32767 にしたもの
+        unsigned short weight;      // 0なら未観測
+    };
+
+    struct Brick
+    {
+        int x, y, z;                // ブリックの座標(ボクセル座標 / BRICK_SIZE)
+        int lastFrame;              // 最後に見えたフレーム(捨てたブリックは負)
+        Voxel voxels[BRICK_VOXELS]; // [z][y][x]
+    };
+
+    struct IntegrateParams
+    {
+        const cv::Mat* depth;
+        CameraIntrinsics intrinsics;
+        RigidTransform worldToCamera;
+        float depthScale;
+        float maxDepth;
+    };
+
+    struct RaycastParams
+    {
+        CameraIntrinsics intrinsics;
+        RigidTransform cameraToWorld;
+        float minDepth;
+        float maxDepth;
+
+        // タイルごとのレイを調べる奥行きの範囲
+        int tilesX;
+        const float* nearZ;
+        const float* farZ;
+    };
+
+    struct BrickTriangles
+    {
+        std::vector<Vec3f> positions;
+        std::vector<unsigned long long> keys;   // 頂点がのっている辺
+    };
+
+    class IntegrateBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        IntegrateBody( TsdfVolume& volume, const IntegrateParams& params )
+            : volume( volume )
+            , params( params )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            for ( int i = range.start; i < range.end; ++i ){
+                volume.integrateBrick( *volume.visible[i], params );
+            }
+        }
+
+    private:
+
+        TsdfVolume& volume;
+        IntegrateParams params;
+    };
+
+    class ExtractBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        ExtractBody( const TsdfVolume& volume, const std::vector<const Brick*>& bricks,
+            std::vector<BrickTriangles>& triangles )
+            : volume( volume )
+            , bricks( bricks )
+            , triangles( triangles )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            for ( int i = range.start; i < range.end; ++i ){
+                volume.extractBrick( *bricks[i], triangles[i] );
+            }
+        }
+
+    private:
+
+        const TsdfVolume& volume;
+        const std::vector<const Brick*>& bricks;
+        std::vector<BrickTriangles>& triangles;
+    };
+
+    class RaycastBody : public cv::ParallelLoopBody
+    {
+    public:
+
+        RaycastBody( const TsdfVolume& volume, const RaycastParams& params, PointMap& map )
+            : volume( volume )
+            , params( params )
+            , map( map )
+        {
+        }
+
+        void operator()( const cv::Range& range ) const
+        {
+            for ( int y = range.start; y < range.end; ++y ){
+                for ( int x = 0; x < map.width; ++x ){
+                    volume.raycastPixel( x, y, params, map.points[y * map.width + x],
+                        map.normals[y * map.width + x] );
+                }
+            }
+        }
+
+    private:
+
+        const TsdfVolume& volume;
+        RaycastParams params;
+        PointMap& map;
+    };
+
+    // ブリックの座標からハッシュのキーを作る(各21ビット)
+    static unsigned long long brickKey( int x, int y, int z )
+    {
+        const unsigned long long mask = (1 << 21) - 1;
+        return (((unsigned long long)(x + (1 << 20)) & mask) << 42) |
+               (((unsigned long long)(y + (1 << 20)) & mask) << 21) |
+               ((unsigned long long)(z + (1 << 20)) & mask);
+    }
+
+    // ボクセル座標と軸から辺のキーを作る(各20ビット + 軸2ビット)
+    static unsigned long long edgeKey( int x, int y, int z, int axis )
+    {
+        const unsigned long long mask = (1 << 20) - 1;
+        return (((unsigned long long)(x + (1 << 19)) & mask) << 42) |
+               (((unsigned long long)(y + (1 << 19)) & mask) << 22) |
+               (((unsigned long long)(z + (1 << 19)) & mask) << 2) |
+               (unsigned long long)axis;
+    }
+
+    Brick* findBrick( int x, int y, int z ) const
+    {
+        auto it = brickMap.find( brickKey( x, y, z ) );
+        return (it != brickMap.end()) ? it->second : nullptr;
+    }
+
+    static int floorDiv( int v )
+    {
+        return (v >= 0) ? (v / BRICK_SIZE) : ((v - BRICK_SIZE + 1) / BRICK_SIZE);
+    }
+
+    // 位置[m]の値を周りの8つのボクセルから線形補間する(未観測のボクセルがあれば false)
+    //   cache : 前に使ったブリック(同じブリックならハッシュを引かない)
+    bool sampleTsdf( const Vec3f& p, const Brick*& cache, float& value ) const
+    {
+        float fx = p.x / voxelSize, fy = p.y / voxelSize, fz = p.z / voxelSize;
+        int x = (int)floorf( fx ), y = (int)floorf( fy ), z = (int)floorf( fz );
+        float dx = fx - x, dy = fy - y, dz = fz - z;
+
+        int bx = floorDiv( x ), by = floorDiv( y ), bz = floorDiv( z );
+        if ( (cache == nullptr) || (cache->x != bx) || (cache->y != by) || (cache->z != bz) ){
+            cache = findBrick( bx, by, bz );
+            if ( cache == nullptr ){
+                return false;
+            }
+        }
+
+        // 角が隣のブリックにはみ出すときだけ、隣のブリックを探す
+        int lx = x - bx * BRICK_SIZE, ly = y - by * BRICK_SIZE, lz = z - bz * BRICK_SIZE;
+        const Brick* neighbors[8] = { cache };
+        bool isSearched[8] = { true };
+
+        value = 0;
+        for ( int c = 0; c < 8; ++c ){
+            int cx = lx + (c & 1), cy = ly + ((c >> 1) & 1), cz = lz + ((c >> 2) & 1);
+            int n = (cx / BRICK_SIZE) | ((cy / BRICK_SIZE) << 1) | ((cz / BRICK_SIZE) << 2);
+            if ( !isSearched[n] ){
+                neighbors[n] = findBrick( bx + (n & 1), by + ((n >> 1) & 1), bz + ((n >> 2) & 1) );
+                isSearched[n] = true;
+            }
+            if ( neighbors[n] == nullptr ){
+                return false;
+            }
+
+            const Voxel& voxel = neighbors[n]->voxels[((cz % BRICK_SIZE) * BRICK_SIZE + (cy % BRICK_SIZE)) * BRICK_SIZE + (cx % BRICK_SIZE)];
+            if ( voxel.weight == 0 ){
+                return false;
+            }
+
+            float w = ((c & 1) ? dx : 1 - dx) * (((c >> 1) & 1) ? dy : 1 - dy) * (((c >> 2) & 1) ? dz : 1 - dz);
+            value += w * (voxel.tsdf / 32767.0f);
+        }
+        return true;
+    }
+
+    // ブリックを画像に投影して、タイルごとにレイを調べる奥行きの範囲を求める
+    // (何もない空間をレイで進まなくて済むようにする)
+    void computeRayRanges( RaycastParams& params, std::vector<float>& nearZ, std::vector<float>& farZ ) const
+    {
+        const auto& K = params.intrinsics;
+        int tilesX = (K.width + RAY_TILE - 1) / RAY_TILE, tilesY = (K.height + RAY_TILE - 1) / RAY_TILE;
+        nearZ.assign( tilesX * tilesY, params.maxDepth );
+        farZ.assign( tilesX * tilesY, 0.0f );
+
+        RigidTransform worldToCamera = params.cameraToWorld.inverse();
+        float brickLength = voxelSize * BRICK_SIZE;
+        for ( const auto& brick : bricks ){
+            if ( brick.lastFrame < 0 ){
+                continue;
+            }
+
+            // ブリックの8つの角を投影して、囲む範囲を求める
+            float zMin = 1e9f, zMax = -1e9f, uMin = 1e9f, uMax = -1e9f, vMin = 1e9f, vMax = -1e9f;
+            bool isBehind = false;
+            for ( int c = 0; c < 8; ++c ){
+                Vec3f p = worldToCamera * makeVec3f( (brick.x + (c & 1)) * brickLength,
+                    (brick.y + ((c >> 1) & 1)) * brickLength, (brick.z + ((c >> 2) & 1)) * brickLength );
+                zMin = std::min( zMin, p.z );
+                zMax = std::max( zMax, p.z );
+                if ( p.z <= 0 ){
+                    isBehind = true;
+                    continue;
+                }
+
+                float u = p.x * K.fx / p.z + K.cx, v = p.y * K.fy / p.z + K.cy;
+                uMin = std::min( uMin, u );
+                uMax = std::max( uMax, u );
+                vMin = std::min( vMin, v );
+                vMax = std::max( vMax, v );
+            }
+            if ( (zMax < params.minDepth) || (zMin > params.maxDepth) ){
+                continue;
+            }
+
+            // カメラの後ろにかかるブリックは、画像全体にかかるものとする
+            int x0 = 0, y0 = 0, x1 = tilesX - 1, y1 = tilesY - 1;
+            if ( !isBehind ){
+                x0 = std::max( x0, (int)std::max( uMin / RAY_TILE, -1.0f ) );
+                y0 = std::max( y0, (int)std::max( vMin / RAY_TILE, -1.0f ) );
+                x1 = std::min( x1, (int)std::min( floorf( uMax / RAY_TILE ), (float)tilesX ) );
+                y1 = std::min( y1, (int)std::min( floorf( vMax / RAY_TILE ), (float)tilesY ) );
+            }
+
+            for ( int ty = y0; ty <= y1; ++ty ){
+                for ( int tx = x0; tx <= x1; ++tx ){
+                    int i = ty * tilesX + tx;
+                    nearZ[i] = std::min( nearZ[i], std::max( zMin, params.minDepth ) );
+                    farZ[i] = std::max( farZ[i], std::min( zMax, params.maxDepth ) );
+                }
+            }
+        }
+
+        params.tilesX = tilesX;
+        params.nearZ = &nearZ[0];
+        params.farZ = &farZ[0];
+    }
+
+    // 1つの画素のレイで、正から負に変わる(カメラから見える)表面を探す
+    void raycastPixel( int u, int v, const RaycastParams& params, Vec3f& point, Vec3f& normal ) const
+    {
+        const auto& K = params.intrinsics;
+        Vec3f origin = params.cameraToWorld.t;
+        Vec3f dir = params.cameraToWorld.rotate( makeVec3f( (u - K.cx) / K.fx, (v - K.cy) / K.fy, 1 ) );
+
+        // 奥行き(z)で進む。ブリックがなければブリックの半分、未観測なら truncation の半分、
+        // 観測済みなら表面までの距離の目安だけ進む
+        float brickLength = voxelSize * BRICK_SIZE;
+        const Brick* cache = nullptr;
+        float prevT = 0, prevValue = 0, step = 0;
+        bool isPrevValid = false;
+        int tile = (v / RAY_TILE) * params.tilesX + (u / RAY_TILE);
+        float farZ = params.farZ[tile];
+        for ( float t = params.nearZ[tile]; t <= farZ; t += step ){
+            Vec3f p = origin + dir * t;
+            int bx = (int)floorf( p.x / brickLength ), by = (int)floorf( p.y / brickLength ), bz = (int)floorf( p.z / brickLength );
+            if ( (cache == nullptr) || (cache->x != bx) || (cache->y != by) || (cache->z != bz) ){
+                const Brick* brick = findBrick( bx, by, bz );
+                if ( brick == nullptr ){
+                    isPrevValid = false;
+                    step = brickLength * 0.5f;
+                    continue;
+                }
+                cache = brick;
+            }
+
+            float value;
+            if ( !sampleTsdf( p, cache, value ) ){
+                isPrevValid = false;
+                step = truncation * 0.5f;
+                continue;
+            }
+
+            // 大きく進んで表面の裏側に入ったときは、戻って細かく進み直す
+            if ( !isPrevValid && (value <= 0) && (step > voxelSize) ){
+                t -= step;
+                step = voxelSize;
+                continue;
+            }
+
+            if ( isPrevValid && (prevValue > 0) && (value <= 0) ){
+                // 2つの値から、0 になる位置を線形補間する
+                float ts = prevT + (t - prevT) * prevValue / (prevValue - value);
+                Vec3f s = origin + dir * ts;
+
+                // 法線は値の勾配
+                float g[6];
+                bool isValid = true;
+                for ( int axis = 0; (axis < 3) && isValid; ++axis ){
+                    for ( int sign = 0; (sign < 2) && isValid; ++sign ){
+                        Vec3f q = s;
+                        float offset = sign ? voxelSize : -voxelSize;
+                        if ( axis == 0 ) q.x += offset;
+                        else if ( axis == 1 ) q.y += offset;
+                        else q.z += offset;
+                        isValid = sampleTsdf( q, cache, g[axis * 2 + sign] );
+                    }
+                }
+                if ( isValid ){
+                    Vec3f n = makeVec3f( g[1] - g[0], g[3] - g[2], g[5] - g[4] );
+                    if ( length( n ) > 0 ){
+                        point = s;
+                        normal = normalize( n );
+                    }
+                }
+                return;
+            }
+
+            // 裏側から表面を見たときは、その先は探さない
+            if ( isPrevValid && (prevValue < 0) && (value > 0) ){
+                return;
+            }
+
+            isPrevValid = true;
+            prevT = t;
+            prevValue = value;
+            step = std::max( voxelSize, value * truncation * 0.8f );
+        }
+    }
+
+    // デプスが観測された表面の近くのブリックを確保して、見えているブリックの一覧を作る
+    void allocateBricks( const cv::Mat& depth, const CameraIntrinsics& intrinsics,
+        const RigidTransform& cameraToWorld, float depthScale, float maxDepth )
+    {
+        // ブリックは画素よりずっと大きいので、画素を間引いて調べる
+        const int STRIDE = 2;
+
+        float brickLength = voxelSize * BRICK_SIZE;
+        float inv = 1.0f / brickLength;
+
+        visible.clear();
+        for ( int v = 0; v < depth.rows; v += STRIDE ){
+            const unsigned short* row = depth.ptr<unsigned short>( v );
+            for ( int u = 0; u < depth.cols; u += STRIDE ){
+                float d = row[u] * depthScale;
+                if ( (d <= 0) || (d > maxDepth) ){
+                    continue;
+                }
+
+                float rx = (u - intrinsics.cx) / intrinsics.fx;
+                float ry = (v - intrinsics.cy) / intrinsics.fy;
+
+                // 表面の前後 truncation の範囲を、ブリックの半分の間隔で調べる
+                for ( float s = d - truncation; s < d + truncation + brickLength * 0.5f; s += brickLength * 0.5f ){
+                    float z = std::min( s, d + truncation );
+                    Vec3f p = cameraToWorld * makeVec3f( rx * z, ry * z, z );
+                    int bx = (int)floorf( p.x * inv );
+                    int by = (int)floorf( p.y * inv );
+                    int bz = (int)floorf( p.z * inv );
+
+                    auto& brick = brickMap[brickKey( bx, by, bz )];
+                    if ( brick == nullptr ){
+                        // 捨てたブリックがあれば使いまわす
+                        if ( !freeBricks.empty() ){
+                            brick = freeBricks.back();
+                            freeBricks.pop_back();
+                        }
+                        else {
+                            bricks.push_back( Brick() );
+                            brick = &bricks.back();
+                        }
+                        brick->x = bx;
+                        brick->y = by;
+                        brick->z = bz;
+                        brick->lastFrame = 0;
+                        memset( brick->voxels, 0, sizeof(brick->voxels) );
+                    }
+
+                    if ( brick->lastFrame != frameCount ){
+                        brick->lastFrame = frameCount;
+                        visible.push_back( brick );
+                    }
+                }
+            }
+        }
+    }
+
+    // ブリックが上限を超えたら、このフレームで見えていないブリックを古い順に捨てる
+    // (毎フレーム捨てないように、上限の7/8まで減らす)
+    void evictBricks()
+    {
+        if ( brickMap.size() <= maxBricks ){
+            return;
+        }
+
+        std::vector<Brick*> candidates;
+        for ( auto& brick : bricks ){
+            if ( (brick.lastFrame >= 0) && (brick.lastFrame != frameCount) ){
+                candidates.push_back( &brick );
+            }
+        }
+
+        size_t target = maxBricks - maxBricks / 8;
+        size_t count = std::min( candidates.size(), brickMap.size() - std::min( brickMap.size(), target ) );
+        std::nth_element( candidates.begin(), candidates.begin() + count, candidates.end(),
+            []( const Brick* a, const Brick* b ){ return a->lastFrame < b->lastFrame; } );
+
+        for ( size_t i = 0; i < count; ++i ){
+            Brick* brick = candidates[i];
+            brickMap.erase( brickKey( brick->x, brick->y, brick->z ) );
+            brick->lastFrame = -1;
+            freeBricks.push_back( brick );
+        }
+        evictedCount += count;
+    }
+
+    // 1つのブリックにデプスを統合する
+    void integrateBrick( Brick& brick, const IntegrateParams& params ) const
+    {
+        const auto& K = params.intrinsics;
+        const auto& depth = *params.depth;
+        const auto& T = params.worldToCamera;
+
+        // ボクセルの位置をカメラ座標系で順に求める
+        Vec3f origin = makeVec3f( brick.x * BRICK_SIZE * voxelSize,
+            brick.y * BRICK_SIZE * voxelSize, brick.z * BRICK_SIZE * voxelSize );
+        Vec3f base = T * origin;
+        Vec3f dx = T.rotate( makeVec3f( voxelSize, 0, 0 ) );
+        Vec3f dy = T.rotate( makeVec3f( 0, voxelSize, 0 ) );
+        Vec3f dz = T.rotate( makeVec3f( 0, 0, voxelSize ) );
+
+        float invTruncation = 1.0f / truncation;
+        Voxel* voxel = brick.voxels;
+        for ( int k = 0; k < BRICK_SIZE; ++k ){
+            for ( int j = 0; j < BRICK_SIZE; ++j ){
+                Vec3f p = base + dy * (float)j + dz * (float)k;
+                for ( int i = 0; i < BRICK_SIZE; ++i, ++voxel, p = p + dx ){
+                    if ( p.z <= 0 ){
+                        continue;
+                    }
+
+                    // デプス画像に投影する
+                    float invZ = 1.0f / p.z;
+                    int u = (int)(p.x * K.fx * invZ + K.cx + 0.5f);
+                    int v = (int)(p.y * K.fy * invZ + K.cy + 0.5f);
+                    if ( (u < 0) || (v < 0) || (u >= depth.cols) || (v >= depth.rows) ){
+                        continue;
+                    }
+
+                    float d = depth.at<unsigned short>( v, u ) * params.depthScale;
+                    if ( (d <= 0) || (d > params.maxDepth) ){
+                        continue;
+                    }
+
+                    // 表面より奥の見えない部分は更新しない
+                    float sdf = d - p.z;
+                    if ( sdf < -truncation ){
+                        continue;
+                    }
+
+                    // 重み付き平均で更新する
+                    float tsdf = std::min( 1.0f, sdf * invTruncation );
+                    float weight = voxel->weight;
+                    float value = (voxel->tsdf / 32767.0f * weight + tsdf) / (weight + 1);
+                    voxel->tsdf = (short)(value * 32767.0f);
+                    voxel->weight = (unsigned short)std::min( (int)weight + 1, maxWeight );
+                }
+            }
+        }
+    }
+
+    // 1つのブリックの三角形を求める
+    void extractBrick( const Brick& brick, BrickTriangles& out ) const
+    {
+        // 隣のブリックの境界を含めた 9x9x9 の値を用意する
+        const int N = BRICK_SIZE + 1;
+        float values[N * N * N];
+        bool observed[N * N * N];
+
+        const Brick* neighbors[8];
+        for ( int n = 0; n < 8; ++n ){
+            neighbors[n] = (n == 0) ? &brick :
+                findBrick( brick.x + (n & 1), brick.y + ((n >> 1) & 1), brick.z + ((n >> 2) & 1) );
+        }
+
+        for ( int k = 0; k < N; ++k ){
+            for ( int j = 0; j < N; ++j ){
+                for ( int i = 0; i < N; ++i ){
+                    int n = (i / BRICK_SIZE) | ((j / BRICK_SIZE) << 1) | ((k / BRICK_SIZE) << 2);
+                    int index = (k * N + j) * N + i;
+                    const Brick* b = neighbors[n];
+                    if ( b == nullptr ){
+                        observed[index] = false;
+                        continue;
+                    }
+
+                    const Voxel& voxel = b->voxels[((k % BRICK_SIZE) * BRICK_SIZE + (j % BRICK_SIZE)) * BRICK_SIZE + (i % BRICK_SIZE)];
+                    observed[index] = (voxel.weight > 0);
+                    values[index] = voxel.tsdf / 32767.0f;
+                }
+            }
+        }
+
+        int gx = brick.x * BRICK_SIZE, gy = brick.y * BRICK_SIZE, gz = brick.z * BRICK_SIZE;
+        for ( int k = 0; k < BRICK_SIZE; ++k ){
+            for ( int j = 0; j < BRICK_SIZE; ++j ){
+                for ( int i = 0; i < BRICK_SIZE; ++i ){
+                    // セルの8つの角
+                    float value[8];
+                    bool isValid = true;
+                    for ( int c = 0; c < 8; ++c ){
+                        int index = ((k + ((c >> 2) & 1)) * N + (j + ((c >> 1) & 1))) * N + (i + (c & 1));
+                        isValid = isValid && observed[index];
+                        value[c] = values[index];
+                    }
+                    if ( !isValid ){
+                        continue;
+                    }
+
+                    int cube = MarchingCubes::cubeIndex( value );
+                    const signed char* triangles = MarchingCubes::TRIANGLES[cube];
+                    for ( int t = 0; triangles[t] >= 0; ++t ){
+                        int edge = triangles[t];
+                        int a = MarchingCubes::EDGE_CORNERS[edge][0];
+                        int b = MarchingCubes::EDGE_CORNERS[edge][1];
+                        float s = value[a] / (value[a] - value[b]);
+
+                        // 辺の始点のボクセル座標
+                        int x = gx + i + (a & 1);
+                        int y = gy + j + ((a >> 1) & 1);
+                        int z = gz + k + ((a >> 2) & 1);
+                        int axis = edge / 4;
+
+                        Vec3f p = makeVec3f( (float)x, (float)y, (float)z );
+                        if ( axis == 0 ) p.x += s;
+                        else if ( axis == 1 ) p.y += s;
+                        else p.z += s;
+
+                        out.positions.push_back( p * voxelSize );
+                        out.keys.push_back( edgeKey( x, y, z, axis ) );
+                    }
+                }
+            }
+        }
+    }
+
+private:
+
+    float voxelSize;
+    float truncation;
+    int maxWeight;
+    size_t maxBricks;
+
+    // ブリック(dequeなので追加してもアドレスが変わらない)とハッシュ
+    std::deque<Brick> bricks;
+    std::unordered_map<unsigned long long, Brick*> brickMap;
+
+    // 捨てて使いまわすのを待っているブリック
+    std::vector<Brick*> freeBricks;
+    size_t evictedCount = 0;
+
+    // このフレームで見えているブリック
+    std::vector<Brick*> visible;
+
+    int frameCount = 0;
+
+    double lastMs = 0;
+};